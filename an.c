@@ -0,0 +1,459 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "an.h"
+#include <string.h>
+#include <time.h>
+
+/* Null message page */
+#define _NULL_PAGE      (FM10K_AN_PAGE_MP | 0x1)
+#define _PAGE_MASK      0xffffffffffffULL
+
+/*
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Technology abilities advertised by a port: the modes of its configured
+ * speed only, since the SerDes lane rate is fixed at bring-up
+ */
+uint32_t
+fm10k_an_abilities(const fm10k_port_cfg_t *port)
+{
+    switch ( port->speed ) {
+    case 100000:
+        return FM10K_AN_100GBASE_KR4 | FM10K_AN_100GBASE_CR4;
+    case 40000:
+        return FM10K_AN_40GBASE_KR4 | FM10K_AN_40GBASE_CR4;
+    case 25000:
+        return FM10K_AN_25GBASE_KR | FM10K_AN_25GBASE_KRS;
+    case 10000:
+        return FM10K_AN_10GBASE_KR;
+    default:
+        return FM10K_AN_1000BASE_KX;
+    }
+}
+
+/*
+ * Build a base page
+ */
+uint64_t
+fm10k_an_base_page(uint32_t tech, int fec, int nonce)
+{
+    uint64_t page;
+
+    /* IEEE 802.3 selector, symmetric pause, BASE-R FEC ability */
+    page = 0x1 | (1ULL << 10) | ((uint64_t)(nonce & 0x1f) << 16)
+        | ((uint64_t)(tech & 0x7ff) << FM10K_AN_TECH_SHIFT) | FM10K_AN_F0;
+    if ( fec ) {
+        page |= FM10K_AN_F1 | FM10K_AN_F2;
+    }
+
+    return page;
+}
+
+/*
+ * Resolve the highest common mode and its FEC from the base pages
+ */
+int
+fm10k_an_resolve(uint64_t local, uint64_t lp, int *speed, int *fec)
+{
+    uint32_t common;
+
+    common = (local >> FM10K_AN_TECH_SHIFT) & (lp >> FM10K_AN_TECH_SHIFT)
+        & 0x7ff;
+    *fec = FM10K_AN_FEC_NONE;
+    if ( common & (FM10K_AN_100GBASE_KR4 | FM10K_AN_100GBASE_CR4
+                   | FM10K_AN_100GBASE_KP4 | FM10K_AN_100GBASE_CR10) ) {
+        /* Clause 91 RS-FEC is mandatory */
+        *speed = 100000;
+        *fec = FM10K_AN_FEC_RS;
+    } else if ( common & (FM10K_AN_40GBASE_KR4 | FM10K_AN_40GBASE_CR4) ) {
+        *speed = 40000;
+    } else if ( common & FM10K_AN_25GBASE_KR ) {
+        *speed = 25000;
+        if ( (local | lp) & FM10K_AN_F2 ) {
+            *fec = FM10K_AN_FEC_RS;
+        } else if ( (local | lp) & FM10K_AN_F3 ) {
+            *fec = FM10K_AN_FEC_BASER;
+        }
+        return 0;
+    } else if ( common & FM10K_AN_25GBASE_KRS ) {
+        /* No RS-FEC in the short-reach mode */
+        *speed = 25000;
+        if ( (local | lp) & (FM10K_AN_F2 | FM10K_AN_F3) ) {
+            *fec = FM10K_AN_FEC_BASER;
+        }
+        return 0;
+    } else if ( common & (FM10K_AN_10GBASE_KR | FM10K_AN_10GBASE_KX4) ) {
+        *speed = 10000;
+    } else if ( common & FM10K_AN_1000BASE_KX ) {
+        *speed = 1000;
+        return 0;
+    } else {
+        return -1;
+    }
+
+    /* Clause 74 FEC for 10G/40G: both able and either requests */
+    if ( *speed != 100000 && (local & lp & FM10K_AN_F0)
+         && ((local | lp) & FM10K_AN_F1) ) {
+        *fec = FM10K_AN_FEC_BASER;
+    }
+
+    return 0;
+}
+
+/*
+ * Initialize the engine for the auto-negotiated ports of a port set
+ */
+int
+fm10k_an_init(fm10k_an_t *an, fm10k_t *fm10k, const fm10k_ports_t *ports)
+{
+    fm10k_an_port_t *p;
+    int i;
+
+    memset(an, 0, sizeof(fm10k_an_t));
+    an->fm10k = fm10k;
+    an->timeout_ms = 3000;
+    for ( i = 0; i < ports->n; i++ ) {
+        if ( !ports->port[i].an || ports->port[i].epl < 0 ) {
+            continue;
+        }
+        p = &an->ports[an->n++];
+        p->cfg = &ports->port[i];
+        p->tech = fm10k_an_abilities(p->cfg);
+        p->state = FM10K_AN_START;
+    }
+
+    return an->n;
+}
+
+/*
+ * Queue a message or unformatted next page to send after the base page
+ */
+int
+fm10k_an_add_next_page(fm10k_an_t *an, int logical, uint64_t page)
+{
+    int i;
+
+    for ( i = 0; i < an->n; i++ ) {
+        if ( an->ports[i].cfg->logical != logical ) {
+            continue;
+        }
+        if ( an->ports[i].nnp >= FM10K_AN_NP_MAX ) {
+            return -1;
+        }
+        an->ports[i].np[an->ports[i].nnp++] = page & _PAGE_MASK
+            & ~(FM10K_AN_PAGE_NP | FM10K_AN_PAGE_ACK);
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Start (or restart) a negotiation
+ */
+static void
+_start(fm10k_an_t *an, fm10k_an_port_t *p, uint64_t now)
+{
+    const fm10k_port_cfg_t *cfg;
+    int nonce;
+
+    cfg = p->cfg;
+    p->npidx = 0;
+    p->lp_nnp = 0;
+    p->lp_more = 0;
+    p->attempts++;
+    if ( !p->first ) {
+        p->first = now;
+    }
+    p->deadline = now + an->timeout_ms * 1000000ULL;
+    p->state = FM10K_AN_BASE;
+
+    /* Clear stale events */
+    wr32(an->fm10k->mmio, FM10K_AN_IP(cfg->epl, cfg->lane), 0x1f);
+    if ( cfg->speed == 1000 ) {
+        /* Clause 37 */
+        wr32(an->fm10k->mmio, FM10K_AN_37_CFG(cfg->epl, cfg->lane), 0x3);
+        return;
+    }
+
+    /* Hand the port back to the Clause 73 PCS after a resolved attempt */
+    fm10k_port_set_mode(an->fm10k, cfg, 0, 0);
+    nonce = (int)((now >> 10) + cfg->logical * 11);
+    p->base = fm10k_an_base_page(p->tech, cfg->fec, nonce);
+    if ( p->nnp ) {
+        p->base |= FM10K_AN_PAGE_NP;
+    }
+    wr64(an->fm10k->mmio, FM10K_AN_73_BASE_PAGE_TX(cfg->epl, cfg->lane),
+         p->base);
+    wr32(an->fm10k->mmio, FM10K_AN_73_CFG(cfg->epl, cfg->lane), 0x3);
+}
+
+/*
+ * Send our next queued page, or a null page once ours are exhausted
+ */
+static void
+_send_np(fm10k_an_t *an, fm10k_an_port_t *p)
+{
+    uint64_t page;
+
+    if ( p->npidx < p->nnp ) {
+        page = p->np[p->npidx++];
+        if ( p->npidx < p->nnp ) {
+            page |= FM10K_AN_PAGE_NP;
+        }
+    } else {
+        page = _NULL_PAGE;
+    }
+    wr64(an->fm10k->mmio,
+         FM10K_AN_73_NEXT_PAGE_TX(p->cfg->epl, p->cfg->lane), page);
+    /* Enable | NextPageValid */
+    wr32(an->fm10k->mmio, FM10K_AN_73_CFG(p->cfg->epl, p->cfg->lane), 0x5);
+}
+
+/*
+ * Give up the current attempt
+ */
+static void
+_retry(fm10k_an_t *an, fm10k_an_port_t *p)
+{
+    if ( an->max_attempts && p->attempts >= an->max_attempts ) {
+        p->state = FM10K_AN_FAILED;
+    } else {
+        p->state = FM10K_AN_START;
+    }
+}
+
+/*
+ * Restart the negotiation of a port (e.g., on link loss)
+ */
+int
+fm10k_an_restart(fm10k_an_t *an, int logical)
+{
+    int i;
+
+    for ( i = 0; i < an->n; i++ ) {
+        if ( an->ports[i].cfg->logical == logical ) {
+            an->ports[i].state = FM10K_AN_START;
+            an->ports[i].attempts = 0;
+            an->ports[i].first = 0;
+            an->ports[i].linkup = 0;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Advance one port without blocking
+ */
+static void
+_poll_port(fm10k_an_t *an, fm10k_an_port_t *p, uint64_t now)
+{
+    const fm10k_port_cfg_t *cfg;
+    uint64_t page;
+    uint32_t ip;
+
+    cfg = p->cfg;
+    switch ( p->state ) {
+    case FM10K_AN_START:
+        _start(an, p, now);
+        return;
+    case FM10K_AN_BASE:
+    case FM10K_AN_NEXT:
+    case FM10K_AN_GOOD:
+        ip = rd32(an->fm10k->mmio, FM10K_AN_IP(cfg->epl, cfg->lane));
+        break;
+    case FM10K_AN_LINK:
+        if ( rd32(an->fm10k->mmio, FM10K_PORT_STATUS(cfg->epl, cfg->lane))
+             & 1 ) {
+            p->state = FM10K_AN_UP;
+            p->linkup = now;
+            return;
+        }
+        if ( now > p->deadline ) {
+            _retry(an, p);
+        }
+        return;
+    default:
+        return;
+    }
+
+    if ( cfg->speed == 1000 ) {
+        /* Clause 37: full duplex only, the PCS applies pause */
+        if ( ip & (1 << 4) ) {
+            wr32(an->fm10k->mmio, FM10K_AN_IP(cfg->epl, cfg->lane), 1 << 4);
+            p->lp_base = rd32(an->fm10k->mmio,
+                              FM10K_AN_37_PAGE_RX(cfg->epl, cfg->lane));
+            if ( !(p->lp_base & (1 << 5)) ) {
+                _retry(an, p);
+                return;
+            }
+            p->speed = 1000;
+            p->fec = FM10K_AN_FEC_NONE;
+            p->state = FM10K_AN_LINK;
+            p->deadline = now + an->timeout_ms * 1000000ULL;
+        } else if ( now > p->deadline ) {
+            _retry(an, p);
+        }
+        return;
+    }
+
+    if ( ip & 1 ) {
+        /* Page received */
+        wr32(an->fm10k->mmio, FM10K_AN_IP(cfg->epl, cfg->lane), 1);
+        page = rd64(an->fm10k->mmio,
+                    FM10K_AN_73_PAGE_RX(cfg->epl, cfg->lane)) & _PAGE_MASK;
+        if ( FM10K_AN_BASE == p->state ) {
+            if ( ((page >> 16) & 0x1f) == ((p->base >> 16) & 0x1f) ) {
+                /* Nonce match: our own page looped back */
+                p->state = FM10K_AN_START;
+                return;
+            }
+            p->lp_base = page;
+        } else if ( p->lp_nnp < FM10K_AN_NP_MAX ) {
+            p->lp_np[p->lp_nnp++] = page;
+        }
+        p->lp_more = (page & FM10K_AN_PAGE_NP) ? 1 : 0;
+        if ( p->lp_more || p->npidx < p->nnp ) {
+            _send_np(an, p);
+            p->state = FM10K_AN_NEXT;
+        } else {
+            p->state = FM10K_AN_GOOD;
+        }
+    }
+    if ( (ip & 2) && FM10K_AN_GOOD == p->state ) {
+        /* AN_GOOD_CHECK: switch to the resolved PCS */
+        wr32(an->fm10k->mmio, FM10K_AN_IP(cfg->epl, cfg->lane), 2);
+        /* A lower common speed would need another lane rate: reject it */
+        if ( fm10k_an_resolve(p->base, p->lp_base, &p->speed, &p->fec) < 0
+             || p->speed != cfg->speed
+             || fm10k_port_set_mode(an->fm10k, cfg, p->speed,
+                                    p->fec != FM10K_AN_FEC_NONE) < 0 ) {
+            _retry(an, p);
+            return;
+        }
+        p->state = FM10K_AN_LINK;
+        p->deadline = now + an->timeout_ms * 1000000ULL;
+        return;
+    }
+    if ( now > p->deadline ) {
+        _retry(an, p);
+    }
+}
+
+/*
+ * Advance every negotiation by one step; returns the number of ports that
+ * are neither up nor failed
+ */
+int
+fm10k_an_poll(fm10k_an_t *an)
+{
+    uint64_t now;
+    int pending;
+    int i;
+
+    now = _now();
+    pending = 0;
+    for ( i = 0; i < an->n; i++ ) {
+        _poll_port(an, &an->ports[i], now);
+        if ( an->ports[i].state != FM10K_AN_UP
+             && an->ports[i].state != FM10K_AN_FAILED ) {
+            pending++;
+        }
+    }
+
+    return pending;
+}
+
+/*
+ * Run all negotiations concurrently until they finish or the timeout
+ * expires; returns the number of ports still pending
+ */
+int
+fm10k_an_run(fm10k_an_t *an, int timeout_ms)
+{
+    struct timespec ts;
+    uint64_t deadline;
+    int pending;
+
+    /* Poll every 1 ms */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 1000000L;
+    deadline = _now() + timeout_ms * 1000000ULL;
+    while ( (pending = fm10k_an_poll(an)) > 0 && _now() < deadline ) {
+        nanosleep(&ts, NULL);
+    }
+
+    return pending;
+}
+
+/*
+ * Print the negotiation results
+ */
+void
+fm10k_an_print(FILE *fp, const fm10k_an_t *an)
+{
+    static const char *fecs[] = { "no FEC", "BASE-R FEC", "RS-FEC" };
+    const fm10k_an_port_t *p;
+    int i;
+
+    for ( i = 0; i < an->n; i++ ) {
+        p = &an->ports[i];
+        fprintf(fp, "Port %d: ", p->cfg->logical);
+        switch ( p->state ) {
+        case FM10K_AN_UP:
+            fprintf(fp, "%dG %s, link up in %.1f ms (%d attempts)\n",
+                    p->speed / 1000, fecs[p->fec],
+                    (p->linkup - p->first) / 1e6, p->attempts);
+            break;
+        case FM10K_AN_FAILED:
+            fprintf(fp, "failed after %d attempts\n", p->attempts);
+            break;
+        default:
+            fprintf(fp, "negotiating (attempt %d)\n", p->attempts);
+        }
+    }
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,159 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _AN_H
+#define _AN_H
+
+#include "fm10k.h"
+#include "port.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Clause 73 base page
+ * 4:0   Selector (1: IEEE 802.3)
+ * 9:5   EchoedNonce
+ * 12:10 Pause
+ * 13    RemoteFault
+ * 14    Ack
+ * 15    NextPage
+ * 20:16 TransmittedNonce
+ * 45:21 TechnologyAbility
+ * 44    F2: 25G RS-FEC requested (within the ability field)
+ * 45    F3: 25G BASE-R FEC requested (within the ability field)
+ * 46    F0: 10G/40G BASE-R FEC ability
+ * 47    F1: 10G/40G BASE-R FEC requested
+ */
+#define FM10K_AN_PAGE_NP        (1ULL << 15)
+#define FM10K_AN_PAGE_ACK       (1ULL << 14)
+#define FM10K_AN_PAGE_MP        (1ULL << 13)
+#define FM10K_AN_TECH_SHIFT     21
+#define FM10K_AN_F2             (1ULL << 44)
+#define FM10K_AN_F3             (1ULL << 45)
+#define FM10K_AN_F0             (1ULL << 46)
+#define FM10K_AN_F1             (1ULL << 47)
+
+/* Technology ability bits (A0..A10) */
+#define FM10K_AN_1000BASE_KX    (1 << 0)
+#define FM10K_AN_10GBASE_KX4    (1 << 1)
+#define FM10K_AN_10GBASE_KR     (1 << 2)
+#define FM10K_AN_40GBASE_KR4    (1 << 3)
+#define FM10K_AN_40GBASE_CR4    (1 << 4)
+#define FM10K_AN_100GBASE_CR10  (1 << 5)
+#define FM10K_AN_100GBASE_KP4   (1 << 6)
+#define FM10K_AN_100GBASE_KR4   (1 << 7)
+#define FM10K_AN_100GBASE_CR4   (1 << 8)
+#define FM10K_AN_25GBASE_KRS    (1 << 9)
+#define FM10K_AN_25GBASE_KR     (1 << 10)
+
+/* Resolved FEC */
+#define FM10K_AN_FEC_NONE       0
+#define FM10K_AN_FEC_BASER      1
+#define FM10K_AN_FEC_RS         2
+
+/* Attempts per port of the negotiations started at boot */
+#define FM10K_AN_BOOT_ATTEMPTS  5
+
+/* Next pages a port may send in addition to null pages */
+#define FM10K_AN_NP_MAX         4
+
+/* Port states */
+#define FM10K_AN_DISABLED       0
+#define FM10K_AN_START          1
+#define FM10K_AN_BASE           2
+#define FM10K_AN_NEXT           3
+#define FM10K_AN_GOOD           4
+#define FM10K_AN_LINK           5
+#define FM10K_AN_UP             6
+#define FM10K_AN_FAILED         7
+
+/*
+ * Per-port negotiation
+ */
+typedef struct _fm10k_an_port {
+    const fm10k_port_cfg_t *cfg;
+    int state;
+    /* Local abilities and pages */
+    uint32_t tech;
+    uint64_t base;
+    uint64_t np[FM10K_AN_NP_MAX];
+    int nnp;
+    int npidx;
+    /* Link partner pages */
+    uint64_t lp_base;
+    uint64_t lp_np[FM10K_AN_NP_MAX];
+    int lp_nnp;
+    /* Next page exchange: partner has more pages */
+    int lp_more;
+    /* Resolved mode */
+    int speed;
+    int fec;
+    /* Timing (ns) */
+    uint64_t first;
+    uint64_t deadline;
+    uint64_t linkup;
+    int attempts;
+} fm10k_an_port_t;
+
+/*
+ * Auto-negotiation engine
+ */
+typedef struct _fm10k_an {
+    fm10k_t *fm10k;
+    fm10k_an_port_t ports[FM10K_PORT_MAX];
+    int n;
+    /* Per-attempt timeout and attempt limit (0: unlimited) */
+    int timeout_ms;
+    int max_attempts;
+} fm10k_an_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t fm10k_an_abilities(const fm10k_port_cfg_t *);
+uint64_t fm10k_an_base_page(uint32_t, int, int);
+int fm10k_an_resolve(uint64_t, uint64_t, int *, int *);
+int fm10k_an_init(fm10k_an_t *, fm10k_t *, const fm10k_ports_t *);
+int fm10k_an_add_next_page(fm10k_an_t *, int, uint64_t);
+int fm10k_an_restart(fm10k_an_t *, int);
+int fm10k_an_poll(fm10k_an_t *);
+int fm10k_an_run(fm10k_an_t *, int);
+void fm10k_an_print(FILE *, const fm10k_an_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _AN_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,695 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "libfm10k.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Scratch registers exercised by the register benchmarks; the low words
+   hold the lock owner and NVM state */
+#define SCRATCH_BASE            512
+#define SCRATCH_WORDS           512
+#define SCRATCH(i)              \
+    FM10K_BSM_SCRATCH(SCRATCH_BASE + (i) % SCRATCH_WORDS)
+
+/* Accesses per register benchmark sample */
+#define REG_OPS                 4096
+
+/* Entries per table load sample */
+#define TABLE_OPS               4096
+
+/* Backend without a device */
+#ifdef FM10K_MODEL
+#define BACKEND                 "model"
+#else
+#define BACKEND                 "sim"
+#endif
+
+/*
+ * Benchmark state
+ */
+typedef struct _bench {
+    fm10k_t fm10k;
+    /* Simulated BAR4; reset before each destructive sample */
+    int sim;
+#ifdef FM10K_MODEL
+    fm10k_model_t model;
+#endif
+    fm10k_ports_t ports;
+    /* Ports with an EPL lane */
+    int neth;
+    uint32_t scratch[SCRATCH_WORDS];
+    fm10k_port_stats_t st[FM10K_PORT_MAX];
+    fm10k_glort_t glort;
+    fm10k_policer_t policer;
+    fm10k_policer_spec_t specs[TABLE_OPS];
+    fm10k_te_t te;
+    fm10k_tunnel_t tunnels[TABLE_OPS];
+} bench_t;
+
+/*
+ * Benchmark: one sample takes ops operations; returns -1 if the sample
+ * failed, which leaves it out of the times and marks the result invalid
+ */
+typedef struct _bench_def {
+    const char *name;
+    /* What one operation is */
+    const char *unit;
+    /* Operations per sample; 0 for one per Ethernet port */
+    int ops;
+    /* Changes the switch state; needs -f on a device */
+    int destructive;
+    int (*run)(bench_t *, int, uint64_t *);
+} bench_def_t;
+
+/* Sink of the register reads */
+static volatile uint32_t _sink;
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-f] [-n samples] [-t names] [-o output] "
+#ifdef FM10K_MODEL
+            "[-m key=value] "
+#endif
+            "[<uio device>]\n"
+            "  -f  run the benchmarks that reset or reprogram the device\n"
+            "  -n  samples per benchmark (default 25)\n"
+            "  -t  comma-separated benchmarks to run (default all)\n"
+            "  -o  JSON output file (default stdout)\n"
+#ifdef FM10K_MODEL
+            "  -m  model setting key=value (nvm_version, nvm_hold_ns, "
+            "lock_ns,\n      pll_lock_ns, bist_ns, steals, systime_hz, "
+            "faults=lock-stuck,\n      lock-steal,pll-fabric,pll-epl,"
+            "bist-hang)\n"
+            "Without a device, the behavioral device model is used.\n",
+#else
+            "Without a device, the simulated BAR4 is used.\n",
+#endif
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Return the simulated switch to its power-on state
+ */
+static void
+_reset(bench_t *b)
+{
+    if ( b->sim ) {
+#ifdef FM10K_MODEL
+        fm10k_model_reset(&b->model);
+#else
+        fm10k_sim_reset(&b->fm10k);
+#endif
+    }
+}
+
+/*
+ * rd32 over the scratch registers
+ */
+static int
+_run_rd32(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    uint32_t acc;
+    int i;
+
+    (void)s;
+    acc = 0;
+    t0 = _now();
+    for ( i = 0; i < REG_OPS; i++ ) {
+        acc += rd32(b->fm10k.mmio, SCRATCH(i));
+    }
+    *ns = _now() - t0;
+    _sink = acc;
+
+    return 0;
+}
+
+/*
+ * wr32 over the scratch registers clear of the lock and NVM words; the
+ * values read at startup are written back so the contents are preserved
+ */
+static int
+_run_wr32(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int i;
+
+    (void)s;
+    t0 = _now();
+    for ( i = 0; i < REG_OPS; i++ ) {
+        wr32(b->fm10k.mmio, SCRATCH(i), b->scratch[i % SCRATCH_WORDS]);
+    }
+    *ns = _now() - t0;
+
+    return 0;
+}
+
+/*
+ * Scheduler memory initialization
+ */
+static int
+_run_sched(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int ret;
+
+    (void)s;
+    _reset(b);
+    t0 = _now();
+    ret = fm10k_boot_scheduler(&b->fm10k);
+    *ns = _now() - t0;
+
+    return ret;
+}
+
+/*
+ * Reset stage of the boot sequence
+ */
+static int
+_run_boot_reset(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int ret;
+
+    (void)s;
+    _reset(b);
+    t0 = _now();
+    ret = fm10k_boot_reset(&b->fm10k);
+    *ns = _now() - t0;
+
+    return ret;
+}
+
+/*
+ * Reset, frame handler clock and release stages of the boot sequence
+ */
+static int
+_run_boot_release(bench_t *b, int s, uint64_t *ns)
+{
+    fm10k_clock_t clk;
+    uint64_t t0;
+    int ret;
+
+    (void)s;
+    _reset(b);
+    t0 = _now();
+    ret = fm10k_boot_reset(&b->fm10k);
+    if ( 0 == ret ) {
+        ret = fm10k_boot_clock(&b->fm10k, FM10K_CLOCK_MAX_THROUGHPUT, &clk);
+    }
+    if ( 0 == ret ) {
+        ret = fm10k_boot_release(&b->fm10k, &clk);
+    }
+    *ns = _now() - t0;
+
+    return ret;
+}
+
+/*
+ * End-to-end boot
+ */
+static int
+_run_boot_switch(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int ret;
+
+    (void)s;
+    _reset(b);
+    t0 = _now();
+    ret = fm10k_boot_switch(&b->fm10k, &b->ports,
+                            FM10K_CLOCK_MAX_THROUGHPUT);
+    *ns = _now() - t0;
+
+    return ret;
+}
+
+/*
+ * Error counters of all Ethernet ports
+ */
+static int
+_run_counters(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int n;
+
+    (void)s;
+    t0 = _now();
+    n = fm10k_stats_read(&b->fm10k, &b->ports, b->st, FM10K_PORT_MAX);
+    *ns = _now() - t0;
+
+    return n == b->neth ? 0 : -1;
+}
+
+/*
+ * GLORT destination table: set and commit every entry of a range
+ */
+static int
+_run_glort(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int ret;
+    int i;
+
+    _reset(b);
+    fm10k_glort_init(&b->glort, &b->fm10k);
+    if ( fm10k_glort_alloc_range(&b->glort, 0x1000, TABLE_OPS) < 0 ) {
+        *ns = 0;
+        return -1;
+    }
+    ret = 0;
+    t0 = _now();
+    for ( i = 0; i < TABLE_OPS; i++ ) {
+        ret |= fm10k_glort_set_dest(&b->glort, 0x1000 + i,
+                                    1ULL << ((i + s) % FM10K_PORT_MAX));
+    }
+    if ( fm10k_glort_commit(&b->glort) != TABLE_OPS ) {
+        ret = -1;
+    }
+    *ns = _now() - t0;
+
+    return ret;
+}
+
+/*
+ * Policer bank 0: program every entry with a rate differing from the
+ * previous sample
+ */
+static int
+_run_policer(bench_t *b, int s, uint64_t *ns)
+{
+    uint64_t t0;
+    int ret;
+    int i;
+
+    _reset(b);
+    for ( i = 0; i < TABLE_OPS; i++ ) {
+        b->specs[i].bank = 0;
+        b->specs[i].index = i;
+        b->specs[i].cir = 1000000ULL * (1 + i % 1000) * (1 + s % 2);
+        b->specs[i].cbs = 65536;
+        b->specs[i].eir = b->specs[i].cir;
+        b->specs[i].ebs = 65536;
+    }
+    t0 = _now();
+    ret = fm10k_policer_set_bulk(&b->policer, b->specs, TABLE_OPS);
+    *ns = _now() - t0;
+
+    return ret == TABLE_OPS ? 0 : -1;
+}
+
+/*
+ * Tunnel engines: provision a batch of VXLAN tunnels
+ */
+static int
+_run_tunnels(bench_t *b, int s, uint64_t *ns)
+{
+    fm10k_te_cfg_t cfg;
+    uint64_t t0;
+    int ret;
+    int i;
+
+    _reset(b);
+    fm10k_te_default_cfg(&cfg);
+    if ( fm10k_te_init(&b->te, &b->fm10k, &cfg) < 0 ) {
+        *ns = 0;
+        return -1;
+    }
+    memset(b->tunnels, 0, sizeof(b->tunnels));
+    for ( i = 0; i < TABLE_OPS; i++ ) {
+        b->tunnels[i].type = FM10K_TUNNEL_VXLAN;
+        b->tunnels[i].vni = 1000 + i;
+        b->tunnels[i].dip = 0x0a000000 | i;
+        b->tunnels[i].weight = 1 + (i * 7 + s) % 100;
+    }
+    t0 = _now();
+    ret = fm10k_te_add_tunnels(&b->te, b->tunnels, TABLE_OPS);
+    *ns = _now() - t0;
+
+    return ret < 0 ? -1 : 0;
+}
+
+static const bench_def_t _benches[] = {
+    { "rd32", "register", REG_OPS, 0, _run_rd32 },
+    { "wr32", "register", REG_OPS, 0, _run_wr32 },
+    { "counter_sweep", "port", 0, 0, _run_counters },
+    { "sched_init", "init", 1, 1, _run_sched },
+    { "boot_reset", "boot", 1, 1, _run_boot_reset },
+    { "boot_release", "boot", 1, 1, _run_boot_release },
+    { "boot_switch", "boot", 1, 1, _run_boot_switch },
+    { "glort_load", "entry", TABLE_OPS, 1, _run_glort },
+    { "policer_load", "entry", TABLE_OPS, 1, _run_policer },
+    { "tunnel_load", "tunnel", TABLE_OPS, 1, _run_tunnels },
+};
+
+/*
+ * Check whether name is in the comma-separated list
+ */
+static int
+_selected(const char *list, const char *name)
+{
+    size_t len;
+    const char *p;
+
+    if ( NULL == list ) {
+        return 1;
+    }
+    len = strlen(name);
+    p = list;
+    while ( NULL != p ) {
+        if ( strncmp(p, name, len) == 0
+             && ('\0' == p[len] || ',' == p[len]) ) {
+            return 1;
+        }
+        p = strchr(p, ',');
+        if ( NULL != p ) {
+            p++;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Order doubles
+ */
+static int
+_cmp(const void *a, const void *b)
+{
+    double x;
+    double y;
+
+    x = *(const double *)a;
+    y = *(const double *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Nearest-rank percentile of sorted samples
+ */
+static double
+_percentile(const double *v, int n, double p)
+{
+    int i;
+
+    i = (int)ceil(p / 100 * n) - 1;
+
+    return v[i < 0 ? 0 : i];
+}
+
+/*
+ * Summarize the per-operation times of the successful samples of a
+ * benchmark as a JSON object; a benchmark with failed samples is invalid
+ */
+static void
+_summary(FILE *fp, const bench_def_t *def, int ops, double *v, int n,
+         int failures)
+{
+    double mean;
+    double var;
+    double p50;
+    int i;
+
+    fprintf(fp, "    {\"name\": \"%s\", \"unit\": \"%s\", \"ops\": %d, "
+            "\"samples\": %d, \"failures\": %d, \"valid\": %s,\n",
+            def->name, def->unit, ops, n, failures,
+            failures ? "false" : "true");
+    if ( 0 == n ) {
+        fprintf(fp, "     \"ns_per_op\": null,\n     \"ops_per_sec\": null");
+        return;
+    }
+
+    qsort(v, n, sizeof(double), _cmp);
+    mean = 0;
+    for ( i = 0; i < n; i++ ) {
+        mean += v[i];
+    }
+    mean /= n;
+    var = 0;
+    for ( i = 0; i < n; i++ ) {
+        var += (v[i] - mean) * (v[i] - mean);
+    }
+    var = n > 1 ? var / (n - 1) : 0;
+    p50 = _percentile(v, n, 50);
+
+    fprintf(fp, "     \"ns_per_op\": {\"min\": %.1f, \"p50\": %.1f, "
+            "\"mean\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, "
+            "\"stddev\": %.1f},\n", v[0], p50, mean,
+            _percentile(v, n, 90), _percentile(v, n, 99), v[n - 1],
+            sqrt(var));
+    fprintf(fp, "     \"ops_per_sec\": %.1f", p50 > 0 ? 1e9 / p50 : 0);
+}
+
+#ifdef FM10K_MODEL
+/*
+ * Model state after the last sample of a benchmark
+ */
+static void
+_model_summary(FILE *fp, const fm10k_model_t *m)
+{
+    static const char *names[FM10K_MODEL_FREELISTS] = { "rxq", "txq",
+                                                        "segment" };
+    int i;
+
+    fprintf(fp, ",\n     \"model\": {\"lock_takes\": %d, "
+            "\"lock_stolen\": %d, \"lock_violations\": %d,\n"
+            "      \"pll_relocks\": [%d, %d], \"bist_done\": %d, "
+            "\"bist_aborted\": %d,\n      \"freelists\": {",
+            m->lock_takes, m->lock_stolen, m->lock_violations,
+            m->pll_relocks[0], m->pll_relocks[1], m->bist_done,
+            m->bist_aborted);
+    for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+        fprintf(fp, "%s\"%s\": {\"preset\": %d, \"pushes\": %d, "
+                "\"complete\": %s}", i ? ", " : "", names[i],
+                m->fl[i].preset, m->fl[i].pushes,
+                fm10k_model_freelist_complete(m, i) ? "true" : "false");
+    }
+    fprintf(fp, "}}");
+}
+#endif
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    static bench_t b;
+    const bench_def_t *def;
+    const char *list;
+    const char *outpath;
+#ifdef FM10K_MODEL
+    fm10k_model_cfg_t mcfg;
+#endif
+    uint64_t ns;
+    double *v;
+    FILE *out;
+    int nsamples;
+    int force;
+    int failures;
+    int first;
+    int n;
+    int ops;
+    int opt;
+    int i;
+    int s;
+
+    nsamples = 25;
+    force = 0;
+    list = NULL;
+    outpath = NULL;
+#ifdef FM10K_MODEL
+    fm10k_model_default_cfg(&mcfg);
+    while ( (opt = getopt(argc, argv, "fn:t:o:m:")) != -1 ) {
+#else
+    while ( (opt = getopt(argc, argv, "fn:t:o:")) != -1 ) {
+#endif
+        switch ( opt ) {
+        case 'f':
+            force = 1;
+            break;
+        case 'n':
+            nsamples = atoi(optarg);
+            break;
+        case 't':
+            list = optarg;
+            break;
+        case 'o':
+            outpath = optarg;
+            break;
+#ifdef FM10K_MODEL
+        case 'm':
+            if ( fm10k_model_set(&mcfg, optarg) < 0 ) {
+                return EXIT_FAILURE;
+            }
+            break;
+#endif
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( argc - optind > 1 || nsamples <= 0 ) {
+        usage(argv[0]);
+    }
+
+    /* The library reports progress on stdout; keep it apart from the
+       results */
+    if ( NULL != outpath ) {
+        out = fopen(outpath, "w");
+    } else {
+        fflush(stdout);
+        out = fdopen(dup(STDOUT_FILENO), "w");
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+    if ( NULL == out ) {
+        perror(NULL != outpath ? outpath : "stdout");
+        return EXIT_FAILURE;
+    }
+
+    if ( argc - optind == 1 ) {
+        if ( fm10k_open(&b.fm10k, argv[optind]) < 0 ) {
+            return EXIT_FAILURE;
+        }
+    } else {
+#ifdef FM10K_MODEL
+        if ( fm10k_model_open(&b.model, &b.fm10k, &mcfg) < 0 ) {
+            return EXIT_FAILURE;
+        }
+#else
+        if ( fm10k_sim_open(&b.fm10k) < 0 ) {
+            return EXIT_FAILURE;
+        }
+#endif
+        b.sim = 1;
+    }
+    fm10k_port_default(&b.ports);
+    if ( fm10k_port_validate(&b.ports) < 0 ) {
+        return EXIT_FAILURE;
+    }
+    for ( i = 0; i < b.ports.n; i++ ) {
+        if ( b.ports.port[i].epl >= 0 ) {
+            b.neth++;
+        }
+    }
+    for ( i = 0; i < SCRATCH_WORDS; i++ ) {
+        b.scratch[i] = rd32(b.fm10k.mmio, SCRATCH(i));
+    }
+    fm10k_policer_init(&b.policer, &b.fm10k);
+
+    v = malloc(sizeof(double) * nsamples);
+    if ( NULL == v ) {
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "{\n  \"tool\": \"fm10k-bench\",\n  \"library\": \"%s\",\n"
+            "  \"backend\": \"%s\",\n  \"time\": %ld,\n  \"results\": [\n",
+            fm10k_lib_version(), b.sim ? BACKEND : argv[optind],
+            (long)time(NULL));
+    first = 1;
+    for ( i = 0; i < (int)(sizeof(_benches) / sizeof(_benches[0])); i++ ) {
+        def = &_benches[i];
+        if ( !_selected(list, def->name) ) {
+            continue;
+        }
+        if ( def->destructive && !b.sim && !force ) {
+            fprintf(stderr, "%s: skipped on a device without -f\n",
+                    def->name);
+            continue;
+        }
+        ops = def->ops ? def->ops : b.neth;
+        if ( 0 == ops ) {
+            fprintf(stderr, "%s: skipped without Ethernet ports\n",
+                    def->name);
+            continue;
+        }
+        failures = 0;
+        n = 0;
+        for ( s = 0; s < nsamples; s++ ) {
+            if ( def->run(&b, s, &ns) < 0 ) {
+                failures++;
+                continue;
+            }
+            v[n++] = (double)ns / ops;
+        }
+        if ( !first ) {
+            fprintf(out, ",\n");
+        }
+        _summary(out, def, ops, v, n, failures);
+#ifdef FM10K_MODEL
+        if ( b.sim ) {
+            _model_summary(out, &b.model);
+        }
+#endif
+        fprintf(out, "}");
+        first = 0;
+    }
+    fprintf(out, "\n  ]\n}\n");
+
+    free(v);
+    fclose(out);
+#ifdef FM10K_MODEL
+    if ( b.sim ) {
+        fm10k_model_close(&b.model);
+    } else {
+        fm10k_close(&b.fm10k);
+    }
+#else
+    fm10k_close(&b.fm10k);
+#endif
+
+    return EXIT_SUCCESS;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,616 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "boot.h"
+#include "sbus.h"
+#include "serdes.h"
+#include "an.h"
+#include "ptp.h"
+#include "glort.h"
+#include "vf.h"
+#include "prog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+/* FM10K NVM recovery version */
+#define NVM_PCIE_RECOVERY_VER   0x122
+
+enum {
+    FM10K_SOFT_RESET_LOCK_FREE = 0,
+    FM10K_SOFT_RESET_LOCK_NVM = 1,
+    FM10K_SOFT_RESET_LOCK_API = 2,
+};
+
+/*
+ * Initialize FM10K scheduler memories; the polling calendar is part of the
+ * configuration program
+ */
+int
+fm10k_boot_scheduler(fm10k_t *fm10k)
+{
+    struct timespec ts;
+    uint32_t mode0;
+    uint32_t mode1;
+    uint32_t run0;
+    uint32_t run1;
+    uint64_t m64;
+    int i;
+    int j;
+
+    /* Clear BIST-accessible switch memories */
+    mode0 = rd32(fm10k->mmio, FM10K_BIST_CTRL_MODE);
+    mode1 = mode0 | (1ULL << 10);
+    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, mode1);
+    run0 = rd32(fm10k->mmio, FM10K_BIST_CTRL_RUN);
+    run1 = run0 | (1ULL << 10);
+    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, run1);
+
+    /* Wait 0.8 ms */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 800000L;
+    nanosleep(&ts, NULL);
+
+    /* FABRIC=0 */
+    wr64(fm10k->mmio, FM10K_BIST_CTRL_RUN, run0);
+    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, mode0);
+
+    /* Initialization of RXQ_MCAST list */
+    for ( i = 0; i < 8; i++ ) {
+        m64 = i | (i << 10);
+        wr64(fm10k->mmio, FM10K_SCHED_RXQ_STORAGE_POINTERS(i), m64);
+    }
+    for ( i = 0; i < (1024 - 8); i++ ){
+        wr32(fm10k->mmio, FM10K_SCHED_RXQ_FREELIST_INIT, i + 8);
+    }
+
+    /* Initialization of TXQ list */
+    for ( i = 0; i < 384; i++ ) {
+        wr32(fm10k->mmio, FM10K_SCHED_TXQ_HEAD_PERQ(i), i);
+        wr32(fm10k->mmio, FM10K_SCHED_TXQ_TAIL0_PERQ(i), i);
+        wr32(fm10k->mmio, FM10K_SCHED_TXQ_TAIL1_PERQ(i), i);
+    }
+    for ( i = 0; i < 24576 - 384; i++ ) {
+        wr32(fm10k->mmio, FM10K_SCHED_RXQ_FREELIST_INIT, i + 384);
+    }
+
+    /* Initialization of FREE segment list */
+    for ( i = 0; i < 48; i++ ) {
+        wr32(fm10k->mmio, FM10K_SCHED_SSCHED_RX_PERPORT(i), i);
+    }
+    for ( i = 0; i < 24576 - 48; i++ ) {
+        wr32(fm10k->mmio, FM10K_SCHED_FREELIST_INIT, 48 + i);
+    }
+
+    return 0;
+}
+
+/*
+ * Wait for SOFT_RESET lock owner
+ */
+int
+fm10k_boot_wait_lock_owner(fm10k_t *fm10k, int owner, long timeout)
+{
+    uint32_t m32;
+    int lockowner;
+    struct timespec ts;
+    long atime;
+    int cnt;
+
+    /* Get the lock owner */
+    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
+    lockowner = m32 & 0x3;
+
+    if ( FM10K_SOFT_RESET_LOCK_API == lockowner ) {
+        if ( FM10K_SOFT_RESET_LOCK_API != owner ) {
+            fprintf(stderr, "warning...\n");
+            return -1;
+        }
+    }
+
+    atime = 0;
+    cnt = 1;
+    while ( lockowner != owner ) {
+        if ( atime >= timeout ) {
+            return -1;
+        }
+        /* Check timeout */
+        ts.tv_sec  = 0;
+        ts.tv_nsec = 10000L * cnt;
+        nanosleep(&ts, NULL);
+        atime += 10000L * cnt;
+        cnt++;
+
+        m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
+        lockowner = m32 & 0x3;
+    }
+
+    return 0;
+}
+
+/*
+ * Take SOFT_RESET lock
+ */
+int
+fm10k_boot_take_lock(fm10k_t *fm10k)
+{
+    uint32_t m32;
+    int i;
+    int ret;
+    struct timespec ts;
+
+    /* Get NVM version */
+    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(401));
+    if ( m32 > NVM_PCIE_RECOVERY_VER ) {
+        /* Support locking in NVM */
+        for ( i = 0; i < 3; i++ ) {
+            ret = fm10k_boot_wait_lock_owner(fm10k,
+                                                 FM10K_SOFT_RESET_LOCK_FREE,
+                                                 1000 * 1000 * 2000);
+            if ( ret < 0 ) {
+                /* Error */
+                return -1;
+            }
+            /* Take a lock */
+            wr32(fm10k->mmio, FM10K_BSM_SCRATCH(2), FM10K_SOFT_RESET_LOCK_API);
+
+            /* Wait 50us */
+            ts.tv_sec  = 0;
+            ts.tv_nsec = 50000L;
+            nanosleep(&ts, NULL);
+
+            /* Check the owner */
+            ret = fm10k_boot_wait_lock_owner(fm10k,
+                                                 FM10K_SOFT_RESET_LOCK_API, 0);
+            if ( 0 == ret ) {
+                return 0;
+            }
+        }
+    } else {
+        /* No support locking in NVM */
+        return -1;
+    }
+
+    return -1;
+}
+
+/*
+ * Drop SOFT_RESET lock
+ */
+int
+fm10k_boot_drop_lock(fm10k_t *fm10k)
+{
+    uint32_t m32;
+    int i;
+    int ret;
+
+    /* Get NVM version */
+    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(401));
+    if ( m32 > NVM_PCIE_RECOVERY_VER ) {
+        /* Support locking in NVM */
+        m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
+        switch ( m32 & 3 ) {
+        case FM10K_SOFT_RESET_LOCK_API:
+            wr32(fm10k->mmio, FM10K_BSM_SCRATCH(2), 0);
+            return 0;
+            break;
+        case FM10K_SOFT_RESET_LOCK_FREE:
+            fprintf(stderr, "warning\n");
+            return 0;
+        default:
+            return -1;
+        }
+    } else {
+        /* No support locking in NVM */
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Reset switch
+ */
+int
+fm10k_boot_reset(fm10k_t *fm10k)
+{
+    uint32_t m32;
+    int ret;
+    struct timespec ts;
+
+    /* Try to take a lock */
+    ret = fm10k_boot_take_lock(fm10k);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Could not take lock\n");
+        return -1;
+    }
+
+    /* Set SwitchReady=0 */
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+    m32 &= ~(1 << 3);
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
+
+    /* Wait 100us */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 100000L;
+    nanosleep(&ts, NULL);
+
+    /* Reduce EPL frequency to reduce power during reset */
+    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_CTRL);
+    m32 |= (63 << 18);          /* OutDiv = 63 */
+    wr32(fm10k->mmio, FM10K_PLL_EPL_CTRL, m32);
+
+    /* Apply OutDiv (Bit[4]) */
+    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_STAT);
+    m32 |= (1 << 6);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
+    m32 &= ~(1 << 6);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
+
+    /* Assert Switch/EPL reset */
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+    m32 |= (1 << 2);            /* SwitchReset */
+    m32 |= (1 << 1);            /* EPLReset */
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
+
+    /* Wait 1ms */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 1000000L;
+    nanosleep(&ts, NULL);
+
+    ret = fm10k_boot_drop_lock(fm10k);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Set frame handler clock for a performance profile
+ */
+int
+fm10k_boot_clock(fm10k_t *fm10k, int profile, fm10k_clock_t *clk)
+{
+    int ret;
+
+    ret = fm10k_clock_plan(fm10k, profile, clk);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    return fm10k_clock_apply_fabric(fm10k, clk);
+}
+
+/*
+ * Release switch
+ */
+int
+fm10k_boot_release(fm10k_t *fm10k, const fm10k_clock_t *clk)
+{
+    uint32_t m32;
+    uint64_t m64;
+    struct timespec ts;
+    int ret;
+
+    /* Clear switch/tunnel/EPL memories */
+    m64 = rd64(fm10k->mmio, FM10K_BIST_CTRL);
+    m64 |= (1 << 10) | (1 << 11) | (1 << 9);
+    wr64(fm10k->mmio, FM10K_BIST_CTRL, m64);
+
+    /* Wait 0.8ms */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 800000L;
+    nanosleep(&ts, NULL);
+
+    m64 &= ~((1 << 10) | (1 << 11) | (1 << 9) | (1ULL << 42) | (1ULL << 43)
+             | (1ULL << 41));
+    wr64(fm10k->mmio, FM10K_BIST_CTRL, m64);
+
+    /* Try to take a lock */
+    ret = fm10k_boot_take_lock(fm10k);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Could not take lock\n");
+        return -1;
+    }
+
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+    m32 &= ~((1 << 2) | (1 << 1));
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
+
+    /* Wait 100ns */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 100000L;
+    nanosleep(&ts, NULL);
+
+    ret = fm10k_boot_drop_lock(fm10k);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    /* EPL clock */
+    return fm10k_clock_apply_epl(fm10k, clk);
+}
+
+/*
+ * Initialize SBUS
+ */
+static int
+_sbus_init(fm10k_t *fm10k)
+{
+    fm10k_sbus_t sbus;
+    int ret;
+
+    /* EPL ring */
+    ret = fm10k_sbus_open(&sbus, fm10k, FM10K_SBUS_EPL);
+    if ( ret < 0 ) {
+        return -1;
+    }
+    ret = fm10k_sbus_init(&sbus);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to initialize the EPL SBUS\n");
+        return -1;
+    }
+
+    /* PCIe ring */
+    ret = fm10k_sbus_open(&sbus, fm10k, FM10K_SBUS_PCIE);
+    if ( ret < 0 ) {
+        return -1;
+    }
+    ret = fm10k_sbus_init(&sbus);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to initialize the PCIe SBUS\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Initialize switch SerDes.  Without the default firmware file the lanes
+ * keep the image they run (e.g., loaded from the NVM); a file named by
+ * FM10K_SERDES_FW must exist.
+ */
+int
+fm10k_boot_serdes(fm10k_t *fm10k, const fm10k_ports_t *ports)
+{
+    fm10k_serdes_cfg_t cfg;
+    fm10k_serdes_report_t report;
+    const char *fw;
+    int ret;
+
+    fm10k_serdes_default_cfg(&cfg);
+    fm10k_port_serdes_cfg(ports, &cfg);
+    fw = getenv("FM10K_SERDES_FW");
+    if ( NULL != fw ) {
+        cfg.fw = fw;
+    } else if ( access(cfg.fw, F_OK) < 0 && ENOENT == errno ) {
+        fprintf(stderr, "Warning: %s not found; SerDes firmware not "
+                "uploaded\n", cfg.fw);
+        return 0;
+    }
+
+    ret = fm10k_serdes_bringup(fm10k, &cfg, &report);
+    fm10k_serdes_print_report(stdout, &report);
+
+    return ret;
+}
+
+/*
+ * Boot switch
+ */
+int
+fm10k_boot_switch(fm10k_t *fm10k, const fm10k_ports_t *ports, int profile)
+{
+    fm10k_clock_t clk;
+    int ret;
+
+    /* Reset the switch */
+    ret = fm10k_boot_reset(fm10k);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to reset the switch\n");
+        return -1;
+    }
+
+    /* Configure clock via FABRIC_PLL */
+    ret = fm10k_boot_clock(fm10k, profile, &clk);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to set frame handler clock\n");
+        return -1;
+    }
+
+    /* Release switch */
+    ret = fm10k_boot_release(fm10k, &clk);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to release switch\n");
+        return -1;
+    }
+
+    ret = _sbus_init(fm10k);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to sbus\n");
+        return -1;
+    }
+
+    ret = fm10k_boot_serdes(fm10k, ports);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to switch serdes\n");
+        return -1;
+    }
+
+    /* Disable scan */
+
+    /* Report the resulting clock and packet rate ceiling */
+    fm10k_clock_report(stdout, fm10k, &clk, ports);
+
+    return 0;
+}
+
+/*
+ * Lay out and enable the SR-IOV VF pool in one batch.  The GLORT and VF
+ * managers are kept by the caller, which services the function level
+ * resets of the guests with fm10k_vf_poll().
+ */
+int
+fm10k_boot_vfs(fm10k_t *fm10k, fm10k_glort_t *glort, fm10k_vf_t *vfm,
+               int nvfs)
+{
+    fm10k_vf_cfg_t cfg;
+    int n;
+
+    fm10k_vf_default_cfg(&cfg);
+    cfg.nvfs = nvfs;
+    fm10k_glort_init(glort, fm10k);
+    if ( fm10k_vf_init(vfm, fm10k, glort, &cfg) < 0 ) {
+        return -1;
+    }
+    if ( fm10k_vf_enable(vfm, nvfs < 64 ? (1ULL << nvfs) - 1 : ~0ULL) < 0 ) {
+        return -1;
+    }
+    n = fm10k_vf_commit(vfm);
+    if ( n < 0 ) {
+        return -1;
+    }
+    printf("VF pool: %d VFs enabled with %d register writes\n", nvfs, n);
+    fm10k_vf_print(stdout, vfm);
+
+    return 0;
+}
+
+/*
+ * Initialize switch manager control.  The applied program is kept in last
+ * (if not NULL) and saved to the shadow file (if not NULL) for the warm
+ * applies that follow.  Auto-negotiation is only started in an; the caller
+ * advances it with fm10k_an_poll() from its event loop.  The nvfs VFs are
+ * laid out in vfm, whose GLORT ranges live in glort.
+ */
+int
+fm10k_boot_manager(fm10k_t *fm10k, const fm10k_conf_t *conf,
+                   fm10k_prog_t *last, const char *shadow, int nvfs,
+                   fm10k_an_t *an, fm10k_glort_t *glort, fm10k_vf_t *vfm)
+{
+    uint32_t m32;
+    uint64_t m64;
+    int i;
+    int ret;
+    fm10k_prog_t prog;
+    fm10k_ptp_cfg_t ptpcfg;
+
+    /* De-assert SWITCH_RESET */
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+    m32 &= ~(1UL << 2);
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
+
+    /* Disable switch scan */
+    m32 = (1UL << 27) | (1UL << 30);
+    wr32(fm10k->mmio, FM10K_SCAN_DATA_IN, m32);
+
+    /* Disable switch loopbacks */
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_CTRL_EXT);
+    m32 &= ~(1UL << 2);
+    wr32(fm10k->mmio, FM10K_PCIE_CTRL_EXT, m32);
+    /* Set TE_CFG.SwitchLoopbackDisable = 1 */
+    for ( i = 0; i < 2; i++ ) {
+        m64 = rd64(fm10k->mmio, FM10K_TE_CFG(i));
+        m64 |= (1 << 25);
+        wr64(fm10k->mmio, FM10K_TE_CFG(i), m64);
+    }
+
+    /* Initialize scheduler */
+    ret = fm10k_boot_scheduler(fm10k);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to initialize the scheduler\n");
+        return -1;
+    }
+
+    /* Configure the ports, congestion management, VLANs and tables and
+       start the scheduler */
+    fm10k_prog_init(&prog);
+    ret = fm10k_conf_compile(conf, &prog);
+    if ( ret >= 0 ) {
+        ret = fm10k_prog_apply(fm10k, &prog);
+    }
+    if ( ret >= 0 && NULL != shadow ) {
+        ret = fm10k_prog_save_file(shadow, &prog);
+    }
+    if ( ret >= 0 && NULL != last ) {
+        fm10k_prog_free(last);
+        *last = prog;
+        fm10k_prog_init(&prog);
+    }
+    fm10k_prog_free(&prog);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to apply the configuration\n");
+        return -1;
+    }
+
+    /* Start LED cntroller */
+    m32 = rd32(fm10k->mmio, FM10K_LED_CFG);
+    m32 |= (1 << 24);
+    wr32(fm10k->mmio, FM10K_LED_CFG, m32);
+
+    /* Initialize IEEE 1588 system time */
+    fm10k_ptp_default_cfg(&ptpcfg);
+    if ( fm10k_ptp_init_clock(fm10k, &ptpcfg) < 0 ) {
+        fprintf(stderr, "Failed to initialize the system time\n");
+        return -1;
+    }
+
+    /* Assert SWITCH_READY */
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+    m32 |= (1UL << 3);
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
+
+    /* Start auto-negotiation of all the AN ports at once; a port that
+       does not come up within its attempts is left failed */
+    fm10k_an_init(an, fm10k, &conf->ports);
+    an->max_attempts = FM10K_AN_BOOT_ATTEMPTS;
+
+    /* Enable LTSSM */
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_CTRL);
+    m32 |= 1;
+    wr32(fm10k->mmio, FM10K_PCIE_CTRL, m32);
+
+    /* Bring up the SR-IOV VFs */
+    if ( nvfs > 0 ) {
+        if ( fm10k_boot_vfs(fm10k, glort, vfm, nvfs) < 0 ) {
+            fprintf(stderr, "Failed to initialize the VFs\n");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,66 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _BOOT_H
+#define _BOOT_H
+
+#include "fm10k.h"
+#include "clock.h"
+#include "port.h"
+#include "conf.h"
+#include "an.h"
+#include "glort.h"
+#include "vf.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_boot_wait_lock_owner(fm10k_t *, int, long);
+int fm10k_boot_take_lock(fm10k_t *);
+int fm10k_boot_drop_lock(fm10k_t *);
+int fm10k_boot_reset(fm10k_t *);
+int fm10k_boot_clock(fm10k_t *, int, fm10k_clock_t *);
+int fm10k_boot_release(fm10k_t *, const fm10k_clock_t *);
+int fm10k_boot_serdes(fm10k_t *, const fm10k_ports_t *);
+int fm10k_boot_switch(fm10k_t *, const fm10k_ports_t *, int);
+int fm10k_boot_scheduler(fm10k_t *);
+int fm10k_boot_vfs(fm10k_t *, fm10k_glort_t *, fm10k_vf_t *, int);
+int fm10k_boot_manager(fm10k_t *, const fm10k_conf_t *, fm10k_prog_t *,
+                       const char *, int, fm10k_an_t *, fm10k_glort_t *,
+                       fm10k_vf_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BOOT_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
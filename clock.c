@@ -0,0 +1,307 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "clock.h"
+#include <string.h>
+#include <time.h>
+
+/* PLL_FABRIC_LOCK.FreqSel presets (index: FreqSel) */
+static const uint64_t _presets[] = {
+    0, 612000000ULL, 510000000ULL, 408000000ULL, 306000000ULL
+};
+#define _NPRESETS       5
+
+/* 64-byte frames plus preamble and IFG */
+#define _MIN_FRAME_BITS ((64 + 20) * 8)
+
+/*
+ * Parse a profile name
+ */
+int
+fm10k_clock_parse_profile(const char *name)
+{
+    if ( 0 == strcmp(name, "max") || 0 == strcmp(name, "max-throughput") ) {
+        return FM10K_CLOCK_MAX_THROUGHPUT;
+    } else if ( 0 == strcmp(name, "balanced") ) {
+        return FM10K_CLOCK_BALANCED;
+    } else if ( 0 == strcmp(name, "low-power") ) {
+        return FM10K_CLOCK_LOW_POWER;
+    }
+
+    return -1;
+}
+
+/*
+ * Select the frame handler clock of a profile from the SKU and the fuses:
+ * max-throughput takes the highest allowed clock, balanced the highest one
+ * within 3/4 of it, low-power the lowest preset
+ */
+int
+fm10k_clock_plan(fm10k_t *fm10k, int profile, fm10k_clock_t *clk)
+{
+    uint64_t target;
+    uint32_t m32;
+    int i;
+
+    memset(clk, 0, sizeof(fm10k_clock_t));
+
+    /* Read SKU from FUSE_DATA_0[15:11] */
+    m32 = rd32(fm10k->mmio, FM10K_FUSE_DATA_0);
+    if ( 0 == m32 ) {
+        /* Unknown SKU */
+        fprintf(stderr, "Unknown SKU\n");
+        clk->sku = 0xff;
+    } else {
+        clk->sku = (m32 >> 11) & 0x1f;
+    }
+
+    /* FeatureCode:
+       0000b = Full -- All frequencies are supported
+       0001b = LIMITED0 -- Restricted to 600, 500, 400, 300 MHz
+       0010b = LIMITED1 -- Restricted to 500, 400, 300 MHz
+       0011b = LIMITED2 -- Restricted to 400, 300 MHz
+       0100b = LIMITED3 -- Restricted to 300 MHz */
+    clk->feature = rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK) & 0xf;
+
+    switch ( clk->sku ) {
+    case 0: /* FM10840 */
+        clk->refdiv = 0x19;
+        clk->outdiv = 0x5;
+        clk->fbdiv4 = 0x1;
+        clk->fbdiv255 = 0xc4;
+        clk->rated_hz = 980000000ULL;
+        break;
+    case 1: /* FM10420 */
+    default:
+        clk->refdiv = 0x3;
+        clk->outdiv = 0x7;
+        clk->fbdiv4 = 0x0;
+        clk->fbdiv255 = 0x2f;
+        clk->rated_hz = 699404761ULL;
+        break;
+    }
+
+    if ( 0 == clk->feature ) {
+        clk->max_hz = clk->rated_hz;
+    } else {
+        clk->max_hz = clk->feature < _NPRESETS
+            ? _presets[clk->feature] : _presets[1];
+        if ( clk->max_hz > clk->rated_hz ) {
+            clk->max_hz = clk->rated_hz;
+        }
+    }
+
+    switch ( profile ) {
+    case FM10K_CLOCK_MAX_THROUGHPUT:
+        target = clk->max_hz;
+        break;
+    case FM10K_CLOCK_BALANCED:
+        target = clk->max_hz / 4 * 3;
+        break;
+    case FM10K_CLOCK_LOW_POWER:
+        target = 0;
+        break;
+    default:
+        return -1;
+    }
+
+    if ( 0 == clk->feature && target == clk->rated_hz ) {
+        /* Rated clock from the PLL_FABRIC_CTRL dividers */
+        clk->fh_hz = clk->rated_hz;
+        clk->freqsel = 0;
+    } else {
+        /* Highest preset within the target, or the lowest one */
+        clk->freqsel = _NPRESETS - 1;
+        for ( i = 1; i < _NPRESETS; i++ ) {
+            if ( _presets[i] <= target && _presets[i] <= clk->max_hz ) {
+                clk->freqsel = i;
+                break;
+            }
+        }
+        clk->fh_hz = _presets[clk->freqsel];
+    }
+    clk->epl_outdiv = FM10K_CLOCK_EPL_OUTDIV;
+
+    return 0;
+}
+
+/*
+ * Wait up to 10 ms for a PLL to lock
+ */
+static int
+_wait_lock(fm10k_t *fm10k, long stat)
+{
+    struct timespec ts;
+    int i;
+
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 100000L;
+    for ( i = 0; i < 100; i++ ) {
+        if ( rd32(fm10k->mmio, stat) & 1 ) {
+            return 0;
+        }
+        nanosleep(&ts, NULL);
+    }
+
+    return -1;
+}
+
+/*
+ * Program the frame handler clock and validate the PLL lock
+ */
+int
+fm10k_clock_apply_fabric(fm10k_t *fm10k, const fm10k_clock_t *clk)
+{
+    struct timespec ts;
+    uint32_t m32;
+
+    if ( 0 == clk->freqsel ) {
+        /* Full control over PLL */
+        m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL);
+        /* RefDiv | FbDiv4 | FbDiv255 | OutDiv */
+        m32 = (m32 & ~(0xfffff8UL)) | (clk->refdiv << 3) | (clk->fbdiv4 << 9)
+            | (clk->fbdiv255 << 10) | (clk->outdiv << 18);
+        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
+
+        /* Toggle reset */
+        m32 &= ~1UL;
+        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
+
+        /* Wait 500ns */
+        ts.tv_sec  = 0;
+        ts.tv_nsec = 500L;
+        nanosleep(&ts, NULL);
+
+        m32 |= 1UL;
+        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
+    }
+
+    /* FreqSel (0: USE_CTRL) */
+    m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK);
+    m32 = (m32 & ~0xf0UL) | (clk->freqsel << 4);
+    wr32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK, m32);
+
+    if ( _wait_lock(fm10k, FM10K_PLL_FABRIC_STAT) < 0 ) {
+        fprintf(stderr, "Fabric PLL failed to lock at %llu Hz\n",
+                (unsigned long long)clk->fh_hz);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Program the EPL PLL output divider and validate the PLL lock
+ */
+int
+fm10k_clock_apply_epl(fm10k_t *fm10k, const fm10k_clock_t *clk)
+{
+    uint32_t m32;
+
+    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_CTRL);
+    m32 = (m32 & ~(0x3f << 18)) | (clk->epl_outdiv << 18);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_CTRL, m32);
+
+    /* Apply OutDiv (toggle PLL_EPL_STAT.MiscCtrl[4]) */
+    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_STAT);
+    m32 |= (1 << 6);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
+
+    m32 &= ~(1 << 6);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
+
+    if ( _wait_lock(fm10k, FM10K_PLL_EPL_STAT) < 0 ) {
+        fprintf(stderr, "EPL PLL failed to lock\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Frame handler clock currently configured (Hz)
+ */
+uint64_t
+fm10k_clock_read(fm10k_t *fm10k)
+{
+    uint32_t m32;
+    uint64_t refdiv;
+    uint64_t outdiv;
+    uint64_t fbdiv;
+    int freqsel;
+
+    freqsel = (rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK) >> 4) & 0xf;
+    if ( freqsel > 0 && freqsel < _NPRESETS ) {
+        return _presets[freqsel];
+    }
+
+    /* REF * FbDiv255 * (FbDiv4 ? 4 : 2) / (RefDiv * OutDiv) */
+    m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL);
+    refdiv = (m32 >> 3) & 0x3f;
+    fbdiv = ((m32 >> 10) & 0xff) * (((m32 >> 9) & 1) ? 4 : 2);
+    outdiv = (m32 >> 18) & 0x3f;
+    if ( 0 == refdiv || 0 == outdiv ) {
+        return 0;
+    }
+
+    return FM10K_CLOCK_REF_HZ * fbdiv / (refdiv * outdiv);
+}
+
+/*
+ * Report the clock against the SKU rating and the packet rate ceiling (one
+ * frame per frame handler cycle) against the 64-byte line-rate demand of
+ * the ports
+ */
+void
+fm10k_clock_report(FILE *fp, fm10k_t *fm10k, const fm10k_clock_t *clk,
+                   const fm10k_ports_t *ports)
+{
+    uint64_t hz;
+    double demand;
+    int i;
+
+    hz = fm10k_clock_read(fm10k);
+    demand = 0;
+    for ( i = 0; i < ports->n; i++ ) {
+        demand += ports->port[i].speed * 1e6 / _MIN_FRAME_BITS;
+    }
+
+    fprintf(fp, "Frame handler: %.1f MHz (%s rated %.1f MHz, fuses allow "
+            "%.1f MHz)%s\n", hz / 1e6,
+            clk->sku == 0 ? "FM10840" : clk->sku == 1 ? "FM10420" : "SKU",
+            clk->rated_hz / 1e6, clk->max_hz / 1e6,
+            hz == clk->rated_hz ? "" : ", below rating");
+    fprintf(fp, "Ceiling %.1f Mpps, 64-byte line rate %.1f Mpps%s\n",
+            hz / 1e6, demand / 1e6,
+            hz < demand ? " (oversubscribed)" : "");
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
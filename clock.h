@@ -0,0 +1,92 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include "fm10k.h"
+#include "port.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* Performance profiles */
+#define FM10K_CLOCK_MAX_THROUGHPUT  0
+#define FM10K_CLOCK_BALANCED        1
+#define FM10K_CLOCK_LOW_POWER       2
+
+/* PLL reference clock */
+#define FM10K_CLOCK_REF_HZ      156250000ULL
+
+/* EPL PLL output divider; the EPL clock follows the SerDes line rates and
+   is the same for all profiles */
+#define FM10K_CLOCK_EPL_OUTDIV  6
+
+/*
+ * Frame handler and EPL clock plan
+ */
+typedef struct _fm10k_clock {
+    /* FUSE_DATA_0 SKU (0xff: unknown) and PLL_FABRIC_LOCK feature code */
+    int sku;
+    int feature;
+    /* Rated clock of the SKU and the highest clock the fuses allow */
+    uint64_t rated_hz;
+    uint64_t max_hz;
+    /* Selected frame handler clock; freqsel 0 uses the PLL_FABRIC_CTRL
+       dividers below */
+    uint64_t fh_hz;
+    int freqsel;
+    int refdiv;
+    int fbdiv4;
+    int fbdiv255;
+    int outdiv;
+    int epl_outdiv;
+} fm10k_clock_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_clock_parse_profile(const char *);
+int fm10k_clock_plan(fm10k_t *, int, fm10k_clock_t *);
+int fm10k_clock_apply_fabric(fm10k_t *, const fm10k_clock_t *);
+int fm10k_clock_apply_epl(fm10k_t *, const fm10k_clock_t *);
+uint64_t fm10k_clock_read(fm10k_t *);
+void fm10k_clock_report(FILE *, fm10k_t *, const fm10k_clock_t *,
+                        const fm10k_ports_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CLOCK_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
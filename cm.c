@@ -0,0 +1,335 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "cm.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define WM_MASK     0x7fffUL
+
+/*
+ * Number of segments needed to hold a number of bytes
+ */
+static uint32_t
+_segs(uint64_t bytes)
+{
+    return (bytes + FM10K_CM_SEGMENT_SIZE - 1) / FM10K_CM_SEGMENT_SIZE;
+}
+
+/*
+ * Default configuration: no ports, everything lossy, 2x hog overcommit
+ */
+void
+fm10k_cm_default_cfg(fm10k_cm_cfg_t *cfg)
+{
+    int i;
+
+    memset(cfg, 0, sizeof(fm10k_cm_cfg_t));
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        cfg->ports[i].mtu = 1518;
+    }
+    cfg->rtt_ns = 1000;
+    cfg->overcommit_pct = 200;
+}
+
+/*
+ * Derive the watermarks from the port speed mix and the lossless/lossy
+ * split.  Each port keeps a private reservation of two maximum-size frames
+ * per partition; lossless ports additionally keep headroom above the global
+ * watermark to absorb the data in flight after PAUSE is sent.  The rest is
+ * shared and split between the partitions, and per-port hog and pause
+ * watermarks are sized in proportion to the port speed.
+ */
+int
+fm10k_cm_derive(fm10k_cm_t *cm, fm10k_t *fm10k, const fm10k_cm_cfg_t *cfg)
+{
+    const fm10k_cm_port_t *port;
+    uint64_t speeds;
+    uint64_t headroom;
+    uint64_t private;
+    uint64_t shared;
+    uint64_t m64;
+    int lossless;
+    int i;
+
+    memset(cm, 0, sizeof(fm10k_cm_t));
+    cm->fm10k = fm10k;
+    cm->cfg = *cfg;
+    lossless = (cfg->lossless_tc && cfg->lossless_pct > 0);
+    if ( cfg->lossless_pct < 0 || cfg->lossless_pct > 100
+         || cfg->overcommit_pct <= 0 ) {
+        return -1;
+    }
+
+    speeds = 0;
+    headroom = 0;
+    private = 0;
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        port = &cfg->ports[i];
+        if ( port->speed <= 0 ) {
+            continue;
+        }
+        speeds += port->speed;
+        cm->private_wm[i][FM10K_CM_SMP_LOSSY] = _segs(2 * port->mtu);
+        private += cm->private_wm[i][FM10K_CM_SMP_LOSSY];
+        if ( lossless ) {
+            cm->private_wm[i][FM10K_CM_SMP_LOSSLESS] = _segs(2 * port->mtu);
+            private += cm->private_wm[i][FM10K_CM_SMP_LOSSLESS];
+            /* Mbit/s x ns / 8000 = bytes in flight */
+            headroom += _segs((uint64_t)port->speed * cfg->rtt_ns / 8000
+                              + 2 * port->mtu);
+        }
+    }
+    if ( 0 == speeds ) {
+        return -1;
+    }
+    if ( headroom + private >= FM10K_CM_SEGMENTS ) {
+        fprintf(stderr, "CM: reservations (%llu segments) exceed memory\n",
+                (unsigned long long)(headroom + private));
+        return -1;
+    }
+    cm->global_wm = FM10K_CM_SEGMENTS - headroom;
+    shared = cm->global_wm - private;
+    cm->shared_wm[FM10K_CM_SMP_LOSSLESS]
+        = lossless ? shared * cfg->lossless_pct / 100 : 0;
+    cm->shared_wm[FM10K_CM_SMP_LOSSY]
+        = shared - cm->shared_wm[FM10K_CM_SMP_LOSSLESS];
+
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        port = &cfg->ports[i];
+        if ( port->speed <= 0 ) {
+            continue;
+        }
+        m64 = (uint64_t)cm->shared_wm[FM10K_CM_SMP_LOSSY]
+            * cfg->overcommit_pct / 100 * port->speed / speeds;
+        if ( m64 > cm->shared_wm[FM10K_CM_SMP_LOSSY] ) {
+            m64 = cm->shared_wm[FM10K_CM_SMP_LOSSY];
+        }
+        if ( m64 < _segs(2 * port->mtu) ) {
+            m64 = _segs(2 * port->mtu);
+        }
+        cm->hog_base[i] = m64;
+        cm->hog_wm[i] = m64;
+
+        if ( lossless ) {
+            m64 = (uint64_t)cm->shared_wm[FM10K_CM_SMP_LOSSLESS]
+                * cfg->overcommit_pct / 100 * port->speed / speeds;
+            if ( m64 > cm->shared_wm[FM10K_CM_SMP_LOSSLESS] ) {
+                m64 = cm->shared_wm[FM10K_CM_SMP_LOSSLESS];
+            }
+            m64 += cm->private_wm[i][FM10K_CM_SMP_LOSSLESS];
+            cm->pause_on[i] = m64;
+            /* Resume once two frames worth of buffer has drained */
+            cm->pause_off[i] = m64 > _segs(2 * port->mtu)
+                ? m64 - _segs(2 * port->mtu) : 0;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Append the derived watermarks to a register program
+ */
+int
+fm10k_cm_emit(const fm10k_cm_t *cm, fm10k_prog_t *prog)
+{
+    uint32_t m32;
+    int nports;
+    int i;
+
+    /* Map traffic classes to partitions */
+    m32 = 0;
+    for ( i = 0; i < 8; i++ ) {
+        if ( (cm->cfg.lossless_tc >> i) & 1 ) {
+            m32 |= FM10K_CM_SMP_LOSSLESS << (3 * i);
+        }
+    }
+    fm10k_prog_wr32(prog, FM10K_CM_APPLY_TC_TO_SMP, m32);
+
+    fm10k_prog_wr32(prog, FM10K_CM_GLOBAL_WM, cm->global_wm & WM_MASK);
+    for ( i = 0; i < 2; i++ ) {
+        fm10k_prog_wr32(prog, FM10K_CM_SHARED_WM(i),
+                        cm->shared_wm[i] & WM_MASK);
+    }
+
+    nports = 0;
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        fm10k_prog_wr32(prog, FM10K_CM_RX_SMP_PRIVATE_WM(i, 0),
+                        cm->private_wm[i][0] & WM_MASK);
+        fm10k_prog_wr32(prog, FM10K_CM_RX_SMP_PRIVATE_WM(i, 1),
+                        cm->private_wm[i][1] & WM_MASK);
+        /* PauseOn | PauseOff */
+        m32 = (cm->pause_on[i] & WM_MASK)
+            | ((cm->pause_off[i] & WM_MASK) << 16);
+        fm10k_prog_wr32(prog,
+                        FM10K_CM_RX_SMP_PAUSE_WM(i, FM10K_CM_SMP_LOSSLESS),
+                        m32);
+        fm10k_prog_wr32(prog, FM10K_CM_TX_HOG_WM(i),
+                        cm->hog_wm[i] & WM_MASK);
+        if ( cm->cfg.ports[i].speed > 0 ) {
+            nports = i + 1;
+        }
+    }
+
+    /* WmSweeperEnable | PauseGenSweeperEnable | PauseRecSweeperEnable |
+       NumSweeperPorts */
+    m32 = (0x1 << 10) | (0x1 << 11) | (0x1 << 12) | (nports << 13);
+    fm10k_prog_rmw32(prog, FM10K_CM_GLOBAL_CFG, m32, 0x1ffUL << 10);
+
+    return 0;
+}
+
+/*
+ * Program the derived watermarks
+ */
+int
+fm10k_cm_apply(fm10k_cm_t *cm)
+{
+    fm10k_prog_t prog;
+    int ret;
+
+    fm10k_prog_init(&prog);
+    ret = fm10k_cm_emit(cm, &prog);
+    if ( ret >= 0 ) {
+        ret = fm10k_prog_apply(cm->fm10k, &prog);
+    }
+    fm10k_prog_free(&prog);
+
+    return ret;
+}
+
+/*
+ * One iteration of the watermark feedback loop.  Ports whose TX usage
+ * approaches their hog watermark (i.e., are about to tail drop) get a larger
+ * share of the lossy partition, taken from the headroom left by ports that
+ * have gone quiet.  Returns the number of watermarks rewritten.
+ */
+int
+fm10k_cm_tune_step(fm10k_cm_t *cm)
+{
+    uint64_t budget;
+    uint64_t sum;
+    uint32_t usage;
+    uint32_t wm;
+    uint32_t step;
+    int n;
+    int i;
+
+    /* Sample the usage and track a decaying peak */
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        if ( cm->cfg.ports[i].speed <= 0 ) {
+            continue;
+        }
+        usage = rd32(cm->fm10k->mmio, FM10K_CM_TX_USAGE(i)) & WM_MASK;
+        if ( usage > cm->peak[i] ) {
+            cm->peak[i] = usage;
+        } else {
+            cm->peak[i] -= cm->peak[i] >> 3;
+        }
+    }
+
+    /* Allow up to 1.5x the configured overcommit while under pressure */
+    budget = (uint64_t)cm->shared_wm[FM10K_CM_SMP_LOSSY]
+        * cm->cfg.overcommit_pct / 100 * 3 / 2;
+    sum = 0;
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        sum += cm->hog_wm[i];
+    }
+
+    n = 0;
+    /* Shrink idle ports back towards the derived watermark first */
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        if ( cm->hog_wm[i] <= cm->hog_base[i]
+             || (uint64_t)cm->peak[i] * 4 >= cm->hog_wm[i] ) {
+            continue;
+        }
+        step = (cm->hog_wm[i] - cm->hog_base[i] + 1) / 2;
+        wm = cm->hog_wm[i] - step;
+        sum -= step;
+        cm->hog_wm[i] = wm;
+        wr32(cm->fm10k->mmio, FM10K_CM_TX_HOG_WM(i), wm & WM_MASK);
+        n++;
+    }
+    /* Then grow ports above 90% of their watermark */
+    for ( i = 0; i < FM10K_CM_PORTS; i++ ) {
+        if ( cm->cfg.ports[i].speed <= 0
+             || (uint64_t)cm->peak[i] * 10 < (uint64_t)cm->hog_wm[i] * 9 ) {
+            continue;
+        }
+        /* A watermark may already be above the lossy partition */
+        if ( cm->hog_wm[i] >= cm->shared_wm[FM10K_CM_SMP_LOSSY] ) {
+            continue;
+        }
+        step = cm->hog_base[i] / 4 + 1;
+        if ( step > cm->shared_wm[FM10K_CM_SMP_LOSSY] - cm->hog_wm[i] ) {
+            step = cm->shared_wm[FM10K_CM_SMP_LOSSY] - cm->hog_wm[i];
+        }
+        if ( sum + step > budget ) {
+            step = budget > sum ? budget - sum : 0;
+        }
+        if ( 0 == step ) {
+            continue;
+        }
+        wm = cm->hog_wm[i] + step;
+        sum += step;
+        cm->hog_wm[i] = wm;
+        wr32(cm->fm10k->mmio, FM10K_CM_TX_HOG_WM(i), wm & WM_MASK);
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Run the feedback loop (iterations <= 0: forever).  Returns the total
+ * number of watermarks rewritten.
+ */
+int
+fm10k_cm_tune(fm10k_cm_t *cm, long interval_us, long iterations)
+{
+    struct timespec ts;
+    long i;
+    int n;
+
+    n = 0;
+    for ( i = 0; iterations <= 0 || i < iterations; i++ ) {
+        n += fm10k_cm_tune_step(cm);
+        ts.tv_sec  = interval_us / 1000000;
+        ts.tv_nsec = (interval_us % 1000000) * 1000L;
+        nanosleep(&ts, NULL);
+    }
+
+    return n;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
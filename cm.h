@@ -0,0 +1,108 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _CM_H
+#define _CM_H
+
+#include "fm10k.h"
+#include "prog.h"
+#include <stdint.h>
+
+#define FM10K_CM_PORTS          48
+/* Shared memory: 24576 segments of 192 bytes */
+#define FM10K_CM_SEGMENTS       24576
+#define FM10K_CM_SEGMENT_SIZE   192
+
+/* Shared memory partitions */
+#define FM10K_CM_SMP_LOSSY      0
+#define FM10K_CM_SMP_LOSSLESS   1
+
+/*
+ * Port parameters
+ */
+typedef struct _fm10k_cm_port {
+    /* Mbit/s (0: port not used) */
+    int speed;
+    /* Maximum frame size in bytes */
+    int mtu;
+} fm10k_cm_port_t;
+
+/*
+ * Congestion management configuration
+ */
+typedef struct _fm10k_cm_cfg {
+    fm10k_cm_port_t ports[FM10K_CM_PORTS];
+    /* Percentage of the shared pool given to the lossless partition */
+    int lossless_pct;
+    /* Traffic classes mapped to the lossless partition (bitmap) */
+    uint8_t lossless_tc;
+    /* Round-trip time absorbed by the pause headroom (ns) */
+    int rtt_ns;
+    /* Sum of the per-port hog watermarks relative to the partition (%) */
+    int overcommit_pct;
+} fm10k_cm_cfg_t;
+
+/*
+ * Congestion management state (all watermarks in segments)
+ */
+typedef struct _fm10k_cm {
+    fm10k_t *fm10k;
+    fm10k_cm_cfg_t cfg;
+    uint32_t global_wm;
+    uint32_t shared_wm[2];
+    uint32_t private_wm[FM10K_CM_PORTS][2];
+    uint32_t pause_on[FM10K_CM_PORTS];
+    uint32_t pause_off[FM10K_CM_PORTS];
+    /* Derived and currently programmed TX hog watermarks */
+    uint32_t hog_base[FM10K_CM_PORTS];
+    uint32_t hog_wm[FM10K_CM_PORTS];
+    /* Decaying peak of the sampled TX usage */
+    uint32_t peak[FM10K_CM_PORTS];
+} fm10k_cm_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_cm_default_cfg(fm10k_cm_cfg_t *);
+int fm10k_cm_derive(fm10k_cm_t *, fm10k_t *, const fm10k_cm_cfg_t *);
+int fm10k_cm_emit(const fm10k_cm_t *, fm10k_prog_t *);
+int fm10k_cm_apply(fm10k_cm_t *);
+int fm10k_cm_tune_step(fm10k_cm_t *);
+int fm10k_cm_tune(fm10k_cm_t *, long, long);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CM_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
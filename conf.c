@@ -0,0 +1,466 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "conf.h"
+#include "clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TOKENS_MAX  16
+
+/*
+ * Parse a number (decimal, 0x-hex or 0-octal)
+ */
+static int
+_num(const char *s, long max, long *val)
+{
+    char *end;
+
+    if ( NULL == s ) {
+        return -1;
+    }
+    *val = strtol(s, &end, 0);
+    if ( '\0' != *end || *val < 0 || *val > max ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse a 64-bit number
+ */
+static int
+_num64(const char *s, uint64_t *val)
+{
+    char *end;
+
+    if ( NULL == s ) {
+        return -1;
+    }
+    *val = strtoull(s, &end, 0);
+    if ( '\0' == *s || '\0' != *end ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse a logical port list such as 1-4,7
+ */
+static int
+_ports(char *s, uint64_t *mask)
+{
+    char *save;
+    char *p;
+    char *q;
+    long a;
+    long b;
+
+    *mask = 0;
+    for ( p = strtok_r(s, ",", &save); p; p = strtok_r(NULL, ",", &save) ) {
+        q = strchr(p, '-');
+        if ( q ) {
+            *q++ = '\0';
+        }
+        if ( _num(p, FM10K_PORT_MAX - 1, &a) < 0 ) {
+            return -1;
+        }
+        b = a;
+        if ( q && (_num(q, FM10K_PORT_MAX - 1, &b) < 0 || b < a) ) {
+            return -1;
+        }
+        for ( ; a <= b; a++ ) {
+            *mask |= 1ULL << a;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Default configuration: the built-in port set at maximum throughput
+ */
+void
+fm10k_conf_default(fm10k_conf_t *conf)
+{
+    memset(conf, 0, sizeof(fm10k_conf_t));
+    conf->profile = FM10K_CLOCK_MAX_THROUGHPUT;
+    fm10k_port_default(&conf->ports);
+    fm10k_cm_default_cfg(&conf->cm);
+}
+
+/*
+ * port <logical> internal <physical> speed <mbps> [mtu <bytes>]
+ * port <logical> epl <n> lane <l> speed <mbps> [an] [fec|nofec]
+ *      [mtu <bytes>]
+ */
+static int
+_parse_port(char **tok, int n, fm10k_conf_t *conf)
+{
+    fm10k_port_cfg_t *port;
+    long logical;
+    long epl;
+    long lane;
+    long speed;
+    long v;
+    int i;
+
+    if ( n < 6 || _num(tok[1], FM10K_PORT_MAX - 1, &logical) < 0 ) {
+        return -1;
+    }
+    if ( 0 == strcmp(tok[2], "internal") ) {
+        if ( _num(tok[3], 0xff, &v) < 0 || strcmp(tok[4], "speed")
+             || _num(tok[5], 400000, &speed) < 0 ) {
+            return -1;
+        }
+        epl = -1;
+        lane = 0;
+        i = 6;
+    } else if ( 0 == strcmp(tok[2], "epl") ) {
+        if ( n < 8 || _num(tok[3], FM10K_PORT_EPLS - 1, &epl) < 0
+             || strcmp(tok[4], "lane") || _num(tok[5], 3, &lane) < 0
+             || strcmp(tok[6], "speed") || _num(tok[7], 100000, &speed) < 0 ) {
+            return -1;
+        }
+        i = 8;
+    } else {
+        return -1;
+    }
+    if ( fm10k_port_add(&conf->ports, logical, epl, lane, speed) < 0 ) {
+        return -1;
+    }
+    port = &conf->ports.port[conf->ports.n - 1];
+    if ( epl < 0 ) {
+        port->physical = v;
+    }
+
+    for ( ; i < n; i++ ) {
+        if ( 0 == strcmp(tok[i], "an") && epl >= 0 ) {
+            port->an = 1;
+        } else if ( 0 == strcmp(tok[i], "fec") ) {
+            port->fec = 1;
+        } else if ( 0 == strcmp(tok[i], "nofec") ) {
+            port->fec = 0;
+        } else if ( 0 == strcmp(tok[i], "mtu") && i + 1 < n ) {
+            if ( _num(tok[++i], 16383, &v) < 0 ) {
+                return -1;
+            }
+            port->mtu = v;
+        } else {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Parse a statement
+ */
+static int
+_parse_line(char **tok, int n, fm10k_conf_t *conf, int *nports)
+{
+    fm10k_conf_vlan_t *vlan;
+    fm10k_conf_lag_t *lag;
+    fm10k_conf_reg_t *reg;
+    uint64_t mask;
+    long v;
+    int i;
+
+    if ( 0 == strcmp(tok[0], "profile") ) {
+        /* profile max-throughput|balanced|low-power */
+        if ( 2 != n ) {
+            return -1;
+        }
+        conf->profile = fm10k_clock_parse_profile(tok[1]);
+        return conf->profile < 0 ? -1 : 0;
+    } else if ( 0 == strcmp(tok[0], "port") ) {
+        /* The first port statement replaces the built-in port set */
+        if ( 0 == (*nports)++ ) {
+            memset(&conf->ports, 0, sizeof(fm10k_ports_t));
+        }
+        return _parse_port(tok, n, conf);
+    } else if ( 0 == strcmp(tok[0], "cm") ) {
+        /* cm [lossless <pct>] [tc <bitmap>] [rtt <ns>] [overcommit <pct>] */
+        if ( 0 == (n & 1) ) {
+            return -1;
+        }
+        for ( i = 1; i < n; i += 2 ) {
+            if ( 0 == strcmp(tok[i], "lossless")
+                 && _num(tok[i + 1], 100, &v) == 0 ) {
+                conf->cm.lossless_pct = v;
+            } else if ( 0 == strcmp(tok[i], "tc")
+                        && _num(tok[i + 1], 0xff, &v) == 0 ) {
+                conf->cm.lossless_tc = v;
+            } else if ( 0 == strcmp(tok[i], "rtt")
+                        && _num(tok[i + 1], 1000000, &v) == 0 ) {
+                conf->cm.rtt_ns = v;
+            } else if ( 0 == strcmp(tok[i], "overcommit")
+                        && _num(tok[i + 1], 1000, &v) == 0 ) {
+                conf->cm.overcommit_pct = v;
+            } else {
+                return -1;
+            }
+        }
+        return 0;
+    } else if ( 0 == strcmp(tok[0], "vlan") ) {
+        /* vlan <vid> ports <list> [tagged <list>] [pvid <list>] */
+        if ( n < 4 || (n & 1) || conf->nvlans >= FM10K_CONF_MAX_VLANS
+             || _num(tok[1], 4095, &v) < 0 || v < 1
+             || strcmp(tok[2], "ports") ) {
+            return -1;
+        }
+        vlan = &conf->vlans[conf->nvlans++];
+        vlan->vid = v;
+        if ( _ports(tok[3], &vlan->members) < 0 ) {
+            return -1;
+        }
+        for ( i = 4; i < n; i += 2 ) {
+            if ( _ports(tok[i + 1], &mask) < 0 ) {
+                return -1;
+            }
+            if ( 0 == strcmp(tok[i], "tagged") ) {
+                vlan->tagged |= mask;
+            } else if ( 0 == strcmp(tok[i], "pvid") ) {
+                for ( v = 0; v < FM10K_PORT_MAX; v++ ) {
+                    if ( mask & (1ULL << v) ) {
+                        conf->pvid[v] = vlan->vid;
+                    }
+                }
+            } else {
+                return -1;
+            }
+        }
+        return 0;
+    } else if ( 0 == strcmp(tok[0], "lag") ) {
+        /* lag ports <list> [hash <fields>] [rotation a|b] */
+        if ( n < 3 || 0 == (n & 1) || conf->nlags >= FM10K_CONF_MAX_LAGS
+             || strcmp(tok[1], "ports") ) {
+            return -1;
+        }
+        lag = &conf->lags[conf->nlags++];
+        if ( _ports(tok[2], &lag->members) < 0 ) {
+            return -1;
+        }
+        fm10k_lag_parse_fields("sip,dip,prot,l4src,l4dst",
+                               &lag->profile.fields);
+        for ( i = 3; i < n; i += 2 ) {
+            if ( 0 == strcmp(tok[i], "hash") ) {
+                if ( fm10k_lag_parse_fields(tok[i + 1],
+                                            &lag->profile.fields) < 0 ) {
+                    return -1;
+                }
+            } else if ( 0 == strcmp(tok[i], "rotation")
+                        && (0 == strcmp(tok[i + 1], "a")
+                            || 0 == strcmp(tok[i + 1], "b")) ) {
+                lag->profile.rotation = ('b' == tok[i + 1][0]);
+            } else {
+                return -1;
+            }
+        }
+        return 0;
+    } else if ( 0 == strcmp(tok[0], "reg") || 0 == strcmp(tok[0], "reg64") ) {
+        /* reg|reg64 <offset> <value> [mask <bits>] */
+        if ( (3 != n && 5 != n) || conf->nregs >= FM10K_CONF_MAX_REGS ) {
+            return -1;
+        }
+        reg = &conf->regs[conf->nregs];
+        reg->wide = ('6' == tok[0][3]);
+        reg->mask = reg->wide ? ~0ULL : 0xffffffffULL;
+        if ( _num64(tok[1], &mask) < 0 || (mask & 3)
+             || _num64(tok[2], &reg->value) < 0 ) {
+            return -1;
+        }
+        reg->offset = mask;
+        if ( 5 == n && (strcmp(tok[3], "mask")
+                        || _num64(tok[4], &reg->mask) < 0) ) {
+            return -1;
+        }
+        conf->nregs++;
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Load a configuration.  One statement per line:
+ *   profile max-throughput|balanced|low-power
+ *   port <logical> internal <physical> speed <mbps> [mtu <bytes>]
+ *   port <logical> epl <n> lane <l> speed <mbps> [an] [fec|nofec]
+ *        [mtu <bytes>]
+ *   cm [lossless <pct>] [tc <bitmap>] [rtt <ns>] [overcommit <pct>]
+ *   vlan <vid> ports <list> [tagged <list>] [pvid <list>]
+ *   lag ports <list> [hash <fields>] [rotation a|b]
+ *   reg|reg64 <offset> <value> [mask <bits>]
+ * Anything not given keeps the built-in default.  The scheduler calendar
+ * is derived from the ports.  The hash is selected by the ingress port, so
+ * all LAGs share one set of hash fields.
+ */
+int
+fm10k_conf_load(FILE *fp, fm10k_conf_t *conf)
+{
+    char buf[512];
+    char *tok[TOKENS_MAX];
+    char *save;
+    char *p;
+    uint64_t ports;
+    uint64_t used;
+    int nports;
+    int line;
+    int n;
+    int i;
+
+    fm10k_conf_default(conf);
+    nports = 0;
+    line = 0;
+    while ( fgets(buf, sizeof(buf), fp) ) {
+        line++;
+        p = strchr(buf, '#');
+        if ( p ) {
+            *p = '\0';
+        }
+        n = 0;
+        for ( p = strtok_r(buf, " \t\r\n", &save); p && n < TOKENS_MAX;
+              p = strtok_r(NULL, " \t\r\n", &save) ) {
+            tok[n++] = p;
+        }
+        if ( 0 == n ) {
+            continue;
+        }
+        if ( _parse_line(tok, n, conf, &nports) < 0 ) {
+            fprintf(stderr, "Invalid configuration at line %d\n", line);
+            return -1;
+        }
+    }
+
+    if ( fm10k_port_validate(&conf->ports) < 0 ) {
+        return -1;
+    }
+    ports = 0;
+    for ( i = 0; i < conf->ports.n; i++ ) {
+        ports |= 1ULL << conf->ports.port[i].logical;
+    }
+    for ( i = 0; i < conf->nvlans; i++ ) {
+        if ( (conf->vlans[i].members | conf->vlans[i].tagged) & ~ports ) {
+            fprintf(stderr, "VLAN %d: member ports are not configured\n",
+                    conf->vlans[i].vid);
+            return -1;
+        }
+    }
+    used = 0;
+    for ( i = 0; i < conf->nlags; i++ ) {
+        if ( conf->lags[i].members & ~ports ) {
+            fprintf(stderr, "LAG %d: member ports are not configured\n", i);
+            return -1;
+        }
+        if ( conf->lags[i].members & used ) {
+            fprintf(stderr, "LAG %d: ports are in another LAG\n", i);
+            return -1;
+        }
+        if ( __builtin_popcountll(conf->lags[i].members)
+             > FM10K_LAG_MAX_MEMBERS ) {
+            fprintf(stderr, "LAG %d: more than %d members\n", i,
+                    FM10K_LAG_MAX_MEMBERS);
+            return -1;
+        }
+        if ( conf->lags[i].profile.fields != conf->lags[0].profile.fields ) {
+            fprintf(stderr, "LAG %d: hash fields differ from LAG 0\n", i);
+            return -1;
+        }
+        used |= conf->lags[i].members;
+    }
+
+    return 0;
+}
+
+/*
+ * Compile a configuration into an optimized register program: the port
+ * modes, the CM watermarks, the VLAN tables and the raw table entries in
+ * one ordering domain, then the scheduler calendar and its start.
+ * Returns the number of records the optimizer removed.
+ */
+int
+fm10k_conf_compile(const fm10k_conf_t *conf, fm10k_prog_t *prog)
+{
+    const fm10k_conf_vlan_t *vlan;
+    const fm10k_conf_reg_t *reg;
+    fm10k_cm_cfg_t cmcfg;
+    fm10k_cm_t cm;
+    int i;
+
+    if ( fm10k_port_emit(&conf->ports, prog) < 0 ) {
+        return -1;
+    }
+
+    cmcfg = conf->cm;
+    fm10k_port_cm_cfg(&conf->ports, &cmcfg);
+    if ( fm10k_cm_derive(&cm, NULL, &cmcfg) < 0 ) {
+        return -1;
+    }
+    fm10k_cm_emit(&cm, prog);
+
+    /* Membership | FID (one filtering database per VLAN) */
+    for ( i = 0; i < conf->nvlans; i++ ) {
+        vlan = &conf->vlans[i];
+        fm10k_prog_wr64(prog, FM10K_INGRESS_VID_TABLE(vlan->vid),
+                        vlan->members | ((uint64_t)vlan->vid << 48));
+        fm10k_prog_wr64(prog, FM10K_EGRESS_VID_TABLE(vlan->vid),
+                        (vlan->tagged & vlan->members)
+                        | ((uint64_t)vlan->vid << 48));
+    }
+    /* PARSER_PORT_CFG_1.DefaultVID */
+    for ( i = 0; i < FM10K_PORT_MAX; i++ ) {
+        if ( conf->pvid[i] ) {
+            fm10k_prog_rmw32(prog, FM10K_PARSER_PORT_CFG_1(i),
+                             (uint32_t)conf->pvid[i] << 9, 0xfffUL << 9);
+        }
+    }
+
+    for ( i = 0; i < conf->nregs; i++ ) {
+        reg = &conf->regs[i];
+        if ( reg->wide ) {
+            fm10k_prog_rmw64(prog, reg->offset, reg->value, reg->mask);
+        } else {
+            fm10k_prog_rmw32(prog, reg->offset, reg->value, reg->mask);
+        }
+    }
+
+    fm10k_prog_barrier(prog);
+    if ( fm10k_port_emit_schedule(&conf->ports, prog) < 0 ) {
+        return -1;
+    }
+
+    return fm10k_prog_optimize(prog);
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
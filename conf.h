@@ -0,0 +1,106 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _CONF_H
+#define _CONF_H
+
+#include "fm10k.h"
+#include "port.h"
+#include "cm.h"
+#include "lag.h"
+#include "prog.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#define FM10K_CONF_MAX_VLANS    256
+#define FM10K_CONF_MAX_REGS     1024
+#define FM10K_CONF_MAX_LAGS     16
+
+/*
+ * VLAN
+ */
+typedef struct _fm10k_conf_vlan {
+    uint16_t vid;
+    /* Member and tagged egress logical ports */
+    uint64_t members;
+    uint64_t tagged;
+} fm10k_conf_vlan_t;
+
+/*
+ * Link aggregation group; the members with link up carry its traffic
+ */
+typedef struct _fm10k_conf_lag {
+    uint64_t members;
+    fm10k_lag_profile_t profile;
+} fm10k_conf_lag_t;
+
+/*
+ * Raw table entry
+ */
+typedef struct _fm10k_conf_reg {
+    uint32_t offset;
+    int wide;
+    uint64_t value;
+    uint64_t mask;
+} fm10k_conf_reg_t;
+
+/*
+ * Switch configuration
+ */
+typedef struct _fm10k_conf {
+    int profile;
+    fm10k_ports_t ports;
+    /* Partitioning and headroom; the port speeds come from the ports */
+    fm10k_cm_cfg_t cm;
+    fm10k_conf_vlan_t vlans[FM10K_CONF_MAX_VLANS];
+    int nvlans;
+    /* Default VLAN of untagged frames per logical port (0: none) */
+    uint16_t pvid[FM10K_PORT_MAX];
+    fm10k_conf_lag_t lags[FM10K_CONF_MAX_LAGS];
+    int nlags;
+    fm10k_conf_reg_t regs[FM10K_CONF_MAX_REGS];
+    int nregs;
+} fm10k_conf_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_conf_default(fm10k_conf_t *);
+int fm10k_conf_load(FILE *, fm10k_conf_t *);
+int fm10k_conf_compile(const fm10k_conf_t *, fm10k_prog_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CONF_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
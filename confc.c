@@ -0,0 +1,162 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "conf.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-o program] <config>\n"
+            "       %s -x <program> <uio device>\n", prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Apply a compiled program to a switch
+ */
+static int
+execute(const char *path, const char *uiodev)
+{
+    struct timespec t0;
+    struct timespec t1;
+    fm10k_prog_t prog;
+    fm10k_t fm10k;
+    FILE *fp;
+    int ret;
+
+    fp = fopen(path, "r");
+    if ( NULL == fp ) {
+        perror(path);
+        return -1;
+    }
+    ret = fm10k_prog_load(fp, &prog);
+    fclose(fp);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    if ( fm10k_open(&fm10k, uiodev) < 0 ) {
+        fm10k_prog_free(&prog);
+        return -1;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    ret = fm10k_prog_apply(&fm10k, &prog);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    fprintf(stderr, "Applied %d records in %.3f ms\n", prog.n,
+            (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    fm10k_close(&fm10k);
+    fm10k_prog_free(&prog);
+
+    return ret;
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    fm10k_conf_t conf;
+    fm10k_prog_t prog;
+    const char *output;
+    const char *exec;
+    FILE *fp;
+    int removed;
+    int opt;
+    int ret;
+
+    output = NULL;
+    exec = NULL;
+    while ( (opt = getopt(argc, argv, "o:x:")) != -1 ) {
+        switch ( opt ) {
+        case 'o':
+            output = optarg;
+            break;
+        case 'x':
+            exec = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( optind + 1 != argc ) {
+        usage(argv[0]);
+    }
+    if ( NULL != exec ) {
+        return execute(exec, argv[optind]) < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    fp = fopen(argv[optind], "r");
+    if ( NULL == fp ) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    ret = fm10k_conf_load(fp, &conf);
+    fclose(fp);
+    if ( ret < 0 ) {
+        return EXIT_FAILURE;
+    }
+
+    fm10k_prog_init(&prog);
+    removed = fm10k_conf_compile(&conf, &prog);
+    if ( removed < 0 ) {
+        fprintf(stderr, "Failed to compile %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%d records (%d removed by the optimizer)\n", prog.n,
+            removed);
+
+    fp = stdout;
+    if ( NULL != output ) {
+        fp = fopen(output, "w");
+        if ( NULL == fp ) {
+            perror(output);
+            return EXIT_FAILURE;
+        }
+    }
+    ret = fm10k_prog_save(fp, &prog);
+    if ( NULL != output ) {
+        fclose(fp);
+    }
+    fm10k_prog_free(&prog);
+
+    return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
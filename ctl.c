@@ -0,0 +1,442 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ctl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define HDR_SIZE    sizeof(fm10k_ctl_hdr_t)
+
+/*
+ * Close a client connection
+ */
+static void
+_drop(fm10k_ctl_client_t *c)
+{
+    close(c->fd);
+    free(c->buf);
+    free(c->out);
+    c->fd = -1;
+    c->len = 0;
+    c->buf = NULL;
+    c->olen = 0;
+    c->off = 0;
+    c->out = NULL;
+}
+
+/*
+ * Write a whole buffer
+ */
+static int
+_send(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+
+    while ( len > 0 ) {
+        n = send(fd, buf, len, MSG_NOSIGNAL);
+        if ( n < 0 && EINTR == errno ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return -1;
+        }
+        buf = (const unsigned char *)buf + n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * Send as much of the pending response as the socket takes; returns 1 if
+ * some of it is left, 0 once it is sent, and -1 on error
+ */
+static int
+_flush(fm10k_ctl_client_t *c)
+{
+    ssize_t n;
+
+    while ( c->off < c->olen ) {
+        n = send(c->fd, c->out + c->off, c->olen - c->off,
+                 MSG_NOSIGNAL | MSG_DONTWAIT);
+        if ( n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno) ) {
+            return 1;
+        }
+        if ( n < 0 && EINTR == errno ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return -1;
+        }
+        c->off += n;
+    }
+    c->olen = 0;
+    c->off = 0;
+
+    return 0;
+}
+
+/*
+ * Read a whole buffer
+ */
+static int
+_recv(int fd, void *buf, size_t len)
+{
+    ssize_t n;
+
+    while ( len > 0 ) {
+        n = recv(fd, buf, len, 0);
+        if ( n < 0 && EINTR == errno ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            return -1;
+        }
+        buf = (unsigned char *)buf + n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * Listen on a Unix-domain socket; only the owner may connect.  The socket
+ * is created with the restricted mode so that there is no window in which
+ * others can connect.
+ */
+int
+fm10k_ctl_open(fm10k_ctl_t *ctl, const char *path,
+               fm10k_ctl_handler_t handler, void *arg)
+{
+    struct sockaddr_un sun;
+    mode_t mask;
+    int ret;
+    int i;
+
+    memset(ctl, 0, sizeof(fm10k_ctl_t));
+    for ( i = 0; i < FM10K_CTL_MAX_CLIENTS; i++ ) {
+        ctl->clients[i].fd = -1;
+    }
+    if ( strlen(path) >= sizeof(sun.sun_path) ) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+
+    ctl->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( ctl->fd < 0 ) {
+        perror("socket");
+        return -1;
+    }
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    /* Remove the socket of a previous instance */
+    (void)unlink(path);
+    mask = umask(077);
+    ret = bind(ctl->fd, (struct sockaddr *)&sun, sizeof(sun));
+    umask(mask);
+    if ( ret < 0 || listen(ctl->fd, 8) < 0 ) {
+        perror(path);
+        close(ctl->fd);
+        return -1;
+    }
+    fcntl(ctl->fd, F_SETFL, fcntl(ctl->fd, F_GETFL) | O_NONBLOCK);
+    strcpy(ctl->path, path);
+    ctl->handler = handler;
+    ctl->arg = arg;
+
+    return 0;
+}
+
+/*
+ * Close the server and its connections
+ */
+void
+fm10k_ctl_close(fm10k_ctl_t *ctl)
+{
+    int i;
+
+    for ( i = 0; i < FM10K_CTL_MAX_CLIENTS; i++ ) {
+        if ( ctl->clients[i].fd >= 0 ) {
+            _drop(&ctl->clients[i]);
+        }
+    }
+    close(ctl->fd);
+    (void)unlink(ctl->path);
+}
+
+/*
+ * Fill the descriptors to poll; returns the number filled.  A client with
+ * a pending response is polled for output only, so that it is not served
+ * before it reads what it asked for.
+ */
+int
+fm10k_ctl_pollfds(fm10k_ctl_t *ctl, struct pollfd *pfds, int max)
+{
+    int n;
+    int i;
+
+    n = 0;
+    if ( n < max ) {
+        pfds[n].fd = ctl->fd;
+        pfds[n].events = POLLIN;
+        pfds[n].revents = 0;
+        n++;
+    }
+    for ( i = 0; i < FM10K_CTL_MAX_CLIENTS && n < max; i++ ) {
+        if ( ctl->clients[i].fd >= 0 ) {
+            pfds[n].fd = ctl->clients[i].fd;
+            pfds[n].events = ctl->clients[i].olen ? POLLOUT : POLLIN;
+            pfds[n].revents = 0;
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Accept the pending connections
+ */
+static void
+_accept(fm10k_ctl_t *ctl)
+{
+    fm10k_ctl_client_t *c;
+    int fd;
+    int i;
+
+    while ( (fd = accept(ctl->fd, NULL, NULL)) >= 0 ) {
+        c = NULL;
+        for ( i = 0; i < FM10K_CTL_MAX_CLIENTS; i++ ) {
+            if ( ctl->clients[i].fd < 0 ) {
+                c = &ctl->clients[i];
+                break;
+            }
+        }
+        if ( NULL == c ) {
+            close(fd);
+            continue;
+        }
+        c->buf = malloc(HDR_SIZE + FM10K_CTL_MAX_PAYLOAD);
+        c->out = malloc(HDR_SIZE + FM10K_CTL_MAX_PAYLOAD);
+        if ( NULL == c->buf || NULL == c->out ) {
+            free(c->buf);
+            free(c->out);
+            c->buf = NULL;
+            c->out = NULL;
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        c->fd = fd;
+        c->len = 0;
+        c->olen = 0;
+        c->off = 0;
+    }
+}
+
+/*
+ * Execute a complete request and queue its response
+ */
+static void
+_dispatch(fm10k_ctl_t *ctl, fm10k_ctl_client_t *c)
+{
+    fm10k_ctl_hdr_t *req;
+    fm10k_ctl_hdr_t *resp;
+    uint32_t rlen;
+
+    req = (fm10k_ctl_hdr_t *)c->buf;
+    resp = (fm10k_ctl_hdr_t *)c->out;
+    rlen = FM10K_CTL_MAX_PAYLOAD;
+    resp->status = ctl->handler(ctl->arg, req->cmd, c->buf + HDR_SIZE,
+                                req->len, c->out + HDR_SIZE, &rlen);
+    if ( resp->status != FM10K_CTL_OK || rlen > FM10K_CTL_MAX_PAYLOAD ) {
+        rlen = 0;
+    }
+    resp->version = FM10K_CTL_VERSION;
+    resp->cmd = req->cmd;
+    resp->seq = req->seq;
+    resp->len = rlen;
+    ctl->requests++;
+    c->olen = HDR_SIZE + rlen;
+    c->off = 0;
+}
+
+/*
+ * Receive on a client connection and execute its complete requests; the
+ * header and the payload are read separately so that the buffer never
+ * holds more than one request.  A response the socket does not take at
+ * once is kept, and the connection is served again once it is sent.
+ */
+static void
+_serve(fm10k_ctl_t *ctl, fm10k_ctl_client_t *c)
+{
+    fm10k_ctl_hdr_t *hdr;
+    uint32_t want;
+    ssize_t n;
+    int ret;
+
+    hdr = (fm10k_ctl_hdr_t *)c->buf;
+    while ( 1 ) {
+        if ( c->len >= HDR_SIZE && c->len == HDR_SIZE + hdr->len ) {
+            _dispatch(ctl, c);
+            c->len = 0;
+        }
+        ret = _flush(c);
+        if ( ret < 0 ) {
+            _drop(c);
+            return;
+        }
+        if ( ret > 0 ) {
+            return;
+        }
+        want = c->len < HDR_SIZE ? HDR_SIZE : HDR_SIZE + hdr->len;
+        n = recv(c->fd, c->buf + c->len, want - c->len, 0);
+        if ( n < 0 && (EAGAIN == errno || EWOULDBLOCK == errno) ) {
+            return;
+        }
+        if ( n < 0 && EINTR == errno ) {
+            continue;
+        }
+        if ( n <= 0 ) {
+            _drop(c);
+            return;
+        }
+        c->len += n;
+        if ( HDR_SIZE == c->len && (hdr->version != FM10K_CTL_VERSION
+                                    || hdr->len > FM10K_CTL_MAX_PAYLOAD) ) {
+            /* Protocol mismatch; the stream cannot be resynchronized */
+            _drop(c);
+            return;
+        }
+    }
+}
+
+/*
+ * Handle the descriptors returned by poll; returns the number of requests
+ * executed so far
+ */
+int
+fm10k_ctl_process(fm10k_ctl_t *ctl, const struct pollfd *pfds, int n)
+{
+    int i;
+    int j;
+
+    for ( i = 0; i < n; i++ ) {
+        if ( !pfds[i].revents ) {
+            continue;
+        }
+        if ( pfds[i].fd == ctl->fd ) {
+            _accept(ctl);
+            continue;
+        }
+        for ( j = 0; j < FM10K_CTL_MAX_CLIENTS; j++ ) {
+            if ( ctl->clients[j].fd == pfds[i].fd ) {
+                _serve(ctl, &ctl->clients[j]);
+                break;
+            }
+        }
+    }
+
+    return ctl->requests;
+}
+
+/*
+ * Connect to the switch manager
+ */
+int
+fm10k_ctl_connect(const char *path)
+{
+    struct sockaddr_un sun;
+    int fd;
+
+    if ( strlen(path) >= sizeof(sun.sun_path) ) {
+        fprintf(stderr, "Socket path too long: %s\n", path);
+        return -1;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ( fd < 0 ) {
+        perror("socket");
+        return -1;
+    }
+    memset(&sun, 0, sizeof(sun));
+    sun.sun_family = AF_UNIX;
+    strcpy(sun.sun_path, path);
+    if ( connect(fd, (struct sockaddr *)&sun, sizeof(sun)) < 0 ) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Send a request and wait for its response; on input *rlen is the size of
+ * the response buffer.  Returns -1 on a connection error, otherwise 0 with
+ * the status of the request.
+ */
+int
+fm10k_ctl_call(int fd, int cmd, const void *req, uint32_t len, void *resp,
+               uint32_t *rlen, int *status)
+{
+    static uint32_t seq;
+    fm10k_ctl_hdr_t hdr;
+
+    if ( len > FM10K_CTL_MAX_PAYLOAD ) {
+        fprintf(stderr, "Request too large: %u bytes\n", len);
+        return -1;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.version = FM10K_CTL_VERSION;
+    hdr.cmd = cmd;
+    hdr.seq = ++seq;
+    hdr.len = len;
+    if ( _send(fd, &hdr, sizeof(hdr)) < 0 || _send(fd, req, len) < 0 ) {
+        return -1;
+    }
+    if ( _recv(fd, &hdr, sizeof(hdr)) < 0 || hdr.seq != seq
+         || hdr.len > *rlen || _recv(fd, resp, hdr.len) < 0 ) {
+        return -1;
+    }
+    *rlen = hdr.len;
+    *status = hdr.status;
+
+    return 0;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
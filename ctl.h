@@ -0,0 +1,192 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _CTL_H
+#define _CTL_H
+
+#include <stdint.h>
+#include <poll.h>
+
+/* Default socket of the switch manager */
+#define FM10K_CTL_PATH          "/var/run/fm10k.sock"
+
+#define FM10K_CTL_VERSION       1
+#define FM10K_CTL_MAX_PAYLOAD   65536
+#define FM10K_CTL_MAX_CLIENTS   16
+
+/* Commands */
+#define FM10K_CTL_PING          0
+/* fm10k_ctl_reg_t; the value is returned by the reads */
+#define FM10K_CTL_READ32        1
+#define FM10K_CTL_WRITE32       2
+#define FM10K_CTL_READ64        3
+#define FM10K_CTL_WRITE64       4
+/* Configuration text in, fm10k_ctl_apply_t out */
+#define FM10K_CTL_APPLY         5
+/* fm10k_ctl_port_t per port out */
+#define FM10K_CTL_PORTS         6
+/* fm10k_ctl_pcie_t out */
+#define FM10K_CTL_PCIE          7
+/* fm10k_ctl_vf_t in: recycle the VFs for new guests */
+#define FM10K_CTL_VF_REASSIGN   8
+
+/* Status */
+#define FM10K_CTL_OK            0
+#define FM10K_CTL_EINVAL        -1
+#define FM10K_CTL_EFAULT        -2
+/* The change needs a switch reset; nothing was written */
+#define FM10K_CTL_ERESET        -3
+#define FM10K_CTL_EUNSUPP       -4
+
+/*
+ * Message header, followed by len bytes of payload.  Requests and
+ * responses share it; the response carries the status and the sequence
+ * number of its request.  All fields are in host byte order.
+ */
+typedef struct _fm10k_ctl_hdr {
+    uint8_t version;
+    uint8_t cmd;
+    int16_t status;
+    uint32_t seq;
+    uint32_t len;
+} fm10k_ctl_hdr_t;
+
+/*
+ * Register access
+ */
+typedef struct _fm10k_ctl_reg {
+    uint32_t offset;
+    uint32_t reserved;
+    uint64_t value;
+} fm10k_ctl_reg_t;
+
+/*
+ * Result of a configuration change
+ */
+typedef struct _fm10k_ctl_apply {
+    int32_t naccess;
+    int32_t ndiff;
+    int32_t ncold;
+    int32_t nstale;
+} fm10k_ctl_apply_t;
+
+/*
+ * Port state
+ */
+typedef struct _fm10k_ctl_port {
+    int32_t logical;
+    int32_t epl;
+    int32_t lane;
+    int32_t speed;
+    /* Published and raw link state */
+    uint8_t up;
+    uint8_t raw;
+    uint8_t suppressed;
+    uint8_t reserved;
+    uint32_t flaps;
+    uint32_t link_counter;
+    uint32_t code_errors;
+} fm10k_ctl_port_t;
+
+/*
+ * Host link state
+ */
+typedef struct _fm10k_ctl_pcie {
+    uint8_t up;
+    uint8_t ltssm;
+    uint8_t speed;
+    uint8_t width;
+    uint8_t max_speed;
+    uint8_t max_width;
+    uint16_t mps;
+    /* Usable bandwidth (Mbit/s) */
+    uint32_t mbps;
+} fm10k_ctl_pcie_t;
+
+/*
+ * VF selection
+ */
+typedef struct _fm10k_ctl_vf {
+    uint64_t mask;
+} fm10k_ctl_vf_t;
+
+/*
+ * Request handler; fills the response payload and its length and returns
+ * the status
+ */
+typedef int (*fm10k_ctl_handler_t)(void *, int, const void *, uint32_t,
+                                   void *, uint32_t *);
+
+/*
+ * Connection of a client
+ */
+typedef struct _fm10k_ctl_client {
+    int fd;
+    /* Bytes of the partial request received */
+    uint32_t len;
+    unsigned char *buf;
+    /* Response not yet accepted by the socket: bytes and bytes sent */
+    uint32_t olen;
+    uint32_t off;
+    unsigned char *out;
+} fm10k_ctl_client_t;
+
+/*
+ * Control socket server
+ */
+typedef struct _fm10k_ctl {
+    int fd;
+    char path[108];
+    fm10k_ctl_client_t clients[FM10K_CTL_MAX_CLIENTS];
+    fm10k_ctl_handler_t handler;
+    void *arg;
+    uint64_t requests;
+} fm10k_ctl_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_ctl_open(fm10k_ctl_t *, const char *, fm10k_ctl_handler_t, void *);
+void fm10k_ctl_close(fm10k_ctl_t *);
+int fm10k_ctl_pollfds(fm10k_ctl_t *, struct pollfd *, int);
+int fm10k_ctl_process(fm10k_ctl_t *, const struct pollfd *, int);
+int fm10k_ctl_connect(const char *);
+int fm10k_ctl_call(int, int, const void *, uint32_t, void *, uint32_t *,
+                   int *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CTL_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,283 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ctl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-s socket] <command>\n"
+            "Commands:\n"
+            "  ping [count]              round trip to the switch manager\n"
+            "  peek|peek64 <offset>      read a register\n"
+            "  poke|poke64 <offset> <value>\n"
+            "                            write a register\n"
+            "  apply <config>            apply a configuration without a "
+            "reset\n"
+            "  ports                     port link state and counters\n"
+            "  pcie                      host link state\n"
+            "  reassign <mask>           recycle the VFs in the mask for new "
+            "guests\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Description of a status
+ */
+static const char *
+_strstatus(int status)
+{
+    switch ( status ) {
+    case FM10K_CTL_OK:
+        return "OK";
+    case FM10K_CTL_EINVAL:
+        return "invalid request";
+    case FM10K_CTL_EFAULT:
+        return "failed";
+    case FM10K_CTL_ERESET:
+        return "the change needs a switch reset";
+    case FM10K_CTL_EUNSUPP:
+        return "unsupported command";
+    }
+
+    return "unknown status";
+}
+
+/*
+ * Read a whole file
+ */
+static char *
+_slurp(const char *path, uint32_t *len)
+{
+    FILE *fp;
+    char *buf;
+    size_t n;
+
+    fp = fopen(path, "r");
+    if ( NULL == fp ) {
+        perror(path);
+        return NULL;
+    }
+    buf = malloc(FM10K_CTL_MAX_PAYLOAD + 1);
+    if ( NULL == buf ) {
+        fclose(fp);
+        return NULL;
+    }
+    n = fread(buf, 1, FM10K_CTL_MAX_PAYLOAD + 1, fp);
+    fclose(fp);
+    if ( n > FM10K_CTL_MAX_PAYLOAD ) {
+        fprintf(stderr, "%s: larger than %d bytes\n", path,
+                FM10K_CTL_MAX_PAYLOAD);
+        free(buf);
+        return NULL;
+    }
+    *len = n;
+
+    return buf;
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    static unsigned char resp[FM10K_CTL_MAX_PAYLOAD];
+    const char *prog;
+    const char *path;
+    const char *cmd;
+    fm10k_ctl_reg_t reg;
+    fm10k_ctl_apply_t *res;
+    fm10k_ctl_port_t *port;
+    fm10k_ctl_pcie_t *pcie;
+    fm10k_ctl_vf_t vf;
+    struct timespec t0;
+    struct timespec t1;
+    uint32_t rlen;
+    char *buf;
+    uint32_t len;
+    int status;
+    int count;
+    int fd;
+    int opt;
+    int op;
+    int i;
+
+    prog = argv[0];
+    path = FM10K_CTL_PATH;
+    while ( (opt = getopt(argc, argv, "s:")) != -1 ) {
+        switch ( opt ) {
+        case 's':
+            path = optarg;
+            break;
+        default:
+            usage(prog);
+        }
+    }
+    if ( optind >= argc ) {
+        usage(prog);
+    }
+    cmd = argv[optind++];
+    argc -= optind;
+    argv += optind;
+
+    fd = fm10k_ctl_connect(path);
+    if ( fd < 0 ) {
+        return EXIT_FAILURE;
+    }
+
+    status = FM10K_CTL_OK;
+    rlen = sizeof(resp);
+    if ( strcmp(cmd, "ping") == 0 ) {
+        count = argc > 0 ? atoi(argv[0]) : 1;
+        if ( count <= 0 ) {
+            usage(prog);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for ( i = 0; i < count && FM10K_CTL_OK == status; i++ ) {
+            rlen = sizeof(resp);
+            if ( fm10k_ctl_call(fd, FM10K_CTL_PING, NULL, 0, resp, &rlen,
+                                &status) < 0 ) {
+                fprintf(stderr, "Connection to %s lost\n", path);
+                return EXIT_FAILURE;
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("%d round trips, %.1f us each\n", count,
+               ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec))
+               / 1e3 / count);
+    } else if ( strncmp(cmd, "peek", 4) == 0 || strncmp(cmd, "poke", 4) == 0 ) {
+        if ( strcmp(cmd + 4, "") != 0 && strcmp(cmd + 4, "64") != 0 ) {
+            usage(prog);
+        }
+        op = 'e' == cmd[1] ? FM10K_CTL_READ32 : FM10K_CTL_WRITE32;
+        if ( '\0' != cmd[4] ) {
+            op += 2;
+        }
+        if ( argc != (FM10K_CTL_READ32 == op || FM10K_CTL_READ64 == op
+                      ? 1 : 2) ) {
+            usage(prog);
+        }
+        memset(&reg, 0, sizeof(reg));
+        reg.offset = strtoul(argv[0], NULL, 0);
+        if ( argc > 1 ) {
+            reg.value = strtoull(argv[1], NULL, 0);
+        }
+        if ( fm10k_ctl_call(fd, op, &reg, sizeof(reg), resp, &rlen,
+                            &status) < 0 ) {
+            fprintf(stderr, "Connection to %s lost\n", path);
+            return EXIT_FAILURE;
+        }
+        if ( FM10K_CTL_OK == status && rlen == sizeof(reg) ) {
+            memcpy(&reg, resp, sizeof(reg));
+            if ( FM10K_CTL_READ32 == op ) {
+                printf("0x%08x\n", (uint32_t)reg.value);
+            } else if ( FM10K_CTL_READ64 == op ) {
+                printf("0x%016llx\n", (unsigned long long)reg.value);
+            }
+        }
+    } else if ( strcmp(cmd, "apply") == 0 ) {
+        if ( argc != 1 ) {
+            usage(prog);
+        }
+        buf = _slurp(argv[0], &len);
+        if ( NULL == buf ) {
+            return EXIT_FAILURE;
+        }
+        if ( fm10k_ctl_call(fd, FM10K_CTL_APPLY, buf, len, resp, &rlen,
+                            &status) < 0 ) {
+            fprintf(stderr, "Connection to %s lost\n", path);
+            return EXIT_FAILURE;
+        }
+        free(buf);
+        if ( FM10K_CTL_OK == status && rlen == sizeof(*res) ) {
+            res = (fm10k_ctl_apply_t *)resp;
+            printf("%d of %d accesses written, %d removed\n", res->ndiff,
+                   res->naccess, res->nstale);
+        }
+    } else if ( strcmp(cmd, "ports") == 0 ) {
+        if ( fm10k_ctl_call(fd, FM10K_CTL_PORTS, NULL, 0, resp, &rlen,
+                            &status) < 0 ) {
+            fprintf(stderr, "Connection to %s lost\n", path);
+            return EXIT_FAILURE;
+        }
+        port = (fm10k_ctl_port_t *)resp;
+        for ( i = 0; FM10K_CTL_OK == status
+                  && i < (int)(rlen / sizeof(fm10k_ctl_port_t)); i++ ) {
+            printf("port %2d (EPL %d lane %d, %6d Mbps): %-4s%s flaps %u "
+                   "link %u code errors %u\n", port[i].logical, port[i].epl,
+                   port[i].lane, port[i].speed, port[i].up ? "up" : "down",
+                   port[i].suppressed ? " (suppressed)" : "", port[i].flaps,
+                   port[i].link_counter, port[i].code_errors);
+        }
+    } else if ( strcmp(cmd, "pcie") == 0 ) {
+        if ( fm10k_ctl_call(fd, FM10K_CTL_PCIE, NULL, 0, resp, &rlen,
+                            &status) < 0 ) {
+            fprintf(stderr, "Connection to %s lost\n", path);
+            return EXIT_FAILURE;
+        }
+        if ( FM10K_CTL_OK == status && rlen == sizeof(*pcie) ) {
+            pcie = (fm10k_ctl_pcie_t *)resp;
+            printf("PCIe %s: x%u Gen%u of x%u Gen%u, MPS %u, %u Mbps\n",
+                   pcie->up ? "up" : "down", pcie->width, pcie->speed,
+                   pcie->max_width, pcie->max_speed, pcie->mps, pcie->mbps);
+        }
+    } else if ( strcmp(cmd, "reassign") == 0 ) {
+        if ( argc != 1 ) {
+            usage(prog);
+        }
+        vf.mask = strtoull(argv[0], NULL, 0);
+        if ( fm10k_ctl_call(fd, FM10K_CTL_VF_REASSIGN, &vf, sizeof(vf), resp,
+                            &rlen, &status) < 0 ) {
+            fprintf(stderr, "Connection to %s lost\n", path);
+            return EXIT_FAILURE;
+        }
+    } else {
+        usage(prog);
+    }
+    close(fd);
+
+    if ( FM10K_CTL_OK != status ) {
+        fprintf(stderr, "%s: %s\n", cmd, _strstatus(status));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,267 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "eacl.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define KEY_VALID   (1ULL << 34)
+
+/*
+ * Pack rules into CAM key/mask (without the profile) and action words
+ */
+static void
+_pack(const fm10k_eacl_rule_t *rules, int n, uint64_t *key, uint64_t *mask,
+      uint64_t *action)
+{
+    const fm10k_eacl_rule_t *r;
+    int i;
+
+    for ( i = 0; i < n; i++ ) {
+        r = &rules[i];
+        mask[i] = 0xffULL | ((uint64_t)r->eacl_id_mask << 8)
+            | ((uint64_t)(r->vid_mask & 0xfff) << 16)
+            | ((uint64_t)(r->dscp_mask & 0x3f) << 28) | KEY_VALID;
+        key[i] = (((uint64_t)r->eacl_id << 8)
+                  | ((uint64_t)(r->vid & 0xfff) << 16)
+                  | ((uint64_t)(r->dscp & 0x3f) << 28) | KEY_VALID) & mask[i];
+        /* Drop | Modify, with the packed rewrite kept for comparison */
+        action[i] = (FM10K_EACL_DROP == r->action ? 1 : 0);
+        if ( FM10K_EACL_DROP != r->action && r->modify ) {
+            action[i] |= 2 | ((uint64_t)fm10k_mod_pack(&r->rewrite) << 32);
+        }
+    }
+}
+
+/*
+ * Release a reference to a profile; its entries are removed with the last
+ */
+static void
+_release(fm10k_eacl_t *eacl, int id)
+{
+    fm10k_eacl_profile_t *p;
+    int s;
+    int i;
+
+    p = &eacl->profile[id];
+    if ( 0 == id || --p->refcnt > 0 ) {
+        return;
+    }
+    for ( i = 0; i < p->nrules; i++ ) {
+        s = p->slots[i];
+        /* Clear the key first: Valid=0 under a Valid mask never matches */
+        wr64(eacl->fm10k->mmio, FM10K_EACL_CAM(s, 0), 0);
+        wr64(eacl->fm10k->mmio, FM10K_EACL_CAM(s, 1), KEY_VALID);
+        eacl->used[s / 64] &= ~(1ULL << (s % 64));
+        if ( p->mods[i] >= 0 ) {
+            fm10k_mod_put(eacl->mod, p->mods[i]);
+        }
+    }
+    free(p->key);
+    memset(p, 0, sizeof(fm10k_eacl_profile_t));
+}
+
+/*
+ * Install a rule list into a free profile
+ */
+static int
+_install(fm10k_eacl_t *eacl, const fm10k_eacl_rule_t *rules, int n,
+         const uint64_t *key, const uint64_t *mask, const uint64_t *action)
+{
+    fm10k_eacl_profile_t *p;
+    uint64_t *buf;
+    int nfree;
+    int id;
+    int s;
+    int i;
+
+    for ( id = 1; id < FM10K_EACL_PROFILES; id++ ) {
+        if ( NULL == eacl->profile[id].key ) {
+            break;
+        }
+    }
+    nfree = 0;
+    for ( s = 0; s < FM10K_EACL_ENTRIES; s++ ) {
+        if ( !(eacl->used[s / 64] & (1ULL << (s % 64))) ) {
+            nfree++;
+        }
+    }
+    if ( id == FM10K_EACL_PROFILES || nfree < n ) {
+        fprintf(stderr, "EACL: no room for %d rules\n", n);
+        return -1;
+    }
+
+    /* One allocation holds the key, mask, action, slot and mod arrays */
+    buf = malloc((sizeof(uint64_t) * 3 + sizeof(int) * 2) * n);
+    if ( NULL == buf ) {
+        return -1;
+    }
+    p = &eacl->profile[id];
+    p->key = buf;
+    p->mask = buf + n;
+    p->action = buf + 2 * n;
+    p->slots = (int *)(buf + 3 * n);
+    p->mods = p->slots + n;
+    p->nrules = n;
+    memcpy(p->key, key, sizeof(uint64_t) * n);
+    memcpy(p->mask, mask, sizeof(uint64_t) * n);
+    memcpy(p->action, action, sizeof(uint64_t) * n);
+
+    /* Allocate CAM entries in rule order (lower index has precedence) */
+    s = 0;
+    for ( i = 0; i < n; i++ ) {
+        while ( eacl->used[s / 64] & (1ULL << (s % 64)) ) {
+            s++;
+        }
+        eacl->used[s / 64] |= 1ULL << (s % 64);
+        p->slots[i] = s;
+        p->mods[i] = -1;
+    }
+    for ( i = 0; i < n; i++ ) {
+        if ( action[i] & 2 ) {
+            p->mods[i] = fm10k_mod_get(eacl->mod, &rules[i].rewrite);
+            if ( p->mods[i] < 0 ) {
+                p->refcnt = 1;
+                _release(eacl, id);
+                return -1;
+            }
+        }
+    }
+
+    /* Actions, then mask, then key so that no entry matches half written */
+    for ( i = 0; i < n; i++ ) {
+        s = p->slots[i];
+        wr32(eacl->fm10k->mmio, FM10K_EACL_ACTION(s),
+             (action[i] & 3) | ((p->mods[i] >= 0 ? p->mods[i] : 0) << 2));
+        wr64(eacl->fm10k->mmio, FM10K_EACL_CAM(s, 1), mask[i]);
+        wr64(eacl->fm10k->mmio, FM10K_EACL_CAM(s, 0), key[i] | id);
+    }
+
+    return id;
+}
+
+/*
+ * Initialize the egress ACL manager
+ */
+int
+fm10k_eacl_init(fm10k_eacl_t *eacl, fm10k_t *fm10k, fm10k_mod_t *mod)
+{
+    int i;
+
+    memset(eacl, 0, sizeof(fm10k_eacl_t));
+    eacl->fm10k = fm10k;
+    eacl->mod = mod;
+    for ( i = 0; i < FM10K_EACL_PORTS; i++ ) {
+        wr32(fm10k->mmio, FM10K_EACL_PROFILE(i), 0);
+    }
+
+    return 0;
+}
+
+/*
+ * Apply one rule list to a batch of egress ports.  Ports with identical
+ * rule lists share a profile, so the CAM and modification entries are
+ * installed once; each port is then switched to the new profile with a
+ * single write and the entries of its old profile are released.
+ */
+int
+fm10k_eacl_set_ports(fm10k_eacl_t *eacl, const int *ports, int nports,
+                     const fm10k_eacl_rule_t *rules, int n)
+{
+    fm10k_eacl_profile_t *p;
+    uint64_t *buf;
+    int old;
+    int id;
+    int i;
+
+    for ( i = 0; i < nports; i++ ) {
+        if ( ports[i] < 0 || ports[i] >= FM10K_EACL_PORTS ) {
+            return -1;
+        }
+    }
+    if ( n < 0 || n > FM10K_EACL_ENTRIES ) {
+        return -1;
+    }
+
+    id = 0;
+    if ( n > 0 ) {
+        buf = malloc(sizeof(uint64_t) * 3 * n);
+        if ( NULL == buf ) {
+            return -1;
+        }
+        _pack(rules, n, buf, buf + n, buf + 2 * n);
+        for ( i = 1; i < FM10K_EACL_PROFILES; i++ ) {
+            p = &eacl->profile[i];
+            if ( p->key && p->nrules == n
+                 && 0 == memcmp(p->key, buf, sizeof(uint64_t) * n)
+                 && 0 == memcmp(p->mask, buf + n, sizeof(uint64_t) * n)
+                 && 0 == memcmp(p->action, buf + 2 * n,
+                                sizeof(uint64_t) * n) ) {
+                id = i;
+                break;
+            }
+        }
+        if ( 0 == id ) {
+            id = _install(eacl, rules, n, buf, buf + n, buf + 2 * n);
+        }
+        free(buf);
+        if ( id < 0 ) {
+            return -1;
+        }
+    }
+
+    for ( i = 0; i < nports; i++ ) {
+        old = eacl->port_profile[ports[i]];
+        eacl->profile[id].refcnt++;
+        eacl->port_profile[ports[i]] = id;
+        wr32(eacl->fm10k->mmio, FM10K_EACL_PROFILE(ports[i]), id);
+        _release(eacl, old);
+    }
+    if ( id > 0 && 0 == eacl->profile[id].refcnt ) {
+        /* Installed for no port */
+        eacl->profile[id].refcnt = 1;
+        _release(eacl, id);
+    }
+
+    return id;
+}
+
+/*
+ * Remove the egress ACL of a port
+ */
+int
+fm10k_eacl_clear_port(fm10k_eacl_t *eacl, int port)
+{
+    return fm10k_eacl_set_ports(eacl, &port, 1, NULL, 0);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,106 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _EACL_H
+#define _EACL_H
+
+#include "fm10k.h"
+#include "mod.h"
+#include <stdint.h>
+
+#define FM10K_EACL_PORTS        48
+#define FM10K_EACL_ENTRIES      256
+#define FM10K_EACL_PROFILES     256
+
+/* Actions */
+#define FM10K_EACL_PERMIT       0
+#define FM10K_EACL_DROP         1
+
+/*
+ * Egress ACL rule (a field is compared where its mask bits are set)
+ */
+typedef struct _fm10k_eacl_rule {
+    /* ACL ID assigned by the FFU */
+    uint8_t eacl_id;
+    uint8_t eacl_id_mask;
+    uint16_t vid;
+    uint16_t vid_mask;
+    uint8_t dscp;
+    uint8_t dscp_mask;
+    int action;
+    /* Rewrite applied to permitted frames */
+    int modify;
+    fm10k_mod_rewrite_t rewrite;
+} fm10k_eacl_rule_t;
+
+/*
+ * Rule list shared by all the ports with identical rules
+ */
+typedef struct _fm10k_eacl_profile {
+    int refcnt;
+    int nrules;
+    /* Packed key, mask and action of each rule */
+    uint64_t *key;
+    uint64_t *mask;
+    uint64_t *action;
+    /* CAM entries and modification entries used */
+    int *slots;
+    int *mods;
+} fm10k_eacl_profile_t;
+
+/*
+ * Egress ACL manager
+ */
+typedef struct _fm10k_eacl {
+    fm10k_t *fm10k;
+    fm10k_mod_t *mod;
+    uint64_t used[FM10K_EACL_ENTRIES / 64];
+    fm10k_eacl_profile_t profile[FM10K_EACL_PROFILES];
+    /* Profile of each egress port (0: no ACL) */
+    int port_profile[FM10K_EACL_PORTS];
+} fm10k_eacl_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_eacl_init(fm10k_eacl_t *, fm10k_t *, fm10k_mod_t *);
+int fm10k_eacl_set_ports(fm10k_eacl_t *, const int *, int,
+                         const fm10k_eacl_rule_t *, int);
+int fm10k_eacl_clear_port(fm10k_eacl_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _EACL_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
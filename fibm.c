@@ -0,0 +1,527 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "fibm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+
+/*
+ * Frame layout (network byte order):
+ *   0  destination MAC, 6  source MAC, 12 EtherType
+ *   14 sequence number, 16 number of operations, 18 flags, 20 GLORT
+ *   22 operations: command/word address (32 bits), data (64 bits)
+ */
+#define FIBM_HDR_LEN        22
+#define FIBM_OP_LEN         12
+#define FIBM_FRAME_LEN      (FIBM_HDR_LEN + FM10K_FIBM_FRAME_OPS * FIBM_OP_LEN)
+#define FIBM_FLAG_RESPONSE  0x8000
+#define FIBM_FLAG_ERROR     0x0001
+
+#define FIBM_CMD_WRITE32    1
+#define FIBM_CMD_WRITE64    2
+#define FIBM_CMD_READ32     3
+#define FIBM_CMD_READ64     4
+#define FIBM_CMD_SHIFT      24
+#define FIBM_ADDR_MASK      0x00ffffffUL
+
+/* Request frames in flight */
+#define FIBM_WINDOW         8
+
+/* Quiet time that ends the collection of late responses (ms) */
+#define FIBM_DRAIN_MS       1
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Default channel: MMIO only until an interface is given
+ */
+void
+fm10k_fibm_default_cfg(fm10k_fibm_cfg_t *cfg)
+{
+    static const uint8_t mac[6] = { 0x02, 0x00, 0x00, 0x00, 0x0f, 0x1b };
+
+    cfg->ifname = NULL;
+    memcpy(cfg->mac, mac, sizeof(mac));
+    cfg->glort = 0x0b00;
+    cfg->timeout_ms = 100;
+    cfg->threshold = 32;
+}
+
+/*
+ * Open the raw socket on the host interface
+ */
+static int
+_open_socket(fm10k_fibm_t *fibm)
+{
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+
+    fibm->ifindex = if_nametoindex(fibm->cfg.ifname);
+    if ( 0 == fibm->ifindex ) {
+        perror(fibm->cfg.ifname);
+        return -1;
+    }
+    fibm->sock = socket(AF_PACKET, SOCK_RAW, htons(FM10K_FIBM_ETHERTYPE));
+    if ( fibm->sock < 0 ) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, fibm->cfg.ifname, IFNAMSIZ - 1);
+    if ( ioctl(fibm->sock, SIOCGIFHWADDR, &ifr) < 0 ) {
+        perror("SIOCGIFHWADDR");
+        goto error;
+    }
+    memcpy(fibm->src, ifr.ifr_hwaddr.sa_data, 6);
+
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(FM10K_FIBM_ETHERTYPE);
+    sll.sll_ifindex = fibm->ifindex;
+    if ( bind(fibm->sock, (struct sockaddr *)&sll, sizeof(sll)) < 0 ) {
+        perror("bind");
+        goto error;
+    }
+
+    return 0;
+
+error:
+    close(fibm->sock);
+    fibm->sock = -1;
+    return -1;
+}
+
+/*
+ * Enable the FIBM block and open the frame channel.  A channel that cannot
+ * be opened stays usable over MMIO.
+ */
+int
+fm10k_fibm_open(fm10k_fibm_t *fibm, fm10k_t *fm10k,
+                const fm10k_fibm_cfg_t *cfg)
+{
+    uint64_t m64;
+    int i;
+
+    memset(fibm, 0, sizeof(fm10k_fibm_t));
+    fibm->fm10k = fm10k;
+    fibm->cfg = *cfg;
+    fibm->sock = -1;
+    fibm->max = 256;
+    fibm->ops = malloc(sizeof(fm10k_fibm_op_t) * fibm->max);
+    if ( NULL == fibm->ops ) {
+        return -1;
+    }
+
+    /* Management port address */
+    m64 = 0;
+    for ( i = 0; i < 6; i++ ) {
+        m64 = (m64 << 8) | cfg->mac[i];
+    }
+    wr32(fm10k->mmio, FM10K_FIBM_GLORT, cfg->glort);
+    wr64(fm10k->mmio, FM10K_FIBM_MAC, m64);
+    wr32(fm10k->mmio, FM10K_FIBM_CFG, (1UL << 0) | (1UL << 1));
+
+    if ( NULL != cfg->ifname && _open_socket(fibm) < 0 ) {
+        fprintf(stderr, "FIBM: %s unavailable, using MMIO\n", cfg->ifname);
+    }
+
+    return 0;
+}
+
+/*
+ * Close the channel
+ */
+void
+fm10k_fibm_close(fm10k_fibm_t *fibm)
+{
+    if ( fibm->sock >= 0 ) {
+        close(fibm->sock);
+        fibm->sock = -1;
+    }
+    free(fibm->ops);
+    fibm->ops = NULL;
+    fibm->n = 0;
+}
+
+/*
+ * Queue an operation
+ */
+static int
+_queue(fm10k_fibm_t *fibm, int cmd, uint32_t addr, uint64_t data,
+       uint64_t *result)
+{
+    fm10k_fibm_op_t *ops;
+
+    if ( (addr & 3) || (addr >> 2) > FIBM_ADDR_MASK ) {
+        fprintf(stderr, "FIBM: invalid register address %08x\n", addr);
+        return -1;
+    }
+    if ( fibm->n == fibm->max ) {
+        ops = realloc(fibm->ops, sizeof(fm10k_fibm_op_t) * fibm->max * 2);
+        if ( NULL == ops ) {
+            return -1;
+        }
+        fibm->ops = ops;
+        fibm->max *= 2;
+    }
+    fibm->ops[fibm->n].cmd = ((uint32_t)cmd << FIBM_CMD_SHIFT) | (addr >> 2);
+    fibm->ops[fibm->n].data = data;
+    fibm->ops[fibm->n].result = result;
+    fibm->n++;
+
+    return 0;
+}
+
+/*
+ * Queue a 32-bit register write
+ */
+int
+fm10k_fibm_write32(fm10k_fibm_t *fibm, uint32_t addr, uint32_t data)
+{
+    return _queue(fibm, FIBM_CMD_WRITE32, addr, data, NULL);
+}
+
+/*
+ * Queue a 64-bit register write
+ */
+int
+fm10k_fibm_write64(fm10k_fibm_t *fibm, uint32_t addr, uint64_t data)
+{
+    return _queue(fibm, FIBM_CMD_WRITE64, addr, data, NULL);
+}
+
+/*
+ * Queue a 32-bit register read; the result is valid after the flush
+ */
+int
+fm10k_fibm_read32(fm10k_fibm_t *fibm, uint32_t addr, uint64_t *result)
+{
+    return _queue(fibm, FIBM_CMD_READ32, addr, 0, result);
+}
+
+/*
+ * Queue a 64-bit register read; the result is valid after the flush
+ */
+int
+fm10k_fibm_read64(fm10k_fibm_t *fibm, uint32_t addr, uint64_t *result)
+{
+    return _queue(fibm, FIBM_CMD_READ64, addr, 0, result);
+}
+
+/*
+ * Execute operations [from, to) with MMIO accesses
+ */
+static void
+_exec_mmio(fm10k_fibm_t *fibm, int from, int to)
+{
+    fm10k_fibm_op_t *op;
+    uint32_t addr;
+    int i;
+
+    for ( i = from; i < to; i++ ) {
+        op = &fibm->ops[i];
+        addr = (op->cmd & FIBM_ADDR_MASK) << 2;
+        switch ( op->cmd >> FIBM_CMD_SHIFT ) {
+        case FIBM_CMD_WRITE32:
+            wr32(fibm->fm10k->mmio, addr, (uint32_t)op->data);
+            break;
+        case FIBM_CMD_WRITE64:
+            wr64(fibm->fm10k->mmio, addr, op->data);
+            break;
+        case FIBM_CMD_READ32:
+            *op->result = rd32(fibm->fm10k->mmio, addr);
+            break;
+        case FIBM_CMD_READ64:
+            *op->result = rd64(fibm->fm10k->mmio, addr);
+            break;
+        }
+    }
+}
+
+/*
+ * Build and send the request frame of frame index f
+ */
+static int
+_send_frame(fm10k_fibm_t *fibm, uint16_t seq, int f)
+{
+    uint8_t buf[FIBM_FRAME_LEN];
+    uint8_t *p;
+    uint32_t m32;
+    uint16_t m16;
+    int from;
+    int n;
+    int i;
+
+    from = f * FM10K_FIBM_FRAME_OPS;
+    n = fibm->n - from;
+    if ( n > FM10K_FIBM_FRAME_OPS ) {
+        n = FM10K_FIBM_FRAME_OPS;
+    }
+
+    memcpy(buf, fibm->cfg.mac, 6);
+    memcpy(buf + 6, fibm->src, 6);
+    m16 = htons(FM10K_FIBM_ETHERTYPE);
+    memcpy(buf + 12, &m16, 2);
+    m16 = htons(seq);
+    memcpy(buf + 14, &m16, 2);
+    m16 = htons(n);
+    memcpy(buf + 16, &m16, 2);
+    m16 = 0;
+    memcpy(buf + 18, &m16, 2);
+    m16 = htons(fibm->cfg.glort);
+    memcpy(buf + 20, &m16, 2);
+
+    p = buf + FIBM_HDR_LEN;
+    for ( i = 0; i < n; i++ ) {
+        m32 = htonl(fibm->ops[from + i].cmd);
+        memcpy(p, &m32, 4);
+        m32 = htonl((uint32_t)(fibm->ops[from + i].data >> 32));
+        memcpy(p + 4, &m32, 4);
+        m32 = htonl((uint32_t)fibm->ops[from + i].data);
+        memcpy(p + 8, &m32, 4);
+        p += FIBM_OP_LEN;
+    }
+
+    if ( send(fibm->sock, buf, p - buf, 0) < 0 ) {
+        perror("FIBM send");
+        return -1;
+    }
+    fibm->frames++;
+
+    return 0;
+}
+
+/*
+ * Receive one response and store its read data.  Returns the frame index
+ * relative to base, or -1 for frames that are not a valid response.
+ */
+static int
+_recv_frame(fm10k_fibm_t *fibm, uint16_t base, int nframes)
+{
+    uint8_t buf[FIBM_FRAME_LEN + 64];
+    fm10k_fibm_op_t *op;
+    uint8_t *p;
+    uint32_t hi;
+    uint32_t lo;
+    uint16_t m16;
+    ssize_t len;
+    int from;
+    int f;
+    int n;
+    int i;
+
+    len = recv(fibm->sock, buf, sizeof(buf), MSG_DONTWAIT);
+    if ( len < FIBM_HDR_LEN ) {
+        return -1;
+    }
+    memcpy(&m16, buf + 12, 2);
+    if ( ntohs(m16) != FM10K_FIBM_ETHERTYPE ) {
+        return -1;
+    }
+    memcpy(&m16, buf + 18, 2);
+    m16 = ntohs(m16);
+    if ( !(m16 & FIBM_FLAG_RESPONSE) || (m16 & FIBM_FLAG_ERROR) ) {
+        return -1;
+    }
+    memcpy(&m16, buf + 14, 2);
+    f = (uint16_t)(ntohs(m16) - base);
+    if ( f >= nframes ) {
+        return -1;
+    }
+    from = f * FM10K_FIBM_FRAME_OPS;
+    memcpy(&m16, buf + 16, 2);
+    n = ntohs(m16);
+    if ( n != fibm->n - from
+         && !(n == FM10K_FIBM_FRAME_OPS && n < fibm->n - from) ) {
+        return -1;
+    }
+    if ( len < FIBM_HDR_LEN + n * FIBM_OP_LEN ) {
+        return -1;
+    }
+
+    p = buf + FIBM_HDR_LEN;
+    for ( i = 0; i < n; i++ ) {
+        op = &fibm->ops[from + i];
+        if ( NULL != op->result ) {
+            memcpy(&hi, p + 4, 4);
+            memcpy(&lo, p + 8, 4);
+            *op->result = ((uint64_t)ntohl(hi) << 32) | ntohl(lo);
+        }
+        p += FIBM_OP_LEN;
+    }
+
+    return f;
+}
+
+/*
+ * Execute the batch in request frames with up to FIBM_WINDOW in flight.
+ * When frames are not acknowledged in time, the channel is quiesced and
+ * only the unacknowledged frames are replayed over MMIO.  The order of the
+ * operations is kept within a frame but not across frames: a replayed
+ * frame lands after the later frames that were acknowledged, and it may
+ * have been executed already if only its response was lost.
+ */
+static void
+_exec_frames(fm10k_fibm_t *fibm)
+{
+    struct pollfd pfd;
+    uint8_t *acked;
+    uint64_t deadline;
+    uint64_t now;
+    uint32_t cfg;
+    uint16_t base;
+    int nframes;
+    int nacked;
+    int next;
+    int from;
+    int to;
+    int f;
+
+    nframes = (fibm->n + FM10K_FIBM_FRAME_OPS - 1) / FM10K_FIBM_FRAME_OPS;
+    acked = calloc(nframes, 1);
+    if ( NULL == acked ) {
+        _exec_mmio(fibm, 0, fibm->n);
+        return;
+    }
+    base = fibm->seq;
+    fibm->seq += nframes;
+
+    next = 0;
+    nacked = 0;
+    deadline = _now() + (uint64_t)fibm->cfg.timeout_ms * 1000000;
+    while ( nacked < nframes ) {
+        while ( next < nframes && next - nacked < FIBM_WINDOW ) {
+            if ( _send_frame(fibm, base + next, next) < 0 ) {
+                goto fallback;
+            }
+            next++;
+        }
+        now = _now();
+        if ( now >= deadline ) {
+            break;
+        }
+        pfd.fd = fibm->sock;
+        pfd.events = POLLIN;
+        if ( poll(&pfd, 1, (deadline - now + 999999) / 1000000) <= 0 ) {
+            continue;
+        }
+        f = _recv_frame(fibm, base, nframes);
+        if ( f >= 0 && !acked[f] ) {
+            acked[f] = 1;
+            nacked++;
+            /* The timeout runs from the last completion */
+            deadline = _now() + (uint64_t)fibm->cfg.timeout_ms * 1000000;
+        }
+    }
+
+fallback:
+    if ( nacked < nframes ) {
+        /* Quiesce: the FIBM block stops executing the requests still in
+           flight, then the responses already sent are collected */
+        cfg = rd32(fibm->fm10k->mmio, FM10K_FIBM_CFG);
+        wr32(fibm->fm10k->mmio, FM10K_FIBM_CFG, cfg & ~1UL);
+        (void)rd32(fibm->fm10k->mmio, FM10K_FIBM_CFG);
+        pfd.fd = fibm->sock;
+        pfd.events = POLLIN;
+        while ( poll(&pfd, 1, FIBM_DRAIN_MS) > 0 ) {
+            f = _recv_frame(fibm, base, nframes);
+            if ( f >= 0 && !acked[f] ) {
+                acked[f] = 1;
+                nacked++;
+            }
+        }
+        if ( nacked < nframes ) {
+            fprintf(stderr, "FIBM: %d of %d frames unacknowledged, "
+                    "replaying over MMIO\n", nframes - nacked, nframes);
+            for ( f = 0; f < nframes; f++ ) {
+                if ( acked[f] ) {
+                    continue;
+                }
+                from = f * FM10K_FIBM_FRAME_OPS;
+                to = from + FM10K_FIBM_FRAME_OPS;
+                _exec_mmio(fibm, from, to < fibm->n ? to : fibm->n);
+            }
+            fibm->fallbacks++;
+        }
+        wr32(fibm->fm10k->mmio, FM10K_FIBM_CFG, cfg);
+    }
+    free(acked);
+}
+
+/*
+ * Execute the queued operations over the selected path.  FM10K_FIBM_AUTO
+ * sends batches of at least cfg.threshold operations in frames.  Returns
+ * the number of operations executed.
+ */
+int
+fm10k_fibm_flush(fm10k_fibm_t *fibm, int mode)
+{
+    int n;
+
+    if ( FM10K_FIBM_AUTO == mode ) {
+        mode = fibm->n >= fibm->cfg.threshold
+            ? FM10K_FIBM_FRAME : FM10K_FIBM_MMIO;
+    }
+    if ( fibm->sock < 0 ) {
+        mode = FM10K_FIBM_MMIO;
+    }
+
+    if ( FM10K_FIBM_FRAME == mode && fibm->n > 0 ) {
+        _exec_frames(fibm);
+    } else {
+        _exec_mmio(fibm, 0, fibm->n);
+    }
+    n = fibm->n;
+    fibm->n = 0;
+
+    return n;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
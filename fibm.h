@@ -0,0 +1,111 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _FIBM_H
+#define _FIBM_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+/* Local experimental EtherType carrying FIBM requests and responses */
+#define FM10K_FIBM_ETHERTYPE    0x88b5
+/* Register operations per frame (fits a 1500-byte MTU) */
+#define FM10K_FIBM_FRAME_OPS    120
+
+/* Path selection of fm10k_fibm_flush() */
+#define FM10K_FIBM_MMIO         0
+#define FM10K_FIBM_FRAME        1
+#define FM10K_FIBM_AUTO         2
+
+/*
+ * Channel configuration
+ */
+typedef struct _fm10k_fibm_cfg {
+    /* Host interface attached to the switch (NULL: MMIO only) */
+    const char *ifname;
+    /* Address and GLORT of the management port */
+    uint8_t mac[6];
+    uint16_t glort;
+    /* Completion timeout of a batch before it falls back to MMIO */
+    int timeout_ms;
+    /* FM10K_FIBM_AUTO uses frames for batches of this many operations */
+    int threshold;
+} fm10k_fibm_cfg_t;
+
+/*
+ * Queued register operation
+ */
+typedef struct _fm10k_fibm_op {
+    /* Command in the high byte, register word address below */
+    uint32_t cmd;
+    uint64_t data;
+    /* Destination of read data */
+    uint64_t *result;
+} fm10k_fibm_op_t;
+
+/*
+ * FIBM channel
+ */
+typedef struct _fm10k_fibm {
+    fm10k_t *fm10k;
+    fm10k_fibm_cfg_t cfg;
+    int sock;
+    int ifindex;
+    uint8_t src[6];
+    uint16_t seq;
+    /* Operation batch */
+    fm10k_fibm_op_t *ops;
+    int n;
+    int max;
+    /* Statistics */
+    uint64_t frames;
+    uint64_t fallbacks;
+} fm10k_fibm_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_fibm_default_cfg(fm10k_fibm_cfg_t *);
+int fm10k_fibm_open(fm10k_fibm_t *, fm10k_t *, const fm10k_fibm_cfg_t *);
+void fm10k_fibm_close(fm10k_fibm_t *);
+int fm10k_fibm_write32(fm10k_fibm_t *, uint32_t, uint32_t);
+int fm10k_fibm_write64(fm10k_fibm_t *, uint32_t, uint64_t);
+int fm10k_fibm_read32(fm10k_fibm_t *, uint32_t, uint64_t *);
+int fm10k_fibm_read64(fm10k_fibm_t *, uint32_t, uint64_t *);
+int fm10k_fibm_flush(fm10k_fibm_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FIBM_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,200 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "fibm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+/* Scratch registers exercised by the benchmark; the lower half holds the
+   SOFT_RESET lock (2) and the NVM version (401) and is left alone */
+#define SCRATCH_BASE            512
+#define SCRATCH_WORDS           512
+#define SCRATCH(i)              \
+    FM10K_BSM_SCRATCH(SCRATCH_BASE + (i) % SCRATCH_WORDS)
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-i ifname] [-n ops] [-b batch] "
+            "<uio device>\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Write n scratch words in batches over one path, read them back and
+ * report the throughput of both directions
+ */
+static int
+bench(fm10k_fibm_t *fibm, const char *name, int mode, int n, int batch)
+{
+    uint64_t *res;
+    uint64_t t0;
+    uint64_t tw;
+    uint64_t tr;
+    int errors;
+    int i;
+
+    res = malloc(sizeof(uint64_t) * batch);
+    if ( NULL == res ) {
+        return -1;
+    }
+
+    t0 = _now();
+    for ( i = 0; i < n; i++ ) {
+        if ( fm10k_fibm_write32(fibm, SCRATCH(i), 0x5a000000 | i) < 0
+             || (((i + 1) % batch == 0 || i + 1 == n)
+                 && fm10k_fibm_flush(fibm, mode) < 0) ) {
+            goto error;
+        }
+    }
+    tw = _now() - t0;
+
+    errors = 0;
+    t0 = _now();
+    for ( i = 0; i < n; i++ ) {
+        if ( fm10k_fibm_read32(fibm, SCRATCH(i), &res[i % batch]) < 0
+             || (((i + 1) % batch == 0 || i + 1 == n)
+                 && fm10k_fibm_flush(fibm, mode) < 0) ) {
+            goto error;
+        }
+    }
+    tr = _now() - t0;
+
+    /* Verify the final contents */
+    for ( i = n > SCRATCH_WORDS ? n - SCRATCH_WORDS : 0; i < n; i++ ) {
+        if ( fm10k_fibm_read32(fibm, SCRATCH(i), &res[0]) < 0
+             || fm10k_fibm_flush(fibm, FM10K_FIBM_MMIO) < 0 ) {
+            goto error;
+        }
+        if ( res[0] != (0x5a000000 | (uint32_t)i) ) {
+            errors++;
+        }
+    }
+
+    printf("%-6s %9d ops  write %10.0f ops/s  read %10.0f ops/s  "
+           "errors %d\n", name, n, n * 1e9 / (tw ? tw : 1),
+           n * 1e9 / (tr ? tr : 1), errors);
+    free(res);
+
+    return errors ? -1 : 0;
+
+error:
+    fprintf(stderr, "%s: failed to queue or flush operation %d\n", name, i);
+    free(res);
+    return -1;
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    fm10k_fibm_cfg_t cfg;
+    fm10k_fibm_t fibm;
+    fm10k_t fm10k;
+    uint32_t saved[SCRATCH_WORDS];
+    int batch;
+    int opt;
+    int ret;
+    int n;
+    int i;
+
+    fm10k_fibm_default_cfg(&cfg);
+    n = 100000;
+    batch = 1024;
+    while ( (opt = getopt(argc, argv, "i:n:b:")) != -1 ) {
+        switch ( opt ) {
+        case 'i':
+            cfg.ifname = optarg;
+            break;
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 'b':
+            batch = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( optind >= argc || n <= 0 || batch <= 0 ) {
+        usage(argv[0]);
+    }
+
+    if ( fm10k_open(&fm10k, argv[optind]) < 0 ) {
+        return EXIT_FAILURE;
+    }
+
+    /* Restore the scratch words when done */
+    for ( i = 0; i < SCRATCH_WORDS; i++ ) {
+        saved[i] = rd32(fm10k.mmio, SCRATCH(i));
+    }
+
+    if ( fm10k_fibm_open(&fibm, &fm10k, &cfg) < 0 ) {
+        return EXIT_FAILURE;
+    }
+    ret = bench(&fibm, "mmio", FM10K_FIBM_MMIO, n, batch);
+    if ( fibm.sock >= 0 ) {
+        ret |= bench(&fibm, "fibm", FM10K_FIBM_FRAME, n, batch);
+        printf("fibm frames %llu, MMIO fallbacks %llu\n",
+               (unsigned long long)fibm.frames,
+               (unsigned long long)fibm.fallbacks);
+    } else {
+        printf("fibm   skipped (no interface)\n");
+    }
+    fm10k_fibm_close(&fibm);
+    for ( i = 0; i < SCRATCH_WORDS; i++ ) {
+        wr32(fm10k.mmio, SCRATCH(i), saved[i]);
+    }
+    fm10k_close(&fm10k);
+
+    return ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
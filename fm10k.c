@@ -0,0 +1,105 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "libfm10k.h"
+#include <stdio.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*
+ * Library version
+ */
+const char *
+fm10k_lib_version(void)
+{
+    return FM10K_LIB_VERSION;
+}
+
+/*
+ * Open a uio device and map BAR4
+ */
+int
+fm10k_open(fm10k_t *fm10k, const char *path)
+{
+    long pagesize;
+
+    fm10k->fd = open(path, O_RDWR);
+    if ( fm10k->fd < 0 ) {
+        perror(path);
+        return -1;
+    }
+    pagesize = sysconf(_SC_PAGESIZE);
+    fm10k->size = (FM10K_BAR4_SIZE + pagesize - 1) / pagesize * pagesize;
+    fm10k->mmio = mmap(NULL, fm10k->size, PROT_READ|PROT_WRITE, MAP_SHARED,
+                       fm10k->fd, 0);
+    if ( MAP_FAILED == fm10k->mmio ) {
+        perror("mmap");
+        close(fm10k->fd);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Unmap and close
+ */
+void
+fm10k_close(fm10k_t *fm10k)
+{
+    (void)munmap(fm10k->mmio, fm10k->size);
+    (void)close(fm10k->fd);
+}
+
+/*
+ * Enable the interrupt of the uio device
+ */
+int
+fm10k_irq_enable(fm10k_t *fm10k)
+{
+    uint32_t info;
+
+    info = 1;
+
+    return write(fm10k->fd, &info, sizeof(info)) == sizeof(info) ? 0 : -1;
+}
+
+/*
+ * Read the interrupt count once the uio device is readable
+ */
+int
+fm10k_irq_read(fm10k_t *fm10k, uint32_t *count)
+{
+    return read(fm10k->fd, count, sizeof(uint32_t)) == sizeof(uint32_t)
+        ? 0 : -1;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -24,6 +24,9 @@
 #ifndef _FM10K_H
 #define _FM10K_H
 
+#include <stdint.h>
+#include <stddef.h>
+
 #define FM10K_EPL(a)            ((0x0e0000 + (a)) * 4)
 #define FM10K_PARSER(a)         ((0xcf0000 + (a)) * 4)
 #define FM10K_FFU(a)            ((0xc00000 + (a)) * 4)
@@ -208,6 +211,30 @@
  */
 #define FM10K_SBUS_EPL_CFG      FM10K_PORTS_MGMT(0x5)
 
+/*
+ * SBUS_EPL_COMMAND
+ * 7:0   Register
+ * 15:8  Address
+ * 23:16 Op
+ * 24    Execute
+ * 25    Busy
+ * 28:26 ResultCode
+ * 31:29 Reserved
+ */
+#define FM10K_SBUS_EPL_COMMAND  FM10K_PORTS_MGMT(0x6)
+
+/*
+ * SBUS_EPL_REQUEST
+ * 31:0 Data
+ */
+#define FM10K_SBUS_EPL_REQUEST  FM10K_PORTS_MGMT(0x7)
+
+/*
+ * SBUS_EPL_RESPONSE
+ * 31:0 Data
+ */
+#define FM10K_SBUS_EPL_RESPONSE FM10K_PORTS_MGMT(0x8)
+
 /*
  * BSM_SCRATCH[0..1023]
  */
@@ -324,6 +351,30 @@
  */
 #define FM10K_SBUS_PCIE_CFG     FM10K_MGMT(0x2243)
 
+/*
+ * SBUS_PCIE_COMMAND
+ * 7:0   Register
+ * 15:8  Address
+ * 23:16 Op
+ * 24    Execute
+ * 25    Busy
+ * 28:26 ResultCode
+ * 31:29 Reserved
+ */
+#define FM10K_SBUS_PCIE_COMMAND FM10K_MGMT(0x2244)
+
+/*
+ * SBUS_PCIE_REQUEST
+ * 31:0 Data
+ */
+#define FM10K_SBUS_PCIE_REQUEST FM10K_MGMT(0x2245)
+
+/*
+ * SBUS_PCIE_RESPONSE
+ * 31:0 Data
+ */
+#define FM10K_SBUS_PCIE_RESPONSE    FM10K_MGMT(0x2246)
+
 /*
  * REI_CTRL
  * 0    Reset
@@ -355,8 +406,42 @@
  */
 #define FM10K_SCAN_DATA_IN      FM10K_MGMT(0xc2d)
 
+/*
+ * SYSTIME
+ * Atomicity: 64
+ * 63:0  SystemTime (ns)
+ */
+#define FM10K_SYSTIME           FM10K_MGMT(0x2250)
+
+/*
+ * SYSTIME0
+ * Atomicity: 64
+ * 63:0  Value loaded into (or, signed, added to) SYSTIME
+ */
+#define FM10K_SYSTIME0          FM10K_MGMT(0x2252)
+
+/*
+ * SYSTIME_INC
+ * Atomicity: 64
+ * 31:0  IncrementFraction (2^-32 ns)
+ * 39:32 IncrementNs
+ * 63:40 Reserved
+ */
+#define FM10K_SYSTIME_INC       FM10K_MGMT(0x2254)
+
+/*
+ * SYSTIME_CFG
+ * 0     Enable
+ * 1     Load (SYSTIME = SYSTIME0; self-clearing)
+ * 2     Adjust (SYSTIME += SYSTIME0; self-clearing)
+ * 31:3  Reserved
+ */
+#define FM10K_SYSTIME_CFG       FM10K_MGMT(0x2256)
+
 /*
  * PCIE_HOST_LANE_CTRL
+ * 7:0   LaneEnable[0..7]
+ * 15:8  LaneActive[0..7]
  */
 #define FM10K_PCIE_HOST_LANE_CTRL   FM10K_PCIE_PF(0x19001)
 
@@ -431,7 +516,8 @@
 #define FM10K_PCIE_ITR(i)       FM10K_PCIE_PF((i) + 0x12400)
 
 /*
- * PCIE_ITR2
+ * PCIE_ITR2: interrupt vector chain of a function
+ * 9:0   Index of the previous vector (itself for the first one)
  */
 #define FM10K_PCIE_ITR2(i)      FM10K_PCIE_PF(0x2 * (i) + 0x12800)
 
@@ -460,6 +546,92 @@
  */
 #define FM10K_PCIE_SRAM_IM      FM10K_PCIE_PF(0x13004)
 
+/*
+ * PCIE_DGLORTMAP: destination GLORT match for the host interface
+ * 15:0  Value
+ * 31:16 Mask
+ */
+#define FM10K_PCIE_DGLORTMAP(i) FM10K_PCIE_PF((i) + 0x30)
+
+/*
+ * PCIE_DGLORTDEC: queue decoding of a matched destination GLORT
+ * 3:0   RSSLength
+ * 6:4   VSILength
+ * 13:7  VSIBase
+ * 15:14 PCLength
+ * 23:16 QBase
+ * 27    InnerRSS
+ */
+#define FM10K_PCIE_DGLORTDEC(i) FM10K_PCIE_PF((i) + 0x38)
+
+/*
+ * PCIE_TQMAP/PCIE_RQMAP: VF queue (vf * 32 + i) to absolute queue
+ * 7:0   Queue
+ */
+#define FM10K_PCIE_TQMAP(i)     FM10K_PCIE_PF((i) + 0x2800)
+#define FM10K_PCIE_RQMAP(i)     FM10K_PCIE_PF((i) + 0x3000)
+
+/*
+ * PCIE_RXQCTL
+ * 0     Enable
+ * 7:2   VF
+ * 8     OwnedByVF
+ */
+#define FM10K_PCIE_RXQCTL(i)    FM10K_PCIE_PF(0x40 * (i) + 0x4006)
+
+/*
+ * PCIE_TXDCTL
+ * 14    Enable
+ */
+#define FM10K_PCIE_TXDCTL(i)    FM10K_PCIE_PF(0x40 * (i) + 0x8006)
+
+/*
+ * PCIE_TXQCTL
+ * 5:0   VF
+ * 6     OwnedByVF
+ */
+#define FM10K_PCIE_TXQCTL(i)    FM10K_PCIE_PF(0x40 * (i) + 0x8014)
+
+/*
+ * PCIE_TX_SGLORT
+ * 15:0  Glort
+ */
+#define FM10K_PCIE_TX_SGLORT(i) FM10K_PCIE_PF(0x40 * (i) + 0x8015)
+
+/*
+ * PCIE_PFVFLRE: function level reset events of VFs 32*i..32*i+31
+ */
+#define FM10K_PCIE_PFVFLRE(i)   FM10K_PCIE_PF((i) + 0x18844)
+
+/*
+ * PCIE_PFVFLREC: write 1 to clear PCIE_PFVFLRE
+ */
+#define FM10K_PCIE_PFVFLREC(i)  FM10K_PCIE_PF((i) + 0x18846)
+
+/*
+ * PCIE_CFG_DEV_CTRL: PCI Express capability (at 0x70), Device Control
+ * 7:5   MaxPayloadSize (128 << n bytes)
+ * 14:12 MaxReadRequestSize (128 << n bytes)
+ */
+#define FM10K_PCIE_CFG_DEV_CTRL FM10K_PCIE_CFG(0x1e)
+
+/*
+ * PCIE_CFG_LINK_CAP: PCI Express capability, Link Capabilities
+ * 3:0   MaxLinkSpeed (1: 2.5 GT/s, 2: 5 GT/s, 3: 8 GT/s)
+ * 9:4   MaxLinkWidth
+ */
+#define FM10K_PCIE_CFG_LINK_CAP FM10K_PCIE_CFG(0x1f)
+
+/*
+ * PCIE_CFG_LINK_CTRL: PCI Express capability, Link Control and Status
+ * 15:0  LinkControl
+ * 19:16 CurrentLinkSpeed
+ * 25:20 NegotiatedLinkWidth
+ * 27    LinkTraining
+ * 29    DataLinkLayerLinkActive
+ */
+#define FM10K_PCIE_CFG_LINK_CTRL    FM10K_PCIE_CFG(0x20)
+
 /*
  * PCIE_PORTLOGIC
  */
@@ -515,6 +687,10 @@
  * 15:12 Port3PcsSel
  * 18:16 QplMode
  * 31:19 Reserved
+ *
+ * PcsSel: 0 Disabled, 1 AN_73, 2 SGMII_10, 3 SGMII_100, 4 SGMII_1000,
+ *         5 1000BASEX, 6 10GBASER, 7 40GBASER4, 8 100GBASER
+ * QplMode: 0 four single-lane ports, 1 one four-lane port on port 0
  */
 #define FM10K_EPL_CFG_B(i)      FM10K_EPL(0x400 * (i) + 0x305)
 
@@ -525,6 +701,10 @@
 
 /*
  * PORT_STATUS[0..8][0..3]
+ * 0     LinkUp
+ * 1     LocalFault
+ * 2     RemoteFault
+ * 31:3  Reserved
  */
 #define FM10K_PORT_STATUS(j, i) FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x0)
 
@@ -539,12 +719,23 @@
 #define FM10K_LINK_IM(j, i)     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x2)
 
 /*
- * AN_IP[0..8][0..3]
+ * AN_IP[0..8][0..3] (write 1 to clear)
+ * 0     An73PageReceived
+ * 1     An73Complete
+ * 2     An73TransmitDisable
+ * 3     An37PageReceived
+ * 4     An37Complete
+ * 31:5  Reserved
  */
 #define FM10K_AN_IP(j, i)       FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x3)
 
 /*
- * LINK_IP[0..8][0..3]
+ * LINK_IP[0..8][0..3] (write 1 to clear)
+ * 0     LinkUp
+ * 1     LinkDown
+ * 2     LocalFault
+ * 3     RemoteFault
+ * 31:4  Reserved
  */
 #define FM10K_LINK_IP(j, i)     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x4)
 
@@ -555,12 +746,21 @@
 
 /*
  * AN_37_PAGE_RX[0..8][0..3]
+ * 5     FullDuplex
+ * 6     HalfDuplex
+ * 8:7   Pause
+ * 13:12 RemoteFault
+ * 14    Ack
+ * 15    NextPage
  */
 #define FM10K_AN_37_PAGE_RX(j, i)               \
     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x8)
 
 /*
  * AN_73_PAGE_RX[0..8][0..3]
+ * Atomicity: 64
+ * 47:0  Page (IEEE 802.3 Clause 73 base or next page)
+ * 63:48 Reserved
  */
 #define FM10K_AN_73_PAGE_RX(j, i)               \
     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0xa)
@@ -572,6 +772,11 @@
 
 /*
  * MAC_CFG[0..8][0..3]
+ * 15:0  TxClockCompensationTimeout
+ * 16    TxClockCompensationEnable
+ * 22:17 TxIdleMinIfgBytes
+ * 25:23 Speed (0: 10G+, 1: 1G, 2: 100M, 3: 10M)
+ * 31:26 Reserved
  */
 #define FM10K_MAC_CFG(j, i)     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x10)
 
@@ -587,6 +792,9 @@
 
 /*
  * MAC_1588_STATUS[0..8][0..3]
+ * Atomicity: 64
+ * 31:0  IngressTimeStamp (SYSTIME[31:0] of the last timestamped frame)
+ * 63:32 EgressTimeStamp
  */
 #define FM10K_MAC_1588_STATUS(j, i)             \
     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x1e)
@@ -653,6 +861,8 @@
 
 /*
  * PCS_1000BASEX_CFG[0..8][0..3]
+ * 0     AnEnable
+ * 31:1  Reserved
  */
 #define FM10K_PCS_1000BASEX_CFG(j, i)           \
     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x2a)
@@ -671,6 +881,10 @@
 
 /*
  * PCS_10GBASER_CFG[0..8][0..3]
+ * 0     TxAlignMarkerEnable
+ * 1     RxAlignMarkerEnable
+ * 2     RsFecEnable
+ * 31:3  Reserved
  */
 #define FM10K_PCS_10GBASER_CFG(j, i)            \
     FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x2d)
@@ -689,14 +903,39 @@
 
 /*
  * AN_37_CFG[0..8][0..3]
+ * 0     Enable
+ * 1     Restart
+ * 31:2  Reserved
  */
 #define FM10K_AN_37_CFG(j, i)   FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x30)
 
 /*
  * AN_73_CFG[0..8][0..3]
+ * 0     Enable
+ * 1     Restart
+ * 2     NextPageValid
+ * 31:3  Reserved
  */
 #define FM10K_AN_73_CFG(j, i)   FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x33)
 
+/*
+ * AN_73_BASE_PAGE_TX[0..8][0..3]
+ * Atomicity: 64
+ * 47:0  Page
+ * 63:48 Reserved
+ */
+#define FM10K_AN_73_BASE_PAGE_TX(j, i)          \
+    FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x36)
+
+/*
+ * AN_73_NEXT_PAGE_TX[0..8][0..3]
+ * Atomicity: 64
+ * 47:0  Page
+ * 63:48 Reserved
+ */
+#define FM10K_AN_73_NEXT_PAGE_TX(j, i)          \
+    FM10K_EPL(0x400 * (j) + 0x80 * (i) + 0x38)
+
 /*
  * AN_37_TIMER_CFG[0..8][0..3]
  */
@@ -743,6 +982,70 @@
  */
 #define FM10K_TE_CFG(i)         FM10K_TE(0x100000 * (i) + 0x55a02)
 
+/*
+ * TE_DATA[0..1][0..32767]
+ * Atomicity: 64
+ */
+#define FM10K_TE_DATA(j, i)     FM10K_TE(0x100000 * (j) + 0x2 * (i) + 0x0)
+
+/*
+ * TE_LOOKUP[0..1][0..16383]
+ * Atomicity: 64
+ * 14:0  DataPointer
+ * 19:15 DataLength
+ * 63:20 Reserved
+ */
+#define FM10K_TE_LOOKUP(j, i)                   \
+    FM10K_TE(0x100000 * (j) + 0x2 * (i) + 0x10000)
+
+/*
+ * TE_DGLORT_MAP[0..1][0..7]
+ * Atomicity: 64
+ * 15:0  DGLORT_Value
+ * 31:16 DGLORT_Mask
+ * 63:32 Reserved
+ */
+#define FM10K_TE_DGLORT_MAP(j, i)               \
+    FM10K_TE(0x100000 * (j) + 0x2 * (i) + 0x55800)
+
+/*
+ * TE_DGLORT_DEC[0..1][0..7]
+ * Atomicity: 64
+ * 14:0  BaseLookup
+ * 18:15 IndexBits
+ * 19    Encap (0: decapsulate, 1: encapsulate)
+ * 63:20 Reserved
+ */
+#define FM10K_TE_DGLORT_DEC(j, i)               \
+    FM10K_TE(0x100000 * (j) + 0x2 * (i) + 0x55810)
+
+/*
+ * TE_DEFAULT_DMAC[0..1]
+ * Atomicity: 64
+ * 47:0  MacAddress
+ */
+#define FM10K_TE_DEFAULT_DMAC(i)    FM10K_TE(0x100000 * (i) + 0x55a04)
+
+/*
+ * TE_DEFAULT_SMAC[0..1]
+ * Atomicity: 64
+ * 47:0  MacAddress
+ */
+#define FM10K_TE_DEFAULT_SMAC(i)    FM10K_TE(0x100000 * (i) + 0x55a06)
+
+/*
+ * TE_DEFAULT_SIP[0..1]
+ * 31:0  IPv4 source address of the outer header
+ */
+#define FM10K_TE_DEFAULT_SIP(i)     FM10K_TE(0x100000 * (i) + 0x55a08)
+
+/*
+ * TE_DEFAULT_L4DST[0..1]
+ * 15:0  VXLAN
+ * 31:16 NGE
+ */
+#define FM10K_TE_DEFAULT_L4DST(i)   FM10K_TE(0x100000 * (i) + 0x55a0a)
+
 /*
  * CM_GLOBAL_WM
  * 14:0  watermark
@@ -763,6 +1066,67 @@
  */
 #define FM10K_CM_GLOBAL_CFG     FM10K_CM_USAGE(0x853)
 
+/*
+ * CM_GLOBAL_USAGE
+ * 14:0  count
+ * 31:15 Reserved
+ */
+#define FM10K_CM_GLOBAL_USAGE   FM10K_CM_USAGE(0x850)
+
+/*
+ * CM_SHARED_WM[0..1]
+ * 14:0  watermark
+ * 31:15 Reserved
+ */
+#define FM10K_CM_SHARED_WM(i)   FM10K_CM_USAGE(0x1 * (i) + 0x854)
+
+/*
+ * CM_SHARED_SMP_USAGE[0..1]
+ * 14:0  count
+ * 31:15 Reserved
+ */
+#define FM10K_CM_SHARED_SMP_USAGE(i)            \
+    FM10K_CM_USAGE(0x1 * (i) + 0x856)
+
+/*
+ * CM_RX_SMP_PRIVATE_WM[0..47][0..1]
+ * 14:0  watermark
+ * 31:15 Reserved
+ */
+#define FM10K_CM_RX_SMP_PRIVATE_WM(j, i)        \
+    FM10K_CM_USAGE(0x2 * (j) + (i) + 0x000)
+
+/*
+ * CM_RX_SMP_PAUSE_WM[0..47][0..1]
+ * 14:0  PauseOn
+ * 15    Reserved
+ * 30:16 PauseOff
+ * 31    Reserved
+ */
+#define FM10K_CM_RX_SMP_PAUSE_WM(j, i)          \
+    FM10K_CM_USAGE(0x2 * (j) + (i) + 0x100)
+
+/*
+ * CM_TX_HOG_WM[0..47]
+ * 14:0  watermark
+ * 31:15 Reserved
+ */
+#define FM10K_CM_TX_HOG_WM(i)   FM10K_CM_USAGE(0x1 * (i) + 0x200)
+
+/*
+ * CM_TX_USAGE[0..47]
+ * 14:0  count
+ * 31:15 Reserved
+ */
+#define FM10K_CM_TX_USAGE(i)    FM10K_CM_USAGE(0x1 * (i) + 0x240)
+
+/*
+ * CM_APPLY_TC_TO_SMP
+ * 23:0  SMP[0..7] (8 x 3-bit)
+ * 31:24 Reserved
+ */
+#define FM10K_CM_APPLY_TC_TO_SMP    FM10K_CM_APPLY(0x0)
+
 /*
  * MA_TCN_IM
  * 0    PendingEvents
@@ -860,6 +1224,33 @@
  */
 #define FM10K_INTERRUPT_MASK_FIBM   FM10K_MGMT(0x440)
 
+/*
+ * FIBM_CFG
+ * 0     Enable
+ * 1     MatchMac (only accept requests sent to FIBM_MAC)
+ */
+#define FM10K_FIBM_CFG              FM10K_FIBM(0x0)
+
+/*
+ * FIBM_GLORT
+ * 15:0  Glort of the management port
+ */
+#define FM10K_FIBM_GLORT            FM10K_FIBM(0x1)
+
+/*
+ * FIBM_MAC
+ * Atomicity: 64
+ * 47:0  MAC address of the management port
+ */
+#define FM10K_FIBM_MAC              FM10K_FIBM(0x2)
+
+/*
+ * FIBM_COUNTERS
+ * 15:0  Requests
+ * 31:16 Dropped
+ */
+#define FM10K_FIBM_COUNTERS         FM10K_FIBM(0x4)
+
 /*
  * INTERRUPT_MASK_BSM
  * 8:0   PCIE_BSM[0..8]
@@ -902,10 +1293,408 @@
  */
 #define FM10K_LED_CFG           FM10K_MGMT(0xc2b)
 
+/*
+ * PARSER_PORT_CFG_1[0..47]
+ * 3:0   Vlan1Tag[0..3]
+ * 7:4   Vlan2Tag[0..3]
+ * 8     Vlan2First
+ * 20:9  DefaultVID
+ * 23:21 DefaultVPRI
+ * 24    DefaultDEI
+ * 25    UseDefaultVLAN
+ * 26    FTAG
+ * 31:27 Reserved
+ */
+#define FM10K_PARSER_PORT_CFG_1(i)              \
+    FM10K_PARSER(0x2 * (i) + 0x0)
+
+/*
+ * PARSER_PORT_CFG_2[0..47]
+ * 3:0   CustomTag1[0..3]
+ * 7:4   CustomTag2[0..3]
+ * 8     ParseMPLS
+ * 11:9  StoreMPLS
+ * 12    ParseL3
+ * 13    ParseL4
+ * 14    FlagIPv4Options
+ * 20:15 DIEnable[0..5]
+ * 31:21 Reserved
+ */
+#define FM10K_PARSER_PORT_CFG_2(i)              \
+    FM10K_PARSER(0x2 * (i) + 0x1)
+
+/*
+ * PARSER_VLAN_TAG[0..3]
+ * 15:0  Tag
+ * 31:16 Reserved
+ */
+#define FM10K_PARSER_VLAN_TAG(i)    FM10K_PARSER(0x1 * (i) + 0x100)
+
+/*
+ * PARSER_CUSTOM_TAG[0..3]
+ * 15:0  Tag
+ * 16    Capture
+ * 21:17 Length (16-bit words following the tag)
+ * 31:22 Reserved
+ */
+#define FM10K_PARSER_CUSTOM_TAG(i)  FM10K_PARSER(0x1 * (i) + 0x104)
+
+/*
+ * PARSER_MPLS_TAG
+ * 15:0  Tag1
+ * 31:16 Tag2
+ */
+#define FM10K_PARSER_MPLS_TAG       FM10K_PARSER(0x108)
+
+/*
+ * PARSER_DI_CFG[0..5]
+ * Atomicity: 64
+ * 7:0   Prot
+ * 23:8  L4Port
+ * 24    L4Compare
+ * 29:25 WordOffset
+ * 30    Enable
+ * 33:31 CaptureWords
+ * 63:34 Reserved
+ */
+#define FM10K_PARSER_DI_CFG(i)      FM10K_PARSER(0x2 * (i) + 0x110)
+
+/*
+ * TRIGGER_CONDITION_CFG[0..63]
+ * 0     MatchRx
+ * 1     MatchFFU
+ * 2     MatchRandom
+ * 7:3   RandomThreshold (match with probability 2^-RandomThreshold)
+ * 31:8  Reserved
+ */
+#define FM10K_TRIGGER_CONDITION_CFG(i)          \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x0)
+
+/*
+ * TRIGGER_CONDITION_PARAM[0..63]
+ * 7:0   FFU_ID
+ * 15:8  FFU_Mask
+ * 31:16 Reserved
+ */
+#define FM10K_TRIGGER_CONDITION_PARAM(i)        \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x40)
+
+/*
+ * TRIGGER_CONDITION_RX[0..63]
+ * Atomicity: 64
+ * 47:0  SrcPortMask
+ * 63:48 Reserved
+ */
+#define FM10K_TRIGGER_CONDITION_RX(i)           \
+    FM10K_TRIG_APPLY(0x2 * (i) + 0x80)
+
+/*
+ * TRIGGER_ACTION_CFG_1[0..63]
+ * 1:0   ForwardingAction
+ * 3:2   TrapAction
+ * 5:4   MirroringAction (0: none, 1: mirror)
+ * 7:6   RateLimitAction (0: none, 1: apply)
+ * 31:8  Reserved
+ */
+#define FM10K_TRIGGER_ACTION_CFG_1(i)           \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x100)
+
+/*
+ * TRIGGER_ACTION_CFG_2[0..63]
+ * 3:0   RateLimitNum
+ * 31:4  Reserved
+ */
+#define FM10K_TRIGGER_ACTION_CFG_2(i)           \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x140)
+
+/*
+ * TRIGGER_ACTION_MIRROR[0..63]
+ * 5:0   MirrorPort
+ * 6     Truncate
+ * 31:7  Reserved
+ */
+#define FM10K_TRIGGER_ACTION_MIRROR(i)          \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x180)
+
+/*
+ * TRIGGER_RATE_LIM_CFG_1[0..15]
+ * 15:0  Rate (frames/s; 10:0 Mantissa, 15:11 Exponent)
+ * 27:16 Capacity (frames)
+ * 31:28 Reserved
+ */
+#define FM10K_TRIGGER_RATE_LIM_CFG_1(i)         \
+    FM10K_TRIG_APPLY(0x1 * (i) + 0x1c0)
+
+/*
+ * TRIGGER_STATS[0..63]
+ * Atomicity: 64
+ * 63:0  CountFrames
+ */
+#define FM10K_TRIGGER_STATS(i)  FM10K_TRIG_USAGE(0x2 * (i) + 0x0)
+
+/*
+ * EACL_PROFILE[0..47]
+ * 7:0   Profile
+ * 31:8  Reserved
+ */
+#define FM10K_EACL_PROFILE(i)   FM10K_EACL(0x1 * (i) + 0x0)
+
+/*
+ * EACL_CAM[0..255][0..1]
+ * Atomicity: 64
+ * [0]: Key, [1]: Mask (a key bit is compared where the mask bit is set)
+ * 7:0   Profile
+ * 15:8  EaclId
+ * 27:16 VID
+ * 33:28 DSCP
+ * 34    Valid
+ * 63:35 Reserved
+ */
+#define FM10K_EACL_CAM(j, i)    FM10K_EACL(0x4 * (j) + 0x2 * (i) + 0x100)
+
+/*
+ * EACL_ACTION[0..255]
+ * 0     Drop
+ * 1     Modify
+ * 13:2  ModIndex
+ * 31:14 Reserved
+ */
+#define FM10K_EACL_ACTION(i)    FM10K_EACL(0x1 * (i) + 0x500)
+
+/*
+ * MOD_DATA[0..4095]
+ * Atomicity: 64
+ * 11:0  VID
+ * 14:12 VPRI
+ * 20:15 DSCP
+ * 21    SetVID
+ * 22    SetVPRI
+ * 23    SetDSCP
+ * 24    StripVLAN
+ * 63:25 Reserved
+ */
+#define FM10K_MOD_DATA(i)       FM10K_MOD(0x2 * (i) + 0x0)
+
+/*
+ * INGRESS_VID_TABLE[0..4095]
+ * Atomicity: 64
+ * 47:0  Membership
+ * 59:48 FID
+ * 60    Reflect
+ * 63:61 Reserved
+ */
+#define FM10K_INGRESS_VID_TABLE(i)              \
+    FM10K_L2LOOKUP(0x2 * (i) + 0x10000)
+
+/*
+ * EGRESS_VID_TABLE[0..4095]
+ * Atomicity: 64
+ * 47:0  Membership (frames leave tagged)
+ * 59:48 FID
+ * 63:60 Reserved
+ */
+#define FM10K_EGRESS_VID_TABLE(i)               \
+    FM10K_L2LOOKUP(0x2 * (i) + 0x14000)
+
+/*
+ * GLORT_DEST_TABLE[0..4095]
+ * Atomicity: 64
+ * 47:0  DestMask
+ * 59:48 IP_MulticastIndex
+ * 63:60 Reserved
+ */
+#define FM10K_GLORT_DEST_TABLE(i)               \
+    FM10K_GLORT(0x2 * (i) + 0x0)
+
+/*
+ * GLORT_RAM[0..63]
+ * Atomicity: 64
+ * 11:0  DestIndex
+ * 19:12 RangeSubIndexA (3:0 Offset, 7:4 Length)
+ * 27:20 RangeSubIndexB (3:0 Offset, 7:4 Length)
+ * 31:28 DestCount
+ * 32    HashRotation
+ * 34:33 Strict
+ * 35    SkipDGLORT_Dec
+ * 63:36 Reserved
+ */
+#define FM10K_GLORT_RAM(i)      FM10K_GLORT(0x2 * (i) + 0x2000)
+
+/*
+ * GLORT_CAM[0..63]
+ * 15:0  KeyInvert
+ * 31:16 Key
+ */
+#define FM10K_GLORT_CAM(i)      FM10K_GLORT(0x1 * (i) + 0x2200)
+
+/*
+ * LAG_CFG[0..47]
+ * 3:0   LagSize
+ * 7:4   Index
+ * 8     HashRotation
+ * 9     InLAG
+ * 31:10 Reserved
+ */
+#define FM10K_LAG_CFG(i)        FM10K_LAG(0x1 * (i) + 0x0)
+
+/*
+ * L234_HASH_CFG[0..47]
+ * 0     Symmetric
+ * 1     UseDMAC
+ * 2     UseSMAC
+ * 3     UseType
+ * 4     UseVPRI
+ * 5     UseVID
+ * 7:6   RotationA
+ * 9:8   RotationB
+ * 31:10 Reserved
+ */
+#define FM10K_L234_HASH_CFG(i)  FM10K_HANDLER(0x1 * (i) + 0x0c0)
+
+/*
+ * L34_HASH_CFG[0..47]
+ * Atomicity: 64
+ * 0     Symmetric
+ * 1     UseSIP
+ * 2     UseDIP
+ * 3     UsePROT
+ * 4     UseTCP
+ * 5     UseUDP
+ * 6     UsePROT1
+ * 7     UsePROT2
+ * 8     UseL4SRC
+ * 9     UseL4DST
+ * 11:10 ECMP_Rotation
+ * 15:12 Reserved
+ * 23:16 PROT1
+ * 31:24 PROT2
+ * 63:32 Reserved
+ */
+#define FM10K_L34_HASH_CFG(i)   FM10K_HANDLER(0x2 * (i) + 0x100)
+
+/*
+ * POLICER_CFG[0..3]
+ * 11:0  IndexLastPolicer
+ * 13:12 IngressColorSource
+ * 14    MarkDSCP
+ * 15    MarkSwitchPri
+ * 31:16 Reserved
+ */
+#define FM10K_POLICER_CFG(i)    FM10K_POLICER_APPLY(0x1 * (i) + 0x0)
+
+/*
+ * POLICER_CFG_4K[0..1][0..4095]
+ * Atomicity: 64
+ * 10:0  CommittedRateMantissa
+ * 15:11 CommittedRateExponent
+ * 26:16 CommittedCapacityMantissa
+ * 31:27 CommittedCapacityExponent
+ * 42:32 ExcessRateMantissa
+ * 47:43 ExcessRateExponent
+ * 58:48 ExcessCapacityMantissa
+ * 63:59 ExcessCapacityExponent
+ * (Rates in bytes per second, capacities in bytes: Mantissa << Exponent)
+ */
+#define FM10K_POLICER_CFG_4K(j, i)              \
+    FM10K_POLICER_USAGE(0x2000 * (j) + 0x2 * (i) + 0x0)
+
+/*
+ * POLICER_CFG_512[0..1][0..511]
+ * Atomicity: 64
+ * (Same layout as POLICER_CFG_4K)
+ */
+#define FM10K_POLICER_CFG_512(j, i)             \
+    FM10K_POLICER_USAGE(0x400 * (j) + 0x2 * (i) + 0x4000)
+
+/*
+ * POLICER_STATS_4K[0..1][0..4095][0..1]
+ * Atomicity: 64
+ * [0]: Conforming frames/bytes, [1]: Exceeding frames/bytes
+ * 39:0  Bytes
+ * 63:40 Frames
+ */
+#define FM10K_POLICER_STATS_4K(k, j, i)         \
+    FM10K_POLICER_USAGE(0x4000 * (k) + 0x4 * (j) + 0x2 * (i) + 0x8000)
+
+/*
+ * POLICER_STATS_512[0..1][0..511][0..1]
+ * Atomicity: 64
+ * (Same layout as POLICER_STATS_4K)
+ */
+#define FM10K_POLICER_STATS_512(k, j, i)        \
+    FM10K_POLICER_USAGE(0x800 * (k) + 0x4 * (j) + 0x2 * (i) + 0x10000)
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* 64 MiB */
+#define FM10K_BAR4_SIZE         0x4000000
+
+/*
+ * FM10K management structure
+ */
+typedef struct _fm10k {
+    /* /dev/uioX */
+    int fd;
+    /* Memory mapped to /dev/uioX (BAR4) */
+    void *mmio;
+    size_t size;
+} fm10k_t;
+
+int fm10k_open(fm10k_t *, const char *);
+void fm10k_close(fm10k_t *);
+int fm10k_irq_enable(fm10k_t *);
+int fm10k_irq_read(fm10k_t *, uint32_t *);
+
+#ifdef FM10K_MODEL
+/* Register accesses through the behavioral device model (model.c) */
+uint32_t fm10k_model_rd32(void *, long);
+uint64_t fm10k_model_rd64(void *, long);
+void fm10k_model_wr32(void *, long, uint32_t);
+void fm10k_model_wr64(void *, long, uint64_t);
+#endif
+
+/*
+ * Read/Write
+ */
+static __inline__ uint32_t
+rd32(void *mmio, long offset)
+{
+#ifdef FM10K_MODEL
+    return fm10k_model_rd32(mmio, offset);
+#else
+    return *((volatile uint32_t *)(mmio + offset));
+#endif
+}
+static __inline__ uint64_t
+rd64(void *mmio, long offset)
+{
+#ifdef FM10K_MODEL
+    return fm10k_model_rd64(mmio, offset);
+#else
+    return *((volatile uint64_t *)(mmio + offset));
+#endif
+}
+static __inline__ void
+wr32(void *mmio, long offset, uint32_t val)
+{
+#ifdef FM10K_MODEL
+    fm10k_model_wr32(mmio, offset, val);
+#else
+    *((volatile uint32_t *)(mmio + offset)) = val;
+#endif
+}
+static __inline__ void
+wr64(void *mmio, long offset, uint64_t val)
+{
+#ifdef FM10K_MODEL
+    fm10k_model_wr64(mmio, offset, val);
+#else
+    *((volatile uint64_t *)(mmio + offset)) = val;
+#endif
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,366 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "glort.h"
+#include <stdio.h>
+#include <string.h>
+
+/* GLORT_RAM.Strict: use RangeSubIndexA/B to index the destination table */
+#define GLORT_RAM_STRICT_DETERMINISTIC  2
+
+#define DEST_MASK_BITS  48
+#define DEST_MASK       ((1ULL << DEST_MASK_BITS) - 1)
+
+/*
+ * Count trailing zeros of a GLORT (16 for zero)
+ */
+static int
+_ctz16(uint16_t v)
+{
+    if ( 0 == v ) {
+        return 16;
+    }
+    return __builtin_ctz(v);
+}
+
+/*
+ * Size (in bits) of the largest aligned block starting at s within [s, end)
+ */
+static int
+_block_bits(uint32_t s, uint32_t end)
+{
+    int bits;
+
+    bits = _ctz16(s);
+    if ( bits > FM10K_GLORT_MAX_RANGE_BITS ) {
+        bits = FM10K_GLORT_MAX_RANGE_BITS;
+    }
+    while ( s + (1U << bits) > end ) {
+        bits--;
+    }
+
+    return bits;
+}
+
+/*
+ * Program a CAM/RAM pair (RAM first so that the CAM never hits a stale RAM)
+ */
+static void
+_write_cam(fm10k_glort_t *glort, int i)
+{
+    fm10k_glort_cam_t *e;
+    uint64_t m64;
+    uint32_t m32;
+    uint16_t mask;
+
+    e = &glort->cam[i];
+    if ( !e->valid ) {
+        /* Key and KeyInvert both set never match */
+        wr32(glort->fm10k->mmio, FM10K_GLORT_CAM(i), 0xffffffffUL);
+        wr64(glort->fm10k->mmio, FM10K_GLORT_RAM(i), 0);
+        return;
+    }
+
+    /* DestIndex | RangeSubIndexA (offset 0, length bits) | Strict */
+    m64 = (uint64_t)e->dest_index | ((uint64_t)(e->bits << 4) << 12)
+        | ((uint64_t)GLORT_RAM_STRICT_DETERMINISTIC << 33);
+    wr64(glort->fm10k->mmio, FM10K_GLORT_RAM(i), m64);
+
+    /* Key | KeyInvert over the bits that are not wildcarded */
+    mask = (uint16_t)(0xffff << e->bits);
+    m32 = ((uint32_t)(e->key & mask) << 16) | (uint16_t)(~e->key & mask);
+    wr32(glort->fm10k->mmio, FM10K_GLORT_CAM(i), m32);
+}
+
+/*
+ * Find a contiguous run of free destination table entries
+ */
+static int
+_alloc_dest(fm10k_glort_t *glort, int n)
+{
+    int i;
+    int run;
+
+    run = 0;
+    for ( i = 0; i < FM10K_GLORT_DEST_ENTRIES; i++ ) {
+        if ( glort->used[i / 64] & (1ULL << (i % 64)) ) {
+            run = 0;
+            continue;
+        }
+        run++;
+        if ( run == n ) {
+            return i - n + 1;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Initialize the GLORT manager and invalidate all CAM entries.  The
+ * destination table is assumed to have been cleared by the BIST memory
+ * initialization in release_switch().
+ */
+int
+fm10k_glort_init(fm10k_glort_t *glort, fm10k_t *fm10k)
+{
+    int i;
+
+    memset(glort, 0, sizeof(fm10k_glort_t));
+    glort->fm10k = fm10k;
+
+    for ( i = 0; i < FM10K_GLORT_CAM_ENTRIES; i++ ) {
+        _write_cam(glort, i);
+    }
+
+    return 0;
+}
+
+/*
+ * Allocate a GLORT range [base, base + count).  The range is split into the
+ * minimum number of aligned power-of-two blocks so that each CAM entry
+ * covers as many GLORTs as possible; all blocks share one contiguous run of
+ * destination table entries.  Returns the first destination index.
+ */
+int
+fm10k_glort_alloc_range(fm10k_glort_t *glort, uint16_t base, int count)
+{
+    uint32_t s;
+    uint32_t end;
+    int bits;
+    int nblk;
+    int nfree;
+    int dest;
+    int i;
+
+    end = (uint32_t)base + count;
+    if ( count <= 0 || end > 0x10000 ) {
+        return -1;
+    }
+
+    /* Reject overlaps with existing blocks */
+    for ( i = 0; i < FM10K_GLORT_CAM_ENTRIES; i++ ) {
+        if ( !glort->cam[i].valid ) {
+            continue;
+        }
+        s = glort->cam[i].key;
+        if ( s < end && base < s + (1U << glort->cam[i].bits) ) {
+            fprintf(stderr, "GLORT range %04x/%d overlaps CAM[%d]\n",
+                    base, count, i);
+            return -1;
+        }
+    }
+
+    /* Count the blocks and the free CAM entries */
+    nblk = 0;
+    for ( s = base; s < end; s += 1U << bits ) {
+        bits = _block_bits(s, end);
+        nblk++;
+    }
+    nfree = 0;
+    for ( i = 0; i < FM10K_GLORT_CAM_ENTRIES; i++ ) {
+        if ( !glort->cam[i].valid ) {
+            nfree++;
+        }
+    }
+    if ( nblk > nfree ) {
+        fprintf(stderr, "GLORT CAM full (%d entries required)\n", nblk);
+        return -1;
+    }
+
+    dest = _alloc_dest(glort, count);
+    if ( dest < 0 ) {
+        fprintf(stderr, "GLORT destination table full\n");
+        return -1;
+    }
+    for ( i = dest; i < dest + count; i++ ) {
+        glort->used[i / 64] |= 1ULL << (i % 64);
+    }
+
+    /* Program the blocks */
+    i = 0;
+    for ( s = base; s < end; s += 1U << bits ) {
+        bits = _block_bits(s, end);
+        while ( glort->cam[i].valid ) {
+            i++;
+        }
+        glort->cam[i].valid = 1;
+        glort->cam[i].key = s;
+        glort->cam[i].bits = bits;
+        glort->cam[i].dest_index = dest + (s - base);
+        _write_cam(glort, i);
+    }
+
+    return dest;
+}
+
+/*
+ * Release a GLORT range previously allocated with the same base and count
+ */
+int
+fm10k_glort_free_range(fm10k_glort_t *glort, uint16_t base, int count)
+{
+    uint32_t end;
+    int dest;
+    int i;
+
+    dest = fm10k_glort_lookup(glort, base);
+    if ( dest < 0 ) {
+        return -1;
+    }
+
+    /* Invalidate the CAM first so no frame hits a released entry */
+    end = (uint32_t)base + count;
+    for ( i = 0; i < FM10K_GLORT_CAM_ENTRIES; i++ ) {
+        if ( glort->cam[i].valid && glort->cam[i].key >= base
+             && glort->cam[i].key < end ) {
+            glort->cam[i].valid = 0;
+            _write_cam(glort, i);
+        }
+    }
+
+    /* Leave released destination entries zeroed in hardware */
+    for ( i = dest; i < dest + count; i++ ) {
+        if ( glort->dest[i] ) {
+            glort->dest[i] = 0;
+            wr64(glort->fm10k->mmio, FM10K_GLORT_DEST_TABLE(i), 0);
+        }
+        glort->dirty[i / 64] &= ~(1ULL << (i % 64));
+        glort->used[i / 64] &= ~(1ULL << (i % 64));
+    }
+
+    return 0;
+}
+
+/*
+ * Resolve a GLORT to its destination table index
+ */
+int
+fm10k_glort_lookup(fm10k_glort_t *glort, uint16_t g)
+{
+    fm10k_glort_cam_t *e;
+    int i;
+
+    for ( i = 0; i < FM10K_GLORT_CAM_ENTRIES; i++ ) {
+        e = &glort->cam[i];
+        if ( e->valid && (g >> e->bits) == (e->key >> e->bits) ) {
+            return e->dest_index + (g & ((1U << e->bits) - 1));
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Set the destination mask of a GLORT (deferred until commit)
+ */
+int
+fm10k_glort_set_dest(fm10k_glort_t *glort, uint16_t g, uint64_t mask)
+{
+    int i;
+    uint64_t m64;
+
+    i = fm10k_glort_lookup(glort, g);
+    if ( i < 0 ) {
+        return -1;
+    }
+    m64 = (glort->dest[i] & ~DEST_MASK) | (mask & DEST_MASK);
+    if ( m64 != glort->dest[i] ) {
+        glort->dest[i] = m64;
+        glort->dirty[i / 64] |= 1ULL << (i % 64);
+    }
+
+    return 0;
+}
+
+/*
+ * Add a logical port to the destination mask of a GLORT
+ */
+int
+fm10k_glort_add_port(fm10k_glort_t *glort, uint16_t g, int port)
+{
+    int i;
+
+    i = fm10k_glort_lookup(glort, g);
+    if ( i < 0 || port < 0 || port >= DEST_MASK_BITS ) {
+        return -1;
+    }
+
+    return fm10k_glort_set_dest(glort, g,
+                                glort->dest[i] | (1ULL << port));
+}
+
+/*
+ * Remove a logical port from the destination mask of a GLORT
+ */
+int
+fm10k_glort_del_port(fm10k_glort_t *glort, uint16_t g, int port)
+{
+    int i;
+
+    i = fm10k_glort_lookup(glort, g);
+    if ( i < 0 || port < 0 || port >= DEST_MASK_BITS ) {
+        return -1;
+    }
+
+    return fm10k_glort_set_dest(glort, g,
+                                glort->dest[i] & ~(1ULL << port));
+}
+
+/*
+ * Write all modified destination table entries.  Returns the number of
+ * register writes issued.
+ */
+int
+fm10k_glort_commit(fm10k_glort_t *glort)
+{
+    uint64_t m64;
+    int w;
+    int i;
+    int n;
+
+    n = 0;
+    for ( w = 0; w < FM10K_GLORT_DEST_ENTRIES / 64; w++ ) {
+        m64 = glort->dirty[w];
+        while ( m64 ) {
+            i = w * 64 + __builtin_ctzll(m64);
+            m64 &= m64 - 1;
+            wr64(glort->fm10k->mmio, FM10K_GLORT_DEST_TABLE(i),
+                 glort->dest[i]);
+            n++;
+        }
+        glort->dirty[w] = 0;
+    }
+
+    return n;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
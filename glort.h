@@ -0,0 +1,87 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _GLORT_H
+#define _GLORT_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+#define FM10K_GLORT_CAM_ENTRIES     64
+#define FM10K_GLORT_DEST_ENTRIES    4096
+/* Maximum number of GLORT bits a single CAM entry can index with */
+#define FM10K_GLORT_MAX_RANGE_BITS  12
+
+/*
+ * GLORT CAM/RAM entry (software shadow)
+ */
+typedef struct _fm10k_glort_cam {
+    int valid;
+    /* Base GLORT and the number of low-order bits that are wildcarded */
+    uint16_t key;
+    int bits;
+    /* First destination table entry of this block */
+    int dest_index;
+} fm10k_glort_cam_t;
+
+/*
+ * GLORT manager
+ */
+typedef struct _fm10k_glort {
+    fm10k_t *fm10k;
+    fm10k_glort_cam_t cam[FM10K_GLORT_CAM_ENTRIES];
+    /* Shadow of GLORT_DEST_TABLE.DestMask */
+    uint64_t dest[FM10K_GLORT_DEST_ENTRIES];
+    /* Allocated and modified destination table entries */
+    uint64_t used[FM10K_GLORT_DEST_ENTRIES / 64];
+    uint64_t dirty[FM10K_GLORT_DEST_ENTRIES / 64];
+} fm10k_glort_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_glort_init(fm10k_glort_t *, fm10k_t *);
+int fm10k_glort_alloc_range(fm10k_glort_t *, uint16_t, int);
+int fm10k_glort_free_range(fm10k_glort_t *, uint16_t, int);
+int fm10k_glort_lookup(fm10k_glort_t *, uint16_t);
+int fm10k_glort_set_dest(fm10k_glort_t *, uint16_t, uint64_t);
+int fm10k_glort_add_port(fm10k_glort_t *, uint16_t, int);
+int fm10k_glort_del_port(fm10k_glort_t *, uint16_t, int);
+int fm10k_glort_commit(fm10k_glort_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GLORT_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
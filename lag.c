@@ -0,0 +1,358 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "lag.h"
+#include <stdio.h>
+#include <string.h>
+
+/* CRC-32C (Castagnoli), reflected */
+#define CRC32C_POLY     0x82f63b78UL
+
+static uint32_t crc32c_table[256];
+static int crc32c_ready;
+
+/*
+ * Field names accepted by fm10k_lag_parse_fields()
+ */
+static const struct {
+    const char *name;
+    uint32_t flag;
+} lag_fields[] = {
+    { "symmetric", FM10K_LAG_HASH_SYMMETRIC },
+    { "dmac", FM10K_LAG_HASH_DMAC },
+    { "smac", FM10K_LAG_HASH_SMAC },
+    { "type", FM10K_LAG_HASH_TYPE },
+    { "vpri", FM10K_LAG_HASH_VPRI },
+    { "vid", FM10K_LAG_HASH_VID },
+    { "sip", FM10K_LAG_HASH_SIP },
+    { "dip", FM10K_LAG_HASH_DIP },
+    { "prot", FM10K_LAG_HASH_PROT },
+    { "l4src", FM10K_LAG_HASH_L4SRC },
+    { "l4dst", FM10K_LAG_HASH_L4DST },
+};
+
+/*
+ * CRC-32C over a buffer
+ */
+static uint32_t
+_crc32c(const uint8_t *buf, int len)
+{
+    uint32_t crc;
+    int i;
+    int j;
+
+    if ( !crc32c_ready ) {
+        for ( i = 0; i < 256; i++ ) {
+            crc = i;
+            for ( j = 0; j < 8; j++ ) {
+                crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+            }
+            crc32c_table[i] = crc;
+        }
+        crc32c_ready = 1;
+    }
+
+    crc = 0xffffffffUL;
+    for ( i = 0; i < len; i++ ) {
+        crc = crc32c_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+/*
+ * Append a pair of fields; with symmetric hashing the smaller comes first
+ * so that both directions of a flow hash identically
+ */
+static int
+_put_pair(uint8_t *key, int pos, const void *a, const void *b, int len,
+          int use_a, int use_b, int symmetric)
+{
+    const void *t;
+
+    if ( symmetric && use_a && use_b && memcmp(a, b, len) > 0 ) {
+        t = a;
+        a = b;
+        b = t;
+    }
+    if ( use_a ) {
+        memcpy(key + pos, a, len);
+        pos += len;
+    }
+    if ( use_b ) {
+        memcpy(key + pos, b, len);
+        pos += len;
+    }
+
+    return pos;
+}
+
+/*
+ * Parse a comma-separated list of hash field names
+ */
+int
+fm10k_lag_parse_fields(const char *s, uint32_t *fields)
+{
+    const char *e;
+    size_t len;
+    size_t i;
+
+    *fields = 0;
+    while ( *s ) {
+        e = strchr(s, ',');
+        len = e ? (size_t)(e - s) : strlen(s);
+        for ( i = 0; i < sizeof(lag_fields) / sizeof(lag_fields[0]); i++ ) {
+            if ( strlen(lag_fields[i].name) == len
+                 && 0 == strncmp(lag_fields[i].name, s, len) ) {
+                *fields |= lag_fields[i].flag;
+                break;
+            }
+        }
+        if ( i == sizeof(lag_fields) / sizeof(lag_fields[0]) ) {
+            fprintf(stderr, "Unknown hash field: %.*s\n", (int)len, s);
+            return -1;
+        }
+        s += len;
+        if ( ',' == *s ) {
+            s++;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Software model of the L234 hash.  The selected fields are serialized in
+ * a fixed order and hashed with CRC-32C; RotationA takes bits 11:0 and
+ * RotationB bits 23:12.  Layer 4 ports only contribute for TCP and UDP,
+ * mirroring L34_HASH_CFG.UseTCP/UseUDP.
+ */
+uint32_t
+fm10k_lag_hash(const fm10k_lag_profile_t *profile, const fm10k_flow_t *flow)
+{
+    uint8_t key[64];
+    uint32_t f;
+    int sym;
+    int l4;
+    int pos;
+    uint32_t crc;
+
+    f = profile->fields;
+    sym = !!(f & FM10K_LAG_HASH_SYMMETRIC);
+    l4 = (6 == flow->prot || 17 == flow->prot);
+
+    pos = 0;
+    pos = _put_pair(key, pos, flow->dmac, flow->smac, 6,
+                    f & FM10K_LAG_HASH_DMAC, f & FM10K_LAG_HASH_SMAC, sym);
+    if ( f & FM10K_LAG_HASH_TYPE ) {
+        memcpy(key + pos, &flow->type, 2);
+        pos += 2;
+    }
+    if ( f & FM10K_LAG_HASH_VID ) {
+        memcpy(key + pos, &flow->vid, 2);
+        pos += 2;
+    }
+    if ( f & FM10K_LAG_HASH_VPRI ) {
+        key[pos++] = flow->vpri;
+    }
+    pos = _put_pair(key, pos, &flow->sip, &flow->dip, 4,
+                    f & FM10K_LAG_HASH_SIP, f & FM10K_LAG_HASH_DIP, sym);
+    if ( f & FM10K_LAG_HASH_PROT ) {
+        key[pos++] = flow->prot;
+    }
+    pos = _put_pair(key, pos, &flow->sport, &flow->dport, 2,
+                    l4 && (f & FM10K_LAG_HASH_L4SRC),
+                    l4 && (f & FM10K_LAG_HASH_L4DST), sym);
+
+    crc = _crc32c(key, pos);
+    if ( profile->rotation ) {
+        return (crc >> 12) & 0xfff;
+    }
+    return crc & 0xfff;
+}
+
+/*
+ * Select the LAG member of a flow
+ */
+int
+fm10k_lag_member(const fm10k_lag_profile_t *profile, const fm10k_flow_t *flow,
+                 int members)
+{
+    return fm10k_lag_hash(profile, flow) % members;
+}
+
+/*
+ * Program the hash profile of an ingress port
+ */
+int
+fm10k_lag_set_profile(fm10k_t *fm10k, int port,
+                      const fm10k_lag_profile_t *profile)
+{
+    uint32_t f;
+    uint32_t m32;
+    uint64_t m64;
+
+    if ( port < 0 || port >= 48 ) {
+        return -1;
+    }
+    f = profile->fields;
+
+    /* Symmetric | UseDMAC | UseSMAC | UseType | UseVPRI | UseVID */
+    m32 = rd32(fm10k->mmio, FM10K_L234_HASH_CFG(port));
+    m32 &= ~0x3fUL;
+    m32 |= (f & FM10K_LAG_HASH_SYMMETRIC) ? (1 << 0) : 0;
+    m32 |= (f & FM10K_LAG_HASH_DMAC) ? (1 << 1) : 0;
+    m32 |= (f & FM10K_LAG_HASH_SMAC) ? (1 << 2) : 0;
+    m32 |= (f & FM10K_LAG_HASH_TYPE) ? (1 << 3) : 0;
+    m32 |= (f & FM10K_LAG_HASH_VPRI) ? (1 << 4) : 0;
+    m32 |= (f & FM10K_LAG_HASH_VID) ? (1 << 5) : 0;
+    wr32(fm10k->mmio, FM10K_L234_HASH_CFG(port), m32);
+
+    /* Symmetric | UseSIP | UseDIP | UsePROT | UseTCP | UseUDP | UseL4SRC
+       | UseL4DST */
+    m64 = rd64(fm10k->mmio, FM10K_L34_HASH_CFG(port));
+    m64 &= ~0x3ffULL;
+    m64 |= (f & FM10K_LAG_HASH_SYMMETRIC) ? (1 << 0) : 0;
+    m64 |= (f & FM10K_LAG_HASH_SIP) ? (1 << 1) : 0;
+    m64 |= (f & FM10K_LAG_HASH_DIP) ? (1 << 2) : 0;
+    m64 |= (f & FM10K_LAG_HASH_PROT) ? (1 << 3) : 0;
+    if ( f & (FM10K_LAG_HASH_L4SRC | FM10K_LAG_HASH_L4DST) ) {
+        m64 |= (1 << 4) | (1 << 5);
+    }
+    m64 |= (f & FM10K_LAG_HASH_L4SRC) ? (1 << 8) : 0;
+    m64 |= (f & FM10K_LAG_HASH_L4DST) ? (1 << 9) : 0;
+    wr64(fm10k->mmio, FM10K_L34_HASH_CFG(port), m64);
+
+    return 0;
+}
+
+/*
+ * Configure LAG membership.  The hash is computed with the profile of the
+ * port a frame arrives on, so every port in the ingress mask (the ports
+ * that forward into the LAG) gets the profile; the members only select
+ * their share of the hash.  Nothing is written unless all ports are valid.
+ */
+int
+fm10k_lag_set_members(fm10k_t *fm10k, const int *ports, int n,
+                      uint64_t ingress, const fm10k_lag_profile_t *profile)
+{
+    uint64_t members;
+    uint32_t m32;
+    int i;
+
+    if ( n <= 0 || n > FM10K_LAG_MAX_MEMBERS || (ingress >> 48) ) {
+        return -1;
+    }
+    members = 0;
+    for ( i = 0; i < n; i++ ) {
+        if ( ports[i] < 0 || ports[i] >= 48
+             || (members & (1ULL << ports[i])) ) {
+            return -1;
+        }
+        members |= 1ULL << ports[i];
+    }
+
+    for ( i = 0; i < 48; i++ ) {
+        if ( ingress & (1ULL << i) ) {
+            fm10k_lag_set_profile(fm10k, i, profile);
+        }
+    }
+    for ( i = 0; i < n; i++ ) {
+        /* LagSize | Index | HashRotation | InLAG (LagSize 0 means 16) */
+        m32 = (n & 0xf) | (i << 4) | ((profile->rotation ? 1 : 0) << 8)
+            | (1 << 9);
+        wr32(fm10k->mmio, FM10K_LAG_CFG(ports[i]), m32);
+    }
+
+    return 0;
+}
+
+/*
+ * Remove ports from their LAG; nothing is written unless all ports are
+ * valid
+ */
+int
+fm10k_lag_clear_members(fm10k_t *fm10k, const int *ports, int n)
+{
+    int i;
+
+    for ( i = 0; i < n; i++ ) {
+        if ( ports[i] < 0 || ports[i] >= 48 ) {
+            return -1;
+        }
+    }
+    for ( i = 0; i < n; i++ ) {
+        wr32(fm10k->mmio, FM10K_LAG_CFG(ports[i]), 0);
+    }
+
+    return 0;
+}
+
+/*
+ * Replay flows through the hash model and compute per-member load
+ */
+int
+fm10k_lag_simulate(const fm10k_lag_profile_t *profile,
+                   const fm10k_flow_t *flows, int nflows, int members,
+                   fm10k_lag_sim_t *sim)
+{
+    uint64_t total;
+    uint64_t max;
+    int m;
+    int i;
+
+    if ( members <= 0 || members > FM10K_LAG_MAX_MEMBERS ) {
+        return -1;
+    }
+    memset(sim, 0, sizeof(fm10k_lag_sim_t));
+    sim->members = members;
+
+    for ( i = 0; i < nflows; i++ ) {
+        m = fm10k_lag_member(profile, &flows[i], members);
+        sim->bytes[m] += flows[i].bytes;
+        sim->pkts[m] += flows[i].pkts;
+        sim->flows[m]++;
+    }
+
+    total = 0;
+    max = 0;
+    for ( m = 0; m < members; m++ ) {
+        total += sim->bytes[m];
+        if ( sim->bytes[m] > max ) {
+            max = sim->bytes[m];
+        }
+    }
+    sim->imbalance = total ? (double)max * members / total : 1.0;
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,116 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _LAG_H
+#define _LAG_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+/* LAG_CFG.LagSize is 4 bits wide */
+#define FM10K_LAG_MAX_MEMBERS   16
+
+/*
+ * Hash fields (L234_HASH_CFG/L34_HASH_CFG)
+ */
+#define FM10K_LAG_HASH_SYMMETRIC    (1 << 0)
+#define FM10K_LAG_HASH_DMAC         (1 << 1)
+#define FM10K_LAG_HASH_SMAC         (1 << 2)
+#define FM10K_LAG_HASH_TYPE         (1 << 3)
+#define FM10K_LAG_HASH_VPRI         (1 << 4)
+#define FM10K_LAG_HASH_VID          (1 << 5)
+#define FM10K_LAG_HASH_SIP          (1 << 6)
+#define FM10K_LAG_HASH_DIP          (1 << 7)
+#define FM10K_LAG_HASH_PROT         (1 << 8)
+#define FM10K_LAG_HASH_L4SRC        (1 << 9)
+#define FM10K_LAG_HASH_L4DST        (1 << 10)
+
+/*
+ * Hash profile
+ */
+typedef struct _fm10k_lag_profile {
+    uint32_t fields;
+    /* 0: RotationA, 1: RotationB */
+    int rotation;
+} fm10k_lag_profile_t;
+
+/*
+ * Flow (IPv4) used by the offline simulator; the key fields come first
+ */
+typedef struct _fm10k_flow {
+    uint8_t dmac[6];
+    uint8_t smac[6];
+    uint16_t type;
+    uint16_t vid;
+    uint8_t vpri;
+    uint8_t prot;
+    uint16_t sport;
+    uint32_t sip;
+    uint32_t dip;
+    uint16_t dport;
+    /* Traffic carried by the flow */
+    uint64_t bytes;
+    uint64_t pkts;
+} fm10k_flow_t;
+
+/*
+ * Simulation result
+ */
+typedef struct _fm10k_lag_sim {
+    int members;
+    uint64_t bytes[FM10K_LAG_MAX_MEMBERS];
+    uint64_t pkts[FM10K_LAG_MAX_MEMBERS];
+    uint64_t flows[FM10K_LAG_MAX_MEMBERS];
+    /* Largest member load over the mean load (1.0 is perfect) */
+    double imbalance;
+} fm10k_lag_sim_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_lag_parse_fields(const char *, uint32_t *);
+uint32_t fm10k_lag_hash(const fm10k_lag_profile_t *, const fm10k_flow_t *);
+int fm10k_lag_member(const fm10k_lag_profile_t *, const fm10k_flow_t *, int);
+int fm10k_lag_set_profile(fm10k_t *, int, const fm10k_lag_profile_t *);
+int fm10k_lag_set_members(fm10k_t *, const int *, int, uint64_t,
+                          const fm10k_lag_profile_t *);
+int fm10k_lag_clear_members(fm10k_t *, const int *, int);
+int fm10k_lag_simulate(const fm10k_lag_profile_t *, const fm10k_flow_t *,
+                       int, int, fm10k_lag_sim_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LAG_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
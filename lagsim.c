@@ -0,0 +1,437 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "lag.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#define PCAP_MAGIC          0xa1b2c3d4UL
+#define PCAP_MAGIC_NSEC     0xa1b23c4dUL
+#define PCAP_LINKTYPE_ETHERNET  1
+
+/*
+ * Flow list
+ */
+typedef struct _flowlist {
+    fm10k_flow_t *flows;
+    int n;
+    int max;
+} flowlist_t;
+
+/*
+ * Preset profiles evaluated by -a
+ */
+static const struct {
+    const char *name;
+    const char *fields;
+} presets[] = {
+    { "l2", "dmac,smac,type,vid" },
+    { "l3", "sip,dip" },
+    { "l3prot", "sip,dip,prot" },
+    { "l4", "sip,dip,prot,l4src,l4dst" },
+    { "l4sym", "symmetric,sip,dip,prot,l4src,l4dst" },
+    { "l4ports", "l4src,l4dst" },
+    { "all", "dmac,smac,type,vid,vpri,sip,dip,prot,l4src,l4dst" },
+};
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n members] [-p fields] [-r rotation] [-a] "
+            "<flows.txt|capture.pcap>\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Append a flow
+ */
+static fm10k_flow_t *
+flowlist_add(flowlist_t *fl)
+{
+    fm10k_flow_t *p;
+    int max;
+
+    if ( fl->n >= fl->max ) {
+        max = fl->max ? fl->max * 2 : 1024;
+        p = realloc(fl->flows, sizeof(fm10k_flow_t) * max);
+        if ( NULL == p ) {
+            return NULL;
+        }
+        fl->flows = p;
+        fl->max = max;
+    }
+    p = &fl->flows[fl->n++];
+    memset(p, 0, sizeof(fm10k_flow_t));
+
+    return p;
+}
+
+/*
+ * Compare the key fields of two flows field by field; the padding of the
+ * structure is not compared
+ */
+static int
+flow_cmp(const void *a, const void *b)
+{
+    const fm10k_flow_t *x;
+    const fm10k_flow_t *y;
+    int c;
+
+    x = a;
+    y = b;
+    c = memcmp(x->dmac, y->dmac, sizeof(x->dmac));
+    if ( 0 == c ) {
+        c = memcmp(x->smac, y->smac, sizeof(x->smac));
+    }
+    if ( 0 != c ) {
+        return c;
+    }
+    if ( x->type != y->type ) {
+        return x->type < y->type ? -1 : 1;
+    }
+    if ( x->vid != y->vid ) {
+        return x->vid < y->vid ? -1 : 1;
+    }
+    if ( x->vpri != y->vpri ) {
+        return x->vpri < y->vpri ? -1 : 1;
+    }
+    if ( x->prot != y->prot ) {
+        return x->prot < y->prot ? -1 : 1;
+    }
+    if ( x->sport != y->sport ) {
+        return x->sport < y->sport ? -1 : 1;
+    }
+    if ( x->sip != y->sip ) {
+        return x->sip < y->sip ? -1 : 1;
+    }
+    if ( x->dip != y->dip ) {
+        return x->dip < y->dip ? -1 : 1;
+    }
+    if ( x->dport != y->dport ) {
+        return x->dport < y->dport ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Merge records of the same flow
+ */
+static void
+flowlist_merge(flowlist_t *fl)
+{
+    int i;
+    int j;
+
+    if ( fl->n < 2 ) {
+        return;
+    }
+    qsort(fl->flows, fl->n, sizeof(fm10k_flow_t), flow_cmp);
+    j = 0;
+    for ( i = 1; i < fl->n; i++ ) {
+        if ( 0 == flow_cmp(&fl->flows[j], &fl->flows[i]) ) {
+            fl->flows[j].bytes += fl->flows[i].bytes;
+            fl->flows[j].pkts += fl->flows[i].pkts;
+        } else {
+            fl->flows[++j] = fl->flows[i];
+        }
+    }
+    fl->n = j + 1;
+}
+
+/*
+ * Load a text flow list: "sip dip prot sport dport bytes [pkts]"
+ */
+static int
+load_flows(FILE *fp, flowlist_t *fl)
+{
+    char buf[512];
+    char sip[64];
+    char dip[64];
+    unsigned int prot;
+    unsigned int sport;
+    unsigned int dport;
+    unsigned long long bytes;
+    unsigned long long pkts;
+    fm10k_flow_t *f;
+    int line;
+    int n;
+
+    line = 0;
+    while ( fgets(buf, sizeof(buf), fp) ) {
+        line++;
+        if ( '#' == buf[0] || '\n' == buf[0] ) {
+            continue;
+        }
+        pkts = 1;
+        n = sscanf(buf, "%63s %63s %u %u %u %llu %llu", sip, dip, &prot,
+                   &sport, &dport, &bytes, &pkts);
+        if ( n < 6 ) {
+            fprintf(stderr, "Invalid flow at line %d\n", line);
+            return -1;
+        }
+        f = flowlist_add(fl);
+        if ( NULL == f ) {
+            return -1;
+        }
+        if ( inet_pton(AF_INET, sip, &f->sip) != 1
+             || inet_pton(AF_INET, dip, &f->dip) != 1 ) {
+            fprintf(stderr, "Invalid address at line %d\n", line);
+            return -1;
+        }
+        f->type = htons(0x0800);
+        f->prot = prot;
+        f->sport = htons(sport);
+        f->dport = htons(dport);
+        f->bytes = bytes;
+        f->pkts = pkts;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse an Ethernet frame into a flow record
+ */
+static void
+parse_frame(const uint8_t *p, uint32_t caplen, uint32_t len, fm10k_flow_t *f)
+{
+    uint16_t type;
+    uint32_t off;
+    uint32_t ihl;
+
+    f->bytes = len;
+    f->pkts = 1;
+    if ( caplen < 14 ) {
+        return;
+    }
+    memcpy(f->dmac, p, 6);
+    memcpy(f->smac, p + 6, 6);
+    type = (p[12] << 8) | p[13];
+    off = 14;
+    if ( 0x8100 == type && caplen >= 18 ) {
+        f->vpri = p[14] >> 5;
+        f->vid = htons(((p[14] << 8) | p[15]) & 0xfff);
+        type = (p[16] << 8) | p[17];
+        off = 18;
+    }
+    f->type = htons(type);
+    if ( 0x0800 != type || caplen < off + 20 ) {
+        return;
+    }
+    ihl = (p[off] & 0xf) * 4;
+    f->prot = p[off + 9];
+    memcpy(&f->sip, p + off + 12, 4);
+    memcpy(&f->dip, p + off + 16, 4);
+    /* Ports are only present in the first fragment */
+    if ( ((p[off + 6] & 0x1f) | p[off + 7]) || caplen < off + ihl + 4 ) {
+        return;
+    }
+    if ( 6 == f->prot || 17 == f->prot ) {
+        memcpy(&f->sport, p + off + ihl, 2);
+        memcpy(&f->dport, p + off + ihl + 2, 2);
+    }
+}
+
+/*
+ * Load a pcap capture
+ */
+static int
+load_pcap(FILE *fp, flowlist_t *fl)
+{
+    uint32_t hdr[6];
+    uint32_t rec[4];
+    uint8_t *pkt;
+    fm10k_flow_t *f;
+    int swap;
+
+    if ( fread(hdr, sizeof(hdr), 1, fp) != 1 ) {
+        return -1;
+    }
+    swap = (hdr[0] != PCAP_MAGIC && hdr[0] != PCAP_MAGIC_NSEC);
+    if ( (swap ? __builtin_bswap32(hdr[5]) : hdr[5])
+         != PCAP_LINKTYPE_ETHERNET ) {
+        fprintf(stderr, "Unsupported pcap link type\n");
+        return -1;
+    }
+    pkt = malloc(65536);
+    if ( NULL == pkt ) {
+        return -1;
+    }
+    while ( fread(rec, sizeof(rec), 1, fp) == 1 ) {
+        if ( swap ) {
+            rec[2] = __builtin_bswap32(rec[2]);
+            rec[3] = __builtin_bswap32(rec[3]);
+        }
+        if ( rec[2] > 65536 || fread(pkt, 1, rec[2], fp) != rec[2] ) {
+            fprintf(stderr, "Truncated pcap\n");
+            free(pkt);
+            return -1;
+        }
+        f = flowlist_add(fl);
+        if ( NULL == f ) {
+            free(pkt);
+            return -1;
+        }
+        parse_frame(pkt, rec[2], rec[3], f);
+    }
+    free(pkt);
+
+    return 0;
+}
+
+/*
+ * Print the per-member load of a profile
+ */
+static void
+print_sim(const fm10k_lag_sim_t *sim)
+{
+    uint64_t total;
+    int m;
+
+    total = 0;
+    for ( m = 0; m < sim->members; m++ ) {
+        total += sim->bytes[m];
+    }
+    printf("member       flows         pkts            bytes   share\n");
+    for ( m = 0; m < sim->members; m++ ) {
+        printf("%6d %11llu %12llu %16llu %6.2f%%\n", m,
+               (unsigned long long)sim->flows[m],
+               (unsigned long long)sim->pkts[m],
+               (unsigned long long)sim->bytes[m],
+               total ? 100.0 * sim->bytes[m] / total : 0.0);
+    }
+    printf("imbalance (max/mean): %.3f\n", sim->imbalance);
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    fm10k_lag_profile_t profile;
+    fm10k_lag_sim_t sim;
+    flowlist_t fl;
+    uint32_t magic;
+    FILE *fp;
+    int members;
+    int all;
+    int opt;
+    int ret;
+    size_t i;
+    int r;
+
+    members = 2;
+    all = 0;
+    profile.fields = FM10K_LAG_HASH_SIP | FM10K_LAG_HASH_DIP
+        | FM10K_LAG_HASH_PROT | FM10K_LAG_HASH_L4SRC | FM10K_LAG_HASH_L4DST;
+    profile.rotation = 0;
+    while ( (opt = getopt(argc, argv, "n:p:r:a")) != -1 ) {
+        switch ( opt ) {
+        case 'n':
+            members = atoi(optarg);
+            if ( members <= 0 || members > FM10K_LAG_MAX_MEMBERS ) {
+                fprintf(stderr, "members must be 1..%d\n",
+                        FM10K_LAG_MAX_MEMBERS);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'p':
+            if ( fm10k_lag_parse_fields(optarg, &profile.fields) < 0 ) {
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'r':
+            profile.rotation = atoi(optarg) ? 1 : 0;
+            break;
+        case 'a':
+            all = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( optind >= argc ) {
+        usage(argv[0]);
+    }
+
+    fp = fopen(argv[optind], "rb");
+    if ( NULL == fp ) {
+        perror(argv[optind]);
+        return EXIT_FAILURE;
+    }
+    memset(&fl, 0, sizeof(flowlist_t));
+    if ( fread(&magic, sizeof(magic), 1, fp) == 1
+         && (PCAP_MAGIC == magic || PCAP_MAGIC_NSEC == magic
+             || PCAP_MAGIC == __builtin_bswap32(magic)
+             || PCAP_MAGIC_NSEC == __builtin_bswap32(magic)) ) {
+        rewind(fp);
+        ret = load_pcap(fp, &fl);
+    } else {
+        rewind(fp);
+        ret = load_flows(fp, &fl);
+    }
+    fclose(fp);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to load %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+    flowlist_merge(&fl);
+    printf("%d flows, %d members\n", fl.n, members);
+
+    if ( !all ) {
+        fm10k_lag_simulate(&profile, fl.flows, fl.n, members, &sim);
+        print_sim(&sim);
+    } else {
+        printf("profile    rotation  imbalance\n");
+        for ( i = 0; i < sizeof(presets) / sizeof(presets[0]); i++ ) {
+            fm10k_lag_parse_fields(presets[i].fields, &profile.fields);
+            for ( r = 0; r < 2; r++ ) {
+                profile.rotation = r;
+                fm10k_lag_simulate(&profile, fl.flows, fl.n, members, &sim);
+                printf("%-10s %8s %10.3f\n", presets[i].name, r ? "B" : "A",
+                       sim.imbalance);
+            }
+        }
+    }
+    free(fl.flows);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
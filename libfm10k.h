@@ -0,0 +1,89 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _LIBFM10K_H
+#define _LIBFM10K_H
+
+/*
+ * libfm10k: register layer, boot sequence, configuration, monitors and
+ * statistics of the FM10K switch.  The minor version grows with additions;
+ * the major version changes when a function or a structure changes
+ * incompatibly.
+ */
+#define FM10K_LIB_VERSION_MAJOR 0
+#define FM10K_LIB_VERSION_MINOR 1
+#define FM10K_LIB_VERSION_PATCH 0
+#define FM10K_LIB_VERSION       "0.1.0"
+
+#include "fm10k.h"
+#include "boot.h"
+#include "prog.h"
+#include "conf.h"
+#include "warm.h"
+#include "port.h"
+#include "cm.h"
+#include "clock.h"
+#include "sbus.h"
+#include "serdes.h"
+#include "an.h"
+#include "link.h"
+#include "pcie.h"
+#include "ptp.h"
+#include "glort.h"
+#include "lag.h"
+#include "policer.h"
+#include "te.h"
+#include "parser.h"
+#include "trig.h"
+#include "mod.h"
+#include "eacl.h"
+#include "vf.h"
+#include "fibm.h"
+#include "snap.h"
+#include "sim.h"
+#ifdef FM10K_MODEL
+#include "model.h"
+#endif
+#include "stats.h"
+#include "ctl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const char *fm10k_lib_version(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LIBFM10K_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
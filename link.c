@@ -0,0 +1,262 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "link.h"
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Default damping: publish up after 500 ms of stable link, down after
+ * 10 ms; suppress a port after two quick flaps
+ */
+void
+fm10k_link_default_cfg(fm10k_link_cfg_t *cfg)
+{
+    cfg->hold_up_ms = 500;
+    cfg->hold_down_ms = 10;
+    cfg->penalty = 1000;
+    cfg->suppress = 2000;
+    cfg->reuse = 750;
+    cfg->half_life_ms = 5000;
+    cfg->max_suppress_ms = 20000;
+}
+
+/*
+ * Initialize damping for the Ethernet ports of a port set; all links start
+ * down
+ */
+int
+fm10k_link_init(fm10k_link_t *link, fm10k_t *fm10k,
+                const fm10k_ports_t *ports, const fm10k_link_cfg_t *cfg,
+                fm10k_link_notify_t notify, void *arg)
+{
+    fm10k_link_port_t *p;
+    uint64_t now;
+    int i;
+
+    if ( cfg->reuse <= 0 || cfg->reuse >= cfg->suppress
+         || cfg->half_life_ms <= 0 ) {
+        return -1;
+    }
+
+    memset(link, 0, sizeof(fm10k_link_t));
+    link->fm10k = fm10k;
+    link->cfg = *cfg;
+    link->max_penalty = cfg->reuse
+        * exp2((double)cfg->max_suppress_ms / cfg->half_life_ms);
+    link->notify = notify;
+    link->arg = arg;
+
+    now = _now();
+    for ( i = 0; i < ports->n; i++ ) {
+        if ( ports->port[i].epl < 0 ) {
+            continue;
+        }
+        p = &link->ports[link->n++];
+        p->cfg = &ports->port[i];
+        p->changed = now;
+        p->decayed = now;
+    }
+
+    return 0;
+}
+
+/*
+ * Decay the penalty of a port to the current time
+ */
+static void
+_decay(fm10k_link_t *link, fm10k_link_port_t *p, uint64_t now)
+{
+    double dt;
+
+    if ( now > p->decayed && p->penalty > 0 ) {
+        dt = (now - p->decayed) / 1e6;
+        p->penalty *= exp2(-dt / link->cfg.half_life_ms);
+        if ( p->suppressed && p->penalty < link->cfg.reuse ) {
+            p->suppressed = 0;
+        }
+    }
+    p->decayed = now;
+}
+
+/*
+ * Record a raw transition
+ */
+static void
+_transition(fm10k_link_t *link, fm10k_link_port_t *p, int up, uint64_t now)
+{
+    _decay(link, p, now);
+    if ( !up ) {
+        p->penalty += link->cfg.penalty;
+        if ( p->penalty > link->max_penalty ) {
+            p->penalty = link->max_penalty;
+        }
+        if ( p->penalty >= link->cfg.suppress ) {
+            p->suppressed = 1;
+        }
+    }
+    p->raw = up;
+    p->changed = now;
+    p->flaps++;
+}
+
+/*
+ * Feed a raw link state of a logical port (e.g., from another event source)
+ */
+int
+fm10k_link_update(fm10k_link_t *link, int logical, int up, uint64_t now)
+{
+    int i;
+
+    for ( i = 0; i < link->n; i++ ) {
+        if ( link->ports[i].cfg->logical == logical ) {
+            if ( link->ports[i].raw != !!up ) {
+                _transition(link, &link->ports[i], !!up, now);
+            }
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Publish the stable transitions; returns the time to the next timer
+ * (ms, rounded up) or -1 if no timer is pending
+ */
+int
+fm10k_link_eval(fm10k_link_t *link, uint64_t now)
+{
+    fm10k_link_port_t *p;
+    uint64_t hold;
+    uint64_t next;
+    uint64_t t;
+    int target;
+    int i;
+
+    next = UINT64_MAX;
+    for ( i = 0; i < link->n; i++ ) {
+        p = &link->ports[i];
+        _decay(link, p, now);
+        if ( p->suppressed ) {
+            /* Time for the penalty to decay to the reuse threshold */
+            t = link->cfg.half_life_ms * 1e6
+                * log2(p->penalty / link->cfg.reuse) + 1;
+            if ( t < next ) {
+                next = t;
+            }
+        }
+
+        target = p->raw && !p->suppressed;
+        if ( target == p->published ) {
+            continue;
+        }
+        if ( p->suppressed ) {
+            /* Withdraw a suppressed port at once; its raw state keeps
+               changing and would restart the down hold timer */
+            hold = 0;
+        } else {
+            hold = (target ? link->cfg.hold_up_ms : link->cfg.hold_down_ms)
+                * 1000000ULL;
+        }
+        if ( now - p->changed >= hold ) {
+            p->published = target;
+            p->events++;
+            if ( link->notify ) {
+                link->notify(link->arg, p->cfg->logical, target);
+            }
+        } else if ( p->changed + hold - now < next ) {
+            next = p->changed + hold - now;
+        }
+    }
+
+    if ( next == UINT64_MAX ) {
+        return -1;
+    }
+
+    return (int)((next + 999999) / 1000000);
+}
+
+/*
+ * Read the link events latched since the last poll and publish the stable
+ * transitions; returns the time to the next timer as fm10k_link_eval
+ */
+int
+fm10k_link_poll(fm10k_link_t *link)
+{
+    fm10k_link_port_t *p;
+    uint64_t now;
+    uint32_t ip;
+    int up;
+    int i;
+
+    now = _now();
+    for ( i = 0; i < link->n; i++ ) {
+        p = &link->ports[i];
+        ip = rd32(link->fm10k->mmio, FM10K_LINK_IP(p->cfg->epl, p->cfg->lane));
+        if ( ip & 0x3 ) {
+            wr32(link->fm10k->mmio, FM10K_LINK_IP(p->cfg->epl, p->cfg->lane),
+                 ip & 0x3);
+        }
+        up = rd32(link->fm10k->mmio,
+                  FM10K_PORT_STATUS(p->cfg->epl, p->cfg->lane)) & 1;
+
+        /* Replay the flaps shorter than the polling interval, so that they
+           are penalized too */
+        if ( (ip & 0x2) && p->raw ) {
+            _transition(link, p, 0, now);
+        }
+        if ( (ip & 0x1) && !p->raw && !up ) {
+            _transition(link, p, 1, now);
+        }
+        if ( p->raw != up ) {
+            _transition(link, p, up, now);
+        }
+    }
+
+    return fm10k_link_eval(link, now);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,110 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _LINK_H
+#define _LINK_H
+
+#include "fm10k.h"
+#include "port.h"
+#include <stdint.h>
+
+/*
+ * Damping configuration
+ */
+typedef struct _fm10k_link_cfg {
+    /* A raw state must persist this long before it is published (ms) */
+    int hold_up_ms;
+    int hold_down_ms;
+    /* Penalty added per down transition, decaying with the half-life */
+    int penalty;
+    /* Suppress above this penalty, reuse below that one */
+    int suppress;
+    int reuse;
+    int half_life_ms;
+    /* Longest suppression of a port that stopped flapping (ms) */
+    int max_suppress_ms;
+} fm10k_link_cfg_t;
+
+/*
+ * Per-port state
+ */
+typedef struct _fm10k_link_port {
+    const fm10k_port_cfg_t *cfg;
+    /* Raw state and the time it was entered (ns) */
+    int raw;
+    uint64_t changed;
+    /* State seen by consumers */
+    int published;
+    int suppressed;
+    double penalty;
+    uint64_t decayed;
+    /* Raw and published transitions */
+    uint64_t flaps;
+    uint64_t events;
+} fm10k_link_port_t;
+
+/*
+ * Link state consumer callback: (arg, logical port, up)
+ */
+typedef void (*fm10k_link_notify_t)(void *, int, int);
+
+/*
+ * Link damping
+ */
+typedef struct _fm10k_link {
+    fm10k_t *fm10k;
+    fm10k_link_cfg_t cfg;
+    double max_penalty;
+    fm10k_link_port_t ports[FM10K_PORT_MAX];
+    int n;
+    fm10k_link_notify_t notify;
+    void *arg;
+} fm10k_link_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_link_default_cfg(fm10k_link_cfg_t *);
+int fm10k_link_init(fm10k_link_t *, fm10k_t *, const fm10k_ports_t *,
+                    const fm10k_link_cfg_t *, fm10k_link_notify_t, void *);
+int fm10k_link_update(fm10k_link_t *, int, int, uint64_t);
+int fm10k_link_eval(fm10k_link_t *, uint64_t);
+int fm10k_link_poll(fm10k_link_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LINK_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
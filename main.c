@@ -21,777 +21,582 @@
  * SOFTWARE.
  */
 
-#include "fm10k.h"
+#include "libfm10k.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
-#include <sys/mman.h>
+#include <string.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdint.h>
-#include <time.h>
 
-/* 64 MiB */
-#define FM10K_BAR4_SIZE         0x4000000
+/* Host link sampling interval (ms) */
+#define PCIE_MON_INTERVAL       1000
 
-/* FM10K NVM recovery version */
-#define NVM_PCIE_RECOVERY_VER   0x122
+/* Auto-negotiation step interval (ms) */
+#define AN_POLL_INTERVAL        1
 
-enum {
-    FM10K_SOFT_RESET_LOCK_FREE = 0,
-    FM10K_SOFT_RESET_LOCK_NVM = 1,
-    FM10K_SOFT_RESET_LOCK_API = 2,
-};
+/* VF function level reset service interval (ms) */
+#define VF_FLR_INTERVAL         100
 
 /*
- * FM10K management structure
+ * State owned by the resident switch manager
  */
-typedef struct _fm10k {
-    /* /dev/uioX */
-    int fd;
-    /* Memory mapped to /dev/uioX (BAR4) */
-    void *mmio;
-} fm10k_t;
+typedef struct _manager {
+    fm10k_t *fm10k;
+    fm10k_conf_t *conf;
+    fm10k_link_t *link;
+    fm10k_pcie_mon_t *pcie;
+    /* Negotiations started by the cold boot */
+    fm10k_an_t an;
+    /* SR-IOV VF pool laid out by the cold boot; nvfs is 0 without one */
+    int nvfs;
+    fm10k_glort_t glort;
+    fm10k_vf_t vf;
+    /* Program of the last apply; empty when unknown */
+    fm10k_prog_t shadow;
+    const char *shadow_path;
+} manager_t;
 
 /*
- * Port mapping
- */
-typedef struct _fm10k_portmap {
-    int logical;
-    int physical;
-    int quad;
-} fm10k_portmap_t;
-
-/*
- * Read/Write
- */
-static __inline__ uint32_t
-rd32(void *mmio, long offset)
-{
-    return *((uint32_t *)(mmio + offset));
-}
-static __inline__ uint64_t
-rd64(void *mmio, long offset)
-{
-    return *((uint64_t *)(mmio + offset));
-}
-static __inline__ void
-wr32(void *mmio, long offset, uint32_t val)
-{
-    *((uint32_t *)(mmio + offset)) = val;
-}
-static __inline__ void
-wr64(void *mmio, long offset, uint64_t val)
-{
-    *((uint64_t *)(mmio + offset)) = val;
-}
-
-
-/*
- * Usage
- */
-void
-usage(const char *prog)
-{
-    fprintf(stderr, "Usage: %s /dev/<uioX>\n", prog);
-    exit(EXIT_FAILURE);
-}
-
-/*
- * Initialize FM10K scheduler
+ * Program each LAG with its members whose link is up; the others leave the
+ * LAG until they come back.  Every configured port forwards into the LAGs,
+ * so all of them get the hash profile.
  */
 int
-init_scheduler(fm10k_t *fm10k)
+lag_sync(manager_t *mgr)
 {
-    struct timespec ts;
-    uint32_t mode0;
-    uint32_t mode1;
-    uint32_t run0;
-    uint32_t run1;
-    uint64_t m64;
-    uint32_t m32;
+    const fm10k_conf_lag_t *lag;
+    uint64_t ingress;
+    uint64_t up;
+    int ports[FM10K_LAG_MAX_MEMBERS];
+    int down[FM10K_LAG_MAX_MEMBERS];
+    int nup;
+    int ndown;
+    int ret;
     int i;
     int j;
 
-    /* Clear BIST-accessible switch memories */
-    mode0 = rd32(fm10k->mmio, FM10K_BIST_CTRL_MODE);
-    mode1 = mode0 | (1ULL << 10);
-    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, mode1);
-    run0 = rd32(fm10k->mmio, FM10K_BIST_CTRL_RUN);
-    run1 = run0 | (1ULL << 10);
-    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, run1);
-
-    /* Wait 0.8 ms */
-    ts.tv_sec  = 0;
-    ts.tv_nsec = 800000L;
-    nanosleep(&ts, NULL);
-
-    /* FABRIC=0 */
-    wr64(fm10k->mmio, FM10K_BIST_CTRL_RUN, run0);
-    wr64(fm10k->mmio, FM10K_BIST_CTRL_MODE, mode0);
-
-    /* Initialization of RXQ_MCAST list */
-    for ( i = 0; i < 8; i++ ) {
-        m64 = i | (i << 10);
-        wr64(fm10k->mmio, FM10K_SCHED_RXQ_STORAGE_POINTERS(i), m64);
-    }
-    for ( i = 0; i < (1024 - 8); i++ ){
-        wr32(fm10k->mmio, FM10K_SCHED_RXQ_FREELIST_INIT, i + 8);
-    }
-
-    /* Initialization of TXQ list */
-    for ( i = 0; i < 384; i++ ) {
-        wr32(fm10k->mmio, FM10K_SCHED_TXQ_HEAD_PERQ(i), i);
-        wr32(fm10k->mmio, FM10K_SCHED_TXQ_TAIL0_PERQ(i), i);
-        wr32(fm10k->mmio, FM10K_SCHED_TXQ_TAIL1_PERQ(i), i);
-    }
-    for ( i = 0; i < 24576 - 384; i++ ) {
-        wr32(fm10k->mmio, FM10K_SCHED_RXQ_FREELIST_INIT, i + 384);
-    }
-
-    /* Initialization of FREE segment list */
-    for ( i = 0; i < 48; i++ ) {
-        wr32(fm10k->mmio, FM10K_SCHED_SSCHED_RX_PERPORT(i), i);
-    }
-    for ( i = 0; i < 24576 - 48; i++ ) {
-        wr32(fm10k->mmio, FM10K_SCHED_FREELIST_INIT, 48 + i);
-    }
-
-    /* Initialization of scheduler polling schedule */
-    fm10k_portmap_t portmap[5] = {
-        { .logical = 0, .physical = 0x3f, .quad = 0 },
-        /* Physical ports 0..35: Ethernet; Set Quad to 1 for 100 GbE */
-        { .logical = 1, .physical = 0x04, .quad = 1 },
-        { .logical = 2, .physical = 0x18, .quad = 1 },
-        { .logical = 3, .physical = 0x24, .quad = 1 },
-        { .logical = 4, .physical = 0x28, .quad = 1 },
-    };
-    for ( i = 0; i < 5; i++ ) {
-        /* PhysPort | Port | Quad */
-        m32 = portmap[i].physical | (portmap[i].logical << 8)
-            | (portmap[i].quad << 14);
-        wr32(fm10k->mmio, FM10K_SCHED_RX_SCHEDULE(i), m32);
-        wr32(fm10k->mmio, FM10K_SCHED_TX_SCHEDULE(i), m32);
-    }
-    /* Start scheduler */
-    m32 = 1 | (5 << 2) | (1 << 11) | (5 << 13);
-    wr32(fm10k->mmio, FM10K_SCHED_SCHEDULE_CTRL, m32);
-
-    return 0;
-}
-
-/*
- * Wait for SOFT_RESET lock owner
- */
-int
-wait_for_soft_reset_lock_owner(fm10k_t *fm10k, int owner, long timeout)
-{
-    uint32_t m32;
-    int lockowner;
-    struct timespec ts;
-    long atime;
-    int cnt;
-
-    /* Get the lock owner */
-    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
-    lockowner = m32 & 0x3;
-
-    if ( FM10K_SOFT_RESET_LOCK_API == lockowner ) {
-        if ( FM10K_SOFT_RESET_LOCK_API != owner ) {
-            fprintf(stderr, "warning...\n");
-            return -1;
+    up = 0;
+    for ( i = 0; i < mgr->link->n; i++ ) {
+        if ( mgr->link->ports[i].published ) {
+            up |= 1ULL << mgr->link->ports[i].cfg->logical;
         }
     }
-
-    atime = 0;
-    cnt = 1;
-    while ( lockowner != owner ) {
-        printf("%x:%x\n", owner, lockowner);
-        if ( atime >= timeout ) {
-            return -1;
-        }
-        /* Check timeout */
-        ts.tv_sec  = 0;
-        ts.tv_nsec = 10000L * cnt;
-        nanosleep(&ts, NULL);
-        atime += 10000L * cnt;
-        cnt++;
-
-        m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
-        lockowner = m32 & 0x3;
+    ingress = 0;
+    for ( i = 0; i < mgr->conf->ports.n; i++ ) {
+        ingress |= 1ULL << mgr->conf->ports.port[i].logical;
     }
 
-    return 0;
-}
-
-/*
- * Take SOFT_RESET lock
- */
-int
-take_soft_reset_lock(fm10k_t *fm10k)
-{
-    uint32_t m32;
-    int i;
-    int ret;
-    struct timespec ts;
-
-    /* Get NVM version */
-    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(401));
-    if ( m32 > NVM_PCIE_RECOVERY_VER ) {
-        /* Support locking in NVM */
-        for ( i = 0; i < 3; i++ ) {
-            ret = wait_for_soft_reset_lock_owner(fm10k,
-                                                 FM10K_SOFT_RESET_LOCK_FREE,
-                                                 1000 * 1000 * 2000);
-            if ( ret < 0 ) {
-                /* Error */
-                return -1;
+    ret = 0;
+    for ( i = 0; i < mgr->conf->nlags; i++ ) {
+        lag = &mgr->conf->lags[i];
+        nup = 0;
+        ndown = 0;
+        for ( j = 0; j < FM10K_PORT_MAX; j++ ) {
+            if ( !(lag->members & (1ULL << j)) ) {
+                continue;
             }
-            /* Take a lock */
-            wr32(fm10k->mmio, FM10K_BSM_SCRATCH(2), FM10K_SOFT_RESET_LOCK_API);
-
-            /* Wait 50us */
-            ts.tv_sec  = 0;
-            ts.tv_nsec = 50000L;
-            nanosleep(&ts, NULL);
-
-            /* Check the owner */
-            ret = wait_for_soft_reset_lock_owner(fm10k,
-                                                 FM10K_SOFT_RESET_LOCK_API, 0);
-            if ( 0 == ret ) {
-                return 0;
+            if ( up & (1ULL << j) ) {
+                ports[nup++] = j;
+            } else {
+                down[ndown++] = j;
             }
         }
-    } else {
-        /* No support locking in NVM */
-        return -1;
+        if ( fm10k_lag_clear_members(mgr->fm10k, down, ndown) < 0
+             || (nup > 0 && fm10k_lag_set_members(mgr->fm10k, ports, nup,
+                                                  ingress,
+                                                  &lag->profile) < 0) ) {
+            fprintf(stderr, "Failed to update the members of LAG %d\n", i);
+            ret = -1;
+        }
     }
 
-    return -1;
+    return ret;
 }
 
 /*
- * Drop SOFT_RESET lock
+ * Stable link state transitions
  */
-int
-drop_soft_reset_lock(fm10k_t *fm10k)
+void
+link_notify(void *arg, int logical, int up)
 {
-    uint32_t m32;
+    manager_t *mgr;
     int i;
-    int ret;
 
-    /* Get NVM version */
-    m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(401));
-    if ( m32 > NVM_PCIE_RECOVERY_VER ) {
-        /* Support locking in NVM */
-        m32 = rd32(fm10k->mmio, FM10K_BSM_SCRATCH(2));
-        switch ( m32 & 3 ) {
-        case FM10K_SOFT_RESET_LOCK_API:
-            wr32(fm10k->mmio, FM10K_BSM_SCRATCH(2), 0);
-            return 0;
+    mgr = arg;
+    printf("Port %d: link %s\n", logical, up ? "up" : "down");
+    for ( i = 0; i < mgr->conf->nlags; i++ ) {
+        if ( mgr->conf->lags[i].members & (1ULL << logical) ) {
+            (void)lag_sync(mgr);
             break;
-        case FM10K_SOFT_RESET_LOCK_FREE:
-            fprintf(stderr, "warning\n");
-            return 0;
-        default:
-            return -1;
         }
-    } else {
-        /* No support locking in NVM */
-        return -1;
     }
-
-    return 0;
 }
 
 /*
- * Set frame handler clock (use default value)
+ * Host link events
  */
-int
-set_frame_handler_clock(fm10k_t *fm10k)
+void
+pcie_notify(void *arg, int ev, const fm10k_pcie_link_t *link)
 {
-    uint32_t m32;
-    int sku;
-    int feature;
-    int freq;
-    int refdiv;
-    int outdiv;
-    int fbdiv4;
-    int fbdiv255;
-    int skuclock;
-    struct timespec ts;
-    int maxfreq;
-    int fhclock;
-    int freqsel;
-
-    /* Read SKU from FUSE_DATA_0[15:11] */
-    m32 = rd32(fm10k->mmio, FM10K_FUSE_DATA_0);
-    if ( 0 == m32 ) {
-        /* Unknown SKU */
-        fprintf(stderr, "Unknown SKU\n");
-        sku = 0xff;
-    } else {
-        sku = (m32 >> 11) & 0x1f;
-    }
-
-    /* Get feature code and frequency selection */
-    m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK);
-    /* FeatureCode:
-       0000b = Full -- All frequencies are supported
-       0001b = LIMITED0 -- Restricted to 600, 500, 400, 300 MHz
-       0010b = LIMITED1 -- Restricted to 500, 400, 300 MHz
-       0011b = LIMITED2 -- Restricted to 400, 300 MHz
-       0100b = LIMITED3 -- Restricted to 300 MHz */
-    feature = m32 & 0xf;
-    /* FreqSel:
-       0000b = USE_CTRL -- Use PLL_FABRIC_CTRL's values to set frequency
-       0001b = F600 -- 600 MHz
-       0010b = F500 -- 500 MHz
-       0011b = F400 -- 400 MHz
-       0100b = F300 -- 300 MHz */
-    freq = (m32 >> 4) & 0xf;
-
-    switch ( sku ) {
-    case 0: /* FM10840 */
-        refdiv = 0x19;
-        outdiv = 0x5;
-        fbdiv4 = 0x1;
-        fbdiv255 = 0xc4;
-        skuclock = 980000000;   /* 980 MHz in binary */
+    (void)arg;
+    switch ( ev ) {
+    case FM10K_PCIE_EV_UP:
+    case FM10K_PCIE_EV_RESTORED:
+        printf("PCIe host link up: x%d Gen%d, %.2f Gbps\n", link->width,
+               link->speed, fm10k_pcie_bandwidth(link) * 8 / 1e9);
         break;
-    case 1: /* FM10420 */
-    default:
-        refdiv = 0x3;
-        outdiv = 0x7;
-        fbdiv4 = 0x0;
-        fbdiv255 = 0x2f;
-        skuclock = 699404761;   /* 700 MHz in binary */
+    case FM10K_PCIE_EV_DOWN:
+        printf("PCIe host link down (LTSSM %s)\n",
+               fm10k_pcie_ltssm_name(link->ltssm));
+        break;
+    case FM10K_PCIE_EV_DEGRADED:
+        printf("PCIe host link degraded: x%d Gen%d of x%d Gen%d, "
+               "%.2f Gbps\n", link->width, link->speed, link->max_width,
+               link->max_speed, fm10k_pcie_bandwidth(link) * 8 / 1e9);
         break;
     }
-
-    if ( 0 == feature ) {
-        /* Full control over PLL */
-        m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL);
-        /* RefDiv | FbDiv4 | FbDiv255 | OutDiv */
-        m32 = (m32 & ~(0xfffff8UL)) |
-            (refdiv << 3) | (fbdiv4 << 4) | (fbdiv255 << 10) | (outdiv << 18);
-        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
-
-        /* Toggle reset */
-        m32 &= ~1UL;
-        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
-
-        /* Wait 500ns */
-        ts.tv_sec  = 0;
-        ts.tv_nsec = 500L;
-        nanosleep(&ts, NULL);
-
-        m32 |= 1UL;
-        wr32(fm10k->mmio, FM10K_PLL_FABRIC_CTRL, m32);
-
-        /* Wait 1ms */
-        ts.tv_sec  = 0;
-        ts.tv_nsec = 1000000L;
-        nanosleep(&ts, NULL);
-
-        m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK);
-        m32 = (m32 & ~0xfUL) | (0);
-        wr32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK, m32);
-    } else {
-        switch ( feature ) {
-        case 1:                 /* LIMITED0 */
-            maxfreq = 612 * 1000000;
-            break;
-        case 2:                 /* LIMITED1 */
-            maxfreq = 510 * 1000000;
-            break;
-        case 3:                 /* LIMITED2 */
-            maxfreq = 408 * 1000000;
-            break;
-        case 4:                 /* LIMITED3 */
-            maxfreq = 306 * 1000000;
-            break;
-        default:
-            maxfreq = 612 * 1000000;
-        }
-        if ( maxfreq > skuclock ) {
-            maxfreq = skuclock;
-        }
-
-        if ( fhclock >= 612 * 1000000 ) {
-            /* F600 */
-            freqsel = 1;
-        } else if ( fhclock >= 510 * 1000000 ) {
-            /* F500 */
-            freqsel = 2;
-        } else if ( fhclock >= 408 * 1000000 ) {
-            /* F400 */
-            freqsel = 3;
-        } else {
-            /* F300 */
-            freqsel = 4;
-        }
-
-        m32 = rd32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK);
-        m32 = (m32 & ~0xf0UL) | (freqsel << 4);
-        wr32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK, m32);
-    }
-
-    return 0;
 }
 
 /*
- * Reset switch
+ * Usage
  */
-int
-reset_switch(fm10k_t *fm10k)
+void
+usage(const char *prog)
 {
-    uint32_t m32;
-    int ret;
-    struct timespec ts;
-
-    /* Try to take a lock */
-    ret = take_soft_reset_lock(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Could not take lock\n");
-        return -1;
-    }
-
-    /* Set SwitchReady=0 */
-    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
-    m32 &= ~(1 << 3);
-    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
-
-    /* Wait 100us */
-    ts.tv_sec  = 0;
-    ts.tv_nsec = 100000L;
-    nanosleep(&ts, NULL);
-
-    /* Reduce EPL frequency to reduce power during reset */
-    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_CTRL);
-    m32 |= (63 << 18);          /* OutDiv = 63 */
-    wr32(fm10k->mmio, FM10K_PLL_EPL_CTRL, m32);
-
-    /* Apply OutDiv (Bit[4]) */
-    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_STAT);
-    m32 |= (1 << 6);
-    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
-    m32 &= ~(1 << 6);
-    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
-
-    /* Assert Switch/EPL reset */
-    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
-    m32 |= (1 << 2);            /* SwitchReset */
-    m32 |= (1 << 1);            /* EPLReset */
-    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
-
-    /* Wait 1ms */
-    ts.tv_sec  = 0;
-    ts.tv_nsec = 1000000L;
-    nanosleep(&ts, NULL);
-
-    ret = drop_soft_reset_lock(fm10k);
-    if ( ret < 0 ) {
-        return -1;
-    }
-
-    return 0;
+    fprintf(stderr, "Usage: %s [-c config] [-p profile] [-s shadow] [-w [-n]] "
+            "[-l socket]\n"
+            "       [-v nvfs] /dev/<uioX>\n"
+            "  -c config   switch configuration\n"
+            "  -p profile  performance profile\n"
+            "  -s shadow   copy of the last applied register program\n"
+            "  -w          warm apply: write only the differences to a "
+            "running switch\n"
+            "              and reset it only when a change needs it\n"
+            "  -n          print the warm apply differences only\n"
+            "  -l socket   serve requests on a control socket, e.g., "
+            FM10K_CTL_PATH "\n"
+            "  -v nvfs     number of SR-IOV VFs to enable at a cold boot\n",
+            prog);
+    exit(EXIT_FAILURE);
 }
 
 /*
- * Release switch
+ * Configuration change from the control socket
  */
 int
-release_switch(fm10k_t *fm10k)
+ctl_apply(manager_t *mgr, const void *req, uint32_t len, void *resp,
+          uint32_t *rlen)
 {
-    uint32_t m32;
-    uint64_t m64;
-    struct timespec ts;
+    fm10k_ctl_apply_t res;
+    fm10k_conf_t *conf;
+    fm10k_link_cfg_t linkcfg;
+    fm10k_warm_t warm;
+    int ports[FM10K_PORT_MAX];
+    FILE *fp;
     int ret;
+    int n;
+    int i;
+    int j;
 
-    /* Clear switch/tunnel/EPL memories */
-    m64 = rd64(fm10k->mmio, FM10K_BIST_CTRL);
-    m64 |= (1 << 10) | (1 << 11) | (1 << 9);
-    wr64(fm10k->mmio, FM10K_BIST_CTRL, m64);
-
-    /* Wait 0.8ms */
-    ts.tv_sec  = 0;
-    ts.tv_nsec = 800000L;
-    nanosleep(&ts, NULL);
-
-    m64 &= ~((1 << 10) | (1 << 11) | (1 << 9) | (1ULL << 42) | (1ULL << 43)
-             | (1ULL << 41));
-    wr64(fm10k->mmio, FM10K_BIST_CTRL, m64);
-
-    /* Try to take a lock */
-    ret = take_soft_reset_lock(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Could not take lock\n");
-        return -1;
+    conf = malloc(sizeof(fm10k_conf_t));
+    if ( NULL == conf ) {
+        return FM10K_CTL_EFAULT;
     }
-
-    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
-    m32 &= ~((1 << 2) | (1 << 1));
-    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
-
-    /* Wait 100ns */
-    ts.tv_sec  = 0;
-    ts.tv_nsec = 100000L;
-    nanosleep(&ts, NULL);
-
-    ret = drop_soft_reset_lock(fm10k);
+    fp = fmemopen((void *)req, len, "r");
+    if ( NULL == fp ) {
+        free(conf);
+        return FM10K_CTL_EFAULT;
+    }
+    fm10k_conf_default(conf);
+    ret = fm10k_conf_load(fp, conf);
+    fclose(fp);
     if ( ret < 0 ) {
-        return -1;
+        free(conf);
+        return FM10K_CTL_EINVAL;
     }
 
-    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_CTRL);
-    m32 = (m32 & ~(0x3f << 18)) | (6 << 18);
-    wr32(fm10k->mmio, FM10K_PLL_EPL_CTRL, m32);
-
-    /* Apply OutDiv (toggle PLL_EPL_STAT.MiscCtrl[4]) */
-    m32 = rd32(fm10k->mmio, FM10K_PLL_EPL_STAT);
-    m32 |= (1 << 6);
-    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
-
-    m32 &= ~(1 << 6);
-    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, m32);
+    ret = fm10k_warm_check(mgr->fm10k, conf->profile);
+    if ( 0 == ret ) {
+        ret = fm10k_warm_write(mgr->fm10k, conf, &mgr->shadow,
+                               mgr->shadow_path, 0, &warm);
+    }
+    if ( 0 == ret ) {
+        /* Take the ports out of the old LAGs */
+        for ( i = 0; i < mgr->conf->nlags; i++ ) {
+            n = 0;
+            for ( j = 0; j < FM10K_PORT_MAX; j++ ) {
+                if ( mgr->conf->lags[i].members & (1ULL << j) ) {
+                    ports[n++] = j;
+                }
+            }
+            (void)fm10k_lag_clear_members(mgr->fm10k, ports, n);
+        }
+        /* The port set is unchanged unless a reset is needed; rebind the
+           link monitor only if it grew or shrank */
+        if ( conf->ports.n != mgr->conf->ports.n ) {
+            *mgr->conf = *conf;
+            linkcfg = mgr->link->cfg;
+            ret = fm10k_link_init(mgr->link, mgr->fm10k, &mgr->conf->ports,
+                                  &linkcfg, mgr->link->notify,
+                                  mgr->link->arg);
+        } else {
+            *mgr->conf = *conf;
+        }
+        if ( 0 == ret ) {
+            ret = lag_sync(mgr);
+        }
+    }
+    if ( 0 == ret ) {
+        res.naccess = warm.naccess;
+        res.ndiff = warm.ndiff;
+        res.ncold = warm.ncold;
+        res.nstale = warm.nstale;
+        memcpy(resp, &res, sizeof(res));
+        *rlen = sizeof(res);
+    }
+    free(conf);
 
-    return 0;
+    return ret < 0 ? FM10K_CTL_EFAULT
+        : (ret > 0 ? FM10K_CTL_ERESET : FM10K_CTL_OK);
 }
 
 /*
- * Initialize SerDes
+ * Control socket requests
  */
 int
-serdes_init_op_mode(fm10k_t *fm10k)
+ctl_handler(void *arg, int cmd, const void *req, uint32_t len, void *resp,
+            uint32_t *rlen)
 {
-    /* FIXME */
-    return 0;
-}
+    manager_t *mgr;
+    fm10k_ctl_reg_t reg;
+    fm10k_ctl_port_t *port;
+    fm10k_ctl_pcie_t *pcie;
+    fm10k_ctl_vf_t vf;
+    const fm10k_link_port_t *p;
+    int wide;
+    int i;
 
-/*
- * Initialize SBUS
- */
-int
-sbus_init(fm10k_t *fm10k)
-{
-    /* FIXME */
-    return 0;
-}
+    mgr = (manager_t *)arg;
+    switch ( cmd ) {
+    case FM10K_CTL_PING:
+        *rlen = 0;
+        return FM10K_CTL_OK;
+    case FM10K_CTL_READ32:
+    case FM10K_CTL_WRITE32:
+    case FM10K_CTL_READ64:
+    case FM10K_CTL_WRITE64:
+        if ( len != sizeof(reg) ) {
+            return FM10K_CTL_EINVAL;
+        }
+        memcpy(&reg, req, sizeof(reg));
+        wide = FM10K_CTL_READ64 == cmd || FM10K_CTL_WRITE64 == cmd;
+        if ( reg.offset & (wide ? 7 : 3)
+             || reg.offset > FM10K_BAR4_SIZE - (wide ? 8 : 4) ) {
+            return FM10K_CTL_EFAULT;
+        }
+        switch ( cmd ) {
+        case FM10K_CTL_READ32:
+            reg.value = rd32(mgr->fm10k->mmio, reg.offset);
+            break;
+        case FM10K_CTL_WRITE32:
+            wr32(mgr->fm10k->mmio, reg.offset, reg.value);
+            break;
+        case FM10K_CTL_READ64:
+            reg.value = rd64(mgr->fm10k->mmio, reg.offset);
+            break;
+        case FM10K_CTL_WRITE64:
+            wr64(mgr->fm10k->mmio, reg.offset, reg.value);
+            break;
+        }
+        memcpy(resp, &reg, sizeof(reg));
+        *rlen = sizeof(reg);
+        return FM10K_CTL_OK;
+    case FM10K_CTL_APPLY:
+        return ctl_apply(mgr, req, len, resp, rlen);
+    case FM10K_CTL_PORTS:
+        port = (fm10k_ctl_port_t *)resp;
+        for ( i = 0; i < mgr->link->n; i++ ) {
+            p = &mgr->link->ports[i];
+            memset(&port[i], 0, sizeof(fm10k_ctl_port_t));
+            port[i].logical = p->cfg->logical;
+            port[i].epl = p->cfg->epl;
+            port[i].lane = p->cfg->lane;
+            port[i].speed = p->cfg->speed;
+            port[i].up = p->published;
+            port[i].raw = p->raw;
+            port[i].suppressed = p->suppressed;
+            port[i].flaps = p->flaps;
+            port[i].link_counter = rd32(mgr->fm10k->mmio,
+                FM10K_MAC_LINK_COUNTER(p->cfg->epl, p->cfg->lane));
+            port[i].code_errors = rd32(mgr->fm10k->mmio,
+                FM10K_MAC_CODE_ERROR_COUNTER(p->cfg->epl, p->cfg->lane));
+        }
+        *rlen = sizeof(fm10k_ctl_port_t) * mgr->link->n;
+        return FM10K_CTL_OK;
+    case FM10K_CTL_PCIE:
+        pcie = (fm10k_ctl_pcie_t *)resp;
+        memset(pcie, 0, sizeof(fm10k_ctl_pcie_t));
+        pcie->up = mgr->pcie->link.up;
+        pcie->ltssm = mgr->pcie->link.ltssm;
+        pcie->speed = mgr->pcie->link.speed;
+        pcie->width = mgr->pcie->link.width;
+        pcie->max_speed = mgr->pcie->link.max_speed;
+        pcie->max_width = mgr->pcie->link.max_width;
+        pcie->mps = mgr->pcie->link.mps;
+        pcie->mbps = fm10k_pcie_bandwidth(&mgr->pcie->link) * 8 / 1e6;
+        *rlen = sizeof(fm10k_ctl_pcie_t);
+        return FM10K_CTL_OK;
+    case FM10K_CTL_VF_REASSIGN:
+        if ( len != sizeof(vf) ) {
+            return FM10K_CTL_EINVAL;
+        }
+        if ( 0 == mgr->nvfs ) {
+            return FM10K_CTL_EUNSUPP;
+        }
+        memcpy(&vf, req, sizeof(vf));
+        *rlen = 0;
+        return fm10k_vf_reassign(&mgr->vf, vf.mask) < 0
+            ? FM10K_CTL_EFAULT : FM10K_CTL_OK;
+    }
 
-/*
- * Initialize switch SerDes
- */
-int
-init_switch_serdes(fm10k_t *fm10k)
-{
-    /* FIXME */
-    return 0;
+    return FM10K_CTL_EUNSUPP;
 }
 
 /*
- * Boot switch
+ * Main routine
  */
 int
-boot_switch(fm10k_t *fm10k)
+main(int argc, char *const argv[])
 {
+    const char *prog;
+    const char *uiodev;
+    const char *confpath;
+    const char *profile;
+    const char *shadow;
+    const char *ctlpath;
+    int warm;
+    int dryrun;
+    int nvfs;
+    int opt;
+    manager_t mgr;
+    fm10k_ctl_t ctl;
+    fm10k_t fm10k;
+    fm10k_conf_t conf;
+    fm10k_link_cfg_t linkcfg;
+    fm10k_link_t link;
+    fm10k_pcie_mon_t pcie;
+    fm10k_ptp_cfg_t ptpcfg;
+    fm10k_ptp_t ptp;
+    fm10k_ptp_ts_t ts;
+    struct pollfd pfds[1 + 1 + FM10K_CTL_MAX_CLIENTS];
+    uint32_t info;
+    int npfds;
+    int timeout;
+    int anpending;
+    FILE *fp;
     int ret;
 
-    /* Reset the switch */
-    ret = reset_switch(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to reset the switch\n");
-        return -1;
+    prog = argv[0];
+    confpath = NULL;
+    profile = NULL;
+    shadow = NULL;
+    ctlpath = NULL;
+    warm = 0;
+    dryrun = 0;
+    nvfs = 0;
+    while ( (opt = getopt(argc, argv, "c:p:s:wnl:v:")) != -1 ) {
+        switch ( opt ) {
+        case 'c':
+            confpath = optarg;
+            break;
+        case 'p':
+            profile = optarg;
+            break;
+        case 's':
+            shadow = optarg;
+            break;
+        case 'w':
+            warm = 1;
+            break;
+        case 'n':
+            dryrun = 1;
+            break;
+        case 'l':
+            ctlpath = optarg;
+            break;
+        case 'v':
+            nvfs = atoi(optarg);
+            break;
+        default:
+            usage(prog);
+        }
     }
-
-    /* Configure clock via FABRIC_PLL */
-    ret = set_frame_handler_clock(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to set frame handler clock\n");
-        return -1;
+    if ( optind + 1 != argc || (dryrun && !warm) || nvfs < 0
+         || nvfs > FM10K_VF_MAX ) {
+        usage(prog);
     }
+    uiodev = argv[optind];
 
-    /* Release switch */
-    ret = release_switch(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to release switch\n");
-        return -1;
+    /* Open and memory map uio device */
+    if ( fm10k_open(&fm10k, uiodev) < 0 ) {
+        return EXIT_FAILURE;
     }
 
-    ret = serdes_init_op_mode(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to serdes\n");
-        return -1;
+    /* Switch configuration */
+    fm10k_conf_default(&conf);
+    if ( NULL != confpath ) {
+        fp = fopen(confpath, "r");
+        if ( NULL == fp ) {
+            perror(confpath);
+            return EXIT_FAILURE;
+        }
+        ret = fm10k_conf_load(fp, &conf);
+        fclose(fp);
+        if ( ret < 0 ) {
+            return EXIT_FAILURE;
+        }
+    } else if ( fm10k_port_validate(&conf.ports) < 0 ) {
+        return EXIT_FAILURE;
     }
 
-    ret = sbus_init(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to sbus\n");
-        return -1;
+    /* Performance profile */
+    if ( NULL != profile ) {
+        conf.profile = fm10k_clock_parse_profile(profile);
+        if ( conf.profile < 0 ) {
+            fprintf(stderr, "Unknown profile: %s\n", profile);
+            return EXIT_FAILURE;
+        }
     }
 
-    ret = init_switch_serdes(fm10k);
-    if ( ret < 0 ) {
-        fprintf(stderr, "Failed to switch serdes\n");
-        return -1;
+    /* Warm apply to a running switch */
+    memset(&mgr, 0, sizeof(mgr));
+    mgr.fm10k = &fm10k;
+    mgr.conf = &conf;
+    mgr.shadow_path = shadow;
+    fm10k_prog_init(&mgr.shadow);
+    ret = 1;
+    if ( warm ) {
+        ret = fm10k_warm_apply(&fm10k, &conf, shadow, dryrun, &mgr.shadow);
+        if ( ret < 0 ) {
+            return EXIT_FAILURE;
+        }
+        if ( dryrun ) {
+            return EXIT_SUCCESS;
+        }
     }
 
-    /* Disable scan */
-
-    return 0;
-}
+    if ( ret > 0 ) {
+        /* The reset loses the state of the shadow */
+        fm10k_prog_free(&mgr.shadow);
+        if ( NULL != shadow ) {
+            (void)unlink(shadow);
+        }
 
-/*
- * Initialize switch manager control
- */
-int
-init_switch_manager(fm10k_t *fm10k)
-{
-    uint32_t m32;
-    uint64_t m64;
-    int i;
+        /* Boot switch */
+        if ( fm10k_boot_switch(&fm10k, &conf.ports, conf.profile) < 0 ) {
+            fprintf(stderr, "Failed to boot the switch\n");
+            return EXIT_FAILURE;
+        }
 
-    /* De-assert SWITCH_RESET */
-    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
-    m32 &= ~(1UL << 2);
-    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
-
-    /* Disable switch scan */
-    m32 = (1UL << 27) | (1UL << 30);
-    wr32(fm10k->mmio, FM10K_SCAN_DATA_IN, m32);
-
-    /* Disable switch loopbacks */
-    m32 = rd32(fm10k->mmio, FM10K_PCIE_CTRL_EXT);
-    m32 &= ~(1UL << 2);
-    wr32(fm10k->mmio, FM10K_PCIE_CTRL_EXT, m32);
-    /* Set EPL_CFG_A.Active = 0xf */
-    for ( i = 0; i <= 8; i++ ) {
-        m32 = rd32(fm10k->mmio, FM10K_EPL_CFG_A(i));
-        m32 |= (0xf << 7);
-        wr32(fm10k->mmio, FM10K_EPL_CFG_A(i), m32);
-    }
-    /* Set TE_CFG.SwitchLoopbackDisable = 1 */
-    for ( i = 0; i < 2; i++ ) {
-        m64 = rd64(fm10k->mmio, FM10K_TE_CFG(i));
-        m64 |= (1 << 25);
-        wr64(fm10k->mmio, FM10K_TE_CFG(i), m64);
+        /* Apply the configuration program; it becomes the shadow */
+        printf("Initializing switch manager control\n");
+        if ( fm10k_boot_manager(&fm10k, &conf, &mgr.shadow, shadow,
+                                nvfs, &mgr.an, &mgr.glort, &mgr.vf) < 0 ) {
+            fprintf(stderr, "Failed to initialize the switch manager\n");
+            return EXIT_FAILURE;
+        }
+        mgr.nvfs = nvfs;
     }
 
-    /* Initialize the switch functions */
-    //m32 = rd32(fm10k->mmio, FM10K_CM_GLOBAL_CFG);
-    //m32 |= (0x1 << 10) | (0x1 << 11) | (0x1 << 12) | (0x4 << 13);
-    //wr32(fm10k->mmio, FM10K_CM_GLOBAL_CFG, m32);
-
-    /* Initialize scheduler */
-    init_scheduler(fm10k);
-
-    /* Start LED cntroller */
-    m32 = rd32(fm10k->mmio, FM10K_LED_CFG);
-    m32 |= (1 << 24);
-    wr32(fm10k->mmio, FM10K_LED_CFG, m32);
-
-    /* Initialize IEEE 1588 system time */
-
-    /* Assert SWITCH_READY */
-    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
-    m32 |= (1UL << 3);
-    wr32(fm10k->mmio, FM10K_SOFT_RESET, m32);
-
-    /* Enable auto-negotiation */
-    wr32(fm10k->mmio, FM10K_AN_73_CFG(1, 0), 1);
-    wr32(fm10k->mmio, FM10K_AN_73_CFG(6, 0), 1);
-
-    /* Enable LTSSM */
-    m32 = rd32(fm10k->mmio, FM10K_PCIE_CTRL);
-    m32 |= 1;
-    wr32(fm10k->mmio, FM10K_PCIE_CTRL, m32);
-
-
-    return 0;
-}
-
-
-/*
- * Main routine
- */
-int
-main(int argc, const char *const argv[])
-{
-    int fd;
-    const char *prog;
-    const char *uiodev;
-    long pagesize;
-    void *ptr;
-    size_t size;
-    fm10k_t fm10k;
-    int i;
-
-    prog = argv[0];
-    if ( argc < 2 ) {
-        usage(prog);
+    /* Host link monitor */
+    fm10k_pcie_mon_init(&pcie, &fm10k, 0, 0, pcie_notify, NULL);
+    fm10k_pcie_mon_sample(&pcie);
+    fm10k_pcie_mon_print(stdout, &pcie);
+
+    /* Link state damping; the LAGs start without members until their
+       links come up */
+    mgr.link = &link;
+    mgr.pcie = &pcie;
+    fm10k_link_default_cfg(&linkcfg);
+    if ( fm10k_link_init(&link, &fm10k, &conf.ports, &linkcfg, link_notify,
+                         &mgr) < 0 || lag_sync(&mgr) < 0 ) {
+        fprintf(stderr, "Failed to initialize the link state damping\n");
+        return EXIT_FAILURE;
     }
-    uiodev = argv[1];
 
-    /* Open and memory map uio device */
-    fd = open (uiodev, O_RDWR);
-    if ( fd < 0 ) {
-        perror(uiodev);
+    /* Timestamp capture, with the switch clock disciplined to the host */
+    fm10k_ptp_default_cfg(&ptpcfg);
+    if ( fm10k_ptp_open(&ptp, &fm10k, &conf.ports, &ptpcfg) < 0
+         || fm10k_ptp_start(&ptp) < 0 ) {
+        fprintf(stderr, "Failed to start the PTP timestamp capture\n");
         return EXIT_FAILURE;
     }
-    pagesize = sysconf(_SC_PAGESIZE);
-    size = (FM10K_BAR4_SIZE + pagesize - 1) / pagesize * pagesize;
-    ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-
-    /* Set them to the FM10K management structure */
-    fm10k.fd = fd;
-    fm10k.mmio = ptr;
-
-    /* Boot switch */
-    boot_switch(&fm10k);
-
-    /* Initialize scheduler */
-    printf("Initializing switch manager control\n");
-    //init_switch_manager(&fm10k);
-
-    /* Testing */
-    printf("SOFT_RESET: %x\n", rd32(fm10k.mmio, FM10K_SOFT_RESET));
-    for ( i = 0; i < 9; i++ ) {
-        printf("PORT_STATUS[%d][%d]: %06x, ", i, 0,
-               rd32(fm10k.mmio, FM10K_PORT_STATUS(i, 0)));
-        printf("LED[%d] %05x, ", i, rd32(fm10k.mmio, FM10K_EPL_LED_STATUS(i)));
-        printf("CFG_A[%d] %05x, ", i, rd32(fm10k.mmio, FM10K_EPL_CFG_A(i)));
-        printf("CFG_B[%d] %05x\n", i, rd32(fm10k.mmio, FM10K_EPL_CFG_B(i)));
+
+    /* Control socket */
+    if ( NULL != ctlpath
+         && fm10k_ctl_open(&ctl, ctlpath, ctl_handler, &mgr) < 0 ) {
+        return EXIT_FAILURE;
     }
-    printf("PCIE_PORTLOGIC: %x\n", rd32(fm10k.mmio, FM10K_PCIE_PORTLOGIC));
-    printf("DEVICE_CFG: %x\n", rd32(fm10k.mmio, FM10K_DEVICE_CFG));
-    printf("AN_37_CFG: %x\n", rd32(fm10k.mmio, FM10K_AN_37_CFG(1, 0)));
-    printf("AN_73_CFG: %x\n", rd32(fm10k.mmio, FM10K_AN_73_CFG(1, 0)));
-    printf("PCIE_IP: %x\n", rd32(fm10k.mmio, FM10K_PCIE_IP));
-    printf("PCIE_IM: %x\n", rd32(fm10k.mmio, FM10K_PCIE_IM));
-    printf("GLOBAL_INTERRUPT_DETECT: %x\n",
-           rd32(fm10k.mmio, FM10K_GLOBAL_INTERRUPT_DETECT));
-    printf("CORE_INTERRUPT_DETECT: %x\n",
-           rd32(fm10k.mmio, FM10K_CORE_INTERRUPT_DETECT));
-    printf("CORE_INTERRUPT_MASK: %x\n",
-           rd32(fm10k.mmio, FM10K_CORE_INTERRUPT_MASK));
-    printf("CM_GLOBAL_CFG: %x\n", rd32(fm10k.mmio, FM10K_CM_GLOBAL_CFG));
-    printf("LED_CFG: %x\n", rd32(fm10k.mmio, FM10K_LED_CFG));
-
-#if 1
-    uint32_t info;
-    ssize_t nr;
+
+    anpending = mgr.an.n;
     while ( 1 ) {
         /* Enable IRQ */
-        info = 1;
-        write(fd, &info, sizeof(info));
-        /* Read interrupt */
-        nr = read(fd, &info, sizeof(info));
-        printf("RD: %lu %u\n", nr, info);
+        (void)fm10k_irq_enable(&fm10k);
+        /* Wait for an interrupt, the next link damping timer or the next
+           host link sample */
+        timeout = fm10k_link_poll(&link);
+        if ( timeout < 0 || timeout > PCIE_MON_INTERVAL ) {
+            timeout = PCIE_MON_INTERVAL;
+        }
+        /* Timestamps captured since the last pass */
+        while ( fm10k_ptp_next(&ptp, &ts) == 0 ) {
+            printf("Port %d: %s timestamp %llu ns\n", ts.port,
+                   FM10K_PTP_INGRESS == ts.dir ? "ingress" : "egress",
+                   (unsigned long long)ts.ns);
+        }
+        /* Service the function level resets of the guests */
+        if ( mgr.nvfs > 0 ) {
+            if ( fm10k_vf_poll(&mgr.vf) < 0 ) {
+                fprintf(stderr, "Failed to reset the VFs\n");
+            }
+            if ( timeout > VF_FLR_INTERVAL ) {
+                timeout = VF_FLR_INTERVAL;
+            }
+        }
+        /* Step the negotiations until every port is up or failed */
+        if ( anpending > 0 ) {
+            anpending = fm10k_an_poll(&mgr.an);
+            if ( anpending > 0 ) {
+                timeout = AN_POLL_INTERVAL;
+            } else {
+                fm10k_an_print(stdout, &mgr.an);
+            }
+        }
+        fm10k_pcie_mon_sample(&pcie);
+        pfds[0].fd = fm10k.fd;
+        pfds[0].events = POLLIN;
+        pfds[0].revents = 0;
+        npfds = 1;
+        if ( NULL != ctlpath ) {
+            npfds += fm10k_ctl_pollfds(&ctl, pfds + 1,
+                                       1 + FM10K_CTL_MAX_CLIENTS);
+        }
+        if ( poll(pfds, npfds, timeout) > 0 ) {
+            if ( pfds[0].revents ) {
+                /* Acknowledge the interrupt; the state is polled above */
+                (void)fm10k_irq_read(&fm10k, &info);
+            }
+            /* Control requests */
+            if ( NULL != ctlpath ) {
+                fm10k_ctl_process(&ctl, pfds + 1, npfds - 1);
+            }
+        }
     }
-#endif
 
     /* Unmap and close */
-    (void)munmap(ptr, size);
-    (void)close(fd);
+    fm10k_ptp_close(&ptp);
+    fm10k_close(&fm10k);
 
     return 0;
 }
@@ -0,0 +1,201 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "mod.h"
+#include <stdio.h>
+#include <string.h>
+
+/* Index of 2 * FM10K_MOD_ENTRIES slots */
+#define HASH_BITS   13
+#define HASH_SIZE   (1 << HASH_BITS)
+
+/* Deleted index slots that trigger a rebuild of the index */
+#define MAX_TOMBS   (HASH_SIZE / 4)
+
+/*
+ * Hash of a packed rewrite: the high bits of a multiplicative hash, which
+ * depend on all the fields
+ */
+static int
+_hash(uint32_t v)
+{
+    return (uint32_t)(v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/*
+ * Pack a rewrite into the MOD_DATA layout
+ */
+uint32_t
+fm10k_mod_pack(const fm10k_mod_rewrite_t *rw)
+{
+    uint32_t m32;
+
+    /* VID | VPRI | DSCP | SetVID | SetVPRI | SetDSCP | StripVLAN */
+    m32 = 0;
+    if ( rw->flags & FM10K_MOD_SET_VID ) {
+        m32 |= (rw->vid & 0xfff) | (1 << 21);
+    }
+    if ( rw->flags & FM10K_MOD_SET_VPRI ) {
+        m32 |= ((rw->vpri & 0x7) << 12) | (1 << 22);
+    }
+    if ( rw->flags & FM10K_MOD_SET_DSCP ) {
+        m32 |= ((rw->dscp & 0x3f) << 15) | (1 << 23);
+    }
+    if ( rw->flags & FM10K_MOD_STRIP_VLAN ) {
+        m32 |= (1 << 24);
+    }
+
+    return m32;
+}
+
+/*
+ * Rebuild the index from the entries in use, dropping the deleted slots
+ * that lengthen the probes
+ */
+static void
+_rehash(fm10k_mod_t *mod)
+{
+    int slot;
+    int i;
+
+    memset(mod->hash, 0, sizeof(mod->hash));
+    mod->ntombs = 0;
+    for ( i = 0; i < FM10K_MOD_ENTRIES; i++ ) {
+        if ( mod->refcnt[i] <= 0 ) {
+            continue;
+        }
+        slot = _hash(mod->data[i]);
+        while ( 0 != mod->hash[slot] ) {
+            slot = (slot + 1) % HASH_SIZE;
+        }
+        mod->hash[slot] = i + 1;
+    }
+}
+
+/*
+ * Initialize the modification table
+ */
+int
+fm10k_mod_init(fm10k_mod_t *mod, fm10k_t *fm10k)
+{
+    memset(mod, 0, sizeof(fm10k_mod_t));
+    mod->fm10k = fm10k;
+
+    return 0;
+}
+
+/*
+ * Get a reference to the entry holding a rewrite; identical rewrites share
+ * one entry, and MOD_DATA is only written when a new entry is created.
+ */
+int
+fm10k_mod_get(fm10k_mod_t *mod, const fm10k_mod_rewrite_t *rw)
+{
+    uint32_t v;
+    int slot;
+    int tomb;
+    int i;
+    int n;
+
+    v = fm10k_mod_pack(rw);
+    tomb = -1;
+    slot = _hash(v);
+    for ( n = 0; n < HASH_SIZE; n++, slot = (slot + 1) % HASH_SIZE ) {
+        if ( 0 == mod->hash[slot] ) {
+            break;
+        }
+        if ( mod->hash[slot] < 0 ) {
+            if ( tomb < 0 ) {
+                tomb = slot;
+            }
+            continue;
+        }
+        i = mod->hash[slot] - 1;
+        if ( mod->data[i] == v ) {
+            mod->refcnt[i]++;
+            return i;
+        }
+    }
+
+    /* New entry */
+    i = 0;
+    while ( i < FM10K_MOD_ENTRIES && mod->refcnt[i] ) {
+        i++;
+    }
+    if ( i == FM10K_MOD_ENTRIES || (tomb < 0 && n == HASH_SIZE) ) {
+        fprintf(stderr, "Modification table full\n");
+        return -1;
+    }
+    if ( tomb >= 0 ) {
+        slot = tomb;
+        mod->ntombs--;
+    }
+    mod->data[i] = v;
+    mod->refcnt[i] = 1;
+    mod->hash[slot] = i + 1;
+    wr64(mod->fm10k->mmio, FM10K_MOD_DATA(i), v);
+
+    return i;
+}
+
+/*
+ * Release a reference to an entry
+ */
+int
+fm10k_mod_put(fm10k_mod_t *mod, int i)
+{
+    int slot;
+    int n;
+
+    if ( i < 0 || i >= FM10K_MOD_ENTRIES || mod->refcnt[i] <= 0 ) {
+        return -1;
+    }
+    if ( --mod->refcnt[i] > 0 ) {
+        return 0;
+    }
+
+    /* Unlink from the index; the stale MOD_DATA is no longer referenced */
+    slot = _hash(mod->data[i]);
+    for ( n = 0; n < HASH_SIZE; n++, slot = (slot + 1) % HASH_SIZE ) {
+        if ( mod->hash[slot] == i + 1 ) {
+            mod->hash[slot] = -1;
+            mod->ntombs++;
+            break;
+        }
+    }
+    if ( mod->ntombs > MAX_TOMBS ) {
+        _rehash(mod);
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,84 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _MOD_H
+#define _MOD_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+#define FM10K_MOD_ENTRIES       4096
+
+/* Rewrite flags */
+#define FM10K_MOD_SET_VID       (1 << 0)
+#define FM10K_MOD_SET_VPRI      (1 << 1)
+#define FM10K_MOD_SET_DSCP      (1 << 2)
+#define FM10K_MOD_STRIP_VLAN    (1 << 3)
+
+/*
+ * VLAN/DSCP rewrite
+ */
+typedef struct _fm10k_mod_rewrite {
+    uint32_t flags;
+    uint16_t vid;
+    uint8_t vpri;
+    uint8_t dscp;
+} fm10k_mod_rewrite_t;
+
+/*
+ * Modification table with shared (reference counted) entries
+ */
+typedef struct _fm10k_mod {
+    fm10k_t *fm10k;
+    /* MOD_DATA shadow and users of each entry */
+    uint32_t data[FM10K_MOD_ENTRIES];
+    int refcnt[FM10K_MOD_ENTRIES];
+    /* Open-addressing index: entry + 1, 0 empty, -1 deleted */
+    int16_t hash[2 * FM10K_MOD_ENTRIES];
+    int ntombs;
+} fm10k_mod_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t fm10k_mod_pack(const fm10k_mod_rewrite_t *);
+int fm10k_mod_init(fm10k_mod_t *, fm10k_t *);
+int fm10k_mod_get(fm10k_mod_t *, const fm10k_mod_rewrite_t *);
+int fm10k_mod_put(fm10k_mod_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MOD_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,708 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "model.h"
+#include "sim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* SOFT_RESET lock owners */
+#define LOCK_FREE       0
+#define LOCK_NVM        1
+#define LOCK_API        2
+
+/* SOFT_RESET.SwitchReset */
+#define SWITCH_RESET    (1 << 2)
+
+/* BIST_CTRL run bit of the first memory group */
+#define BIST_RUN_SHIFT  9
+
+/* Model receiving the accesses to its BAR; one at a time */
+static fm10k_model_t *_active;
+
+static const int _capacity[FM10K_MODEL_FREELISTS] = { 1024, 24576, 24576 };
+static const char *_flname[FM10K_MODEL_FREELISTS] = { "rxq", "txq",
+                                                      "segment" };
+
+static const struct {
+    const char *name;
+    int fault;
+} _faults[] = {
+    { "lock-stuck", FM10K_MODEL_LOCK_STUCK },
+    { "lock-steal", FM10K_MODEL_LOCK_STEAL },
+    { "pll-fabric", FM10K_MODEL_PLL_FABRIC },
+    { "pll-epl", FM10K_MODEL_PLL_EPL },
+    { "bist-hang", FM10K_MODEL_BIST_HANG },
+};
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Plain memory accesses to the simulated BAR
+ */
+static uint32_t
+_raw_rd32(void *mmio, long offset)
+{
+    return *((volatile uint32_t *)(mmio + offset));
+}
+static void
+_raw_wr32(void *mmio, long offset, uint32_t val)
+{
+    *((volatile uint32_t *)(mmio + offset)) = val;
+}
+
+/*
+ * Default configuration: latencies below the waits of the boot sequence
+ */
+void
+fm10k_model_default_cfg(fm10k_model_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(fm10k_model_cfg_t));
+    cfg->nvm_version = FM10K_SIM_NVM_VER;
+    cfg->nvm_hold_ns = 0;
+    cfg->lock_ns = 1000;
+    cfg->pll_lock_ns = 200000;
+    cfg->bist_ns = 500000;
+    cfg->systime_hz = 250000000ULL;
+}
+
+/*
+ * Parse a comma-separated list of faults
+ */
+static int
+_parse_faults(const char *s)
+{
+    size_t len;
+    int faults;
+    int i;
+
+    faults = 0;
+    while ( '\0' != *s ) {
+        len = strcspn(s, ",");
+        for ( i = 0; i < (int)(sizeof(_faults) / sizeof(_faults[0])); i++ ) {
+            if ( strlen(_faults[i].name) == len
+                 && strncmp(s, _faults[i].name, len) == 0 ) {
+                faults |= _faults[i].fault;
+                break;
+            }
+        }
+        if ( i == (int)(sizeof(_faults) / sizeof(_faults[0])) ) {
+            return -1;
+        }
+        s += len;
+        if ( ',' == *s ) {
+            s++;
+        }
+    }
+
+    return faults;
+}
+
+/*
+ * Set a configuration item given as key=value (latencies in ns, faults as
+ * a comma-separated list)
+ */
+int
+fm10k_model_set(fm10k_model_cfg_t *cfg, const char *item)
+{
+    const char *val;
+    unsigned long long v;
+    char *end;
+    size_t len;
+    int faults;
+
+    val = strchr(item, '=');
+    if ( NULL == val ) {
+        fprintf(stderr, "Model: invalid item %s\n", item);
+        return -1;
+    }
+    len = val - item;
+    val++;
+    if ( strncmp(item, "faults", len) == 0 && len == 6 ) {
+        faults = _parse_faults(val);
+        if ( faults < 0 ) {
+            fprintf(stderr, "Model: unknown fault in %s\n", val);
+            return -1;
+        }
+        cfg->faults = faults;
+        return 0;
+    }
+    v = strtoull(val, &end, 0);
+    if ( '\0' == *val || '\0' != *end ) {
+        fprintf(stderr, "Model: invalid value %s\n", item);
+        return -1;
+    }
+    if ( strncmp(item, "nvm_version", len) == 0 && len == 11 ) {
+        cfg->nvm_version = v;
+    } else if ( strncmp(item, "nvm_hold_ns", len) == 0 && len == 11 ) {
+        cfg->nvm_hold_ns = v;
+    } else if ( strncmp(item, "lock_ns", len) == 0 && len == 7 ) {
+        cfg->lock_ns = v;
+    } else if ( strncmp(item, "pll_lock_ns", len) == 0 && len == 11 ) {
+        cfg->pll_lock_ns = v;
+    } else if ( strncmp(item, "bist_ns", len) == 0 && len == 7 ) {
+        cfg->bist_ns = v;
+    } else if ( strncmp(item, "steals", len) == 0 && len == 6 ) {
+        cfg->steals = v;
+    } else if ( strncmp(item, "systime_hz", len) == 0 && len == 10 ) {
+        cfg->systime_hz = v;
+    } else {
+        fprintf(stderr, "Model: unknown item %s\n", item);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Empty the free lists, as a switch reset or a memory BIST does
+ */
+static void
+_clear_freelists(fm10k_model_t *m)
+{
+    fm10k_model_freelist_t *fl;
+    int i;
+
+    for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+        fl = &m->fl[i];
+        memset(fl->used, 0, sizeof(uint64_t) * (fl->capacity + 63) / 64);
+        fl->preset = 0;
+        fl->pushes = 0;
+        fl->duplicates = 0;
+        fl->out_of_range = 0;
+        fl->dropped = 0;
+    }
+}
+
+/*
+ * Open a simulated BAR4 driven by the model
+ */
+int
+fm10k_model_open(fm10k_model_t *m, fm10k_t *fm10k,
+                 const fm10k_model_cfg_t *cfg)
+{
+    int i;
+
+    if ( NULL != _active ) {
+        fprintf(stderr, "Model: another model is open\n");
+        return -1;
+    }
+    memset(m, 0, sizeof(fm10k_model_t));
+    m->cfg = *cfg;
+    for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+        m->fl[i].capacity = _capacity[i];
+        m->fl[i].used = calloc((_capacity[i] + 63) / 64, sizeof(uint64_t));
+        if ( NULL == m->fl[i].used ) {
+            while ( i-- > 0 ) {
+                free(m->fl[i].used);
+            }
+            return -1;
+        }
+    }
+    if ( fm10k_sim_open(fm10k) < 0 ) {
+        for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+            free(m->fl[i].used);
+        }
+        return -1;
+    }
+    m->fm10k = fm10k;
+    fm10k_model_reset(m);
+
+    return 0;
+}
+
+/*
+ * Close the model and its BAR
+ */
+void
+fm10k_model_close(fm10k_model_t *m)
+{
+    int i;
+
+    _active = NULL;
+    fm10k_close(m->fm10k);
+    for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+        free(m->fl[i].used);
+    }
+}
+
+/*
+ * Power-on reset: the registers, the NVM lock hold, the PLLs and the
+ * counters
+ */
+void
+fm10k_model_reset(fm10k_model_t *m)
+{
+    int i;
+
+    /* The preset values are not accesses of the software */
+    _active = NULL;
+    fm10k_sim_reset(m->fm10k);
+    _raw_wr32(m->fm10k->mmio, FM10K_BSM_SCRATCH(401), m->cfg.nvm_version);
+    _active = m;
+
+    if ( m->cfg.nvm_hold_ns || (m->cfg.faults & FM10K_MODEL_LOCK_STUCK) ) {
+        m->owner = LOCK_NVM;
+    } else {
+        m->owner = LOCK_FREE;
+    }
+    m->pending = -1;
+    m->nvm_until = _now() + m->cfg.nvm_hold_ns;
+    m->steals = m->cfg.steals;
+    m->lock_takes = 0;
+    m->lock_stolen = 0;
+    m->lock_violations = 0;
+    for ( i = 0; i < 2; i++ ) {
+        m->pll_at[i] = 0;
+        m->pll_relocks[i] = 0;
+    }
+    for ( i = 0; i < FM10K_MODEL_BISTS; i++ ) {
+        m->bist_at[i] = 0;
+    }
+    m->bist_done = 0;
+    m->bist_aborted = 0;
+    m->systime = 0;
+    m->systime_frac = 0;
+    m->systime_at = _now();
+    _clear_freelists(m);
+}
+
+/*
+ * Advance the lock to the current time
+ */
+static void
+_lock_update(fm10k_model_t *m, uint64_t now)
+{
+    if ( m->pending >= 0 && now >= m->pending_at ) {
+        m->owner = m->pending;
+        m->pending = -1;
+    }
+    if ( LOCK_NVM == m->owner && now >= m->nvm_until
+         && !(m->cfg.faults & FM10K_MODEL_LOCK_STUCK) ) {
+        m->owner = LOCK_FREE;
+    }
+}
+
+/*
+ * Software write of the lock owner
+ */
+static void
+_lock_write(fm10k_model_t *m, uint64_t now, int owner)
+{
+    _lock_update(m, now);
+    switch ( owner ) {
+    case LOCK_API:
+        if ( LOCK_API == m->owner && m->pending < 0 ) {
+            /* Already held */
+            break;
+        }
+        if ( LOCK_FREE != m->owner || m->pending >= 0 ) {
+            m->lock_violations++;
+            break;
+        }
+        m->lock_takes++;
+        if ( (m->cfg.faults & FM10K_MODEL_LOCK_STEAL) && m->steals > 0 ) {
+            /* The NVM took it first */
+            m->steals--;
+            m->lock_stolen++;
+            m->owner = LOCK_NVM;
+            m->nvm_until = now + m->cfg.nvm_hold_ns;
+            break;
+        }
+        m->pending = LOCK_API;
+        m->pending_at = now + m->cfg.lock_ns;
+        break;
+    case LOCK_FREE:
+        if ( LOCK_API == m->owner && m->pending < 0 ) {
+            m->pending = LOCK_FREE;
+            m->pending_at = now + m->cfg.lock_ns;
+        } else if ( LOCK_FREE != m->owner ) {
+            m->lock_violations++;
+        }
+        break;
+    default:
+        /* Only the NVM takes the lock as the NVM */
+        m->lock_violations++;
+    }
+}
+
+/*
+ * Whether a PLL (0: fabric, 1: EPL) is locked
+ */
+static int
+_pll_locked(fm10k_model_t *m, uint64_t now, int pll)
+{
+    if ( m->cfg.faults & (pll ? FM10K_MODEL_PLL_EPL
+                          : FM10K_MODEL_PLL_FABRIC) ) {
+        return 0;
+    }
+
+    return now >= m->pll_at[pll];
+}
+
+/*
+ * Drop a PLL lock; it comes back after the lock time
+ */
+static void
+_pll_relock(fm10k_model_t *m, uint64_t now, int pll)
+{
+    m->pll_at[pll] = now + m->cfg.pll_lock_ns;
+    m->pll_relocks[pll]++;
+}
+
+/*
+ * Start and stop the memory BISTs on the BIST_CTRL run bits.  Stopping a
+ * BIST before it completed leaves the memories as they were.
+ */
+static void
+_bist_write(fm10k_model_t *m, uint64_t now, uint32_t old, uint32_t val)
+{
+    uint32_t bit;
+    int i;
+
+    for ( i = 0; i < FM10K_MODEL_BISTS; i++ ) {
+        bit = 1U << (BIST_RUN_SHIFT + i);
+        if ( !(old & bit) && (val & bit) ) {
+            m->bist_at[i] = now;
+        } else if ( (old & bit) && !(val & bit) && m->bist_at[i] ) {
+            if ( (m->cfg.faults & FM10K_MODEL_BIST_HANG)
+                 || now - m->bist_at[i] < m->cfg.bist_ns ) {
+                m->bist_aborted++;
+            } else {
+                m->bist_done++;
+                if ( FM10K_MODEL_BIST_SWITCH == i ) {
+                    _clear_freelists(m);
+                }
+            }
+            m->bist_at[i] = 0;
+        }
+    }
+}
+
+/*
+ * Hand out a free list entry, either through a head pointer or a push
+ */
+static void
+_claim(fm10k_model_t *m, int list, uint32_t entry, int push)
+{
+    fm10k_model_freelist_t *fl;
+
+    fl = &m->fl[list];
+    if ( _raw_rd32(m->fm10k->mmio, FM10K_SOFT_RESET) & SWITCH_RESET ) {
+        /* The scheduler ignores writes while in reset */
+        fl->dropped++;
+        return;
+    }
+    if ( push ) {
+        fl->pushes++;
+    } else {
+        fl->preset++;
+    }
+    if ( entry >= (uint32_t)fl->capacity ) {
+        fl->out_of_range++;
+        return;
+    }
+    if ( fl->used[entry / 64] & (1ULL << (entry % 64)) ) {
+        fl->duplicates++;
+        return;
+    }
+    fl->used[entry / 64] |= 1ULL << (entry % 64);
+}
+
+/*
+ * Free list side effects of scheduler register writes
+ */
+static void
+_sched_write(fm10k_model_t *m, long offset, uint32_t val)
+{
+    if ( FM10K_SCHED_RXQ_FREELIST_INIT == offset ) {
+        _claim(m, FM10K_MODEL_RXQ, val, 1);
+    } else if ( FM10K_SCHED_TXQ_FREELIST_INIT == offset ) {
+        _claim(m, FM10K_MODEL_TXQ, val, 1);
+    } else if ( FM10K_SCHED_FREELIST_INIT == offset ) {
+        _claim(m, FM10K_MODEL_SEGMENT, val, 1);
+    } else if ( offset >= FM10K_SCHED_RXQ_STORAGE_POINTERS(0)
+                && offset < FM10K_SCHED_RXQ_STORAGE_POINTERS(8)
+                && 0 == (offset - FM10K_SCHED_RXQ_STORAGE_POINTERS(0)) % 8 ) {
+        /* HeadPage of the lower word */
+        _claim(m, FM10K_MODEL_RXQ, val & 0x3ff, 0);
+    } else if ( offset >= FM10K_SCHED_TXQ_HEAD_PERQ(0)
+                && offset < FM10K_SCHED_TXQ_HEAD_PERQ(384) ) {
+        _claim(m, FM10K_MODEL_TXQ, val, 0);
+    } else if ( offset >= FM10K_SCHED_SSCHED_RX_PERPORT(0)
+                && offset < FM10K_SCHED_SSCHED_RX_PERPORT(48) ) {
+        _claim(m, FM10K_MODEL_SEGMENT, val, 0);
+    }
+}
+
+/*
+ * Advance SYSTIME to the current time: SYSTIME_INC per reference clock
+ * cycle while enabled
+ */
+static void
+_systime_update(fm10k_model_t *m, uint64_t now)
+{
+    unsigned __int128 fx;
+    uint64_t inc;
+
+    if ( _raw_rd32(m->fm10k->mmio, FM10K_SYSTIME_CFG) & 1 ) {
+        inc = _raw_rd32(m->fm10k->mmio, FM10K_SYSTIME_INC)
+            | (uint64_t)(_raw_rd32(m->fm10k->mmio, FM10K_SYSTIME_INC + 4)
+                         & 0xff) << 32;
+        fx = ((unsigned __int128)m->systime << 32) | m->systime_frac;
+        fx += (unsigned __int128)(now - m->systime_at) * m->cfg.systime_hz
+            * inc / 1000000000ULL;
+        m->systime = (uint64_t)(fx >> 32);
+        m->systime_frac = (uint32_t)fx;
+    }
+    m->systime_at = now;
+}
+
+/*
+ * SYSTIME_CFG write: load or adjust, then keep only Enable
+ */
+static uint32_t
+_systime_cfg(fm10k_model_t *m, uint64_t now, uint32_t val)
+{
+    uint64_t v;
+
+    _systime_update(m, now);
+    v = _raw_rd32(m->fm10k->mmio, FM10K_SYSTIME0)
+        | (uint64_t)_raw_rd32(m->fm10k->mmio, FM10K_SYSTIME0 + 4) << 32;
+    if ( val & 2 ) {
+        m->systime = v;
+        m->systime_frac = 0;
+    } else if ( val & 4 ) {
+        m->systime += v;
+    }
+
+    return val & 1;
+}
+
+/*
+ * Register read seen by the software
+ */
+static uint32_t
+_read(fm10k_model_t *m, long offset)
+{
+    uint32_t m32;
+    uint64_t now;
+
+    m32 = _raw_rd32(m->fm10k->mmio, offset);
+    switch ( offset ) {
+    case FM10K_BSM_SCRATCH(2):
+        now = _now();
+        _lock_update(m, now);
+        m32 = (m32 & ~3UL) | m->owner;
+        break;
+    case FM10K_PLL_FABRIC_STAT:
+        m32 = (m32 & ~1UL) | _pll_locked(m, _now(), 0);
+        break;
+    case FM10K_PLL_EPL_STAT:
+        m32 = (m32 & ~1UL) | _pll_locked(m, _now(), 1);
+        break;
+    case FM10K_SYSTIME:
+        /* The upper half is latched for the read that follows */
+        _systime_update(m, _now());
+        m32 = (uint32_t)m->systime;
+        _raw_wr32(m->fm10k->mmio, FM10K_SYSTIME + 4,
+                  (uint32_t)(m->systime >> 32));
+        break;
+    default:
+        ;
+    }
+
+    return m32;
+}
+
+/*
+ * Register write by the software
+ */
+static void
+_write(fm10k_model_t *m, long offset, uint32_t val)
+{
+    uint32_t old;
+    uint64_t now;
+
+    old = _raw_rd32(m->fm10k->mmio, offset);
+    now = _now();
+    switch ( offset ) {
+    case FM10K_BSM_SCRATCH(2):
+        _lock_write(m, now, val & 3);
+        break;
+    case FM10K_SOFT_RESET:
+        _lock_update(m, now);
+        if ( LOCK_API != m->owner ) {
+            m->lock_violations++;
+        }
+        if ( !(old & SWITCH_RESET) && (val & SWITCH_RESET) ) {
+            /* The switch memories are lost */
+            _clear_freelists(m);
+        }
+        break;
+    case FM10K_PLL_FABRIC_CTRL:
+        if ( val != old ) {
+            _pll_relock(m, now, 0);
+        }
+        break;
+    case FM10K_PLL_FABRIC_LOCK:
+        if ( (val ^ old) & 0xf0 ) {
+            /* FreqSel */
+            _pll_relock(m, now, 0);
+        }
+        break;
+    case FM10K_PLL_EPL_CTRL:
+        if ( val != old ) {
+            _pll_relock(m, now, 1);
+        }
+        break;
+    case FM10K_PLL_EPL_STAT:
+        if ( val & (1 << 6) ) {
+            /* Apply OutDiv */
+            _pll_relock(m, now, 1);
+        }
+        break;
+    case FM10K_BIST_CTRL:
+        _bist_write(m, now, old, val);
+        break;
+    case FM10K_SYSTIME_INC:
+    case FM10K_SYSTIME_INC + 4:
+        /* The time so far runs at the old increment */
+        _systime_update(m, now);
+        break;
+    case FM10K_SYSTIME_CFG:
+        val = _systime_cfg(m, now, val);
+        break;
+    default:
+        if ( offset >= FM10K_SCHED(0) ) {
+            _sched_write(m, offset, val);
+        }
+    }
+    _raw_wr32(m->fm10k->mmio, offset, val);
+}
+
+/*
+ * Register accesses; those to other mappings than the model's BAR are
+ * plain memory accesses
+ */
+uint32_t
+fm10k_model_rd32(void *mmio, long offset)
+{
+    if ( NULL == _active || mmio != _active->fm10k->mmio ) {
+        return _raw_rd32(mmio, offset);
+    }
+
+    return _read(_active, offset);
+}
+uint64_t
+fm10k_model_rd64(void *mmio, long offset)
+{
+    uint64_t lo;
+
+    lo = fm10k_model_rd32(mmio, offset);
+
+    return lo | ((uint64_t)fm10k_model_rd32(mmio, offset + 4) << 32);
+}
+void
+fm10k_model_wr32(void *mmio, long offset, uint32_t val)
+{
+    if ( NULL == _active || mmio != _active->fm10k->mmio ) {
+        _raw_wr32(mmio, offset, val);
+        return;
+    }
+    _write(_active, offset, val);
+}
+void
+fm10k_model_wr64(void *mmio, long offset, uint64_t val)
+{
+    fm10k_model_wr32(mmio, offset, val);
+    fm10k_model_wr32(mmio, offset + 4, val >> 32);
+}
+
+/*
+ * Whether every entry of a free list was handed out exactly once
+ */
+int
+fm10k_model_freelist_complete(const fm10k_model_t *m, int list)
+{
+    const fm10k_model_freelist_t *fl;
+    int n;
+    int i;
+
+    fl = &m->fl[list];
+    n = 0;
+    for ( i = 0; i < (fl->capacity + 63) / 64; i++ ) {
+        n += __builtin_popcountll(fl->used[i]);
+    }
+
+    return n == fl->capacity && 0 == fl->duplicates && 0 == fl->out_of_range
+        && 0 == fl->dropped;
+}
+
+/*
+ * Print the model state
+ */
+void
+fm10k_model_print(FILE *fp, const fm10k_model_t *m)
+{
+    const fm10k_model_freelist_t *fl;
+    int i;
+
+    fprintf(fp, "Lock: %d takes, %d stolen by the NVM, %d violations\n",
+            m->lock_takes, m->lock_stolen, m->lock_violations);
+    fprintf(fp, "PLL relocks: fabric %d, EPL %d\n", m->pll_relocks[0],
+            m->pll_relocks[1]);
+    fprintf(fp, "BIST: %d completed, %d aborted\n", m->bist_done,
+            m->bist_aborted);
+    fprintf(fp, "free list capacity preset pushes duplicates range dropped\n");
+    for ( i = 0; i < FM10K_MODEL_FREELISTS; i++ ) {
+        fl = &m->fl[i];
+        fprintf(fp, "%-9s %8d %6d %6d %10d %5d %7d  %s\n", _flname[i],
+                fl->capacity, fl->preset, fl->pushes, fl->duplicates,
+                fl->out_of_range, fl->dropped,
+                fm10k_model_freelist_complete(m, i) ? "complete"
+                : "incomplete");
+    }
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
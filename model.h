@@ -0,0 +1,153 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _MODEL_H
+#define _MODEL_H
+
+#include "fm10k.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Behavioral model of the FM10K registers the boot sequence depends on.
+ * Built into libfm10k-model, where rd32/wr32/rd64/wr64 are routed through
+ * fm10k_model_*() (FM10K_MODEL); the other registers behave as memory.
+ */
+
+/* Faults */
+#define FM10K_MODEL_LOCK_STUCK  (1 << 0)    /* NVM never frees the lock */
+#define FM10K_MODEL_LOCK_STEAL  (1 << 1)    /* NVM wins the next takes */
+#define FM10K_MODEL_PLL_FABRIC  (1 << 2)    /* Fabric PLL never locks */
+#define FM10K_MODEL_PLL_EPL     (1 << 3)    /* EPL PLL never locks */
+#define FM10K_MODEL_BIST_HANG   (1 << 4)    /* Memory BIST never completes */
+
+/* Free lists initialized by software */
+#define FM10K_MODEL_RXQ         0
+#define FM10K_MODEL_TXQ         1
+#define FM10K_MODEL_SEGMENT     2
+#define FM10K_MODEL_FREELISTS   3
+
+/* Memory groups cleared by BIST (BIST_CTRL run bit - 9) */
+#define FM10K_MODEL_BIST_EPL    0
+#define FM10K_MODEL_BIST_SWITCH 1
+#define FM10K_MODEL_BIST_TUNNEL 2
+#define FM10K_MODEL_BISTS       3
+
+/*
+ * Configuration; latencies in nanoseconds
+ */
+typedef struct _fm10k_model_cfg {
+    uint32_t nvm_version;
+    /* The NVM holds the SOFT_RESET lock this long after power-on and after
+       each steal */
+    uint64_t nvm_hold_ns;
+    /* Delay before a lock write is visible */
+    uint64_t lock_ns;
+    uint64_t pll_lock_ns;
+    uint64_t bist_ns;
+    int faults;
+    /* Takes lost to the NVM with FM10K_MODEL_LOCK_STEAL */
+    int steals;
+    /* SYSTIME reference clock */
+    uint64_t systime_hz;
+} fm10k_model_cfg_t;
+
+/*
+ * Free list: entries handed out by the head/storage pointers (preset) or
+ * pushed through the FREELIST_INIT register
+ */
+typedef struct _fm10k_model_freelist {
+    int capacity;
+    uint64_t *used;
+    int preset;
+    int pushes;
+    int duplicates;
+    int out_of_range;
+    /* Pushes while the switch was held in reset */
+    int dropped;
+} fm10k_model_freelist_t;
+
+/*
+ * Model state
+ */
+typedef struct _fm10k_model {
+    fm10k_t *fm10k;
+    fm10k_model_cfg_t cfg;
+
+    /* BSM_SCRATCH[2] lock: owner, and an owner written but not yet
+       visible (-1 if none) */
+    int owner;
+    int pending;
+    uint64_t pending_at;
+    uint64_t nvm_until;
+    int steals;
+    int lock_takes;
+    int lock_stolen;
+    /* Lock writes not permitted to the API, and SOFT_RESET writes without
+       the lock */
+    int lock_violations;
+
+    /* PLL lock times (fabric, EPL) and number of relocks */
+    uint64_t pll_at[2];
+    int pll_relocks[2];
+
+    /* Start time of each running BIST (0 if idle) */
+    uint64_t bist_at[FM10K_MODEL_BISTS];
+    int bist_done;
+    int bist_aborted;
+
+    /* SYSTIME (ns and 2^-32 ns) as of systime_at */
+    uint64_t systime;
+    uint32_t systime_frac;
+    uint64_t systime_at;
+
+    fm10k_model_freelist_t fl[FM10K_MODEL_FREELISTS];
+} fm10k_model_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_model_default_cfg(fm10k_model_cfg_t *);
+int fm10k_model_set(fm10k_model_cfg_t *, const char *);
+int fm10k_model_open(fm10k_model_t *, fm10k_t *, const fm10k_model_cfg_t *);
+void fm10k_model_close(fm10k_model_t *);
+void fm10k_model_reset(fm10k_model_t *);
+int fm10k_model_freelist_complete(const fm10k_model_t *, int);
+void fm10k_model_print(FILE *, const fm10k_model_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MODEL_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,408 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define TOKENS_MAX  16
+
+/*
+ * Parse a number (decimal, 0x-hex or 0-octal)
+ */
+static int
+_num(const char *s, long max, long *val)
+{
+    char *end;
+
+    if ( NULL == s ) {
+        return -1;
+    }
+    *val = strtol(s, &end, 0);
+    if ( '\0' != *end || *val < 0 || *val > max ) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parse an optional tag position
+ */
+static int
+_position(const char *s)
+{
+    if ( 0 == strcmp(s, "outer") ) {
+        return FM10K_PARSER_OUTER;
+    } else if ( 0 == strcmp(s, "inner") ) {
+        return FM10K_PARSER_INNER;
+    }
+
+    return -1;
+}
+
+/*
+ * Parse one line of the header description
+ */
+static int
+_parse_line(char **tok, int n, fm10k_parser_spec_t *spec)
+{
+    fm10k_parser_hdr_t *h;
+    long v;
+    int i;
+
+    if ( 0 == strcmp(tok[0], "l3") || 0 == strcmp(tok[0], "l4") ) {
+        if ( n != 2 || (strcmp(tok[1], "on") && strcmp(tok[1], "off")) ) {
+            return -1;
+        }
+        v = (0 == strcmp(tok[1], "on"));
+        if ( '3' == tok[0][1] ) {
+            spec->parse_l3 = v;
+        } else {
+            spec->parse_l4 = v;
+        }
+        return 0;
+    }
+
+    if ( spec->nhdrs >= FM10K_PARSER_MAX_HDRS ) {
+        return -1;
+    }
+    h = &spec->hdrs[spec->nhdrs];
+    memset(h, 0, sizeof(fm10k_parser_hdr_t));
+    h->position = FM10K_PARSER_OUTER | FM10K_PARSER_INNER;
+
+    if ( 0 == strcmp(tok[0], "vlan") ) {
+        /* vlan <ethertype> [outer|inner] */
+        h->kind = FM10K_PARSER_HDR_VLAN;
+        if ( n < 2 || n > 3 || _num(tok[1], 0xffff, &v) < 0 ) {
+            return -1;
+        }
+        h->ethertype = v;
+        if ( 3 == n && (h->position = _position(tok[2])) < 0 ) {
+            return -1;
+        }
+        snprintf(h->name, sizeof(h->name), "vlan%d", spec->nhdrs);
+    } else if ( 0 == strcmp(tok[0], "mpls") ) {
+        /* mpls <ethertype> [depth <labels>] */
+        h->kind = FM10K_PARSER_HDR_MPLS;
+        if ( (n != 2 && n != 4) || _num(tok[1], 0xffff, &v) < 0 ) {
+            return -1;
+        }
+        h->ethertype = v;
+        if ( 4 == n ) {
+            if ( strcmp(tok[2], "depth") || _num(tok[3], 7, &v) < 0 ) {
+                return -1;
+            }
+            spec->mpls_depth = v;
+        }
+        snprintf(h->name, sizeof(h->name), "mpls%d", spec->nhdrs);
+    } else if ( 0 == strcmp(tok[0], "custom") ) {
+        /* custom <name> <ethertype> length <bytes> [capture] [outer|inner] */
+        h->kind = FM10K_PARSER_HDR_CUSTOM;
+        h->position = FM10K_PARSER_OUTER;
+        if ( n < 5 || _num(tok[2], 0xffff, &v) < 0 ) {
+            return -1;
+        }
+        h->ethertype = v;
+        if ( strcmp(tok[3], "length") || _num(tok[4], 62, &v) < 0 ) {
+            return -1;
+        }
+        h->length = v;
+        for ( i = 5; i < n; i++ ) {
+            if ( 0 == strcmp(tok[i], "capture") ) {
+                h->capture = 1;
+            } else if ( (h->position = _position(tok[i])) < 0 ) {
+                return -1;
+            }
+        }
+        snprintf(h->name, sizeof(h->name), "%s", tok[1]);
+    } else if ( 0 == strcmp(tok[0], "di") ) {
+        /* di <name> <tcp|udp|prot> [port <n>] offset <bytes> [words <n>] */
+        h->kind = FM10K_PARSER_HDR_DI;
+        h->words = 1;
+        if ( n < 5 ) {
+            return -1;
+        }
+        if ( 0 == strcmp(tok[2], "tcp") ) {
+            h->prot = 6;
+        } else if ( 0 == strcmp(tok[2], "udp") ) {
+            h->prot = 17;
+        } else if ( _num(tok[2], 0xff, &v) == 0 ) {
+            h->prot = v;
+        } else {
+            return -1;
+        }
+        for ( i = 3; i + 1 < n; i += 2 ) {
+            if ( 0 == strcmp(tok[i], "port") && _num(tok[i + 1], 0xffff, &v)
+                 == 0 ) {
+                h->l4port = v;
+            } else if ( 0 == strcmp(tok[i], "offset")
+                        && _num(tok[i + 1], 124, &v) == 0 ) {
+                h->offset = v;
+            } else if ( 0 == strcmp(tok[i], "words")
+                        && _num(tok[i + 1], 4, &v) == 0 && v > 0 ) {
+                h->words = v;
+            } else {
+                return -1;
+            }
+        }
+        if ( i != n ) {
+            return -1;
+        }
+        snprintf(h->name, sizeof(h->name), "%s", tok[1]);
+    } else {
+        return -1;
+    }
+    spec->nhdrs++;
+
+    return 0;
+}
+
+/*
+ * Default specification: single/double 802.1Q tagging, L3 and L4 parsing
+ */
+void
+fm10k_parser_default_spec(fm10k_parser_spec_t *spec)
+{
+    memset(spec, 0, sizeof(fm10k_parser_spec_t));
+    spec->parse_l3 = 1;
+    spec->parse_l4 = 1;
+}
+
+/*
+ * Load a header description.  One header per line:
+ *   vlan <ethertype> [outer|inner]
+ *   mpls <ethertype> [depth <labels>]
+ *   custom <name> <ethertype> length <bytes> [capture] [outer|inner]
+ *   di <name> <tcp|udp|prot> [port <n>] offset <bytes> [words <n>]
+ *   l3 on|off
+ *   l4 on|off
+ */
+int
+fm10k_parser_load(FILE *fp, fm10k_parser_spec_t *spec)
+{
+    char buf[512];
+    char *tok[TOKENS_MAX];
+    char *save;
+    char *p;
+    int line;
+    int n;
+
+    fm10k_parser_default_spec(spec);
+    line = 0;
+    while ( fgets(buf, sizeof(buf), fp) ) {
+        line++;
+        p = strchr(buf, '#');
+        if ( p ) {
+            *p = '\0';
+        }
+        n = 0;
+        for ( p = strtok_r(buf, " \t\r\n", &save); p && n < TOKENS_MAX;
+              p = strtok_r(NULL, " \t\r\n", &save) ) {
+            tok[n++] = p;
+        }
+        if ( 0 == n ) {
+            continue;
+        }
+        if ( _parse_line(tok, n, spec) < 0 ) {
+            fprintf(stderr, "Invalid parser description at line %d\n", line);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Compile a specification into parser register settings.  Resource limits
+ * (four VLAN and custom tags, two MPLS EtherTypes, six deep inspection
+ * slots) are checked here so that applying a program cannot fail halfway.
+ */
+int
+fm10k_parser_compile(const fm10k_parser_spec_t *spec,
+                     fm10k_parser_prog_t *prog)
+{
+    const fm10k_parser_hdr_t *h;
+    int nvlan;
+    int ncustom;
+    int nmpls;
+    int ndi;
+    int i;
+
+    memset(prog, 0, sizeof(fm10k_parser_prog_t));
+    nvlan = 0;
+    ncustom = 0;
+    nmpls = 0;
+    ndi = 0;
+    for ( i = 0; i < spec->nhdrs; i++ ) {
+        h = &spec->hdrs[i];
+        prog->key[i] = -1;
+        switch ( h->kind ) {
+        case FM10K_PARSER_HDR_VLAN:
+            if ( nvlan >= FM10K_PARSER_VLAN_TAGS ) {
+                fprintf(stderr, "Parser: too many VLAN tags\n");
+                return -1;
+            }
+            prog->vlan_tag[nvlan] = h->ethertype;
+            if ( h->position & FM10K_PARSER_OUTER ) {
+                prog->port_cfg_1 |= 1 << nvlan;
+            }
+            if ( h->position & FM10K_PARSER_INNER ) {
+                prog->port_cfg_1 |= 1 << (4 + nvlan);
+            }
+            nvlan++;
+            break;
+        case FM10K_PARSER_HDR_MPLS:
+            if ( nmpls >= FM10K_PARSER_MPLS_TAGS ) {
+                fprintf(stderr, "Parser: too many MPLS EtherTypes\n");
+                return -1;
+            }
+            prog->mpls_tag |= (uint32_t)h->ethertype << (16 * nmpls);
+            nmpls++;
+            break;
+        case FM10K_PARSER_HDR_CUSTOM:
+            if ( ncustom >= FM10K_PARSER_CUSTOM_TAGS || (h->length & 1) ) {
+                fprintf(stderr, "Parser: cannot place custom tag %s\n",
+                        h->name);
+                return -1;
+            }
+            /* Tag | Capture | Length */
+            prog->custom_tag[ncustom] = h->ethertype
+                | ((h->capture ? 1 : 0) << 16) | ((h->length / 2) << 17);
+            if ( h->position & FM10K_PARSER_OUTER ) {
+                prog->port_cfg_2 |= 1 << ncustom;
+            }
+            if ( h->position & FM10K_PARSER_INNER ) {
+                prog->port_cfg_2 |= 1 << (4 + ncustom);
+            }
+            if ( h->capture ) {
+                prog->key[i] = ncustom;
+            }
+            ncustom++;
+            break;
+        case FM10K_PARSER_HDR_DI:
+            if ( ndi >= FM10K_PARSER_DI_SLOTS || (h->offset & 3)
+                 || !spec->parse_l4 ) {
+                fprintf(stderr, "Parser: cannot place deep inspection %s\n",
+                        h->name);
+                return -1;
+            }
+            /* Prot | L4Port | L4Compare | WordOffset | Enable |
+               CaptureWords */
+            prog->di_cfg[ndi] = h->prot | ((uint64_t)h->l4port << 8)
+                | ((uint64_t)(h->l4port ? 1 : 0) << 24)
+                | ((uint64_t)(h->offset / 4) << 25) | (1ULL << 30)
+                | ((uint64_t)h->words << 31);
+            prog->port_cfg_2 |= 1 << (15 + ndi);
+            prog->key[i] = ndi;
+            ndi++;
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    /* Plain 802.1Q unless VLAN tags are described */
+    if ( 0 == nvlan ) {
+        prog->vlan_tag[0] = 0x8100;
+        prog->port_cfg_1 |= (1 << 0) | (1 << 4);
+    }
+    if ( nmpls ) {
+        /* ParseMPLS | StoreMPLS */
+        prog->port_cfg_2 |= (1 << 8) | ((spec->mpls_depth & 0x7) << 9);
+    }
+    if ( spec->parse_l4 && !spec->parse_l3 ) {
+        fprintf(stderr, "Parser: L4 parsing requires L3 parsing\n");
+        return -1;
+    }
+    prog->port_cfg_2 |= (spec->parse_l3 ? 1 << 12 : 0)
+        | (spec->parse_l4 ? 1 << 13 : 0);
+
+    return 0;
+}
+
+/*
+ * Apply a compiled program to a set of ports
+ */
+int
+fm10k_parser_apply(fm10k_t *fm10k, const fm10k_parser_prog_t *prog,
+                   const int *ports, int n)
+{
+    uint32_t m32;
+    int i;
+
+    for ( i = 0; i < n; i++ ) {
+        if ( ports[i] < 0 || ports[i] >= FM10K_PARSER_PORTS ) {
+            return -1;
+        }
+    }
+
+    for ( i = 0; i < FM10K_PARSER_VLAN_TAGS; i++ ) {
+        wr32(fm10k->mmio, FM10K_PARSER_VLAN_TAG(i), prog->vlan_tag[i]);
+    }
+    for ( i = 0; i < FM10K_PARSER_CUSTOM_TAGS; i++ ) {
+        wr32(fm10k->mmio, FM10K_PARSER_CUSTOM_TAG(i), prog->custom_tag[i]);
+    }
+    wr32(fm10k->mmio, FM10K_PARSER_MPLS_TAG, prog->mpls_tag);
+    for ( i = 0; i < FM10K_PARSER_DI_SLOTS; i++ ) {
+        wr64(fm10k->mmio, FM10K_PARSER_DI_CFG(i), prog->di_cfg[i]);
+    }
+
+    for ( i = 0; i < n; i++ ) {
+        /* Keep the default VLAN settings of the port */
+        m32 = rd32(fm10k->mmio, FM10K_PARSER_PORT_CFG_1(ports[i]));
+        m32 = (m32 & ~0x1ffUL) | prog->port_cfg_1;
+        wr32(fm10k->mmio, FM10K_PARSER_PORT_CFG_1(ports[i]), m32);
+        wr32(fm10k->mmio, FM10K_PARSER_PORT_CFG_2(ports[i]), prog->port_cfg_2);
+    }
+
+    return 0;
+}
+
+/*
+ * Key field (custom tag or deep inspection slot) of a named header
+ */
+int
+fm10k_parser_key(const fm10k_parser_spec_t *spec,
+                 const fm10k_parser_prog_t *prog, const char *name)
+{
+    int i;
+
+    for ( i = 0; i < spec->nhdrs; i++ ) {
+        if ( 0 == strcmp(spec->hdrs[i].name, name) ) {
+            return prog->key[i];
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,122 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _PARSER_H
+#define _PARSER_H
+
+#include "fm10k.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define FM10K_PARSER_PORTS          48
+#define FM10K_PARSER_VLAN_TAGS      4
+#define FM10K_PARSER_CUSTOM_TAGS    4
+#define FM10K_PARSER_MPLS_TAGS      2
+#define FM10K_PARSER_DI_SLOTS       6
+#define FM10K_PARSER_MAX_HDRS       16
+#define FM10K_PARSER_NAME_LEN       32
+
+/* Header kinds */
+#define FM10K_PARSER_HDR_VLAN       0
+#define FM10K_PARSER_HDR_MPLS       1
+#define FM10K_PARSER_HDR_CUSTOM     2
+#define FM10K_PARSER_HDR_DI         3
+
+/* Position of a VLAN or custom tag */
+#define FM10K_PARSER_OUTER          (1 << 0)
+#define FM10K_PARSER_INNER          (1 << 1)
+
+/*
+ * Header description
+ */
+typedef struct _fm10k_parser_hdr {
+    char name[FM10K_PARSER_NAME_LEN];
+    int kind;
+    /* VLAN, MPLS and custom tags: EtherType; position (FM10K_PARSER_*) */
+    uint16_t ethertype;
+    int position;
+    /* Custom tag: bytes following the EtherType, captured into the key */
+    int length;
+    int capture;
+    /* Deep inspection: IP protocol, L4 port (0: any), payload byte offset
+       and number of 32-bit words captured into the key */
+    uint8_t prot;
+    uint16_t l4port;
+    int offset;
+    int words;
+} fm10k_parser_hdr_t;
+
+/*
+ * Declarative parser specification
+ */
+typedef struct _fm10k_parser_spec {
+    fm10k_parser_hdr_t hdrs[FM10K_PARSER_MAX_HDRS];
+    int nhdrs;
+    /* MPLS labels stored in the key */
+    int mpls_depth;
+    int parse_l3;
+    int parse_l4;
+} fm10k_parser_spec_t;
+
+/*
+ * Compiled parser settings
+ */
+typedef struct _fm10k_parser_prog {
+    uint32_t vlan_tag[FM10K_PARSER_VLAN_TAGS];
+    uint32_t custom_tag[FM10K_PARSER_CUSTOM_TAGS];
+    uint32_t mpls_tag;
+    uint64_t di_cfg[FM10K_PARSER_DI_SLOTS];
+    /* PARSER_PORT_CFG_1 VLAN tag fields (8:0) and PARSER_PORT_CFG_2 */
+    uint32_t port_cfg_1;
+    uint32_t port_cfg_2;
+    /* Key field of each header: custom tag or DI slot (-1: none) */
+    int key[FM10K_PARSER_MAX_HDRS];
+} fm10k_parser_prog_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_parser_default_spec(fm10k_parser_spec_t *);
+int fm10k_parser_load(FILE *, fm10k_parser_spec_t *);
+int fm10k_parser_compile(const fm10k_parser_spec_t *, fm10k_parser_prog_t *);
+int fm10k_parser_apply(fm10k_t *, const fm10k_parser_prog_t *, const int *,
+                       int);
+int fm10k_parser_key(const fm10k_parser_spec_t *, const fm10k_parser_prog_t *,
+                     const char *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PARSER_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
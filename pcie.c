@@ -0,0 +1,273 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "pcie.h"
+#include <string.h>
+#include <time.h>
+
+/* Framing, sequence number, 4DW header and LCRC of a TLP */
+#define TLP_OVERHEAD    24
+
+static const char *ltssm_names[] = {
+    "DETECT_QUIET", "DETECT_ACT", "POLL_ACTIVE", "POLL_COMPLIANCE",
+    "POLL_CONFIG", "PRE_DETECT_QUIET", "DETECT_WAIT", "CFG_LINKWD_START",
+    "CFG_LINKWD_ACEPT", "CFG_LANENUM_WAIT", "CFG_LANENUM_ACEPT",
+    "CFG_COMPLETE", "CFG_IDLE", "RCVRY_LOCK", "RCVRY_SPEED",
+    "RCVRY_RCVRCFG", "RCVRY_IDLE", "L0", "L0S", "L123_SEND_EIDLE",
+    "L1_IDLE", "L2_IDLE", "L2_WAKE", "DISABLED_ENTRY", "DISABLED_IDLE",
+    "DISABLED", "LPBK_ENTRY", "LPBK_ACTIVE", "LPBK_EXIT",
+    "LPBK_EXIT_TIMEOUT", "HOT_RESET_ENTRY", "HOT_RESET", "RCVRY_EQ0",
+    "RCVRY_EQ1", "RCVRY_EQ2", "RCVRY_EQ3",
+};
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Name of an LTSSM state
+ */
+const char *
+fm10k_pcie_ltssm_name(int ltssm)
+{
+    if ( ltssm < 0
+         || ltssm >= (int)(sizeof(ltssm_names) / sizeof(ltssm_names[0])) ) {
+        return "UNKNOWN";
+    }
+
+    return ltssm_names[ltssm];
+}
+
+/*
+ * Read the host link state
+ */
+void
+fm10k_pcie_read_link(fm10k_t *fm10k, fm10k_pcie_link_t *link)
+{
+    uint64_t m64;
+    uint32_t m32;
+    int i;
+
+    memset(link, 0, sizeof(fm10k_pcie_link_t));
+
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_CFG_LINK_CAP);
+    link->max_speed = m32 & 0xf;
+    link->max_width = (m32 >> 4) & 0x3f;
+
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_CFG_LINK_CTRL);
+    link->speed = (m32 >> 16) & 0xf;
+    link->width = (m32 >> 20) & 0x3f;
+    link->training = (m32 >> 27) & 1;
+
+    /* DLL Link Active is optional for endpoints: the link is up in L0 */
+    m64 = rd64(fm10k->mmio, FM10K_PCIE_PORTLOGIC_LINK_STATE);
+    link->ltssm = m64 & 0x3f;
+    link->up = FM10K_PCIE_LTSSM_L0 == link->ltssm;
+    link->training |= (m64 >> 61) & 1;
+
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_HOST_LANE_CTRL);
+    link->lanes_enabled = m32 & 0xff;
+    link->lanes_active = (m32 >> 8) & 0xff;
+    for ( i = 0; i < FM10K_PCIE_LANES; i++ ) {
+        m64 = rd64(fm10k->mmio, FM10K_PCIE_SERDES_CTRL(i));
+        if ( m64 & (1ULL << 1) ) {
+            link->lanes_serdes_int |= 1 << i;
+        }
+    }
+
+    m32 = rd32(fm10k->mmio, FM10K_PCIE_CFG_DEV_CTRL);
+    link->mps = 128 << ((m32 >> 5) & 7);
+}
+
+/*
+ * Effective host bandwidth ceiling in bytes per second per direction:
+ * the lane rate after line encoding, less the TLP overhead at the maximum
+ * payload size
+ */
+double
+fm10k_pcie_bandwidth(const fm10k_pcie_link_t *link)
+{
+    static const double rate[] = { 0, 2.5e9, 5e9, 8e9 };
+    double enc;
+
+    if ( !link->up || link->width <= 0 || link->speed <= 0
+         || link->speed > 3 ) {
+        return 0;
+    }
+    enc = link->speed >= 3 ? 128.0 / 130 : 8.0 / 10;
+
+    return rate[link->speed] * link->width * enc / 8
+        * link->mps / (link->mps + TLP_OVERHEAD);
+}
+
+/*
+ * Initialize the monitor.  Widths and generations below expect_width and
+ * expect_speed (0: the link capability) are reported as downtraining.
+ */
+void
+fm10k_pcie_mon_init(fm10k_pcie_mon_t *mon, fm10k_t *fm10k, int expect_width,
+                    int expect_speed, fm10k_pcie_notify_t notify, void *arg)
+{
+    memset(mon, 0, sizeof(fm10k_pcie_mon_t));
+    mon->fm10k = fm10k;
+    mon->expect_width = expect_width;
+    mon->expect_speed = expect_speed;
+    mon->notify = notify;
+    mon->arg = arg;
+
+    /* The first sample reports the current link as coming up */
+    fm10k_pcie_read_link(fm10k, &mon->link);
+    mon->link.up = 0;
+}
+
+/*
+ * Raise an event
+ */
+static void
+_event(fm10k_pcie_mon_t *mon, int ev)
+{
+    if ( NULL != mon->notify ) {
+        mon->notify(mon->arg, ev, &mon->link);
+    }
+}
+
+/*
+ * Sample the link once.  LTSSM states visited between two samples are not
+ * seen, so sample often while the link trains.  Returns the number of
+ * events raised.
+ */
+int
+fm10k_pcie_mon_sample(fm10k_pcie_mon_t *mon)
+{
+    fm10k_pcie_link_t prev;
+    fm10k_pcie_transition_t *tr;
+    int width;
+    int speed;
+    int deg;
+    int n;
+
+    prev = mon->link;
+    fm10k_pcie_read_link(mon->fm10k, &mon->link);
+    n = 0;
+
+    if ( mon->link.ltssm != prev.ltssm ) {
+        tr = &mon->history[mon->ntransitions % FM10K_PCIE_HISTORY];
+        tr->t = _now();
+        tr->from = prev.ltssm;
+        tr->to = mon->link.ltssm;
+        mon->ntransitions++;
+        if ( FM10K_PCIE_LTSSM_RCVRY_LOCK == mon->link.ltssm ) {
+            mon->recoveries++;
+        }
+        _event(mon, FM10K_PCIE_EV_LTSSM);
+        n++;
+    }
+
+    if ( prev.up && !mon->link.up ) {
+        mon->linkdowns++;
+        mon->degraded = 0;
+        _event(mon, FM10K_PCIE_EV_DOWN);
+        n++;
+    } else if ( !prev.up && mon->link.up ) {
+        _event(mon, FM10K_PCIE_EV_UP);
+        n++;
+    }
+
+    /* Compare the trained link only */
+    if ( mon->link.up && !mon->link.training ) {
+        width = mon->expect_width ? mon->expect_width : mon->link.max_width;
+        speed = mon->expect_speed ? mon->expect_speed : mon->link.max_speed;
+        deg = mon->link.width < width || mon->link.speed < speed;
+        if ( deg && !mon->degraded ) {
+            mon->downtrains++;
+            fprintf(stderr, "PCIe host link downtrained: x%d Gen%d "
+                    "(expected x%d Gen%d, active lanes %02x)\n",
+                    mon->link.width, mon->link.speed, width, speed,
+                    mon->link.lanes_active);
+            _event(mon, FM10K_PCIE_EV_DEGRADED);
+            n++;
+        } else if ( !deg && mon->degraded ) {
+            _event(mon, FM10K_PCIE_EV_RESTORED);
+            n++;
+        }
+        mon->degraded = deg;
+    }
+
+    return n;
+}
+
+/*
+ * Print the link state, the bandwidth ceiling and the recent transitions
+ */
+void
+fm10k_pcie_mon_print(FILE *fp, const fm10k_pcie_mon_t *mon)
+{
+    const fm10k_pcie_link_t *link;
+    const fm10k_pcie_transition_t *tr;
+    uint64_t i;
+    uint64_t from;
+
+    link = &mon->link;
+    fprintf(fp, "PCIe host link: %s x%d Gen%d (capable x%d Gen%d)%s\n",
+            link->up ? "up" : "down", link->width, link->speed,
+            link->max_width, link->max_speed,
+            mon->degraded ? " DOWNTRAINED" : "");
+    fprintf(fp, "  LTSSM %s, lanes enabled %02x active %02x, "
+            "SerDes interrupts %02x\n", fm10k_pcie_ltssm_name(link->ltssm),
+            link->lanes_enabled, link->lanes_active,
+            link->lanes_serdes_int);
+    fprintf(fp, "  bandwidth ceiling %.2f Gbps per direction (MPS %d)\n",
+            fm10k_pcie_bandwidth(link) * 8 / 1e9, link->mps);
+    fprintf(fp, "  transitions %llu, recoveries %llu, downtrains %llu, "
+            "link downs %llu\n", (unsigned long long)mon->ntransitions,
+            (unsigned long long)mon->recoveries,
+            (unsigned long long)mon->downtrains,
+            (unsigned long long)mon->linkdowns);
+
+    from = mon->ntransitions > 8 ? mon->ntransitions - 8 : 0;
+    for ( i = from; i < mon->ntransitions; i++ ) {
+        tr = &mon->history[i % FM10K_PCIE_HISTORY];
+        fprintf(fp, "  %llu.%09llu %s -> %s\n",
+                (unsigned long long)(tr->t / 1000000000ULL),
+                (unsigned long long)(tr->t % 1000000000ULL),
+                fm10k_pcie_ltssm_name(tr->from),
+                fm10k_pcie_ltssm_name(tr->to));
+    }
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,125 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _PCIE_H
+#define _PCIE_H
+
+#include "fm10k.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#define FM10K_PCIE_LANES        8
+#define FM10K_PCIE_HISTORY      64
+
+/* LTSSM states of interest */
+#define FM10K_PCIE_LTSSM_DETECT_QUIET   0x00
+#define FM10K_PCIE_LTSSM_L0             0x11
+#define FM10K_PCIE_LTSSM_RCVRY_LOCK     0x0d
+
+/* Events */
+#define FM10K_PCIE_EV_LTSSM     0
+#define FM10K_PCIE_EV_DOWN      1
+#define FM10K_PCIE_EV_UP        2
+#define FM10K_PCIE_EV_DEGRADED  3
+#define FM10K_PCIE_EV_RESTORED  4
+
+/*
+ * Host link state
+ */
+typedef struct _fm10k_pcie_link {
+    int up;
+    int training;
+    int ltssm;
+    /* Generation (1..3) and lanes */
+    int speed;
+    int width;
+    int max_speed;
+    int max_width;
+    /* Lanes enabled and active in PCIE_HOST_LANE_CTRL */
+    uint8_t lanes_enabled;
+    uint8_t lanes_active;
+    /* Lanes with a pending SerDes interrupt */
+    uint8_t lanes_serdes_int;
+    int mps;
+} fm10k_pcie_link_t;
+
+/*
+ * LTSSM transition
+ */
+typedef struct _fm10k_pcie_transition {
+    uint64_t t;
+    uint8_t from;
+    uint8_t to;
+} fm10k_pcie_transition_t;
+
+/*
+ * Event callback: (arg, event, link state)
+ */
+typedef void (*fm10k_pcie_notify_t)(void *, int, const fm10k_pcie_link_t *);
+
+/*
+ * Host link monitor
+ */
+typedef struct _fm10k_pcie_mon {
+    fm10k_t *fm10k;
+    /* Expected width and generation (0: the link capability) */
+    int expect_width;
+    int expect_speed;
+    fm10k_pcie_link_t link;
+    int degraded;
+    /* Recent LTSSM transitions */
+    fm10k_pcie_transition_t history[FM10K_PCIE_HISTORY];
+    uint64_t ntransitions;
+    uint64_t recoveries;
+    uint64_t downtrains;
+    uint64_t linkdowns;
+    fm10k_pcie_notify_t notify;
+    void *arg;
+} fm10k_pcie_mon_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_pcie_read_link(fm10k_t *, fm10k_pcie_link_t *);
+const char *fm10k_pcie_ltssm_name(int);
+double fm10k_pcie_bandwidth(const fm10k_pcie_link_t *);
+void fm10k_pcie_mon_init(fm10k_pcie_mon_t *, fm10k_t *, int, int,
+                         fm10k_pcie_notify_t, void *);
+int fm10k_pcie_mon_sample(fm10k_pcie_mon_t *);
+void fm10k_pcie_mon_print(FILE *, const fm10k_pcie_mon_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PCIE_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,283 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "policer.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MANT_MAX    ((1U << FM10K_POLICER_MANT_BITS) - 1)
+#define EXP_MAX     ((1U << FM10K_POLICER_EXP_BITS) - 1)
+
+#define STATS_BYTES_MASK    ((1ULL << 40) - 1)
+#define STATS_FRAMES_MASK   ((1ULL << 24) - 1)
+
+/*
+ * Flat shadow index of a policer
+ */
+static int
+_flat(int bank, int index)
+{
+    if ( index < 0 || index >= fm10k_policer_bank_size(bank) ) {
+        return -1;
+    }
+    if ( bank < 2 ) {
+        return bank * 4096 + index;
+    }
+    return 2 * 4096 + (bank - 2) * 512 + index;
+}
+
+/*
+ * Register offset of a policer configuration
+ */
+static long
+_cfg_reg(int bank, int index)
+{
+    if ( bank < 2 ) {
+        return FM10K_POLICER_CFG_4K(bank, index);
+    }
+    return FM10K_POLICER_CFG_512(bank - 2, index);
+}
+
+/*
+ * Register offset of a policer counter (0: conform, 1: exceed)
+ */
+static long
+_stats_reg(int bank, int index, int k)
+{
+    if ( bank < 2 ) {
+        return FM10K_POLICER_STATS_4K(bank, index, k);
+    }
+    return FM10K_POLICER_STATS_512(bank - 2, index, k);
+}
+
+/*
+ * Accumulate the difference between two raw counter values
+ */
+static void
+_delta(uint64_t cur, uint64_t prev, uint64_t *frames, uint64_t *bytes)
+{
+    *bytes += (cur - prev) & STATS_BYTES_MASK;
+    *frames += ((cur >> 40) - (prev >> 40)) & STATS_FRAMES_MASK;
+}
+
+/*
+ * Number of policers in a bank
+ */
+int
+fm10k_policer_bank_size(int bank)
+{
+    switch ( bank ) {
+    case 0:
+    case 1:
+        return 4096;
+    case 2:
+    case 3:
+        return 512;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Encode a value as Mantissa << Exponent, rounded to nearest.  The smallest
+ * exponent that fits is used, which bounds the relative error by 1/2047.
+ */
+int
+fm10k_policer_encode(uint64_t value, uint32_t *field)
+{
+    uint64_t m;
+    uint32_t e;
+
+    e = 0;
+    while ( (value >> e) > MANT_MAX ) {
+        e++;
+    }
+    m = e ? (value + (1ULL << (e - 1))) >> e : value;
+    if ( m > MANT_MAX ) {
+        /* Rounding carried into the next exponent */
+        e++;
+        m = (value + (1ULL << (e - 1))) >> e;
+    }
+    if ( e > EXP_MAX ) {
+        return -1;
+    }
+    *field = (uint32_t)m | (e << FM10K_POLICER_MANT_BITS);
+
+    return 0;
+}
+
+/*
+ * Decode a Mantissa/Exponent field
+ */
+uint64_t
+fm10k_policer_decode(uint32_t field)
+{
+    return (uint64_t)(field & MANT_MAX) << (field >> FM10K_POLICER_MANT_BITS);
+}
+
+/*
+ * Initialize the policer manager.  Configurations and counters are assumed
+ * to have been cleared by the BIST memory initialization.
+ */
+int
+fm10k_policer_init(fm10k_policer_t *pol, fm10k_t *fm10k)
+{
+    memset(pol, 0, sizeof(fm10k_policer_t));
+    pol->fm10k = fm10k;
+
+    return 0;
+}
+
+/*
+ * Set the last index of a bank used as a policer (entries above count only)
+ */
+int
+fm10k_policer_set_bank(fm10k_policer_t *pol, int bank, int last)
+{
+    uint32_t m32;
+
+    if ( _flat(bank, last) < 0 ) {
+        return -1;
+    }
+    m32 = rd32(pol->fm10k->mmio, FM10K_POLICER_CFG(bank));
+    m32 = (m32 & ~0xfffUL) | last;
+    wr32(pol->fm10k->mmio, FM10K_POLICER_CFG(bank), m32);
+
+    return 0;
+}
+
+/*
+ * Program a policer.  Returns 1 if the entry was written, 0 if it was
+ * already up to date.
+ */
+int
+fm10k_policer_set(fm10k_policer_t *pol, const fm10k_policer_spec_t *spec)
+{
+    uint32_t cr;
+    uint32_t cc;
+    uint32_t er;
+    uint32_t ec;
+    uint64_t m64;
+    int i;
+
+    i = _flat(spec->bank, spec->index);
+    if ( i < 0 ) {
+        return -1;
+    }
+    /* Rates are specified in bit/s; the hardware works in bytes */
+    if ( fm10k_policer_encode((spec->cir + 4) / 8, &cr) < 0
+         || fm10k_policer_encode(spec->cbs, &cc) < 0
+         || fm10k_policer_encode((spec->eir + 4) / 8, &er) < 0
+         || fm10k_policer_encode(spec->ebs, &ec) < 0 ) {
+        fprintf(stderr, "Policer %d/%d out of range\n", spec->bank,
+                spec->index);
+        return -1;
+    }
+    m64 = (uint64_t)cr | ((uint64_t)cc << 16) | ((uint64_t)er << 32)
+        | ((uint64_t)ec << 48);
+    if ( m64 == pol->cfg[i] ) {
+        return 0;
+    }
+    wr64(pol->fm10k->mmio, _cfg_reg(spec->bank, spec->index), m64);
+    pol->cfg[i] = m64;
+
+    return 1;
+}
+
+/*
+ * Program a batch of policers.  All specifications are validated before any
+ * register is written; returns the number of entries written.
+ */
+int
+fm10k_policer_set_bulk(fm10k_policer_t *pol, const fm10k_policer_spec_t *specs,
+                       int n)
+{
+    uint32_t field;
+    int ret;
+    int w;
+    int i;
+
+    for ( i = 0; i < n; i++ ) {
+        if ( _flat(specs[i].bank, specs[i].index) < 0
+             || fm10k_policer_encode((specs[i].cir + 4) / 8, &field) < 0
+             || fm10k_policer_encode(specs[i].cbs, &field) < 0
+             || fm10k_policer_encode((specs[i].eir + 4) / 8, &field) < 0
+             || fm10k_policer_encode(specs[i].ebs, &field) < 0 ) {
+            fprintf(stderr, "Invalid policer specification #%d\n", i);
+            return -1;
+        }
+    }
+
+    w = 0;
+    for ( i = 0; i < n; i++ ) {
+        ret = fm10k_policer_set(pol, &specs[i]);
+        if ( ret < 0 ) {
+            return -1;
+        }
+        w += ret;
+    }
+
+    return w;
+}
+
+/*
+ * Read the counters of n consecutive policers and add the increments since
+ * the previous read to cnt[0..n-1]
+ */
+int
+fm10k_policer_read_counters(fm10k_policer_t *pol, int bank, int first, int n,
+                            fm10k_policer_counter_t *cnt)
+{
+    uint64_t conform;
+    uint64_t exceed;
+    int base;
+    int i;
+
+    base = _flat(bank, first);
+    if ( base < 0 || n < 0 || (n > 0 && _flat(bank, first + n - 1) < 0) ) {
+        return -1;
+    }
+
+    for ( i = 0; i < n; i++ ) {
+        conform = rd64(pol->fm10k->mmio, _stats_reg(bank, first + i, 0));
+        exceed = rd64(pol->fm10k->mmio, _stats_reg(bank, first + i, 1));
+        _delta(conform, pol->stats[base + i][0], &cnt[i].conform_frames,
+               &cnt[i].conform_bytes);
+        _delta(exceed, pol->stats[base + i][1], &cnt[i].exceed_frames,
+               &cnt[i].exceed_bytes);
+        pol->stats[base + i][0] = conform;
+        pol->stats[base + i][1] = exceed;
+    }
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,101 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _POLICER_H
+#define _POLICER_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+/* Banks 0..1 hold 4096 entries, banks 2..3 hold 512 entries */
+#define FM10K_POLICER_BANKS         4
+#define FM10K_POLICER_ENTRIES       (2 * 4096 + 2 * 512)
+
+/* Rate/capacity encoding: Mantissa << Exponent */
+#define FM10K_POLICER_MANT_BITS     11
+#define FM10K_POLICER_EXP_BITS      5
+
+/*
+ * Policer specification
+ */
+typedef struct _fm10k_policer_spec {
+    int bank;
+    int index;
+    /* Committed/excess information rates (bit/s) and burst sizes (bytes) */
+    uint64_t cir;
+    uint64_t cbs;
+    uint64_t eir;
+    uint64_t ebs;
+} fm10k_policer_spec_t;
+
+/*
+ * Policer counters
+ */
+typedef struct _fm10k_policer_counter {
+    uint64_t conform_frames;
+    uint64_t conform_bytes;
+    uint64_t exceed_frames;
+    uint64_t exceed_bytes;
+} fm10k_policer_counter_t;
+
+/*
+ * Policer manager
+ */
+typedef struct _fm10k_policer {
+    fm10k_t *fm10k;
+    /* Shadow of POLICER_CFG_4K/POLICER_CFG_512 */
+    uint64_t cfg[FM10K_POLICER_ENTRIES];
+    /* Last raw POLICER_STATS values (conform, exceed) */
+    uint64_t stats[FM10K_POLICER_ENTRIES][2];
+} fm10k_policer_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_policer_bank_size(int);
+int fm10k_policer_encode(uint64_t, uint32_t *);
+uint64_t fm10k_policer_decode(uint32_t);
+int fm10k_policer_init(fm10k_policer_t *, fm10k_t *);
+int fm10k_policer_set_bank(fm10k_policer_t *, int, int);
+int fm10k_policer_set(fm10k_policer_t *, const fm10k_policer_spec_t *);
+int fm10k_policer_set_bulk(fm10k_policer_t *, const fm10k_policer_spec_t *,
+                           int);
+int fm10k_policer_read_counters(fm10k_policer_t *, int, int, int,
+                                fm10k_policer_counter_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _POLICER_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
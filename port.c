@@ -0,0 +1,490 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "port.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Default port set: the PCIe host interface as logical port 0 and four
+ * 100 GbE ports
+ */
+void
+fm10k_port_default(fm10k_ports_t *ports)
+{
+    memset(ports, 0, sizeof(fm10k_ports_t));
+
+    fm10k_port_add(ports, 0, -1, 0, 50000);
+    ports->port[0].physical = 0x3f;
+    fm10k_port_add(ports, 1, 1, 0, 100000);
+    ports->port[1].an = 1;
+    fm10k_port_add(ports, 2, 6, 0, 100000);
+    ports->port[2].an = 1;
+    fm10k_port_add(ports, 3, 7, 0, 100000);
+    fm10k_port_add(ports, 4, 8, 0, 100000);
+}
+
+/*
+ * Add a port
+ */
+int
+fm10k_port_add(fm10k_ports_t *ports, int logical, int epl, int lane,
+               int speed)
+{
+    fm10k_port_cfg_t *port;
+
+    if ( ports->n >= FM10K_PORT_MAX ) {
+        return -1;
+    }
+    port = &ports->port[ports->n++];
+    memset(port, 0, sizeof(fm10k_port_cfg_t));
+    port->logical = logical;
+    port->epl = epl;
+    port->lane = lane;
+    port->speed = speed;
+    port->mtu = 1518;
+    port->fec = (speed == 25000 || speed == 100000);
+
+    return 0;
+}
+
+/*
+ * Number of SerDes lanes of an Ethernet port
+ */
+int
+fm10k_port_lanes(const fm10k_port_cfg_t *port)
+{
+    switch ( port->speed ) {
+    case 40000:
+    case 100000:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+/*
+ * PCS for an Ethernet speed
+ */
+static int
+_pcs_sel(int speed)
+{
+    switch ( speed ) {
+    case 1000:
+        return FM10K_PCS_SEL_1000BASEX;
+    case 10000:
+        return FM10K_PCS_SEL_10GBASER;
+    case 40000:
+        return FM10K_PCS_SEL_40GBASER4;
+    case 25000:
+    case 100000:
+        return FM10K_PCS_SEL_100GBASER;
+    default:
+        return FM10K_PCS_SEL_DISABLED;
+    }
+}
+
+/*
+ * Check the port set and derive the physical port of Ethernet ports
+ */
+int
+fm10k_port_validate(fm10k_ports_t *ports)
+{
+    fm10k_port_cfg_t *port;
+    uint64_t logical;
+    uint8_t used[FM10K_PORT_EPLS];
+    int nl;
+    int i;
+
+    logical = 0;
+    memset(used, 0, sizeof(used));
+    for ( i = 0; i < ports->n; i++ ) {
+        port = &ports->port[i];
+        if ( port->logical < 0 || port->logical >= FM10K_PORT_MAX
+             || (logical & (1ULL << port->logical)) ) {
+            fprintf(stderr, "Port %d: invalid or duplicate logical port\n",
+                    port->logical);
+            return -1;
+        }
+        logical |= 1ULL << port->logical;
+
+        if ( port->epl < 0 ) {
+            /* PCIe, tunnel engine or FIBM port */
+            if ( port->speed <= 0 || port->physical < 0
+                 || port->physical > 0xff ) {
+                fprintf(stderr, "Port %d: invalid internal port\n",
+                        port->logical);
+                return -1;
+            }
+            continue;
+        }
+
+        if ( port->epl >= FM10K_PORT_EPLS
+             || FM10K_PCS_SEL_DISABLED == _pcs_sel(port->speed) ) {
+            fprintf(stderr, "Port %d: invalid EPL or speed\n",
+                    port->logical);
+            return -1;
+        }
+        nl = fm10k_port_lanes(port);
+        if ( port->lane < 0 || port->lane + nl > 4
+             || (nl == 4 && port->lane != 0) ) {
+            fprintf(stderr, "Port %d: %d lanes do not fit at EPL %d lane "
+                    "%d\n", port->logical, nl, port->epl, port->lane);
+            return -1;
+        }
+        if ( used[port->epl] & (((1 << nl) - 1) << port->lane) ) {
+            fprintf(stderr, "Port %d: EPL %d lane %d already in use\n",
+                    port->logical, port->epl, port->lane);
+            return -1;
+        }
+        used[port->epl] |= ((1 << nl) - 1) << port->lane;
+        if ( port->fec && port->speed != 25000 && port->speed != 100000 ) {
+            fprintf(stderr, "Port %d: RS-FEC requires 25G or 100G\n",
+                    port->logical);
+            return -1;
+        }
+        port->physical = port->epl * 4 + port->lane;
+    }
+
+    return 0;
+}
+
+/*
+ * Configure the MAC and PCS of a port for a speed and FEC
+ */
+static void
+_mac_pcs(fm10k_prog_t *prog, const fm10k_port_cfg_t *port, int speed,
+         int fec)
+{
+    uint32_t m32;
+    int nl;
+    int i;
+
+    /* MAC: clock compensation, 12-byte IFG and speed */
+    m32 = (1 << 16) | (12 << 17) | ((speed < 10000 ? 1 : 0) << 23);
+    fm10k_prog_rmw32(prog, FM10K_MAC_CFG(port->epl, port->lane), m32,
+                     0xffff0000UL);
+
+    /* PCS of every lane of the port */
+    nl = fm10k_port_lanes(port);
+    for ( i = port->lane; i < port->lane + nl; i++ ) {
+        if ( speed == 1000 ) {
+            /* Clause 37 auto-negotiation */
+            fm10k_prog_wr32(prog, FM10K_PCS_1000BASEX_CFG(port->epl, i), 1);
+            continue;
+        }
+        m32 = 0;
+        if ( nl == 4 ) {
+            /* Lane alignment markers */
+            m32 |= 0x3;
+        }
+        if ( fec ) {
+            m32 |= 1 << 2;
+        }
+        fm10k_prog_wr32(prog, FM10K_PCS_10GBASER_CFG(port->epl, i), m32);
+    }
+}
+
+/*
+ * Append the EPL, MAC and PCS configuration of the port set to a register
+ * program.  Auto-negotiated ports start on the Clause 73 PCS and are
+ * switched to the resolved mode by fm10k_port_set_mode.
+ */
+int
+fm10k_port_emit(const fm10k_ports_t *ports, fm10k_prog_t *prog)
+{
+    const fm10k_port_cfg_t *port;
+    uint32_t active[FM10K_PORT_EPLS];
+    uint32_t cfgb[FM10K_PORT_EPLS];
+    int pcs;
+    int nl;
+    int i;
+
+    memset(active, 0, sizeof(active));
+    memset(cfgb, 0, sizeof(cfgb));
+    for ( i = 0; i < ports->n; i++ ) {
+        port = &ports->port[i];
+        if ( port->epl < 0 ) {
+            continue;
+        }
+        nl = fm10k_port_lanes(port);
+        active[port->epl] |= ((1 << nl) - 1) << port->lane;
+        pcs = _pcs_sel(port->speed);
+        if ( port->an && port->speed != 1000 ) {
+            pcs = FM10K_PCS_SEL_AN_73;
+        }
+        cfgb[port->epl] |= pcs << (4 * port->lane);
+        if ( nl == 4 ) {
+            /* QplMode */
+            cfgb[port->epl] |= 1 << 16;
+        }
+        _mac_pcs(prog, port, port->speed, port->fec);
+    }
+
+    for ( i = 0; i < FM10K_PORT_EPLS; i++ ) {
+        /* EPL_CFG_A.Active */
+        fm10k_prog_rmw32(prog, FM10K_EPL_CFG_A(i), active[i] << 7,
+                         0xf << 7);
+        /* EPL_CFG_B.PortNPcsSel and QplMode */
+        fm10k_prog_rmw32(prog, FM10K_EPL_CFG_B(i), cfgb[i], 0x7ffffUL);
+    }
+
+    return 0;
+}
+
+/*
+ * Configure the EPLs, MACs and PCSes for the port set
+ */
+int
+fm10k_port_apply(fm10k_t *fm10k, const fm10k_ports_t *ports)
+{
+    fm10k_prog_t prog;
+    int ret;
+
+    fm10k_prog_init(&prog);
+    ret = fm10k_port_emit(ports, &prog);
+    if ( ret >= 0 ) {
+        ret = fm10k_prog_apply(fm10k, &prog);
+    }
+    fm10k_prog_free(&prog);
+
+    return ret;
+}
+
+/*
+ * Switch a port to a (negotiated) speed and FEC; the lane count is kept.
+ * Speed 0 hands the port back to the Clause 73 PCS.
+ */
+int
+fm10k_port_set_mode(fm10k_t *fm10k, const fm10k_port_cfg_t *port, int speed,
+                    int fec)
+{
+    fm10k_prog_t prog;
+    int pcs;
+    int ret;
+
+    if ( port->epl < 0 ) {
+        return -1;
+    }
+    pcs = speed ? _pcs_sel(speed) : FM10K_PCS_SEL_AN_73;
+    if ( FM10K_PCS_SEL_DISABLED == pcs ) {
+        return -1;
+    }
+    fm10k_prog_init(&prog);
+    fm10k_prog_rmw32(&prog, FM10K_EPL_CFG_B(port->epl),
+                     pcs << (4 * port->lane), 0xfUL << (4 * port->lane));
+    if ( speed ) {
+        _mac_pcs(&prog, port, speed, fec);
+    }
+    ret = fm10k_prog_apply(fm10k, &prog);
+    fm10k_prog_free(&prog);
+
+    return ret;
+}
+
+/*
+ * Build the scheduler calendar.  Each port gets one slot per
+ * FM10K_PORT_SLOT_MBPS of its speed and the slots are spread by smooth
+ * weighted round robin, so that every port is polled at even intervals and
+ * mixed-speed ports all reach line rate.  An idle slot separates two
+ * consecutive slots of the same port, also across the wrap of the
+ * calendar.  Returns the number of slots, idle ones included.
+ */
+int
+fm10k_port_schedule(const fm10k_ports_t *ports, fm10k_port_slot_t *slots,
+                    int max)
+{
+    int weight[FM10K_PORT_MAX];
+    int cur[FM10K_PORT_MAX];
+    int order[FM10K_PORT_SCHED_MAX];
+    int total;
+    int best;
+    int n;
+    int i;
+    int k;
+
+    total = 0;
+    for ( i = 0; i < ports->n; i++ ) {
+        weight[i] = (ports->port[i].speed + FM10K_PORT_SLOT_MBPS - 1)
+            / FM10K_PORT_SLOT_MBPS;
+        cur[i] = 0;
+        total += weight[i];
+    }
+    if ( total > max || total > FM10K_PORT_SCHED_MAX ) {
+        fprintf(stderr, "Scheduler: %d slots exceed the calendar\n", total);
+        return -1;
+    }
+
+    for ( k = 0; k < total; k++ ) {
+        best = -1;
+        for ( i = 0; i < ports->n; i++ ) {
+            cur[i] += weight[i];
+            if ( best < 0 || cur[i] > cur[best] ) {
+                best = i;
+            }
+        }
+        cur[best] -= total;
+        order[k] = best;
+    }
+
+    /* The idle slots count against the calendar as well */
+    n = total;
+    for ( k = 0; k < total; k++ ) {
+        if ( total > 1 && order[k] == order[(k + 1) % total] ) {
+            n++;
+        }
+    }
+    if ( n > max || n > FM10K_PORT_SCHED_MAX ) {
+        fprintf(stderr, "Scheduler: %d slots with the idle ones exceed the "
+                "calendar\n", n);
+        return -1;
+    }
+
+    n = 0;
+    for ( k = 0; k < total; k++ ) {
+        i = order[k];
+        slots[n].physical = ports->port[i].physical;
+        slots[n].logical = ports->port[i].logical;
+        slots[n].quad = fm10k_port_lanes(&ports->port[i]) == 4;
+        slots[n].idle = 0;
+        n++;
+        if ( total > 1 && order[k] == order[(k + 1) % total] ) {
+            memset(&slots[n], 0, sizeof(fm10k_port_slot_t));
+            slots[n++].idle = 1;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Append the RX/TX scheduler calendars and the scheduler start to a
+ * register program
+ */
+int
+fm10k_port_emit_schedule(const fm10k_ports_t *ports, fm10k_prog_t *prog)
+{
+    fm10k_port_slot_t slots[FM10K_PORT_SCHED_MAX];
+    uint32_t m32;
+    int n;
+    int i;
+
+    n = fm10k_port_schedule(ports, slots, FM10K_PORT_SCHED_MAX);
+    if ( n <= 0 ) {
+        return -1;
+    }
+    for ( i = 0; i < n; i++ ) {
+        /* PhysPort | Port | Quad | Idle */
+        m32 = slots[i].physical | (slots[i].logical << 8)
+            | (slots[i].quad << 14) | (slots[i].idle << 16);
+        fm10k_prog_wr32(prog, FM10K_SCHED_RX_SCHEDULE(i), m32);
+        fm10k_prog_wr32(prog, FM10K_SCHED_TX_SCHEDULE(i), m32);
+    }
+    /* Start scheduler once the calendar is in place */
+    fm10k_prog_barrier(prog);
+    /* The MaxIndex fields hold the last entry of the calendar */
+    m32 = 1 | ((n - 1) << 2) | (1 << 11) | ((n - 1) << 13);
+    fm10k_prog_wr32(prog, FM10K_SCHED_SCHEDULE_CTRL, m32);
+
+    return 0;
+}
+
+/*
+ * Program the scheduler calendar of the port set and start the scheduler
+ */
+int
+fm10k_port_apply_schedule(fm10k_t *fm10k, const fm10k_ports_t *ports)
+{
+    fm10k_prog_t prog;
+    int ret;
+
+    fm10k_prog_init(&prog);
+    ret = fm10k_port_emit_schedule(ports, &prog);
+    if ( ret >= 0 ) {
+        ret = fm10k_prog_apply(fm10k, &prog);
+    }
+    fm10k_prog_free(&prog);
+
+    return ret;
+}
+
+/*
+ * Set the port speeds and MTUs of a congestion management configuration
+ */
+void
+fm10k_port_cm_cfg(const fm10k_ports_t *ports, fm10k_cm_cfg_t *cfg)
+{
+    int i;
+
+    for ( i = 0; i < ports->n; i++ ) {
+        cfg->ports[ports->port[i].logical].speed = ports->port[i].speed;
+        cfg->ports[ports->port[i].logical].mtu = ports->port[i].mtu;
+    }
+}
+
+/*
+ * Select the SerDes lanes and rates of a bring-up configuration
+ */
+void
+fm10k_port_serdes_cfg(const fm10k_ports_t *ports, fm10k_serdes_cfg_t *cfg)
+{
+    const fm10k_port_cfg_t *port;
+    int lane;
+    int nl;
+    int i;
+    int j;
+
+    cfg->lanes = 0;
+    for ( i = 0; i < ports->n; i++ ) {
+        port = &ports->port[i];
+        if ( port->epl < 0 ) {
+            continue;
+        }
+        nl = fm10k_port_lanes(port);
+        for ( j = 0; j < nl; j++ ) {
+            lane = port->epl * 4 + port->lane + j;
+            cfg->lanes |= 1ULL << lane;
+            switch ( port->speed ) {
+            case 1000:
+                cfg->rate[lane] = FM10K_SERDES_RATE_1G;
+                break;
+            case 25000:
+            case 100000:
+                cfg->rate[lane] = FM10K_SERDES_RATE_25G;
+                break;
+            default:
+                cfg->rate[lane] = FM10K_SERDES_RATE_10G;
+            }
+        }
+    }
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,118 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _PORT_H
+#define _PORT_H
+
+#include "fm10k.h"
+#include "cm.h"
+#include "prog.h"
+#include "serdes.h"
+#include <stdint.h>
+
+#define FM10K_PORT_MAX          48
+#define FM10K_PORT_EPLS         9
+
+/* Scheduler calendar: one slot per 5 Gbit/s */
+#define FM10K_PORT_SLOT_MBPS    5000
+#define FM10K_PORT_SCHED_MAX    512
+
+/* EPL_CFG_B.PcsSel */
+#define FM10K_PCS_SEL_DISABLED  0
+#define FM10K_PCS_SEL_AN_73     1
+#define FM10K_PCS_SEL_1000BASEX 5
+#define FM10K_PCS_SEL_10GBASER  6
+#define FM10K_PCS_SEL_40GBASER4 7
+#define FM10K_PCS_SEL_100GBASER 8
+
+/*
+ * Port configuration
+ */
+typedef struct _fm10k_port_cfg {
+    int logical;
+    /* EPL and first lane (epl < 0: not an Ethernet port, e.g., PCIe) */
+    int epl;
+    int lane;
+    /* Scheduler physical port; derived from epl/lane for Ethernet ports */
+    int physical;
+    /* Mbit/s: 1000, 10000, 25000, 40000, 100000 (any for non-EPL ports) */
+    int speed;
+    int mtu;
+    /* Clause 91 RS-FEC (25G/100G) */
+    int fec;
+    /* Auto-negotiation (Clause 73; Clause 37 for 1G) with speed as the
+       highest mode advertised */
+    int an;
+} fm10k_port_cfg_t;
+
+/*
+ * Port set
+ */
+typedef struct _fm10k_ports {
+    fm10k_port_cfg_t port[FM10K_PORT_MAX];
+    int n;
+} fm10k_ports_t;
+
+/*
+ * Scheduler calendar entry
+ */
+typedef struct _fm10k_port_slot {
+    uint8_t physical;
+    uint8_t logical;
+    uint8_t quad;
+    uint8_t idle;
+} fm10k_port_slot_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_port_default(fm10k_ports_t *);
+int fm10k_port_add(fm10k_ports_t *, int, int, int, int);
+int fm10k_port_lanes(const fm10k_port_cfg_t *);
+int fm10k_port_validate(fm10k_ports_t *);
+int fm10k_port_emit(const fm10k_ports_t *, fm10k_prog_t *);
+int fm10k_port_apply(fm10k_t *, const fm10k_ports_t *);
+int fm10k_port_set_mode(fm10k_t *, const fm10k_port_cfg_t *, int, int);
+int fm10k_port_schedule(const fm10k_ports_t *, fm10k_port_slot_t *, int);
+int fm10k_port_emit_schedule(const fm10k_ports_t *, fm10k_prog_t *);
+int fm10k_port_apply_schedule(fm10k_t *, const fm10k_ports_t *);
+void fm10k_port_cm_cfg(const fm10k_ports_t *, fm10k_cm_cfg_t *);
+void fm10k_port_serdes_cfg(const fm10k_ports_t *, fm10k_serdes_cfg_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PORT_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
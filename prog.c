@@ -0,0 +1,667 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "prog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TOKENS_MAX  8
+
+static const char *opnames[] = {
+    "wr32", "wr64", "rmw32", "rmw64", "poll32", "delay", "barrier",
+};
+
+/*
+ * Register contents known to the optimizer
+ */
+typedef struct _known {
+    int valid;
+    uint32_t offset;
+    int wide;
+    uint64_t mask;
+    uint64_t value;
+} known_t;
+
+/*
+ * Sort key of a register access
+ */
+typedef struct _sortkey {
+    uint32_t offset;
+    int index;
+} sortkey_t;
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Initialize an empty program
+ */
+void
+fm10k_prog_init(fm10k_prog_t *prog)
+{
+    memset(prog, 0, sizeof(fm10k_prog_t));
+}
+
+/*
+ * Release a program
+ */
+void
+fm10k_prog_free(fm10k_prog_t *prog)
+{
+    free(prog->recs);
+    memset(prog, 0, sizeof(fm10k_prog_t));
+}
+
+/*
+ * Append a record
+ */
+int
+fm10k_prog_add(fm10k_prog_t *prog, int op, uint32_t offset, uint64_t value,
+               uint64_t mask)
+{
+    fm10k_prog_rec_t *recs;
+    int max;
+
+    if ( prog->n == prog->max ) {
+        max = prog->max ? prog->max * 2 : 256;
+        recs = realloc(prog->recs, sizeof(fm10k_prog_rec_t) * max);
+        if ( NULL == recs ) {
+            return -1;
+        }
+        prog->recs = recs;
+        prog->max = max;
+    }
+    prog->recs[prog->n].offset = offset;
+    prog->recs[prog->n].op = op;
+    prog->recs[prog->n].value = value;
+    prog->recs[prog->n].mask = mask;
+    prog->recs[prog->n].timeout = 0;
+    prog->n++;
+
+    return 0;
+}
+
+/*
+ * Append a 32-bit register write
+ */
+int
+fm10k_prog_wr32(fm10k_prog_t *prog, uint32_t offset, uint32_t value)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_WR32, offset, value, 0xffffffffUL);
+}
+
+/*
+ * Append a 64-bit register write
+ */
+int
+fm10k_prog_wr64(fm10k_prog_t *prog, uint32_t offset, uint64_t value)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_WR64, offset, value, ~0ULL);
+}
+
+/*
+ * Append a 32-bit read-modify-write of the bits in mask
+ */
+int
+fm10k_prog_rmw32(fm10k_prog_t *prog, uint32_t offset, uint32_t value,
+                 uint32_t mask)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_RMW32, offset, value & mask,
+                          mask);
+}
+
+/*
+ * Append a 64-bit read-modify-write of the bits in mask
+ */
+int
+fm10k_prog_rmw64(fm10k_prog_t *prog, uint32_t offset, uint64_t value,
+                 uint64_t mask)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_RMW64, offset, value & mask,
+                          mask);
+}
+
+/*
+ * Append a poll for (reg & mask) == value
+ */
+int
+fm10k_prog_poll32(fm10k_prog_t *prog, uint32_t offset, uint32_t value,
+                  uint32_t mask, int timeout_us)
+{
+    if ( timeout_us < 0 ) {
+        return -1;
+    }
+    if ( fm10k_prog_add(prog, FM10K_PROG_POLL32, offset, value & mask,
+                        mask) < 0 ) {
+        return -1;
+    }
+    prog->recs[prog->n - 1].timeout = timeout_us;
+
+    return 0;
+}
+
+/*
+ * Append a delay
+ */
+int
+fm10k_prog_delay(fm10k_prog_t *prog, int us)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_DELAY, 0, us, 0);
+}
+
+/*
+ * Close the current ordering domain
+ */
+int
+fm10k_prog_barrier(fm10k_prog_t *prog)
+{
+    return fm10k_prog_add(prog, FM10K_PROG_BARRIER, 0, 0, 0);
+}
+
+/*
+ * Register access operation
+ */
+static int
+_is_access(int op)
+{
+    return op <= FM10K_PROG_RMW64;
+}
+
+/*
+ * 64-bit register access
+ */
+static int
+_is_wide(int op)
+{
+    return FM10K_PROG_WR64 == op || FM10K_PROG_RMW64 == op;
+}
+
+/*
+ * Find (or create) the known contents of a register
+ */
+static known_t *
+_known(known_t *tab, uint32_t size, uint32_t offset, int create)
+{
+    uint32_t h;
+
+    h = ((offset >> 2) * 2654435761U) & (size - 1);
+    while ( tab[h].valid ) {
+        if ( tab[h].offset == offset ) {
+            return &tab[h];
+        }
+        h = (h + 1) & (size - 1);
+    }
+    if ( !create ) {
+        return NULL;
+    }
+    tab[h].valid = 1;
+    tab[h].offset = offset;
+
+    return &tab[h];
+}
+
+/*
+ * Order accesses by register and then by position
+ */
+static int
+_cmp_key(const void *a, const void *b)
+{
+    const sortkey_t *ka;
+    const sortkey_t *kb;
+
+    ka = a;
+    kb = b;
+    if ( ka->offset != kb->offset ) {
+        return ka->offset < kb->offset ? -1 : 1;
+    }
+
+    return ka->index - kb->index;
+}
+
+/*
+ * Fold the accesses of one register within an ordering domain into a
+ * single write or read-modify-write.  Returns the number of records
+ * emitted.
+ */
+static int
+_fold(const fm10k_prog_t *prog, const sortkey_t *keys, int nkeys,
+      known_t *k, fm10k_prog_rec_t *out)
+{
+    const fm10k_prog_rec_t *r;
+    uint64_t full;
+    uint64_t known;
+    uint64_t value;
+    uint64_t changed;
+    uint64_t m;
+    int wide;
+    int i;
+
+    /* Registers accessed with both widths are left alone */
+    wide = _is_wide(prog->recs[keys[0].index].op);
+    for ( i = 1; i < nkeys; i++ ) {
+        if ( _is_wide(prog->recs[keys[i].index].op) != wide ) {
+            for ( i = 0; i < nkeys; i++ ) {
+                out[i] = prog->recs[keys[i].index];
+            }
+            k->mask = 0;
+            return nkeys;
+        }
+    }
+    full = wide ? ~0ULL : 0xffffffffULL;
+    if ( k->wide != wide ) {
+        k->mask = 0;
+    }
+
+    known = k->mask;
+    value = k->value;
+    changed = 0;
+    for ( i = 0; i < nkeys; i++ ) {
+        r = &prog->recs[keys[i].index];
+        if ( FM10K_PROG_WR32 == r->op || FM10K_PROG_WR64 == r->op ) {
+            known = full;
+            value = r->value & full;
+            changed = full;
+            continue;
+        }
+        m = r->mask & full;
+        if ( (known & m) == m && (value & m) == (r->value & m) ) {
+            /* No effect on bits already programmed */
+            continue;
+        }
+        value = (value & ~m) | (r->value & m);
+        known |= m;
+        changed |= m;
+    }
+    k->wide = wide;
+    k->mask = known;
+    k->value = value;
+    if ( 0 == changed ) {
+        return 0;
+    }
+
+    out->offset = keys[0].offset;
+    if ( known == full ) {
+        /* Every bit is known: the read is not needed */
+        out->op = wide ? FM10K_PROG_WR64 : FM10K_PROG_WR32;
+        out->value = value;
+        out->mask = full;
+    } else {
+        out->op = wide ? FM10K_PROG_RMW64 : FM10K_PROG_RMW32;
+        out->value = value & changed;
+        out->mask = changed;
+    }
+
+    return 1;
+}
+
+/*
+ * Optimize a program.  Polls, delays and barriers delimit ordering
+ * domains.  Within a domain the accesses are sorted by register, and all
+ * the accesses to one register are merged into one record.  A
+ * read-modify-write becomes a plain write once the program has set every
+ * bit of the register, and it is dropped if it changes nothing the program
+ * wrote before.  What the program wrote is forgotten at a delay or a
+ * barrier, since hardware may change registers while it waits, and for the
+ * polled register at a poll.  Returns the number of records removed.
+ */
+int
+fm10k_prog_optimize(fm10k_prog_t *prog)
+{
+    fm10k_prog_rec_t *out;
+    known_t *tab;
+    known_t *k;
+    sortkey_t *keys;
+    uint32_t size;
+    int nkeys;
+    int nout;
+    int dom;
+    int s;
+    int e;
+    int a;
+    int b;
+
+    if ( 0 == prog->n ) {
+        return 0;
+    }
+    size = 16;
+    while ( size < (uint32_t)prog->n * 2 ) {
+        size <<= 1;
+    }
+    out = malloc(sizeof(fm10k_prog_rec_t) * prog->n);
+    keys = malloc(sizeof(sortkey_t) * prog->n);
+    tab = calloc(size, sizeof(known_t));
+    if ( NULL == out || NULL == keys || NULL == tab ) {
+        free(out);
+        free(keys);
+        free(tab);
+        return -1;
+    }
+
+    nout = 0;
+    for ( s = 0; s < prog->n; s = e + 1 ) {
+        dom = nout;
+        nkeys = 0;
+        for ( e = s; e < prog->n && _is_access(prog->recs[e].op); e++ ) {
+            keys[nkeys].offset = prog->recs[e].offset;
+            keys[nkeys].index = e;
+            nkeys++;
+        }
+        qsort(keys, nkeys, sizeof(sortkey_t), _cmp_key);
+        for ( a = 0; a < nkeys; a = b ) {
+            b = a + 1;
+            while ( b < nkeys && keys[b].offset == keys[a].offset ) {
+                b++;
+            }
+            k = _known(tab, size, keys[a].offset, 1);
+            nout += _fold(prog, keys + a, b - a, k, out + nout);
+        }
+        if ( e >= prog->n ) {
+            break;
+        }
+        /* Domain boundary */
+        switch ( prog->recs[e].op ) {
+        case FM10K_PROG_POLL32:
+            k = _known(tab, size, prog->recs[e].offset, 0);
+            if ( NULL != k ) {
+                k->mask = 0;
+            }
+            break;
+        case FM10K_PROG_DELAY:
+            memset(tab, 0, sizeof(known_t) * size);
+            break;
+        case FM10K_PROG_BARRIER:
+            memset(tab, 0, sizeof(known_t) * size);
+            if ( nout == dom ) {
+                /* Empty domain */
+                continue;
+            }
+            break;
+        }
+        out[nout++] = prog->recs[e];
+    }
+
+    free(keys);
+    free(tab);
+    free(prog->recs);
+    s = prog->n - nout;
+    prog->recs = out;
+    prog->n = nout;
+    prog->max = prog->n;
+
+    return s;
+}
+
+/*
+ * Execute a program
+ */
+int
+fm10k_prog_apply(fm10k_t *fm10k, const fm10k_prog_t *prog)
+{
+    const fm10k_prog_rec_t *r;
+    struct timespec ts;
+    uint64_t deadline;
+    uint64_t m64;
+    uint32_t last;
+    int i;
+
+    last = 0;
+    for ( i = 0; i < prog->n; i++ ) {
+        r = &prog->recs[i];
+        switch ( r->op ) {
+        case FM10K_PROG_WR32:
+            wr32(fm10k->mmio, r->offset, (uint32_t)r->value);
+            last = r->offset;
+            break;
+        case FM10K_PROG_WR64:
+            wr64(fm10k->mmio, r->offset, r->value);
+            last = r->offset;
+            break;
+        case FM10K_PROG_RMW32:
+            m64 = rd32(fm10k->mmio, r->offset);
+            m64 = (m64 & ~r->mask) | r->value;
+            wr32(fm10k->mmio, r->offset, (uint32_t)m64);
+            last = r->offset;
+            break;
+        case FM10K_PROG_RMW64:
+            m64 = rd64(fm10k->mmio, r->offset);
+            m64 = (m64 & ~r->mask) | r->value;
+            wr64(fm10k->mmio, r->offset, m64);
+            last = r->offset;
+            break;
+        case FM10K_PROG_POLL32:
+            deadline = _now() + (uint64_t)r->timeout * 1000;
+            while ( (rd32(fm10k->mmio, r->offset) & (uint32_t)r->mask)
+                    != r->value ) {
+                if ( _now() > deadline ) {
+                    fprintf(stderr, "Register program: poll of %08x timed "
+                            "out at record %d\n", r->offset, i);
+                    return -1;
+                }
+            }
+            break;
+        case FM10K_PROG_DELAY:
+            ts.tv_sec = r->value / 1000000;
+            ts.tv_nsec = (r->value % 1000000) * 1000;
+            nanosleep(&ts, NULL);
+            break;
+        case FM10K_PROG_BARRIER:
+            /* Flush the posted writes */
+            (void)rd32(fm10k->mmio, last);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Write a program in text form, one record per line:
+ *   wr32|wr64 <offset> <value>
+ *   rmw32|rmw64 <offset> <value> <mask>
+ *   poll32 <offset> <value> <mask> <timeout us>
+ *   delay <us>
+ *   barrier
+ */
+int
+fm10k_prog_save(FILE *fp, const fm10k_prog_t *prog)
+{
+    const fm10k_prog_rec_t *r;
+    int i;
+
+    for ( i = 0; i < prog->n; i++ ) {
+        r = &prog->recs[i];
+        switch ( r->op ) {
+        case FM10K_PROG_WR32:
+        case FM10K_PROG_WR64:
+            fprintf(fp, "%s 0x%08x 0x%llx\n", opnames[r->op], r->offset,
+                    (unsigned long long)r->value);
+            break;
+        case FM10K_PROG_RMW32:
+        case FM10K_PROG_RMW64:
+            fprintf(fp, "%s 0x%08x 0x%llx 0x%llx\n", opnames[r->op],
+                    r->offset, (unsigned long long)r->value,
+                    (unsigned long long)r->mask);
+            break;
+        case FM10K_PROG_POLL32:
+            fprintf(fp, "%s 0x%08x 0x%llx 0x%llx %u\n", opnames[r->op],
+                    r->offset, (unsigned long long)r->value,
+                    (unsigned long long)r->mask, r->timeout);
+            break;
+        case FM10K_PROG_DELAY:
+            fprintf(fp, "%s %llu\n", opnames[r->op],
+                    (unsigned long long)r->value);
+            break;
+        case FM10K_PROG_BARRIER:
+            fprintf(fp, "%s\n", opnames[r->op]);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Read a program written by fm10k_prog_save
+ */
+int
+fm10k_prog_load(FILE *fp, fm10k_prog_t *prog)
+{
+    char buf[256];
+    char *tok[TOKENS_MAX];
+    char *save;
+    char *p;
+    uint64_t v[4];
+    int line;
+    int ret;
+    int op;
+    int n;
+    int i;
+
+    fm10k_prog_init(prog);
+    line = 0;
+    while ( fgets(buf, sizeof(buf), fp) ) {
+        line++;
+        p = strchr(buf, '#');
+        if ( p ) {
+            *p = '\0';
+        }
+        n = 0;
+        for ( p = strtok_r(buf, " \t\r\n", &save); p && n < TOKENS_MAX;
+              p = strtok_r(NULL, " \t\r\n", &save) ) {
+            tok[n++] = p;
+        }
+        if ( 0 == n ) {
+            continue;
+        }
+        for ( op = 0; op <= FM10K_PROG_BARRIER; op++ ) {
+            if ( 0 == strcmp(tok[0], opnames[op]) ) {
+                break;
+            }
+        }
+        memset(v, 0, sizeof(v));
+        for ( i = 1; i < n && i <= 4; i++ ) {
+            v[i - 1] = strtoull(tok[i], NULL, 0);
+        }
+        switch ( op ) {
+        case FM10K_PROG_WR32:
+        case FM10K_PROG_WR64:
+            if ( 3 != n ) {
+                goto error;
+            }
+            ret = fm10k_prog_add(prog, op, v[0], v[1],
+                                 FM10K_PROG_WR32 == op ? 0xffffffffULL : ~0ULL);
+            break;
+        case FM10K_PROG_RMW32:
+        case FM10K_PROG_RMW64:
+            if ( 4 != n ) {
+                goto error;
+            }
+            ret = fm10k_prog_add(prog, op, v[0], v[1] & v[2], v[2]);
+            break;
+        case FM10K_PROG_POLL32:
+            if ( 5 != n || v[3] > 0x7fffffff ) {
+                goto error;
+            }
+            ret = fm10k_prog_poll32(prog, v[0], v[1], v[2], v[3]);
+            break;
+        case FM10K_PROG_DELAY:
+            if ( 2 != n ) {
+                goto error;
+            }
+            ret = fm10k_prog_delay(prog, v[0]);
+            break;
+        case FM10K_PROG_BARRIER:
+            ret = fm10k_prog_barrier(prog);
+            break;
+        default:
+            goto error;
+        }
+        if ( ret < 0 ) {
+            fprintf(stderr, "Out of memory loading a register program\n");
+            fm10k_prog_free(prog);
+            return -1;
+        }
+    }
+
+    return 0;
+
+error:
+    fprintf(stderr, "Invalid register program at line %d\n", line);
+    fm10k_prog_free(prog);
+    return -1;
+}
+
+/*
+ * Write a program to a file; it is written aside and renamed so that an
+ * interrupted write keeps the previous contents
+ */
+int
+fm10k_prog_save_file(const char *path, const fm10k_prog_t *prog)
+{
+    char tmp[1024];
+    FILE *fp;
+    int ret;
+
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    fp = fopen(tmp, "w");
+    if ( NULL == fp ) {
+        perror(tmp);
+        return -1;
+    }
+    ret = fm10k_prog_save(fp, prog);
+    if ( fclose(fp) != 0 ) {
+        ret = -1;
+    }
+    if ( ret < 0 || rename(tmp, path) < 0 ) {
+        perror(path);
+        (void)unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
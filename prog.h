@@ -0,0 +1,98 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _PROG_H
+#define _PROG_H
+
+#include "fm10k.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/* Operations */
+#define FM10K_PROG_WR32         0
+#define FM10K_PROG_WR64         1
+/* reg = (reg & ~mask) | value */
+#define FM10K_PROG_RMW32        2
+#define FM10K_PROG_RMW64        3
+/* Wait until (reg & mask) == value for at most timeout microseconds */
+#define FM10K_PROG_POLL32       4
+/* Wait value microseconds */
+#define FM10K_PROG_DELAY        5
+/* End of an ordering domain */
+#define FM10K_PROG_BARRIER      6
+
+/*
+ * Register program record
+ */
+typedef struct _fm10k_prog_rec {
+    uint32_t offset;
+    uint32_t op;
+    uint64_t value;
+    uint64_t mask;
+    /* Poll timeout in microseconds */
+    uint32_t timeout;
+} fm10k_prog_rec_t;
+
+/*
+ * Register program
+ */
+typedef struct _fm10k_prog {
+    fm10k_prog_rec_t *recs;
+    int n;
+    int max;
+} fm10k_prog_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_prog_init(fm10k_prog_t *);
+void fm10k_prog_free(fm10k_prog_t *);
+int fm10k_prog_add(fm10k_prog_t *, int, uint32_t, uint64_t, uint64_t);
+int fm10k_prog_wr32(fm10k_prog_t *, uint32_t, uint32_t);
+int fm10k_prog_wr64(fm10k_prog_t *, uint32_t, uint64_t);
+int fm10k_prog_rmw32(fm10k_prog_t *, uint32_t, uint32_t, uint32_t);
+int fm10k_prog_rmw64(fm10k_prog_t *, uint32_t, uint64_t, uint64_t);
+int fm10k_prog_poll32(fm10k_prog_t *, uint32_t, uint32_t, uint32_t, int);
+int fm10k_prog_delay(fm10k_prog_t *, int);
+int fm10k_prog_barrier(fm10k_prog_t *);
+int fm10k_prog_optimize(fm10k_prog_t *);
+int fm10k_prog_apply(fm10k_t *, const fm10k_prog_t *);
+int fm10k_prog_save(FILE *, const fm10k_prog_t *);
+int fm10k_prog_load(FILE *, fm10k_prog_t *);
+int fm10k_prog_save_file(const char *, const fm10k_prog_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PROG_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,392 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ptp.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Host reference clock */
+#ifdef CLOCK_TAI
+#define _HOST_CLOCK     CLOCK_TAI
+#else
+#define _HOST_CLOCK     CLOCK_REALTIME
+#endif
+
+/* Largest frequency adjustment (ppb) */
+#define _MAX_PPB        1000000.0
+
+/*
+ * Host time in nanoseconds
+ */
+static uint64_t
+_host(clockid_t clk)
+{
+    struct timespec ts;
+
+    clock_gettime(clk, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Default configuration: 250 MHz reference, host-disciplined every second
+ */
+void
+fm10k_ptp_default_cfg(fm10k_ptp_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(fm10k_ptp_cfg_t));
+    cfg->clock_hz = 250000000ULL;
+    cfg->ring = 4096;
+    cfg->interval_us = 10;
+    cfg->sync_ms = 1000;
+    cfg->step_ns = 100000;
+    cfg->kp = 0.7;
+    cfg->ki = 0.3;
+}
+
+/*
+ * Nominal SYSTIME increment per reference clock cycle (2^-32 ns)
+ */
+static uint64_t
+_nominal_inc(const fm10k_ptp_cfg_t *cfg)
+{
+    return (1000000000ULL << 32) / cfg->clock_hz;
+}
+
+/*
+ * Start the system time at the host time
+ */
+int
+fm10k_ptp_init_clock(fm10k_t *fm10k, const fm10k_ptp_cfg_t *cfg)
+{
+    if ( 0 == cfg->clock_hz ) {
+        return -1;
+    }
+    wr64(fm10k->mmio, FM10K_SYSTIME_INC, _nominal_inc(cfg));
+    wr64(fm10k->mmio, FM10K_SYSTIME0, _host(_HOST_CLOCK));
+    /* Enable | Load */
+    wr32(fm10k->mmio, FM10K_SYSTIME_CFG, 0x3);
+
+    return 0;
+}
+
+/*
+ * Open the timestamp capture of the Ethernet ports of a port set
+ */
+int
+fm10k_ptp_open(fm10k_ptp_t *ptp, fm10k_t *fm10k, const fm10k_ports_t *ports,
+               const fm10k_ptp_cfg_t *cfg)
+{
+    const fm10k_port_cfg_t *port;
+    int i;
+
+    if ( 0 == cfg->clock_hz ) {
+        return -1;
+    }
+    memset(ptp, 0, sizeof(fm10k_ptp_t));
+    ptp->fm10k = fm10k;
+    ptp->cfg = *cfg;
+    ptp->inc = _nominal_inc(cfg);
+
+    for ( i = 0; i < ports->n; i++ ) {
+        port = &ports->port[i];
+        if ( port->epl < 0 ) {
+            continue;
+        }
+        ptp->ports[ptp->n].logical = port->logical;
+        ptp->ports[ptp->n].epl = port->epl;
+        ptp->ports[ptp->n].lane = port->lane;
+        /* Do not report stale timestamps */
+        ptp->ports[ptp->n].last
+            = rd64(fm10k->mmio, FM10K_MAC_1588_STATUS(port->epl, port->lane));
+        ptp->n++;
+    }
+
+    ptp->slots = malloc(sizeof(fm10k_ptp_ts_t) * cfg->ring);
+    if ( NULL == ptp->slots ) {
+        return -1;
+    }
+    if ( fm10k_ring_init(&ptp->ring, ptp->slots, sizeof(fm10k_ptp_ts_t),
+                         cfg->ring) < 0 ) {
+        free(ptp->slots);
+        return -1;
+    }
+    atomic_init(&ptp->running, 0);
+    atomic_init(&ptp->captured, 0);
+    atomic_init(&ptp->dropped, 0);
+
+    return 0;
+}
+
+/*
+ * Close the timestamp capture
+ */
+void
+fm10k_ptp_close(fm10k_ptp_t *ptp)
+{
+    fm10k_ptp_stop(ptp);
+    free(ptp->slots);
+    ptp->slots = NULL;
+}
+
+/*
+ * Read the system time
+ */
+uint64_t
+fm10k_ptp_gettime(fm10k_ptp_t *ptp)
+{
+    return rd64(ptp->fm10k->mmio, FM10K_SYSTIME);
+}
+
+/*
+ * Set the system time
+ */
+void
+fm10k_ptp_settime(fm10k_ptp_t *ptp, uint64_t ns)
+{
+    wr64(ptp->fm10k->mmio, FM10K_SYSTIME0, ns);
+    /* Enable | Load */
+    wr32(ptp->fm10k->mmio, FM10K_SYSTIME_CFG, 0x3);
+}
+
+/*
+ * Step the system time by a signed offset without stopping it
+ */
+void
+fm10k_ptp_adjtime(fm10k_ptp_t *ptp, int64_t delta)
+{
+    wr64(ptp->fm10k->mmio, FM10K_SYSTIME0, (uint64_t)delta);
+    /* Enable | Adjust */
+    wr32(ptp->fm10k->mmio, FM10K_SYSTIME_CFG, 0x5);
+}
+
+/*
+ * Set the frequency offset from the nominal rate (ppb)
+ */
+void
+fm10k_ptp_adjfreq(fm10k_ptp_t *ptp, double ppb)
+{
+    if ( ppb > _MAX_PPB ) {
+        ppb = _MAX_PPB;
+    } else if ( ppb < -_MAX_PPB ) {
+        ppb = -_MAX_PPB;
+    }
+    ptp->ppb = ppb;
+    wr64(ptp->fm10k->mmio, FM10K_SYSTIME_INC,
+         (uint64_t)(ptp->inc * (1.0 + ppb / 1e9)));
+}
+
+/*
+ * Feed a measured offset (switch time - reference time, ns) to the PI
+ * servo; the gains assume one sample per second
+ */
+void
+fm10k_ptp_servo(fm10k_ptp_t *ptp, int64_t offset)
+{
+    ptp->offset = offset;
+    if ( offset > ptp->cfg.step_ns || offset < -ptp->cfg.step_ns ) {
+        fm10k_ptp_adjtime(ptp, -offset);
+        ptp->integral = 0;
+        return;
+    }
+    ptp->integral += ptp->cfg.ki * offset;
+    fm10k_ptp_adjfreq(ptp, -(ptp->cfg.kp * offset + ptp->integral));
+}
+
+/*
+ * Measure the offset to the host clock and discipline the switch clock;
+ * the read latency is halved out by bracketing the SYSTIME read
+ */
+int64_t
+fm10k_ptp_sync_host(fm10k_ptp_t *ptp)
+{
+    uint64_t t1;
+    uint64_t t2;
+    uint64_t sys;
+    int64_t offset;
+
+    t1 = _host(_HOST_CLOCK);
+    sys = fm10k_ptp_gettime(ptp);
+    t2 = _host(_HOST_CLOCK);
+    offset = (int64_t)(sys - (t1 + (t2 - t1) / 2));
+    fm10k_ptp_servo(ptp, offset);
+
+    return offset;
+}
+
+/*
+ * Extend a 32-bit timestamp with the upper bits of the current time
+ */
+static __inline__ uint64_t
+_extend(uint64_t now, uint32_t ts)
+{
+    uint64_t full;
+
+    full = (now & ~0xffffffffULL) | ts;
+    if ( full > now ) {
+        full -= 1ULL << 32;
+    }
+
+    return full;
+}
+
+/*
+ * Publish a timestamp to the ring
+ */
+static __inline__ void
+_emit(fm10k_ptp_t *ptp, int port, int dir, uint64_t ns)
+{
+    fm10k_ptp_ts_t *ts;
+
+    ts = fm10k_ring_slot(&ptp->ring);
+    if ( NULL == ts ) {
+        atomic_fetch_add_explicit(&ptp->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    ts->ns = ns;
+    ts->port = port;
+    ts->dir = dir;
+    fm10k_ring_commit(&ptp->ring);
+    atomic_fetch_add_explicit(&ptp->captured, 1, memory_order_relaxed);
+}
+
+/*
+ * Capture new timestamps: one 64-bit read per port, which returns both the
+ * ingress and the egress timestamp, and one SYSTIME read per pass.  SYSTIME
+ * is read last, so that every timestamp was latched before it.  Returns the
+ * number of timestamps captured.
+ */
+int
+fm10k_ptp_poll(fm10k_ptp_t *ptp)
+{
+    uint64_t st[FM10K_PORT_MAX];
+    uint64_t now;
+    uint64_t diff;
+    int n;
+    int i;
+
+    n = 0;
+    for ( i = 0; i < ptp->n; i++ ) {
+        st[i] = rd64(ptp->fm10k->mmio,
+                     FM10K_MAC_1588_STATUS(ptp->ports[i].epl,
+                                           ptp->ports[i].lane));
+    }
+    now = rd64(ptp->fm10k->mmio, FM10K_SYSTIME);
+    for ( i = 0; i < ptp->n; i++ ) {
+        diff = st[i] ^ ptp->ports[i].last;
+        if ( !diff ) {
+            continue;
+        }
+        ptp->ports[i].last = st[i];
+        if ( diff & 0xffffffffULL ) {
+            _emit(ptp, ptp->ports[i].logical, FM10K_PTP_INGRESS,
+                  _extend(now, (uint32_t)st[i]));
+            n++;
+        }
+        if ( diff >> 32 ) {
+            _emit(ptp, ptp->ports[i].logical, FM10K_PTP_EGRESS,
+                  _extend(now, (uint32_t)(st[i] >> 32)));
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Capture thread
+ */
+static void *
+_capture(void *arg)
+{
+    fm10k_ptp_t *ptp;
+    struct timespec ts;
+    uint64_t next;
+    uint64_t now;
+
+    ptp = arg;
+    ts.tv_sec = 0;
+    ts.tv_nsec = ptp->cfg.interval_us * 1000L;
+    next = _host(CLOCK_MONOTONIC);
+    while ( atomic_load_explicit(&ptp->running, memory_order_relaxed) ) {
+        fm10k_ptp_poll(ptp);
+        if ( ptp->cfg.sync_ms ) {
+            now = _host(CLOCK_MONOTONIC);
+            if ( now >= next ) {
+                fm10k_ptp_sync_host(ptp);
+                next = now + ptp->cfg.sync_ms * 1000000ULL;
+            }
+        }
+        if ( ptp->cfg.interval_us ) {
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Start the capture thread; it is the only producer of the ring
+ */
+int
+fm10k_ptp_start(fm10k_ptp_t *ptp)
+{
+    atomic_store(&ptp->running, 1);
+    if ( pthread_create(&ptp->thread, NULL, _capture, ptp) != 0 ) {
+        atomic_store(&ptp->running, 0);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Stop the capture thread
+ */
+void
+fm10k_ptp_stop(fm10k_ptp_t *ptp)
+{
+    if ( atomic_exchange(&ptp->running, 0) ) {
+        pthread_join(ptp->thread, NULL);
+    }
+}
+
+/*
+ * Consumer: get the next timestamp (-1 if none)
+ */
+int
+fm10k_ptp_next(fm10k_ptp_t *ptp, fm10k_ptp_ts_t *ts)
+{
+    return fm10k_ring_pop(&ptp->ring, ts);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,130 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _PTP_H
+#define _PTP_H
+
+#include "fm10k.h"
+#include "port.h"
+#include "ring.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define FM10K_PTP_INGRESS       0
+#define FM10K_PTP_EGRESS        1
+
+/*
+ * Clock and capture configuration
+ */
+typedef struct _fm10k_ptp_cfg {
+    /* System time reference clock */
+    uint64_t clock_hz;
+    /* Timestamp ring entries (power of two) */
+    int ring;
+    /* Capture thread polling interval (0: busy poll) */
+    int interval_us;
+    /* Discipline the switch clock to the host clock every sync_ms
+       (0: left to the PTP daemon) */
+    int sync_ms;
+    /* Offsets above this are stepped instead of slewed */
+    int64_t step_ns;
+    /* PI servo gains */
+    double kp;
+    double ki;
+} fm10k_ptp_cfg_t;
+
+/*
+ * Timestamp record
+ */
+typedef struct _fm10k_ptp_ts {
+    uint64_t ns;
+    uint16_t port;
+    uint8_t dir;
+    uint8_t reserved[5];
+} fm10k_ptp_ts_t;
+
+/*
+ * PTP time subsystem
+ */
+typedef struct _fm10k_ptp {
+    fm10k_t *fm10k;
+    fm10k_ptp_cfg_t cfg;
+    /* Ports: location and the last MAC_1588_STATUS value */
+    struct {
+        int logical;
+        int epl;
+        int lane;
+        uint64_t last;
+    } ports[FM10K_PORT_MAX];
+    int n;
+    /* Nominal increment (2^-32 ns) and the current frequency offset */
+    uint64_t inc;
+    double ppb;
+    double integral;
+    int64_t offset;
+    /* Timestamp ring and its producer */
+    fm10k_ring_t ring;
+    fm10k_ptp_ts_t *slots;
+    pthread_t thread;
+    atomic_int running;
+    atomic_uint_fast64_t captured;
+    atomic_uint_fast64_t dropped;
+} fm10k_ptp_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_ptp_default_cfg(fm10k_ptp_cfg_t *);
+int fm10k_ptp_init_clock(fm10k_t *, const fm10k_ptp_cfg_t *);
+int fm10k_ptp_open(fm10k_ptp_t *, fm10k_t *, const fm10k_ports_t *,
+                   const fm10k_ptp_cfg_t *);
+void fm10k_ptp_close(fm10k_ptp_t *);
+uint64_t fm10k_ptp_gettime(fm10k_ptp_t *);
+void fm10k_ptp_settime(fm10k_ptp_t *, uint64_t);
+void fm10k_ptp_adjtime(fm10k_ptp_t *, int64_t);
+void fm10k_ptp_adjfreq(fm10k_ptp_t *, double);
+void fm10k_ptp_servo(fm10k_ptp_t *, int64_t);
+int64_t fm10k_ptp_sync_host(fm10k_ptp_t *);
+int fm10k_ptp_poll(fm10k_ptp_t *);
+int fm10k_ptp_start(fm10k_ptp_t *);
+void fm10k_ptp_stop(fm10k_ptp_t *);
+int fm10k_ptp_next(fm10k_ptp_t *, fm10k_ptp_ts_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PTP_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,108 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "libfm10k.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-q] <uio device> <offset> [<value>]\n"
+            "  -q  64-bit access\n"
+            "Reads the register, or writes the value to it.\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    fm10k_t fm10k;
+    unsigned long offset;
+    unsigned long long value;
+    char *end;
+    int wide;
+    int opt;
+
+    wide = 0;
+    while ( (opt = getopt(argc, argv, "q")) != -1 ) {
+        switch ( opt ) {
+        case 'q':
+            wide = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( argc - optind != 2 && argc - optind != 3 ) {
+        usage(argv[0]);
+    }
+    offset = strtoul(argv[optind + 1], &end, 0);
+    if ( '\0' != *end || offset & (wide ? 7 : 3)
+         || offset > FM10K_BAR4_SIZE - (wide ? 8 : 4) ) {
+        fprintf(stderr, "Invalid offset: %s\n", argv[optind + 1]);
+        return EXIT_FAILURE;
+    }
+    value = 0;
+    if ( argc - optind == 3 ) {
+        value = strtoull(argv[optind + 2], &end, 0);
+        if ( '\0' != *end ) {
+            fprintf(stderr, "Invalid value: %s\n", argv[optind + 2]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( fm10k_open(&fm10k, argv[optind]) < 0 ) {
+        return EXIT_FAILURE;
+    }
+    if ( argc - optind == 3 ) {
+        if ( wide ) {
+            wr64(fm10k.mmio, offset, value);
+        } else {
+            wr32(fm10k.mmio, offset, value);
+        }
+    } else if ( wide ) {
+        printf("0x%016llx\n", (unsigned long long)rd64(fm10k.mmio, offset));
+    } else {
+        printf("0x%08x\n", rd32(fm10k.mmio, offset));
+    }
+    fm10k_close(&fm10k);
+
+    return EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,148 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Single-producer/single-consumer lock-free ring of fixed-size records.
+ * The producer and the consumer indices live on separate cache lines.
+ */
+typedef struct _fm10k_ring {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    _Alignas(64) size_t mask;
+    size_t size;
+    uint8_t *buf;
+} fm10k_ring_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Initialize a ring over buf (n records of size bytes, n a power of two)
+ */
+static __inline__ int
+fm10k_ring_init(fm10k_ring_t *ring, void *buf, size_t size, size_t n)
+{
+    if ( 0 == n || (n & (n - 1)) ) {
+        return -1;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->mask = n - 1;
+    ring->size = size;
+    ring->buf = buf;
+
+    return 0;
+}
+
+/*
+ * Producer: get the next free slot (NULL if full) without publishing it
+ */
+static __inline__ void *
+fm10k_ring_slot(fm10k_ring_t *ring)
+{
+    size_t h;
+    size_t t;
+
+    h = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    t = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if ( h - t > ring->mask ) {
+        return NULL;
+    }
+
+    return ring->buf + (h & ring->mask) * ring->size;
+}
+
+/*
+ * Producer: publish the slot returned by fm10k_ring_slot()
+ */
+static __inline__ void
+fm10k_ring_commit(fm10k_ring_t *ring)
+{
+    size_t h;
+
+    h = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, h + 1, memory_order_release);
+}
+
+/*
+ * Producer: copy a record into the ring
+ */
+static __inline__ int
+fm10k_ring_push(fm10k_ring_t *ring, const void *rec)
+{
+    void *slot;
+
+    slot = fm10k_ring_slot(ring);
+    if ( NULL == slot ) {
+        return -1;
+    }
+    memcpy(slot, rec, ring->size);
+    fm10k_ring_commit(ring);
+
+    return 0;
+}
+
+/*
+ * Consumer: copy the oldest record out of the ring
+ */
+static __inline__ int
+fm10k_ring_pop(fm10k_ring_t *ring, void *rec)
+{
+    size_t h;
+    size_t t;
+
+    t = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    h = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if ( t == h ) {
+        return -1;
+    }
+    memcpy(rec, ring->buf + (t & ring->mask) * ring->size, ring->size);
+    atomic_store_explicit(&ring->tail, t + 1, memory_order_release);
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RING_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,318 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "sbus.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Start the next queued command
+ */
+static void
+_issue(fm10k_sbus_t *sbus)
+{
+    fm10k_sbus_cmd_t *cmd;
+
+    cmd = &sbus->queue[sbus->head];
+    if ( FM10K_SBUS_OP_WRITE == cmd->op ) {
+        wr32(sbus->fm10k->mmio, sbus->request, cmd->data);
+    }
+    /* Register | Address | Op | Execute */
+    wr32(sbus->fm10k->mmio, sbus->command,
+         cmd->reg | (cmd->addr << 8) | (cmd->op << 16) | (1UL << 24));
+    sbus->inflight = sbus->head++;
+    sbus->deadline = _now() + sbus->timeout_us * 1000ULL;
+    sbus->ncmds++;
+}
+
+/*
+ * Poll the command in flight: 1 if completed, 0 if still busy, -1 on error
+ */
+static int
+_poll(fm10k_sbus_t *sbus)
+{
+    fm10k_sbus_cmd_t *cmd;
+    uint32_t m32;
+    int expect;
+
+    cmd = &sbus->queue[sbus->inflight];
+    m32 = rd32(sbus->fm10k->mmio, sbus->command);
+    sbus->npolls++;
+    if ( m32 & (1UL << 25) ) {
+        if ( _now() > sbus->deadline ) {
+            fprintf(stderr, "SBUS%d: timeout (addr %02x reg %02x)\n",
+                    sbus->ring, cmd->addr, cmd->reg);
+            return -1;
+        }
+        return 0;
+    }
+
+    switch ( cmd->op ) {
+    case FM10K_SBUS_OP_RESET:
+        expect = FM10K_SBUS_RESULT_RESET;
+        break;
+    case FM10K_SBUS_OP_WRITE:
+        expect = FM10K_SBUS_RESULT_WRITE;
+        break;
+    default:
+        expect = FM10K_SBUS_RESULT_READ;
+    }
+    /* Broadcast commands carry no meaningful result code */
+    if ( cmd->addr != FM10K_SBUS_BCAST && cmd->addr != FM10K_SBUS_SERDES_BCAST
+         && (int)((m32 >> 26) & 0x7) != expect ) {
+        fprintf(stderr, "SBUS%d: result %d (addr %02x reg %02x op %02x)\n",
+                sbus->ring, (m32 >> 26) & 0x7, cmd->addr, cmd->reg, cmd->op);
+        return -1;
+    }
+    if ( cmd->result ) {
+        *cmd->result = rd32(sbus->fm10k->mmio, sbus->response);
+    }
+    sbus->inflight = -1;
+
+    return 1;
+}
+
+/*
+ * Open an SBUS master (FM10K_SBUS_EPL or FM10K_SBUS_PCIE)
+ */
+int
+fm10k_sbus_open(fm10k_sbus_t *sbus, fm10k_t *fm10k, int ring)
+{
+    memset(sbus, 0, sizeof(fm10k_sbus_t));
+    sbus->fm10k = fm10k;
+    sbus->ring = ring;
+    sbus->timeout_us = 1000;
+    sbus->inflight = -1;
+
+    switch ( ring ) {
+    case FM10K_SBUS_EPL:
+        sbus->cfg = FM10K_SBUS_EPL_CFG;
+        sbus->command = FM10K_SBUS_EPL_COMMAND;
+        sbus->request = FM10K_SBUS_EPL_REQUEST;
+        sbus->response = FM10K_SBUS_EPL_RESPONSE;
+        break;
+    case FM10K_SBUS_PCIE:
+        sbus->cfg = FM10K_SBUS_PCIE_CFG;
+        sbus->command = FM10K_SBUS_PCIE_COMMAND;
+        sbus->request = FM10K_SBUS_PCIE_REQUEST;
+        sbus->response = FM10K_SBUS_PCIE_RESPONSE;
+        break;
+    default:
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Reset the SBUS controller and wait for its ROM load to complete
+ */
+int
+fm10k_sbus_init(fm10k_sbus_t *sbus)
+{
+    struct timespec ts;
+    uint32_t m32;
+    int i;
+
+    /* Toggle SBUS_ControllerReset */
+    m32 = rd32(sbus->fm10k->mmio, sbus->cfg);
+    wr32(sbus->fm10k->mmio, sbus->cfg, m32 | 1);
+
+    /* Wait 1us */
+    ts.tv_sec  = 0;
+    ts.tv_nsec = 1000L;
+    nanosleep(&ts, NULL);
+
+    wr32(sbus->fm10k->mmio, sbus->cfg, m32 & ~1UL);
+
+    /* Wait up to 100ms for RomBusy to clear */
+    ts.tv_nsec = 100000L;
+    for ( i = 0; i < 1000; i++ ) {
+        m32 = rd32(sbus->fm10k->mmio, sbus->cfg);
+        if ( !(m32 & (1 << 2)) ) {
+            break;
+        }
+        nanosleep(&ts, NULL);
+    }
+    if ( i == 1000 ) {
+        fprintf(stderr, "SBUS%d: ROM load timeout\n", sbus->ring);
+        return -1;
+    }
+    if ( m32 & (1 << 4) ) {
+        fprintf(stderr, "SBUS%d: BIST failed\n", sbus->ring);
+        return -1;
+    }
+
+    /* Reset the ring */
+    return fm10k_sbus_reset(sbus, FM10K_SBUS_CONTROLLER);
+}
+
+/*
+ * Queue a command; the queue is flushed when full.  For reads, the result
+ * is stored to *result when the command completes.
+ */
+int
+fm10k_sbus_queue(fm10k_sbus_t *sbus, uint8_t op, uint8_t addr, uint8_t reg,
+                 uint32_t data, uint32_t *result)
+{
+    fm10k_sbus_cmd_t *cmd;
+
+    if ( sbus->nqueue == FM10K_SBUS_QUEUE ) {
+        if ( fm10k_sbus_flush(sbus) < 0 ) {
+            return -1;
+        }
+    }
+    cmd = &sbus->queue[sbus->nqueue++];
+    cmd->op = op;
+    cmd->addr = addr;
+    cmd->reg = reg;
+    cmd->data = data;
+    cmd->result = result;
+
+    return 0;
+}
+
+/*
+ * Execute the queued commands of one master
+ */
+int
+fm10k_sbus_flush(fm10k_sbus_t *sbus)
+{
+    return fm10k_sbus_flush_all(&sbus, 1);
+}
+
+/*
+ * Execute the queued commands of several masters concurrently.  Each master
+ * gets its next command as soon as its previous one completes, so the EPL
+ * and PCIe rings overlap and no master ever sleeps between commands.
+ */
+int
+fm10k_sbus_flush_all(fm10k_sbus_t **sbus, int n)
+{
+    fm10k_sbus_t *s;
+    int active;
+    int ret;
+    int i;
+
+    ret = 0;
+    do {
+        active = 0;
+        for ( i = 0; i < n; i++ ) {
+            s = sbus[i];
+            if ( s->inflight >= 0 ) {
+                switch ( _poll(s) ) {
+                case 0:
+                    active = 1;
+                    continue;
+                case 1:
+                    break;
+                default:
+                    /* Abandon the rest of this master's queue */
+                    s->inflight = -1;
+                    s->head = s->nqueue;
+                    ret = -1;
+                    continue;
+                }
+            }
+            if ( s->head < s->nqueue ) {
+                _issue(s);
+                active = 1;
+            }
+        }
+    } while ( active );
+
+    for ( i = 0; i < n; i++ ) {
+        sbus[i]->nqueue = 0;
+        sbus[i]->head = 0;
+    }
+
+    return ret;
+}
+
+/*
+ * Write a register of a receiver
+ */
+int
+fm10k_sbus_write(fm10k_sbus_t *sbus, uint8_t addr, uint8_t reg,
+                 uint32_t data)
+{
+    if ( fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr, reg, data, NULL)
+         < 0 ) {
+        return -1;
+    }
+
+    return fm10k_sbus_flush(sbus);
+}
+
+/*
+ * Read a register of a receiver
+ */
+int
+fm10k_sbus_read(fm10k_sbus_t *sbus, uint8_t addr, uint8_t reg,
+                uint32_t *data)
+{
+    if ( fm10k_sbus_queue(sbus, FM10K_SBUS_OP_READ, addr, reg, 0, data)
+         < 0 ) {
+        return -1;
+    }
+
+    return fm10k_sbus_flush(sbus);
+}
+
+/*
+ * Reset a receiver
+ */
+int
+fm10k_sbus_reset(fm10k_sbus_t *sbus, uint8_t addr)
+{
+    if ( fm10k_sbus_queue(sbus, FM10K_SBUS_OP_RESET, addr, 0, 0, NULL)
+         < 0 ) {
+        return -1;
+    }
+
+    return fm10k_sbus_flush(sbus);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
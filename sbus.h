@@ -0,0 +1,115 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _SBUS_H
+#define _SBUS_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+/* SBUS rings */
+#define FM10K_SBUS_EPL          0
+#define FM10K_SBUS_PCIE         1
+
+/* Receiver addresses */
+#define FM10K_SBUS_SERDES_BCAST 0xe1
+#define FM10K_SBUS_SBM          0xfd
+#define FM10K_SBUS_CONTROLLER   0xfe
+#define FM10K_SBUS_BCAST        0xff
+
+/* Operations and their result codes */
+#define FM10K_SBUS_OP_RESET     0x20
+#define FM10K_SBUS_OP_WRITE     0x21
+#define FM10K_SBUS_OP_READ      0x22
+#define FM10K_SBUS_RESULT_RESET 0x0
+#define FM10K_SBUS_RESULT_WRITE 0x1
+#define FM10K_SBUS_RESULT_READ  0x4
+
+/* Commands queued before a flush */
+#define FM10K_SBUS_QUEUE        256
+
+/*
+ * Queued command
+ */
+typedef struct _fm10k_sbus_cmd {
+    uint8_t op;
+    uint8_t addr;
+    uint8_t reg;
+    uint32_t data;
+    /* Read result (NULL for writes) */
+    uint32_t *result;
+} fm10k_sbus_cmd_t;
+
+/*
+ * SBUS master
+ */
+typedef struct _fm10k_sbus {
+    fm10k_t *fm10k;
+    int ring;
+    long cfg;
+    long command;
+    long request;
+    long response;
+    /* Per-command completion timeout and deadline of the command in
+       flight */
+    long timeout_us;
+    uint64_t deadline;
+    /* Command queue and the command in flight (-1: none) */
+    fm10k_sbus_cmd_t queue[FM10K_SBUS_QUEUE];
+    int nqueue;
+    int head;
+    int inflight;
+    /* Statistics */
+    uint64_t ncmds;
+    uint64_t npolls;
+} fm10k_sbus_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_sbus_open(fm10k_sbus_t *, fm10k_t *, int);
+int fm10k_sbus_init(fm10k_sbus_t *);
+int fm10k_sbus_queue(fm10k_sbus_t *, uint8_t, uint8_t, uint8_t, uint32_t,
+                     uint32_t *);
+int fm10k_sbus_flush(fm10k_sbus_t *);
+int fm10k_sbus_flush_all(fm10k_sbus_t **, int);
+int fm10k_sbus_write(fm10k_sbus_t *, uint8_t, uint8_t, uint32_t);
+int fm10k_sbus_read(fm10k_sbus_t *, uint8_t, uint8_t, uint32_t *);
+int fm10k_sbus_reset(fm10k_sbus_t *, uint8_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SBUS_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
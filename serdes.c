@@ -0,0 +1,456 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "serdes.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Per-lane bring-up steps */
+#define _STEP_CRC       0
+#define _STEP_TXRX      1
+#define _STEP_RATE      2
+#define _STEP_DFE       3
+#define _STEP_DFE_WAIT  4
+#define _STEP_DONE      5
+#define _STEP_FAILED    6
+
+/* Rounds an interrupt may stay in progress */
+#define _INT_ROUNDS     1000
+
+/*
+ * Lane state
+ */
+typedef struct _lane {
+    int step;
+    /* Interrupt issued and not completed yet */
+    int pending;
+    int rounds;
+    int retried;
+    int crc_error;
+    uint32_t status;
+    uint64_t deadline;
+} _lane_t;
+
+/*
+ * Monotonic time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Default configuration: all lanes at 10G, broadcast upload
+ */
+void
+fm10k_serdes_default_cfg(fm10k_serdes_cfg_t *cfg)
+{
+    int i;
+
+    memset(cfg, 0, sizeof(fm10k_serdes_cfg_t));
+    cfg->fw = FM10K_SERDES_FW;
+    cfg->lanes = (1ULL << FM10K_SERDES_LANES) - 1;
+    for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+        cfg->rate[i] = FM10K_SERDES_RATE_10G;
+    }
+    cfg->broadcast = 1;
+    cfg->tune_timeout_ms = 2000;
+}
+
+/*
+ * Load a firmware image; returns the number of words
+ */
+int
+fm10k_serdes_load_fw(const char *path, uint16_t *fw, int max)
+{
+    FILE *fp;
+    char buf[64];
+    char *end;
+    unsigned long w;
+    int n;
+
+    fp = fopen(path, "r");
+    if ( NULL == fp ) {
+        perror(path);
+        return -1;
+    }
+    n = 0;
+    while ( fgets(buf, sizeof(buf), fp) ) {
+        w = strtoul(buf, &end, 16);
+        if ( end == buf ) {
+            /* Blank line */
+            continue;
+        }
+        if ( w > 0x3ff || n >= max ) {
+            fprintf(stderr, "%s: invalid image at word %d\n", path, n);
+            fclose(fp);
+            return -1;
+        }
+        fw[n++] = w;
+    }
+    fclose(fp);
+
+    return n;
+}
+
+/*
+ * Queue the upload of a firmware image to a receiver (a lane or the SerDes
+ * broadcast address)
+ */
+static int
+_upload(fm10k_sbus_t *sbus, uint8_t addr, const uint16_t *fw, int n)
+{
+    uint32_t data;
+    int ret;
+    int i;
+
+    /* Hold SPICO in reset with IMEM access, then release the reset */
+    ret = fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                           FM10K_SERDES_REG_SPICO_CTRL, 0x11, NULL);
+    ret |= fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                            FM10K_SERDES_REG_SPICO_CTRL, 0x10, NULL);
+    /* IMEM override, burst from address 0 */
+    ret |= fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                            FM10K_SERDES_REG_IMEM_CFG, 0x30000000, NULL);
+    ret |= fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                            FM10K_SERDES_REG_IMEM_CTRL, 0x40000000, NULL);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    /* Three words per write */
+    for ( i = 0; i < n; i += 3 ) {
+        data = fw[i];
+        if ( i + 1 < n ) {
+            data |= (uint32_t)fw[i + 1] << 10;
+        }
+        if ( i + 2 < n ) {
+            data |= (uint32_t)fw[i + 2] << 20;
+        }
+        data |= (uint32_t)(n - i < 3 ? n - i : 3) << 30;
+        ret = fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                               FM10K_SERDES_REG_IMEM_DATA, data, NULL);
+        if ( ret < 0 ) {
+            return -1;
+        }
+    }
+
+    /* End the burst, enable ECC and start SPICO */
+    ret = fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                           FM10K_SERDES_REG_IMEM_CTRL, 0, NULL);
+    ret |= fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                            FM10K_SERDES_REG_IMEM_CFG, 0x40000, NULL);
+    ret |= fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, addr,
+                            FM10K_SERDES_REG_SPICO_CTRL, 0x02, NULL);
+
+    return ret;
+}
+
+/*
+ * Queue the SPICO interrupt of a lane's current step
+ */
+static int
+_interrupt(fm10k_sbus_t *sbus, const fm10k_serdes_cfg_t *cfg, int i,
+           _lane_t *lane)
+{
+    uint32_t code;
+    uint32_t data;
+
+    switch ( lane->step ) {
+    case _STEP_CRC:
+        code = FM10K_SERDES_INT_CRC;
+        data = 0;
+        break;
+    case _STEP_TXRX:
+        code = FM10K_SERDES_INT_TXRX_EN;
+        data = 0x3;
+        break;
+    case _STEP_RATE:
+        code = FM10K_SERDES_INT_RATE;
+        data = cfg->rate[i];
+        break;
+    case _STEP_DFE:
+        /* Initial calibration */
+        code = FM10K_SERDES_INT_DFE;
+        data = 0x1;
+        break;
+    default:
+        code = FM10K_SERDES_INT_DFE_STATUS;
+        data = 0x0b00;
+    }
+
+    return fm10k_sbus_queue(sbus, FM10K_SBUS_OP_WRITE, FM10K_SERDES_ADDR(i),
+                            FM10K_SERDES_REG_INT, (code << 16) | data, NULL);
+}
+
+/*
+ * Advance a lane whose interrupt completed
+ */
+static int
+_advance(fm10k_sbus_t *sbus, const fm10k_serdes_cfg_t *cfg, int i,
+         _lane_t *lane, const uint16_t *fw, int n, uint64_t now)
+{
+    uint16_t result;
+
+    result = lane->status & 0xffff;
+    switch ( lane->step ) {
+    case _STEP_CRC:
+        if ( result == 0 ) {
+            lane->step = _STEP_TXRX;
+        } else if ( !lane->retried ) {
+            /* Reload this lane alone; the upload precedes the next CRC
+               interrupt on the ring */
+            lane->retried = 1;
+            if ( _upload(sbus, FM10K_SERDES_ADDR(i), fw, n) < 0 ) {
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "SerDes %d: firmware CRC error\n", i);
+            lane->crc_error = 1;
+            lane->step = _STEP_FAILED;
+        }
+        break;
+    case _STEP_TXRX:
+    case _STEP_RATE:
+        lane->step++;
+        break;
+    case _STEP_DFE:
+        lane->step = _STEP_DFE_WAIT;
+        lane->deadline = now + cfg->tune_timeout_ms * 1000000ULL;
+        break;
+    case _STEP_DFE_WAIT:
+        /* Bits 1:0: calibration/adaptation in progress */
+        if ( !(result & 0x3) ) {
+            lane->step = _STEP_DONE;
+        } else if ( now > lane->deadline ) {
+            fprintf(stderr, "SerDes %d: DFE tuning timeout\n", i);
+            lane->step = _STEP_FAILED;
+        }
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Bring up the EPL SerDes.  The firmware is uploaded once by broadcast,
+ * then every lane runs its own CRC check, initialization and DFE tuning
+ * steps.  Each round issues the next step of all lanes back to back on
+ * the SBUS and collects their results with a single flush, so the lanes
+ * proceed concurrently and a slow lane does not hold the others.
+ */
+int
+fm10k_serdes_bringup(fm10k_t *fm10k, const fm10k_serdes_cfg_t *cfg,
+                     fm10k_serdes_report_t *report)
+{
+    fm10k_sbus_t *sbus;
+    _lane_t lanes[FM10K_SERDES_LANES];
+    uint16_t *fw;
+    uint64_t t0;
+    uint64_t t;
+    int active;
+    int minstep;
+    int n;
+    int i;
+    int ret;
+
+    memset(report, 0, sizeof(fm10k_serdes_report_t));
+    memset(lanes, 0, sizeof(lanes));
+
+    fw = malloc(sizeof(uint16_t) * FM10K_SERDES_FW_MAX);
+    sbus = malloc(sizeof(fm10k_sbus_t));
+    if ( NULL == fw || NULL == sbus ) {
+        free(fw);
+        free(sbus);
+        return -1;
+    }
+    ret = -1;
+    n = fm10k_serdes_load_fw(cfg->fw, fw, FM10K_SERDES_FW_MAX);
+    if ( n < 0 ) {
+        goto out;
+    }
+    report->nwords = n;
+    if ( fm10k_sbus_open(sbus, fm10k, FM10K_SBUS_EPL) < 0 ) {
+        goto out;
+    }
+
+    /* Upload */
+    t0 = _now();
+    if ( cfg->broadcast ) {
+        if ( _upload(sbus, FM10K_SBUS_SERDES_BCAST, fw, n) < 0 ) {
+            goto out;
+        }
+    } else {
+        for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+            if ( !(cfg->lanes & (1ULL << i)) ) {
+                continue;
+            }
+            if ( _upload(sbus, FM10K_SERDES_ADDR(i), fw, n) < 0 ) {
+                goto out;
+            }
+        }
+    }
+    if ( fm10k_sbus_flush(sbus) < 0 ) {
+        goto out;
+    }
+    t = _now();
+    report->upload_ns = t - t0;
+    t0 = t;
+
+    for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+        if ( cfg->lanes & (1ULL << i) ) {
+            report->nlanes++;
+        } else {
+            lanes[i].step = _STEP_DONE;
+        }
+    }
+
+    /* Per-lane steps */
+    do {
+        for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+            if ( lanes[i].step >= _STEP_DONE ) {
+                continue;
+            }
+            if ( !lanes[i].pending ) {
+                if ( _interrupt(sbus, cfg, i, &lanes[i]) < 0 ) {
+                    goto out;
+                }
+                lanes[i].pending = 1;
+                lanes[i].rounds = 0;
+            }
+            if ( fm10k_sbus_queue(sbus, FM10K_SBUS_OP_READ,
+                                  FM10K_SERDES_ADDR(i),
+                                  FM10K_SERDES_REG_INT_STATUS, 0,
+                                  &lanes[i].status) < 0 ) {
+                goto out;
+            }
+        }
+        if ( fm10k_sbus_flush(sbus) < 0 ) {
+            goto out;
+        }
+
+        t = _now();
+        active = 0;
+        minstep = _STEP_DONE;
+        for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+            if ( lanes[i].step >= _STEP_DONE ) {
+                continue;
+            }
+            if ( lanes[i].status & (1 << 16) ) {
+                /* Interrupt in progress */
+                if ( ++lanes[i].rounds > _INT_ROUNDS ) {
+                    fprintf(stderr, "SerDes %d: interrupt timeout\n", i);
+                    lanes[i].step = _STEP_FAILED;
+                    continue;
+                }
+            } else {
+                lanes[i].pending = 0;
+                if ( _advance(sbus, cfg, i, &lanes[i], fw, n, t) < 0 ) {
+                    goto out;
+                }
+            }
+            if ( lanes[i].step < _STEP_DONE ) {
+                active = 1;
+                if ( lanes[i].step < minstep ) {
+                    minstep = lanes[i].step;
+                }
+            }
+        }
+
+        /* Phase boundaries: the slowest lane leaves the phase */
+        if ( !report->crc_ns && minstep > _STEP_CRC ) {
+            report->crc_ns = t - t0;
+        }
+        if ( !report->init_ns && minstep > _STEP_RATE ) {
+            report->init_ns = t - t0 - report->crc_ns;
+        }
+        if ( !active ) {
+            report->tune_ns = t - t0 - report->crc_ns - report->init_ns;
+        }
+    } while ( active );
+
+    for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+        if ( lanes[i].step == _STEP_FAILED ) {
+            report->failed |= 1ULL << i;
+            if ( lanes[i].crc_error ) {
+                report->crc_failed |= 1ULL << i;
+            }
+        }
+    }
+    report->ncmds = sbus->ncmds;
+    ret = report->failed ? -1 : 0;
+
+out:
+    free(fw);
+    free(sbus);
+
+    return ret;
+}
+
+/*
+ * Print the bring-up timing report
+ */
+void
+fm10k_serdes_print_report(FILE *fp, const fm10k_serdes_report_t *report)
+{
+    uint64_t total;
+    int i;
+
+    total = report->upload_ns + report->crc_ns + report->init_ns
+        + report->tune_ns;
+    fprintf(fp, "SerDes bring-up: %d lanes, %d firmware words\n",
+            report->nlanes, report->nwords);
+    fprintf(fp, "  upload %10.3f ms\n", report->upload_ns / 1e6);
+    fprintf(fp, "  crc    %10.3f ms\n", report->crc_ns / 1e6);
+    fprintf(fp, "  init   %10.3f ms\n", report->init_ns / 1e6);
+    fprintf(fp, "  tune   %10.3f ms\n", report->tune_ns / 1e6);
+    fprintf(fp, "  total  %10.3f ms, %.1f lanes/s, %llu SBUS commands\n",
+            total / 1e6, total ? report->nlanes * 1e9 / total : 0.0,
+            (unsigned long long)report->ncmds);
+    if ( report->failed ) {
+        fprintf(fp, "  failed lanes:");
+        for ( i = 0; i < FM10K_SERDES_LANES; i++ ) {
+            if ( report->failed & (1ULL << i) ) {
+                fprintf(fp, " %d%s", i,
+                        report->crc_failed & (1ULL << i) ? "(crc)" : "");
+            }
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,129 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef _SERDES_H
+#define _SERDES_H
+
+#include "fm10k.h"
+#include "sbus.h"
+#include <stdint.h>
+#include <stdio.h>
+
+/* EPL SerDes: 9 EPLs x 4 lanes, SBUS receiver address = lane + 1 */
+#define FM10K_SERDES_LANES      36
+#define FM10K_SERDES_ADDR(i)    ((i) + 1)
+
+/* Default firmware image (one 10-bit hex word per line) */
+#define FM10K_SERDES_FW         "/lib/firmware/fm10k_serdes.rom"
+#define FM10K_SERDES_FW_MAX     16384
+
+/*
+ * SerDes registers on SBUS
+ *
+ * 0x00 IMEM_CTRL:  15:0 burst start address, 30 burst enable
+ * 0x03 INT:        15:0 data, 31:16 interrupt code
+ * 0x04 INT_STATUS: 15:0 result, 16 in progress
+ * 0x07 SPICO_CTRL: 0 reset, 1 enable, 4 IMEM access
+ * 0x08 IMEM_CFG:   29:28 IMEM override, 18 ECC enable
+ * 0x0a IMEM_DATA:  9:0, 19:10, 29:20 words, 31:30 word count
+ */
+#define FM10K_SERDES_REG_IMEM_CTRL      0x00
+#define FM10K_SERDES_REG_INT            0x03
+#define FM10K_SERDES_REG_INT_STATUS     0x04
+#define FM10K_SERDES_REG_SPICO_CTRL     0x07
+#define FM10K_SERDES_REG_IMEM_CFG       0x08
+#define FM10K_SERDES_REG_IMEM_DATA      0x0a
+
+/* SPICO interrupts */
+#define FM10K_SERDES_INT_TXRX_EN        0x01
+#define FM10K_SERDES_INT_RATE           0x05
+#define FM10K_SERDES_INT_DFE            0x0a
+#define FM10K_SERDES_INT_DFE_STATUS     0x26
+#define FM10K_SERDES_INT_CRC            0x3c
+
+/* Rate dividers for a 156.25 MHz reference clock */
+#define FM10K_SERDES_RATE_1G    8
+#define FM10K_SERDES_RATE_10G   66
+#define FM10K_SERDES_RATE_25G   165
+
+/*
+ * Bring-up configuration
+ */
+typedef struct _fm10k_serdes_cfg {
+    /* Firmware image path */
+    const char *fw;
+    /* Lanes to bring up (bitmap) */
+    uint64_t lanes;
+    /* Rate divider of each lane */
+    uint16_t rate[FM10K_SERDES_LANES];
+    /* Upload the image by SBUS broadcast (0: per-lane upload) */
+    int broadcast;
+    /* Give up on a lane's tuning after this (ms) */
+    int tune_timeout_ms;
+} fm10k_serdes_cfg_t;
+
+/*
+ * Bring-up result and timing
+ */
+typedef struct _fm10k_serdes_report {
+    int nwords;
+    int nlanes;
+    /* Lanes whose firmware CRC check failed after the retry */
+    uint64_t crc_failed;
+    /* Lanes that failed initialization or tuning */
+    uint64_t failed;
+    /* Phase durations (ns) */
+    uint64_t upload_ns;
+    uint64_t crc_ns;
+    uint64_t init_ns;
+    uint64_t tune_ns;
+    /* SBUS commands issued */
+    uint64_t ncmds;
+} fm10k_serdes_report_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_serdes_default_cfg(fm10k_serdes_cfg_t *);
+int fm10k_serdes_load_fw(const char *, uint16_t *, int);
+int fm10k_serdes_bringup(fm10k_t *, const fm10k_serdes_cfg_t *,
+                         fm10k_serdes_report_t *);
+void fm10k_serdes_print_report(FILE *, const fm10k_serdes_report_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SERDES_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
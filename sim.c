@@ -0,0 +1,80 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "sim.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/*
+ * Open a simulated BAR4: anonymous memory holding the power-on values of
+ * the registers the boot sequence reads.  There is no uio device behind
+ * it (fd is -1), so interrupts are unavailable; fm10k_close() releases it.
+ */
+int
+fm10k_sim_open(fm10k_t *fm10k)
+{
+    fm10k->fd = -1;
+    fm10k->size = FM10K_BAR4_SIZE;
+    fm10k->mmio = mmap(NULL, fm10k->size, PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if ( MAP_FAILED == fm10k->mmio ) {
+        perror("mmap");
+        return -1;
+    }
+    fm10k_sim_reset(fm10k);
+
+    return 0;
+}
+
+/*
+ * Return the simulated BAR4 to its power-on state
+ */
+void
+fm10k_sim_reset(fm10k_t *fm10k)
+{
+    memset(fm10k->mmio, 0, fm10k->size);
+
+    /* Switch ready, lock free, NVM with SOFT_RESET lock support */
+    wr32(fm10k->mmio, FM10K_SOFT_RESET, 1 << 3);
+    wr32(fm10k->mmio, FM10K_BSM_SCRATCH(2), 0);
+    wr32(fm10k->mmio, FM10K_BSM_SCRATCH(401), FM10K_SIM_NVM_VER);
+
+    /* FM10420 SKU, full feature code */
+    wr32(fm10k->mmio, FM10K_FUSE_DATA_0, 1 << 11);
+    wr32(fm10k->mmio, FM10K_PLL_FABRIC_LOCK, 0);
+
+    /* Both PLLs report lock; memory cannot drop it */
+    wr32(fm10k->mmio, FM10K_PLL_FABRIC_STAT, 1);
+    wr32(fm10k->mmio, FM10K_PLL_EPL_STAT, 1);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,654 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "snap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define W   FM10K_SNAP_WIDE
+#define V   FM10K_SNAP_VOLATILE
+
+/* Single register */
+#define REG(r, fl)          { #r, FM10K_##r, 1, 0, 1, 0, (fl) }
+/* Register array */
+#define ARR(r, n, fl)                                           \
+    { #r, FM10K_##r(0), (n), FM10K_##r(1) - FM10K_##r(0), 1, 0, (fl) }
+/* Two-dimensional register array */
+#define MAT(r, n, ni, fl)                                       \
+    { #r, FM10K_##r(0, 0), (n), FM10K_##r(1, 0) - FM10K_##r(0, 0),  \
+      (ni), FM10K_##r(0, 1) - FM10K_##r(0, 0), (fl) }
+/* Per-port register of the nine EPLs */
+#define EPL(r, fl)          MAT(r, 9, 4, fl)
+
+/* Header and section index entry sizes */
+#define HDR_SIZE    32
+#define IDX_SIZE    32
+
+/* Words compared at once before looking into the individual words */
+#define CMP_BLOCK   16
+
+/*
+ * Management
+ */
+static const fm10k_snap_reg_t _mgmt[] = {
+    REG(DEVICE_CFG, 0),
+    REG(SOFT_RESET, 0),
+    REG(BSM_CTRL, 0),
+    REG(BSM_ARGS, 0),
+    ARR(BSM_SCRATCH, 1024, 0),
+    REG(FUSE_DATA_0, 0),
+    REG(FUSE_DATA_1, 0),
+    REG(BIST_CTRL, W),
+    REG(SBUS_EPL_CFG, 0),
+    REG(SBUS_PCIE_CFG, 0),
+    REG(REI_CTRL, 0),
+    REG(REI_STAT, V),
+    REG(SCAN_DATA_IN, 0),
+    REG(LED_CFG, 0),
+    REG(PCIE_CTRL, 0),
+    REG(PCIE_CTRL_EXT, 0),
+    REG(PCIE_HOST_LANE_CTRL, 0),
+    REG(SYSTIME_CFG, 0),
+    REG(SYSTIME_INC, W),
+    REG(SYSTIME, W | V),
+};
+
+/*
+ * PLLs
+ */
+static const fm10k_snap_reg_t _pll[] = {
+    REG(PLL_EPL_CTRL, 0),
+    REG(PLL_EPL_STAT, V),
+    REG(PLL_FABRIC_CTRL, 0),
+    REG(PLL_FABRIC_STAT, V),
+    REG(PLL_FABRIC_LOCK, 0),
+    REG(PLL_PCIE_CTRL, 0),
+    REG(PLL_PCIE_STAT, V),
+};
+
+/*
+ * Interrupts
+ */
+static const fm10k_snap_reg_t _intr[] = {
+    REG(GLOBAL_INTERRUPT_DETECT, W | V),
+    REG(INTERRUPT_MASK_INT, W),
+    REG(INTERRUPT_MASK_PCIE, W),
+    REG(INTERRUPT_MASK_FIBM, W),
+    REG(INTERRUPT_MASK_BSM, W),
+    REG(CORE_INTERRUPT_DETECT, V),
+    REG(CORE_INTERRUPT_MASK, 0),
+    REG(PCIE_IP, V),
+    REG(PCIE_IM, 0),
+    REG(MA_TCN_IM, 0),
+    REG(FH_TAIL_IM, 0),
+    EPL(AN_IM, 0),
+    EPL(LINK_IM, 0),
+    EPL(AN_IP, V),
+    EPL(LINK_IP, V),
+};
+
+/*
+ * Ethernet port logic
+ */
+static const fm10k_snap_reg_t _epl[] = {
+    ARR(EPL_CFG_A, 9, 0),
+    ARR(EPL_CFG_B, 9, 0),
+    ARR(EPL_LED_STATUS, 9, V),
+    EPL(PORT_STATUS, V),
+    EPL(MP_CFG, 0),
+    EPL(LINK_RULES, 0),
+    EPL(MAC_CFG, 0),
+    EPL(PCS_1000BASEX_CFG, 0),
+    EPL(PCS_10GBASER_CFG, 0),
+    EPL(AN_37_CFG, 0),
+    EPL(AN_73_CFG, 0),
+    EPL(PCS_10GBASER_RX_STATUS, V),
+    EPL(MAC_LINK_COUNTER, V),
+    EPL(MAC_CODE_ERROR_COUNTER, V),
+};
+
+/*
+ * Scheduler
+ */
+static const fm10k_snap_reg_t _sched[] = {
+    REG(SCHED_SCHEDULE_CTRL, 0),
+    ARR(SCHED_RX_SCHEDULE, 1024, 0),
+    ARR(SCHED_TX_SCHEDULE, 1024, 0),
+    ARR(SCHED_SSCHED_RX_PERPORT, 48, 0),
+    ARR(SCHED_RXQ_STORAGE_POINTERS, 8, W),
+    REG(SCHED_RXQ_FREELIST_INIT, 0),
+    REG(SCHED_TXQ_FREELIST_INIT, 0),
+    REG(SCHED_FREELIST_INIT, 0),
+    ARR(SCHED_TXQ_HEAD_PERQ, 384, V),
+    ARR(SCHED_TXQ_TAIL0_PERQ, 384, V),
+    ARR(SCHED_TXQ_TAIL1_PERQ, 384, V),
+};
+
+/*
+ * Congestion management
+ */
+static const fm10k_snap_reg_t _cm[] = {
+    REG(CM_GLOBAL_WM, 0),
+    REG(CM_GLOBAL_CFG, 0),
+    REG(CM_GLOBAL_USAGE, V),
+    ARR(CM_SHARED_WM, 2, 0),
+    ARR(CM_SHARED_SMP_USAGE, 2, V),
+    MAT(CM_RX_SMP_PRIVATE_WM, 48, 2, 0),
+    MAT(CM_RX_SMP_PAUSE_WM, 48, 2, 0),
+    ARR(CM_TX_HOG_WM, 48, 0),
+    ARR(CM_TX_USAGE, 48, V),
+    REG(CM_APPLY_TC_TO_SMP, 0),
+};
+
+/*
+ * Sections of the register set
+ */
+static const struct {
+    const char *name;
+    const fm10k_snap_reg_t *regs;
+    int nregs;
+} _sections[] = {
+    { "mgmt", _mgmt, sizeof(_mgmt) / sizeof(_mgmt[0]) },
+    { "pll", _pll, sizeof(_pll) / sizeof(_pll[0]) },
+    { "intr", _intr, sizeof(_intr) / sizeof(_intr[0]) },
+    { "epl", _epl, sizeof(_epl) / sizeof(_epl[0]) },
+    { "sched", _sched, sizeof(_sched) / sizeof(_sched[0]) },
+    { "cm", _cm, sizeof(_cm) / sizeof(_cm[0]) },
+};
+
+#define NSECTIONS   (int)(sizeof(_sections) / sizeof(_sections[0]))
+
+/*
+ * Words of a register array
+ */
+static uint32_t
+_words(const fm10k_snap_reg_t *reg)
+{
+    return reg->n * reg->ni * ((reg->flags & W) ? 2 : 1);
+}
+
+/*
+ * FNV-1a checksum of a section
+ */
+static uint32_t
+_sum(const uint32_t *words, uint32_t n)
+{
+    uint32_t h;
+    uint32_t i;
+    int k;
+
+    h = 2166136261UL;
+    for ( i = 0; i < n; i++ ) {
+        for ( k = 0; k < 32; k += 8 ) {
+            h ^= (words[i] >> k) & 0xff;
+            h *= 16777619UL;
+        }
+    }
+
+    return h;
+}
+
+/*
+ * Little-endian encoding
+ */
+static void
+_put32(unsigned char *b, uint32_t v)
+{
+    b[0] = v;
+    b[1] = v >> 8;
+    b[2] = v >> 16;
+    b[3] = v >> 24;
+}
+
+static uint32_t
+_get32(const unsigned char *b)
+{
+    return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16)
+        | ((uint32_t)b[3] << 24);
+}
+
+/*
+ * Bind a section to the register set of this build
+ */
+static void
+_bind(fm10k_snap_sec_t *sec)
+{
+    uint32_t n;
+    int i;
+    int j;
+
+    sec->regs = NULL;
+    sec->nregs = 0;
+    for ( i = 0; i < NSECTIONS; i++ ) {
+        if ( strcmp(sec->name, _sections[i].name) != 0 ) {
+            continue;
+        }
+        n = 0;
+        for ( j = 0; j < _sections[i].nregs; j++ ) {
+            n += _words(&_sections[i].regs[j]);
+        }
+        if ( n == sec->nwords ) {
+            sec->regs = _sections[i].regs;
+            sec->nregs = _sections[i].nregs;
+        }
+        return;
+    }
+}
+
+/*
+ * Capture the register set
+ */
+int
+fm10k_snap_capture(fm10k_t *fm10k, fm10k_snap_t *snap)
+{
+    const fm10k_snap_reg_t *reg;
+    fm10k_snap_sec_t *sec;
+    uint32_t offset;
+    uint32_t *w;
+    uint64_t m64;
+    int s;
+    int r;
+    int j;
+    int i;
+
+    memset(snap, 0, sizeof(fm10k_snap_t));
+    snap->time = time(NULL);
+    for ( s = 0; s < NSECTIONS; s++ ) {
+        sec = &snap->secs[s];
+        snprintf(sec->name, sizeof(sec->name), "%s", _sections[s].name);
+        sec->regs = _sections[s].regs;
+        sec->nregs = _sections[s].nregs;
+        for ( r = 0; r < sec->nregs; r++ ) {
+            sec->nwords += _words(&sec->regs[r]);
+        }
+        sec->words = malloc(sizeof(uint32_t) * sec->nwords);
+        if ( NULL == sec->words ) {
+            fm10k_snap_free(snap);
+            return -1;
+        }
+        snap->nsecs++;
+
+        w = sec->words;
+        for ( r = 0; r < sec->nregs; r++ ) {
+            reg = &sec->regs[r];
+            for ( j = 0; j < reg->n; j++ ) {
+                for ( i = 0; i < reg->ni; i++ ) {
+                    offset = reg->offset + j * reg->stride + i * reg->istride;
+                    if ( reg->flags & W ) {
+                        m64 = rd64(fm10k->mmio, offset);
+                        *w++ = m64;
+                        *w++ = m64 >> 32;
+                    } else {
+                        *w++ = rd32(fm10k->mmio, offset);
+                    }
+                }
+            }
+        }
+        sec->sum = _sum(sec->words, sec->nwords);
+    }
+
+    return 0;
+}
+
+/*
+ * Release a snapshot
+ */
+void
+fm10k_snap_free(fm10k_snap_t *snap)
+{
+    int s;
+
+    for ( s = 0; s < snap->nsecs; s++ ) {
+        free(snap->secs[s].words);
+    }
+    memset(snap, 0, sizeof(fm10k_snap_t));
+}
+
+/*
+ * Write a snapshot:
+ *   header:  magic[8] version:32 nsections:32 time:64 reserved:64
+ *   index:   name[16] offset:32 nwords:32 sum:32 reserved:32 per section
+ *   data:    32-bit words of the sections; 64-bit registers low word first
+ * All fields are little-endian.
+ */
+int
+fm10k_snap_save(FILE *fp, const fm10k_snap_t *snap)
+{
+    unsigned char hdr[HDR_SIZE];
+    unsigned char idx[IDX_SIZE];
+    unsigned char *buf;
+    const fm10k_snap_sec_t *sec;
+    uint32_t offset;
+    uint32_t i;
+    int s;
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, FM10K_SNAP_MAGIC, 8);
+    _put32(hdr + 8, FM10K_SNAP_VERSION);
+    _put32(hdr + 12, snap->nsecs);
+    _put32(hdr + 16, snap->time);
+    _put32(hdr + 20, snap->time >> 32);
+    if ( fwrite(hdr, sizeof(hdr), 1, fp) != 1 ) {
+        return -1;
+    }
+
+    offset = HDR_SIZE + IDX_SIZE * snap->nsecs;
+    for ( s = 0; s < snap->nsecs; s++ ) {
+        sec = &snap->secs[s];
+        memset(idx, 0, sizeof(idx));
+        memcpy(idx, sec->name, FM10K_SNAP_NAME_LEN);
+        _put32(idx + 16, offset);
+        _put32(idx + 20, sec->nwords);
+        _put32(idx + 24, sec->sum);
+        if ( fwrite(idx, sizeof(idx), 1, fp) != 1 ) {
+            return -1;
+        }
+        offset += sec->nwords * 4;
+    }
+
+    for ( s = 0; s < snap->nsecs; s++ ) {
+        sec = &snap->secs[s];
+        buf = malloc(sec->nwords * 4 + 1);
+        if ( NULL == buf ) {
+            return -1;
+        }
+        for ( i = 0; i < sec->nwords; i++ ) {
+            _put32(buf + i * 4, sec->words[i]);
+        }
+        if ( fwrite(buf, 4, sec->nwords, fp) != sec->nwords ) {
+            free(buf);
+            return -1;
+        }
+        free(buf);
+    }
+
+    return 0;
+}
+
+/*
+ * Read a snapshot
+ */
+int
+fm10k_snap_load(FILE *fp, fm10k_snap_t *snap)
+{
+    unsigned char hdr[HDR_SIZE];
+    unsigned char idx[IDX_SIZE * FM10K_SNAP_MAX_SECTIONS];
+    unsigned char *buf;
+    fm10k_snap_sec_t *sec;
+    uint32_t offset;
+    uint32_t nsecs;
+    uint32_t i;
+    int s;
+
+    memset(snap, 0, sizeof(fm10k_snap_t));
+    if ( fread(hdr, sizeof(hdr), 1, fp) != 1
+         || memcmp(hdr, FM10K_SNAP_MAGIC, 8) != 0 ) {
+        fprintf(stderr, "Not a register snapshot\n");
+        return -1;
+    }
+    if ( _get32(hdr + 8) != FM10K_SNAP_VERSION ) {
+        fprintf(stderr, "Unsupported snapshot version %u\n", _get32(hdr + 8));
+        return -1;
+    }
+    nsecs = _get32(hdr + 12);
+    if ( nsecs > FM10K_SNAP_MAX_SECTIONS ) {
+        fprintf(stderr, "Too many sections: %u\n", nsecs);
+        return -1;
+    }
+    snap->time = _get32(hdr + 16) | ((uint64_t)_get32(hdr + 20) << 32);
+    if ( fread(idx, IDX_SIZE, nsecs, fp) != nsecs ) {
+        fprintf(stderr, "Truncated section index\n");
+        return -1;
+    }
+
+    for ( s = 0; s < (int)nsecs; s++ ) {
+        sec = &snap->secs[s];
+        memcpy(sec->name, idx + IDX_SIZE * s, FM10K_SNAP_NAME_LEN);
+        sec->name[FM10K_SNAP_NAME_LEN - 1] = '\0';
+        offset = _get32(idx + IDX_SIZE * s + 16);
+        sec->nwords = _get32(idx + IDX_SIZE * s + 20);
+        sec->sum = _get32(idx + IDX_SIZE * s + 24);
+        if ( sec->nwords > 0x1000000 ) {
+            fprintf(stderr, "Broken section %s\n", sec->name);
+            fm10k_snap_free(snap);
+            return -1;
+        }
+        sec->words = malloc(sizeof(uint32_t) * sec->nwords + 1);
+        buf = malloc(sec->nwords * 4 + 1);
+        if ( NULL == sec->words || NULL == buf ) {
+            free(buf);
+            free(sec->words);
+            fm10k_snap_free(snap);
+            return -1;
+        }
+        snap->nsecs++;
+        if ( fseek(fp, offset, SEEK_SET) != 0
+             || fread(buf, 4, sec->nwords, fp) != sec->nwords ) {
+            fprintf(stderr, "Truncated section %s\n", sec->name);
+            free(buf);
+            fm10k_snap_free(snap);
+            return -1;
+        }
+        for ( i = 0; i < sec->nwords; i++ ) {
+            sec->words[i] = _get32(buf + i * 4);
+        }
+        free(buf);
+        if ( _sum(sec->words, sec->nwords) != sec->sum ) {
+            fprintf(stderr, "Checksum mismatch in section %s\n", sec->name);
+            fm10k_snap_free(snap);
+            return -1;
+        }
+        _bind(sec);
+    }
+
+    return 0;
+}
+
+/*
+ * Symbolic name of entry e of a register array
+ */
+static void
+_name(char *buf, size_t size, const fm10k_snap_reg_t *reg, int e)
+{
+    if ( 1 == reg->n && 1 == reg->ni ) {
+        snprintf(buf, size, "%s", reg->name);
+    } else if ( 1 == reg->ni ) {
+        snprintf(buf, size, "%s[%d]", reg->name, e);
+    } else {
+        snprintf(buf, size, "%s[%d][%d]", reg->name, e / reg->ni,
+                 e % reg->ni);
+    }
+}
+
+/*
+ * First differing word in [from, to); whole blocks are compared with memcmp
+ * so that equal runs are skipped at the vector width of the C library
+ */
+static uint32_t
+_next_diff(const uint32_t *a, const uint32_t *b, uint32_t from, uint32_t to)
+{
+    while ( from + CMP_BLOCK <= to
+            && memcmp(a + from, b + from, CMP_BLOCK * 4) == 0 ) {
+        from += CMP_BLOCK;
+    }
+    while ( from < to && a[from] == b[from] ) {
+        from++;
+    }
+
+    return from;
+}
+
+/*
+ * Print the registers that differ between two snapshots; volatile registers
+ * are compared only when all is set.  Returns the number of differences.
+ */
+int
+fm10k_snap_diff(FILE *fp, const fm10k_snap_t *a, const fm10k_snap_t *b,
+                int all)
+{
+    const fm10k_snap_sec_t *sa;
+    const fm10k_snap_sec_t *sb;
+    const fm10k_snap_reg_t *reg;
+    char name[64];
+    uint32_t base;
+    uint32_t end;
+    uint32_t k;
+    int wpe;
+    int e;
+    int n;
+    int s;
+    int t;
+    int r;
+
+    n = 0;
+    for ( s = 0; s < a->nsecs; s++ ) {
+        sa = &a->secs[s];
+        sb = NULL;
+        for ( t = 0; t < b->nsecs; t++ ) {
+            if ( strcmp(sa->name, b->secs[t].name) == 0 ) {
+                sb = &b->secs[t];
+                break;
+            }
+        }
+        if ( NULL == sb || sa->nwords != sb->nwords ) {
+            fprintf(fp, "%-6s section layout differs\n", sa->name);
+            n++;
+            continue;
+        }
+        if ( sa->sum == sb->sum
+             && memcmp(sa->words, sb->words, sa->nwords * 4) == 0 ) {
+            continue;
+        }
+
+        if ( NULL == sa->regs ) {
+            /* Unknown to this build; report by word */
+            k = 0;
+            while ( (k = _next_diff(sa->words, sb->words, k, sa->nwords))
+                    < sa->nwords ) {
+                fprintf(fp, "%-6s +0x%-26x 0x%08x -> 0x%08x\n", sa->name,
+                        k * 4, sa->words[k], sb->words[k]);
+                n++;
+                k++;
+            }
+            continue;
+        }
+
+        base = 0;
+        for ( r = 0; r < sa->nregs; r++ ) {
+            reg = &sa->regs[r];
+            end = base + _words(reg);
+            wpe = (reg->flags & W) ? 2 : 1;
+            k = base;
+            while ( (all || !(reg->flags & V))
+                    && (k = _next_diff(sa->words, sb->words, k, end))
+                    < end ) {
+                e = (k - base) / wpe;
+                k = base + e * wpe;
+                _name(name, sizeof(name), reg, e);
+                if ( reg->flags & W ) {
+                    fprintf(fp, "%-6s %-28s 0x%016llx -> 0x%016llx\n",
+                            sa->name, name,
+                            ((unsigned long long)sa->words[k + 1] << 32)
+                            | sa->words[k],
+                            ((unsigned long long)sb->words[k + 1] << 32)
+                            | sb->words[k]);
+                } else {
+                    fprintf(fp, "%-6s %-28s 0x%08x -> 0x%08x\n", sa->name,
+                            name, sa->words[k], sb->words[k]);
+                }
+                n++;
+                k += wpe;
+            }
+            base = end;
+        }
+    }
+    for ( t = 0; t < b->nsecs; t++ ) {
+        for ( s = 0; s < a->nsecs; s++ ) {
+            if ( strcmp(a->secs[s].name, b->secs[t].name) == 0 ) {
+                break;
+            }
+        }
+        if ( s == a->nsecs ) {
+            fprintf(fp, "%-6s section layout differs\n", b->secs[t].name);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+/*
+ * Print the registers of a snapshot
+ */
+void
+fm10k_snap_print(FILE *fp, const fm10k_snap_t *snap, int all)
+{
+    const fm10k_snap_sec_t *sec;
+    const fm10k_snap_reg_t *reg;
+    char name[64];
+    uint32_t k;
+    int s;
+    int r;
+    int e;
+
+    for ( s = 0; s < snap->nsecs; s++ ) {
+        sec = &snap->secs[s];
+        if ( NULL == sec->regs ) {
+            fprintf(fp, "%-6s %u words (unknown layout)\n", sec->name,
+                    sec->nwords);
+            continue;
+        }
+        k = 0;
+        for ( r = 0; r < sec->nregs; r++ ) {
+            reg = &sec->regs[r];
+            for ( e = 0; e < reg->n * reg->ni; e++ ) {
+                if ( !all && (reg->flags & V) ) {
+                    k += (reg->flags & W) ? 2 : 1;
+                    continue;
+                }
+                _name(name, sizeof(name), reg, e);
+                if ( reg->flags & W ) {
+                    fprintf(fp, "%-6s %-28s 0x%016llx\n", sec->name, name,
+                            ((unsigned long long)sec->words[k + 1] << 32)
+                            | sec->words[k]);
+                    k += 2;
+                } else {
+                    fprintf(fp, "%-6s %-28s 0x%08x\n", sec->name, name,
+                            sec->words[k]);
+                    k++;
+                }
+            }
+        }
+    }
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,103 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _SNAP_H
+#define _SNAP_H
+
+#include "fm10k.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/* File format */
+#define FM10K_SNAP_MAGIC        "FM10KSNP"
+#define FM10K_SNAP_VERSION      1
+#define FM10K_SNAP_NAME_LEN     16
+#define FM10K_SNAP_MAX_SECTIONS 16
+
+/* Register flags */
+#define FM10K_SNAP_WIDE         1
+/* Status and counters; skipped by the diff unless asked for */
+#define FM10K_SNAP_VOLATILE     2
+
+/*
+ * Register array of the snapshot set; entry [j][i] is at
+ * offset + j * stride + i * istride
+ */
+typedef struct _fm10k_snap_reg {
+    const char *name;
+    uint32_t offset;
+    int n;
+    uint32_t stride;
+    int ni;
+    uint32_t istride;
+    int flags;
+} fm10k_snap_reg_t;
+
+/*
+ * Captured section
+ */
+typedef struct _fm10k_snap_sec {
+    char name[FM10K_SNAP_NAME_LEN];
+    uint32_t nwords;
+    uint32_t sum;
+    uint32_t *words;
+    /* Register set of the section; NULL when unknown to this build */
+    const fm10k_snap_reg_t *regs;
+    int nregs;
+} fm10k_snap_sec_t;
+
+/*
+ * Snapshot
+ */
+typedef struct _fm10k_snap {
+    uint64_t time;
+    int nsecs;
+    fm10k_snap_sec_t secs[FM10K_SNAP_MAX_SECTIONS];
+} fm10k_snap_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_snap_capture(fm10k_t *, fm10k_snap_t *);
+void fm10k_snap_free(fm10k_snap_t *);
+int fm10k_snap_save(FILE *, const fm10k_snap_t *);
+int fm10k_snap_load(FILE *, fm10k_snap_t *);
+int fm10k_snap_diff(FILE *, const fm10k_snap_t *, const fm10k_snap_t *,
+                    int);
+void fm10k_snap_print(FILE *, const fm10k_snap_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SNAP_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
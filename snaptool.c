@@ -0,0 +1,155 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "snap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-a] -o <snapshot> <uio device>\n"
+            "       %s [-a] <snapshot|uio device>\n"
+            "       %s [-a] <snapshot|uio device> <snapshot|uio device>\n"
+            "  -o  capture the register set into a snapshot\n"
+            "  -a  include status and counter registers\n"
+            "With one source the registers are printed, with two the "
+            "registers that\ndiffer are.\n", prog, prog, prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Read a snapshot file, or capture one from a device
+ */
+static int
+source(const char *path, fm10k_snap_t *snap)
+{
+    char magic[8];
+    fm10k_t fm10k;
+    FILE *fp;
+    int ret;
+
+    fp = fopen(path, "r");
+    if ( NULL == fp ) {
+        perror(path);
+        return -1;
+    }
+    if ( fread(magic, sizeof(magic), 1, fp) == 1
+         && memcmp(magic, FM10K_SNAP_MAGIC, sizeof(magic)) == 0 ) {
+        rewind(fp);
+        ret = fm10k_snap_load(fp, snap);
+        fclose(fp);
+        return ret;
+    }
+    fclose(fp);
+
+    if ( fm10k_open(&fm10k, path) < 0 ) {
+        return -1;
+    }
+    ret = fm10k_snap_capture(&fm10k, snap);
+    fm10k_close(&fm10k);
+
+    return ret;
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    fm10k_snap_t a;
+    fm10k_snap_t b;
+    const char *output;
+    FILE *fp;
+    int all;
+    int opt;
+    int ret;
+
+    output = NULL;
+    all = 0;
+    while ( (opt = getopt(argc, argv, "ao:")) != -1 ) {
+        switch ( opt ) {
+        case 'a':
+            all = 1;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( optind == argc || argc - optind > (NULL != output ? 1 : 2) ) {
+        usage(argv[0]);
+    }
+
+    if ( source(argv[optind], &a) < 0 ) {
+        return EXIT_FAILURE;
+    }
+
+    if ( NULL != output ) {
+        fp = fopen(output, "w");
+        if ( NULL == fp ) {
+            perror(output);
+            return EXIT_FAILURE;
+        }
+        ret = fm10k_snap_save(fp, &a);
+        if ( fclose(fp) != 0 || ret < 0 ) {
+            fprintf(stderr, "Failed to write %s\n", output);
+            return EXIT_FAILURE;
+        }
+        fm10k_snap_free(&a);
+        return EXIT_SUCCESS;
+    }
+
+    if ( argc - optind == 1 ) {
+        fm10k_snap_print(stdout, &a, all);
+        fm10k_snap_free(&a);
+        return EXIT_SUCCESS;
+    }
+
+    if ( source(argv[optind + 1], &b) < 0 ) {
+        return EXIT_FAILURE;
+    }
+    ret = fm10k_snap_diff(stdout, &a, &b, all);
+    fprintf(stderr, "%d registers differ\n", ret);
+    fm10k_snap_free(&a);
+    fm10k_snap_free(&b);
+
+    /* Exit status 1 when they differ, as diff(1) */
+    return ret > 0 ? 1 : EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,109 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "stats.h"
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Read the status and counters of an EPL port
+ */
+void
+fm10k_stats_read_port(fm10k_t *fm10k, const fm10k_port_cfg_t *cfg,
+                      fm10k_port_stats_t *st)
+{
+    int j;
+    int i;
+
+    j = cfg->epl;
+    i = cfg->lane;
+    memset(st, 0, sizeof(fm10k_port_stats_t));
+    st->logical = cfg->logical;
+    st->epl = j;
+    st->lane = i;
+    st->status = rd32(fm10k->mmio, FM10K_PORT_STATUS(j, i));
+    st->link = rd32(fm10k->mmio, FM10K_MAC_LINK_COUNTER(j, i));
+    st->code_errors = rd32(fm10k->mmio, FM10K_MAC_CODE_ERROR_COUNTER(j, i));
+    st->tx_frame_errors = rd32(fm10k->mmio,
+                               FM10K_EPL_TX_FRAME_ERROR_COUNTER(j, i));
+    st->oversize = rd32(fm10k->mmio, FM10K_MAC_OVERSIZE_COUNTER(j, i));
+    st->jabber = rd32(fm10k->mmio, FM10K_MAC_JABBER_COUNTER(j, i));
+    st->undersize = rd32(fm10k->mmio, FM10K_MAC_UNDERSIZE_COUNTER(j, i));
+    st->runt = rd32(fm10k->mmio, FM10K_MAC_RUNT_COUNTER(j, i));
+    st->overrun = rd32(fm10k->mmio, FM10K_MAC_OVERRUN_COUNTER(j, i));
+    st->underrun = rd32(fm10k->mmio, FM10K_MAC_UNDERRUN_COUNTER(j, i));
+    st->wake_errors = rd32(fm10k->mmio, FM10K_WAKE_ERROR_COUNTER(j, i));
+}
+
+/*
+ * Read the EPL ports of a port set; returns the number of ports read
+ */
+int
+fm10k_stats_read(fm10k_t *fm10k, const fm10k_ports_t *ports,
+                 fm10k_port_stats_t *st, int max)
+{
+    int n;
+    int i;
+
+    n = 0;
+    for ( i = 0; i < ports->n && n < max; i++ ) {
+        if ( ports->port[i].epl < 0 ) {
+            continue;
+        }
+        fm10k_stats_read_port(fm10k, &ports->port[i], &st[n]);
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Print port statistics
+ */
+void
+fm10k_stats_print(FILE *fp, const fm10k_port_stats_t *st, int n)
+{
+    int i;
+
+    fprintf(fp, "port epl lane link  fault  links codeerr txerr oversize "
+            "jabber undersize runt overrun underrun wake\n");
+    for ( i = 0; i < n; i++ ) {
+        fprintf(fp, "%4d %3d %4d %-5s %-6s %5u %7u %5u %8u %6u %9u %4u "
+                "%7u %8u %4u\n", st[i].logical, st[i].epl, st[i].lane,
+                (st[i].status & 1) ? "up" : "down",
+                (st[i].status & 2) ? "local"
+                : ((st[i].status & 4) ? "remote" : "-"),
+                st[i].link, st[i].code_errors, st[i].tx_frame_errors,
+                st[i].oversize, st[i].jabber, st[i].undersize, st[i].runt,
+                st[i].overrun, st[i].underrun, st[i].wake_errors);
+    }
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
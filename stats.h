@@ -0,0 +1,76 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "fm10k.h"
+#include "port.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * EPL port status and MAC error counters
+ */
+typedef struct _fm10k_port_stats {
+    int logical;
+    int epl;
+    int lane;
+    /* PORT_STATUS */
+    uint32_t status;
+    uint32_t link;
+    uint32_t code_errors;
+    uint32_t tx_frame_errors;
+    uint32_t oversize;
+    uint32_t jabber;
+    uint32_t undersize;
+    uint32_t runt;
+    uint32_t overrun;
+    uint32_t underrun;
+    uint32_t wake_errors;
+} fm10k_port_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_stats_read_port(fm10k_t *, const fm10k_port_cfg_t *,
+                           fm10k_port_stats_t *);
+int fm10k_stats_read(fm10k_t *, const fm10k_ports_t *, fm10k_port_stats_t *,
+                     int);
+void fm10k_stats_print(FILE *, const fm10k_port_stats_t *, int);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _STATS_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
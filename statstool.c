@@ -0,0 +1,109 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "libfm10k.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * Usage
+ */
+void
+usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-i interval] <uio device>\n"
+            "  -c config    port set (default: built-in)\n"
+            "  -i interval  repeat every interval seconds\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Main routine
+ */
+int
+main(int argc, char *const argv[])
+{
+    static fm10k_conf_t conf;
+    fm10k_port_stats_t st[FM10K_PORT_MAX];
+    const char *path;
+    fm10k_t fm10k;
+    FILE *fp;
+    int interval;
+    int opt;
+    int ret;
+    int n;
+
+    path = NULL;
+    interval = 0;
+    while ( (opt = getopt(argc, argv, "c:i:")) != -1 ) {
+        switch ( opt ) {
+        case 'c':
+            path = optarg;
+            break;
+        case 'i':
+            interval = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if ( argc - optind != 1 || interval < 0 ) {
+        usage(argv[0]);
+    }
+
+    fm10k_conf_default(&conf);
+    if ( NULL != path ) {
+        fp = fopen(path, "r");
+        if ( NULL == fp ) {
+            perror(path);
+            return EXIT_FAILURE;
+        }
+        ret = fm10k_conf_load(fp, &conf);
+        fclose(fp);
+        if ( ret < 0 ) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if ( fm10k_open(&fm10k, argv[optind]) < 0 ) {
+        return EXIT_FAILURE;
+    }
+    do {
+        n = fm10k_stats_read(&fm10k, &conf.ports, st, FM10K_PORT_MAX);
+        fm10k_stats_print(stdout, st, n);
+        fflush(stdout);
+    } while ( interval > 0 && sleep(interval) == 0 );
+    fm10k_close(&fm10k);
+
+    return EXIT_SUCCESS;
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
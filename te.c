@@ -0,0 +1,310 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "te.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/*
+ * MAC address to a 48-bit register value
+ */
+static uint64_t
+_mac64(const uint8_t *mac)
+{
+    uint64_t m64;
+    int i;
+
+    m64 = 0;
+    for ( i = 0; i < 6; i++ ) {
+        m64 = (m64 << 8) | mac[i];
+    }
+
+    return m64;
+}
+
+/*
+ * Sort key of a tunnel
+ */
+typedef struct _weightkey {
+    uint32_t weight;
+    int index;
+} weightkey_t;
+
+/*
+ * Order tunnels by descending weight and then by position
+ */
+static int
+_weight_cmp(const void *a, const void *b)
+{
+    const weightkey_t *ka;
+    const weightkey_t *kb;
+
+    ka = a;
+    kb = b;
+    if ( ka->weight != kb->weight ) {
+        return ka->weight > kb->weight ? -1 : 1;
+    }
+
+    return ka->index - kb->index;
+}
+
+/*
+ * Default configuration: 4096 VXLAN/NVGRE tunnels per engine
+ */
+void
+fm10k_te_default_cfg(fm10k_te_cfg_t *cfg)
+{
+    memset(cfg, 0, sizeof(fm10k_te_cfg_t));
+    cfg->encap_glort[0] = 0x2000;
+    cfg->encap_glort[1] = 0x3000;
+    cfg->encap_bits = FM10K_TE_MAX_BITS;
+    cfg->decap_glort[0] = 0x1ff0;
+    cfg->decap_glort[1] = 0x1ff1;
+    cfg->vxlan_port = 4789;
+    cfg->ttl = 64;
+}
+
+/*
+ * Initialize both tunnel engines: default outer header and the DGLORT
+ * ranges that select encapsulation (indexed by DGLORT) and decapsulation
+ * (indexed by VNI).
+ */
+int
+fm10k_te_init(fm10k_te_t *te, fm10k_t *fm10k, const fm10k_te_cfg_t *cfg)
+{
+    uint64_t m64;
+    uint16_t mask;
+    int j;
+
+    if ( cfg->encap_bits <= 0 || cfg->encap_bits > FM10K_TE_MAX_BITS ) {
+        return -1;
+    }
+    mask = (uint16_t)(0xffff << cfg->encap_bits);
+    if ( (cfg->encap_glort[0] & ~mask) || (cfg->encap_glort[1] & ~mask)
+         || cfg->encap_glort[0] == cfg->encap_glort[1] ) {
+        fprintf(stderr, "TE: misaligned or overlapping encap GLORTs\n");
+        return -1;
+    }
+
+    memset(te, 0, sizeof(fm10k_te_t));
+    te->fm10k = fm10k;
+    te->cfg = *cfg;
+
+    for ( j = 0; j < FM10K_TE_ENGINES; j++ ) {
+        /* OuterTTL | OuterTOS */
+        m64 = rd64(fm10k->mmio, FM10K_TE_CFG(j));
+        m64 = (m64 & ~0xffffULL) | cfg->ttl | ((uint64_t)cfg->tos << 8);
+        wr64(fm10k->mmio, FM10K_TE_CFG(j), m64);
+
+        wr64(fm10k->mmio, FM10K_TE_DEFAULT_SMAC(j), _mac64(cfg->smac));
+        wr64(fm10k->mmio, FM10K_TE_DEFAULT_DMAC(j), _mac64(cfg->dmac));
+        wr32(fm10k->mmio, FM10K_TE_DEFAULT_SIP(j), ntohl(cfg->sip));
+        wr32(fm10k->mmio, FM10K_TE_DEFAULT_L4DST(j), cfg->vxlan_port);
+
+        /* Encapsulation: DGLORT range, one lookup per tunnel */
+        wr64(fm10k->mmio, FM10K_TE_DGLORT_MAP(j, 0),
+             cfg->encap_glort[j] | ((uint64_t)mask << 16));
+        wr64(fm10k->mmio, FM10K_TE_DGLORT_DEC(j, 0),
+             0 | ((uint64_t)cfg->encap_bits << 15) | (1ULL << 19));
+
+        /* Decapsulation: exact DGLORT, lookup indexed by VNI */
+        wr64(fm10k->mmio, FM10K_TE_DGLORT_MAP(j, 1),
+             cfg->decap_glort[j] | (0xffffULL << 16));
+        wr64(fm10k->mmio, FM10K_TE_DGLORT_DEC(j, 1),
+             FM10K_TE_DECAP_LOOKUP | (12ULL << 15));
+    }
+
+    return 0;
+}
+
+/*
+ * Provision a batch of tunnels.  Tunnels are assigned heaviest first to the
+ * least-loaded engine, then all TE_DATA records are written before any
+ * TE_LOOKUP entry points at them.  The assigned engine, index and DGLORT
+ * are returned in each tunnel.
+ */
+int
+fm10k_te_add_tunnels(fm10k_te_t *te, fm10k_tunnel_t *t, int n)
+{
+    weightkey_t *order;
+    int cap;
+    int e;
+    int i;
+    int j;
+    int k;
+    uint64_t m64;
+
+    cap = 1 << te->cfg.encap_bits;
+    for ( i = 0; i < n; i++ ) {
+        if ( (t[i].type != FM10K_TUNNEL_VXLAN
+              && t[i].type != FM10K_TUNNEL_NVGRE) || t[i].vni >> 24 ) {
+            fprintf(stderr, "TE: invalid tunnel #%d\n", i);
+            return -1;
+        }
+    }
+    if ( n > 2 * cap - te->count[0] - te->count[1] ) {
+        fprintf(stderr, "TE: not enough tunnel entries\n");
+        return -1;
+    }
+
+    order = malloc(sizeof(weightkey_t) * (n > 0 ? n : 1));
+    if ( NULL == order ) {
+        return -1;
+    }
+    for ( i = 0; i < n; i++ ) {
+        order[i].weight = t[i].weight;
+        order[i].index = i;
+    }
+    qsort(order, n, sizeof(weightkey_t), _weight_cmp);
+
+    /* Assign engines and indices */
+    for ( k = 0; k < n; k++ ) {
+        i = order[k].index;
+        e = (te->count[0] >= cap
+             || (te->count[1] < cap && te->load[1] < te->load[0])) ? 1 : 0;
+        j = 0;
+        while ( te->used[e][j / 64] & (1ULL << (j % 64)) ) {
+            j++;
+        }
+        te->used[e][j / 64] |= 1ULL << (j % 64);
+        te->weight[e][j] = t[i].weight ? t[i].weight : 1;
+        te->load[e] += te->weight[e][j];
+        te->count[e]++;
+        t[i].engine = e;
+        t[i].index = j;
+        t[i].dglort = te->cfg.encap_glort[e] + j;
+    }
+    free(order);
+
+    /* Data first, then lookups */
+    for ( i = 0; i < n; i++ ) {
+        m64 = ntohl(t[i].dip) | ((uint64_t)t[i].vni << 32)
+            | ((uint64_t)t[i].type << 56);
+        wr64(te->fm10k->mmio, FM10K_TE_DATA(t[i].engine, 2 * t[i].index),
+             m64);
+        wr64(te->fm10k->mmio, FM10K_TE_DATA(t[i].engine, 2 * t[i].index + 1),
+             _mac64(t[i].dmac));
+    }
+    for ( i = 0; i < n; i++ ) {
+        /* DataPointer | DataLength */
+        m64 = (2 * t[i].index) | (2ULL << 15);
+        wr64(te->fm10k->mmio, FM10K_TE_LOOKUP(t[i].engine, t[i].index), m64);
+    }
+
+    return 0;
+}
+
+/*
+ * Remove a tunnel
+ */
+int
+fm10k_te_del_tunnel(fm10k_te_t *te, const fm10k_tunnel_t *t)
+{
+    int e;
+    int j;
+
+    e = t->engine;
+    j = t->index;
+    if ( e < 0 || e >= FM10K_TE_ENGINES || j < 0
+         || j >= (1 << te->cfg.encap_bits)
+         || !(te->used[e][j / 64] & (1ULL << (j % 64))) ) {
+        return -1;
+    }
+    wr64(te->fm10k->mmio, FM10K_TE_LOOKUP(e, j), 0);
+    te->used[e][j / 64] &= ~(1ULL << (j % 64));
+    te->load[e] -= te->weight[e][j];
+    te->count[e]--;
+
+    return 0;
+}
+
+/*
+ * Map a VNI/VSID to the inner DGLORT and VLAN after decapsulation (on both
+ * engines, since either may receive the tunneled frame)
+ */
+int
+fm10k_te_add_decap(fm10k_te_t *te, uint32_t vni, uint16_t dglort,
+                   uint16_t vlan)
+{
+    uint64_t m64;
+    int slot;
+    int j;
+
+    if ( vni >> 24 || vlan >> 12 ) {
+        return -1;
+    }
+    slot = vni % FM10K_TE_DECAP_ENTRIES;
+    if ( (te->decap_used[slot / 64] & (1ULL << (slot % 64)))
+         && te->decap[slot] != vni ) {
+        fprintf(stderr, "TE: VNI %u collides with VNI %u\n", vni,
+                te->decap[slot]);
+        return -1;
+    }
+
+    m64 = dglort | ((uint64_t)vlan << 16) | ((uint64_t)vni << 32);
+    for ( j = 0; j < FM10K_TE_ENGINES; j++ ) {
+        wr64(te->fm10k->mmio, FM10K_TE_DATA(j, FM10K_TE_DECAP_DATA + slot),
+             m64);
+        wr64(te->fm10k->mmio, FM10K_TE_LOOKUP(j, FM10K_TE_DECAP_LOOKUP + slot),
+             (FM10K_TE_DECAP_DATA + slot) | (1ULL << 15));
+    }
+    te->decap[slot] = vni;
+    te->decap_used[slot / 64] |= 1ULL << (slot % 64);
+
+    return 0;
+}
+
+/*
+ * Remove a VNI/VSID decapsulation entry
+ */
+int
+fm10k_te_del_decap(fm10k_te_t *te, uint32_t vni)
+{
+    int slot;
+    int j;
+
+    slot = vni % FM10K_TE_DECAP_ENTRIES;
+    if ( !(te->decap_used[slot / 64] & (1ULL << (slot % 64)))
+         || te->decap[slot] != vni ) {
+        return -1;
+    }
+    for ( j = 0; j < FM10K_TE_ENGINES; j++ ) {
+        wr64(te->fm10k->mmio,
+             FM10K_TE_LOOKUP(j, FM10K_TE_DECAP_LOOKUP + slot), 0);
+    }
+    te->decap_used[slot / 64] &= ~(1ULL << (slot % 64));
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,126 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _TE_H
+#define _TE_H
+
+#include "fm10k.h"
+#include <stdint.h>
+
+#define FM10K_TE_ENGINES        2
+#define FM10K_TE_MAX_BITS       12
+#define FM10K_TE_MAX_TUNNELS    (1 << FM10K_TE_MAX_BITS)
+#define FM10K_TE_DECAP_ENTRIES  4096
+
+/* Tunnel types */
+#define FM10K_TUNNEL_VXLAN      0
+#define FM10K_TUNNEL_NVGRE      1
+
+/*
+ * TE_LOOKUP/TE_DATA layout
+ *   Encap lookup [i] -> TE_DATA[2i..2i+1]
+ *     [0] 31:0 DIP, 55:32 VNI/VSID, 57:56 Type
+ *     [1] 47:0 Next-hop DMAC (0: TE_DEFAULT_DMAC)
+ *   Decap lookup [FM10K_TE_DECAP_LOOKUP + (VNI % 4096)]
+ *     -> TE_DATA[FM10K_TE_DECAP_DATA + (VNI % 4096)]
+ *     [0] 15:0 Inner DGLORT, 27:16 VLAN, 55:32 VNI/VSID
+ */
+#define FM10K_TE_DECAP_LOOKUP   8192
+#define FM10K_TE_DECAP_DATA     16384
+
+/*
+ * Tunnel engine configuration
+ */
+typedef struct _fm10k_te_cfg {
+    /* First DGLORT steering frames into each engine for encapsulation */
+    uint16_t encap_glort[FM10K_TE_ENGINES];
+    /* log2 of the number of tunnels per engine */
+    int encap_bits;
+    /* DGLORT of tunneled frames to decapsulate */
+    uint16_t decap_glort[FM10K_TE_ENGINES];
+    /* Default outer header */
+    uint8_t smac[6];
+    uint8_t dmac[6];
+    uint32_t sip;
+    uint16_t vxlan_port;
+    uint8_t ttl;
+    uint8_t tos;
+} fm10k_te_cfg_t;
+
+/*
+ * Tunnel endpoint
+ */
+typedef struct _fm10k_tunnel {
+    int type;
+    uint32_t vni;
+    /* Remote endpoint (network byte order) and next hop */
+    uint32_t dip;
+    uint8_t dmac[6];
+    /* Expected load used to spread tunnels over the engines */
+    uint32_t weight;
+    /* Assigned by fm10k_te_add_tunnels() */
+    int engine;
+    int index;
+    uint16_t dglort;
+} fm10k_tunnel_t;
+
+/*
+ * Tunnel engine manager
+ */
+typedef struct _fm10k_te {
+    fm10k_t *fm10k;
+    fm10k_te_cfg_t cfg;
+    uint64_t used[FM10K_TE_ENGINES][FM10K_TE_MAX_TUNNELS / 64];
+    uint32_t weight[FM10K_TE_ENGINES][FM10K_TE_MAX_TUNNELS];
+    uint64_t load[FM10K_TE_ENGINES];
+    int count[FM10K_TE_ENGINES];
+    uint32_t decap[FM10K_TE_DECAP_ENTRIES];
+    uint64_t decap_used[FM10K_TE_DECAP_ENTRIES / 64];
+} fm10k_te_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_te_default_cfg(fm10k_te_cfg_t *);
+int fm10k_te_init(fm10k_te_t *, fm10k_t *, const fm10k_te_cfg_t *);
+int fm10k_te_add_tunnels(fm10k_te_t *, fm10k_tunnel_t *, int);
+int fm10k_te_del_tunnel(fm10k_te_t *, const fm10k_tunnel_t *);
+int fm10k_te_add_decap(fm10k_te_t *, uint32_t, uint16_t, uint16_t);
+int fm10k_te_del_decap(fm10k_te_t *, uint32_t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TE_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
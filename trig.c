@@ -0,0 +1,300 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "trig.h"
+#include "policer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+
+/*
+ * Receive loop of the sample consumer: frames are received directly into
+ * the next free ring slot and published without copying
+ */
+static void *
+_sampler_loop(void *arg)
+{
+    fm10k_sampler_t *s;
+    fm10k_sample_t *slot;
+    fm10k_sample_t discard;
+    struct sockaddr_ll sll;
+    socklen_t alen;
+    struct pollfd pfd;
+    struct timespec ts;
+    ssize_t nr;
+
+    s = arg;
+    pfd.fd = s->fd;
+    pfd.events = POLLIN;
+    while ( atomic_load_explicit(&s->running, memory_order_relaxed) ) {
+        if ( poll(&pfd, 1, 100) <= 0 ) {
+            continue;
+        }
+        slot = fm10k_ring_slot(&s->ring);
+        if ( NULL == slot ) {
+            /* Ring full: drain the socket and account the drop */
+            slot = &discard;
+        }
+        alen = sizeof(sll);
+        nr = recvfrom(s->fd, slot->data, FM10K_SAMPLE_HDR_LEN, MSG_TRUNC,
+                      (struct sockaddr *)&sll, &alen);
+        if ( nr < 0 || PACKET_OUTGOING == sll.sll_pkttype ) {
+            /* Not a mirrored copy; the slot is reused */
+            continue;
+        }
+        if ( slot == &discard ) {
+            atomic_fetch_add_explicit(&s->dropped, 1, memory_order_relaxed);
+            continue;
+        }
+        clock_gettime(CLOCK_REALTIME, &ts);
+        slot->ts_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        slot->len = nr;
+        slot->caplen = nr < FM10K_SAMPLE_HDR_LEN ? nr : FM10K_SAMPLE_HDR_LEN;
+        fm10k_ring_commit(&s->ring);
+        atomic_fetch_add_explicit(&s->received, 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+/*
+ * Find another trigger limited by a rate limiter; returns -1 if none
+ */
+static int
+_limiter_user(fm10k_t *fm10k, int lim, int trig)
+{
+    int t;
+
+    for ( t = 0; t < FM10K_TRIGGERS; t++ ) {
+        if ( t == trig ) {
+            continue;
+        }
+        if ( ((rd32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_1(t)) >> 6) & 3)
+             && (rd32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_2(t)) & 0xf)
+             == (uint32_t)lim ) {
+            return t;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Configure a trigger to sample (mirror) matching frames to the host.  The
+ * effective 1-in-N sampling rate is returned in *effective for export.  A
+ * rate limiter in use by another trigger at a different rate is refused.
+ */
+int
+fm10k_trig_set_sample(fm10k_t *fm10k, int trig,
+                      const fm10k_trig_sample_cfg_t *cfg, uint32_t *effective)
+{
+    uint32_t m32;
+    uint32_t rate;
+    uint32_t lcfg;
+    int lim;
+    int user;
+    int k;
+
+    if ( trig < 0 || trig >= FM10K_TRIGGERS || 0 == cfg->rate
+         || cfg->mirror_port < 0 || cfg->mirror_port >= 48 ) {
+        return -1;
+    }
+
+    /* Rate | Capacity (10 ms worth of samples, at least 1) */
+    lim = cfg->rate_limiter;
+    lcfg = 0;
+    if ( cfg->max_pps ) {
+        if ( lim < 0 || lim >= FM10K_TRIG_RATE_LIMITERS
+             || fm10k_policer_encode(cfg->max_pps, &rate) < 0 ) {
+            return -1;
+        }
+        m32 = cfg->max_pps / 100;
+        if ( m32 > 0xfff ) {
+            m32 = 0xfff;
+        } else if ( 0 == m32 ) {
+            m32 = 1;
+        }
+        lcfg = rate | (m32 << 16);
+        user = _limiter_user(fm10k, lim, trig);
+        if ( user >= 0
+             && rd32(fm10k->mmio, FM10K_TRIGGER_RATE_LIM_CFG_1(lim))
+             != lcfg ) {
+            fprintf(stderr, "Trigger rate limiter %d is used by trigger %d "
+                    "at another rate\n", lim, user);
+            return -1;
+        }
+    }
+
+    /* Nearest power of two: match with probability 2^-k */
+    k = 0;
+    while ( k < 31 && (1ULL << (k + 1)) <= cfg->rate ) {
+        k++;
+    }
+    if ( k < 31 && cfg->rate - (1U << k) > (1U << (k + 1)) - cfg->rate ) {
+        k++;
+    }
+    if ( effective ) {
+        *effective = 1U << k;
+    }
+
+    /* Disable while reconfiguring */
+    wr32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_1(trig), 0);
+
+    wr64(fm10k->mmio, FM10K_TRIGGER_CONDITION_RX(trig),
+         cfg->rx_ports ? cfg->rx_ports : ((1ULL << 48) - 1));
+    wr32(fm10k->mmio, FM10K_TRIGGER_CONDITION_PARAM(trig),
+         cfg->ffu_id | ((uint32_t)cfg->ffu_mask << 8));
+    /* MatchRx | MatchFFU | MatchRandom | RandomThreshold */
+    m32 = (1 << 0) | ((cfg->ffu_mask ? 1 : 0) << 1) | ((k ? 1 : 0) << 2)
+        | (k << 3);
+    wr32(fm10k->mmio, FM10K_TRIGGER_CONDITION_CFG(trig), m32);
+
+    /* MirrorPort | Truncate */
+    wr32(fm10k->mmio, FM10K_TRIGGER_ACTION_MIRROR(trig),
+         cfg->mirror_port | ((cfg->truncate ? 1 : 0) << 6));
+
+    if ( cfg->max_pps ) {
+        wr32(fm10k->mmio, FM10K_TRIGGER_RATE_LIM_CFG_1(lim), lcfg);
+        wr32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_2(trig), lim);
+    }
+
+    /* MirroringAction | RateLimitAction */
+    m32 = (1 << 4) | ((cfg->max_pps ? 1 : 0) << 6);
+    wr32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_1(trig), m32);
+
+    return 0;
+}
+
+/*
+ * Disable a trigger
+ */
+int
+fm10k_trig_clear(fm10k_t *fm10k, int trig)
+{
+    if ( trig < 0 || trig >= FM10K_TRIGGERS ) {
+        return -1;
+    }
+    wr32(fm10k->mmio, FM10K_TRIGGER_ACTION_CFG_1(trig), 0);
+    wr32(fm10k->mmio, FM10K_TRIGGER_CONDITION_CFG(trig), 0);
+
+    return 0;
+}
+
+/*
+ * Number of frames a trigger has fired on
+ */
+uint64_t
+fm10k_trig_count(fm10k_t *fm10k, int trig)
+{
+    return rd64(fm10k->mmio, FM10K_TRIGGER_STATS(trig));
+}
+
+/*
+ * Start consuming samples from the host interface into a ring of n slots
+ * (n a power of two); the interface must only receive the mirror
+ */
+int
+fm10k_sampler_start(fm10k_sampler_t *s, const char *ifname, int n)
+{
+    struct sockaddr_ll sll;
+
+    if ( n <= 0 || (n & (n - 1)) ) {
+        return -1;
+    }
+    memset(s, 0, sizeof(fm10k_sampler_t));
+    s->slots = malloc(sizeof(fm10k_sample_t) * n);
+    if ( NULL == s->slots ) {
+        return -1;
+    }
+    if ( fm10k_ring_init(&s->ring, s->slots, sizeof(fm10k_sample_t), n)
+         < 0 ) {
+        free(s->slots);
+        return -1;
+    }
+
+    s->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    if ( s->fd < 0 ) {
+        perror("socket");
+        free(s->slots);
+        return -1;
+    }
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = if_nametoindex(ifname);
+    if ( 0 == sll.sll_ifindex
+         || bind(s->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0 ) {
+        perror(ifname);
+        close(s->fd);
+        free(s->slots);
+        return -1;
+    }
+
+    atomic_store(&s->running, 1);
+    if ( pthread_create(&s->thread, NULL, _sampler_loop, s) != 0 ) {
+        close(s->fd);
+        free(s->slots);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Get the next sample (non-blocking); returns -1 if none is pending
+ */
+int
+fm10k_sampler_next(fm10k_sampler_t *s, fm10k_sample_t *sample)
+{
+    return fm10k_ring_pop(&s->ring, sample);
+}
+
+/*
+ * Stop the sample consumer
+ */
+void
+fm10k_sampler_stop(fm10k_sampler_t *s)
+{
+    atomic_store(&s->running, 0);
+    pthread_join(s->thread, NULL);
+    close(s->fd);
+    free(s->slots);
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
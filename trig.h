@@ -0,0 +1,114 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _TRIG_H
+#define _TRIG_H
+
+#include "fm10k.h"
+#include "ring.h"
+#include <pthread.h>
+#include <stdint.h>
+
+#define FM10K_TRIGGERS          64
+#define FM10K_TRIG_RATE_LIMITERS    16
+
+/* Bytes of each sampled frame kept by the consumer */
+#define FM10K_SAMPLE_HDR_LEN    128
+
+/*
+ * Sampling trigger configuration
+ */
+typedef struct _fm10k_trig_sample_cfg {
+    /* Ingress ports to sample (0: all) */
+    uint64_t rx_ports;
+    /* FFU trigger ID and mask to match (mask 0: any frame) */
+    uint8_t ffu_id;
+    uint8_t ffu_mask;
+    /* Sample 1 in rate frames (rounded to a power of two) */
+    uint32_t rate;
+    /* Logical port of the PCIe host interface receiving the samples */
+    int mirror_port;
+    /* Truncate the mirrored copies */
+    int truncate;
+    /* Upper bound on samples/s sent to the host (0: unlimited) */
+    uint32_t max_pps;
+    /* Rate limiter (0..15) enforcing max_pps; triggers may only share one
+       at the same rate */
+    int rate_limiter;
+} fm10k_trig_sample_cfg_t;
+
+/*
+ * Sampled frame
+ */
+typedef struct _fm10k_sample {
+    uint64_t ts_ns;
+    /* Length of the frame on the wire and of the captured header */
+    uint32_t len;
+    uint32_t caplen;
+    uint8_t data[FM10K_SAMPLE_HDR_LEN];
+} fm10k_sample_t;
+
+/*
+ * Host-side sample consumer.  The mirrored copies carry no marking, so
+ * every frame received on the interface is taken as a sample; the
+ * interface must be dedicated to the mirror.  Frames sent by the host are
+ * skipped.
+ */
+typedef struct _fm10k_sampler {
+    int fd;
+    fm10k_ring_t ring;
+    fm10k_sample_t *slots;
+    pthread_t thread;
+    atomic_int running;
+    /* Samples received and dropped because the ring was full */
+    atomic_uint_fast64_t received;
+    atomic_uint_fast64_t dropped;
+} fm10k_sampler_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_trig_set_sample(fm10k_t *, int, const fm10k_trig_sample_cfg_t *,
+                          uint32_t *);
+int fm10k_trig_clear(fm10k_t *, int);
+uint64_t fm10k_trig_count(fm10k_t *, int);
+int fm10k_sampler_start(fm10k_sampler_t *, const char *, int);
+int fm10k_sampler_next(fm10k_sampler_t *, fm10k_sample_t *);
+void fm10k_sampler_stop(fm10k_sampler_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TRIG_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
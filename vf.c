@@ -0,0 +1,445 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "vf.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define RXQCTL_ENABLE       (1UL << 0)
+#define RXQCTL_VF_SHIFT     2
+#define RXQCTL_OWNED_BY_VF  (1UL << 8)
+#define TXDCTL_ENABLE       (1UL << 14)
+#define TXQCTL_OWNED_BY_VF  (1UL << 6)
+
+/*
+ * Get the current time in nanoseconds
+ */
+static uint64_t
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Ceiling of log2
+ */
+static int
+_log2(int n)
+{
+    int b;
+
+    b = 0;
+    while ( (1 << b) < n ) {
+        b++;
+    }
+
+    return b;
+}
+
+/*
+ * Default pool: 64 VFs with two queue pairs and eight vectors each
+ */
+void
+fm10k_vf_default_cfg(fm10k_vf_cfg_t *cfg)
+{
+    cfg->nvfs = FM10K_VF_MAX;
+    cfg->queues = 2;
+    cfg->vectors = 8;
+    cfg->glort_base = 0x4100;
+    cfg->pf_port = 0;
+    cfg->timeout_us = 10000;
+}
+
+/*
+ * Lay out the resources of the whole VF pool in one pass: a single GLORT
+ * range, one contiguous queue block at the top of the queue space and one
+ * vector block above the PF vectors.  Nothing is enabled until
+ * fm10k_vf_enable() and fm10k_vf_commit().
+ */
+int
+fm10k_vf_init(fm10k_vf_t *vfm, fm10k_t *fm10k, fm10k_glort_t *glort,
+              const fm10k_vf_cfg_t *cfg)
+{
+    int qbase;
+    int vsi;
+    int i;
+
+    if ( cfg->nvfs <= 0 || cfg->nvfs > FM10K_VF_MAX ) {
+        fprintf(stderr, "Invalid number of VFs: %d\n", cfg->nvfs);
+        return -1;
+    }
+    if ( cfg->queues <= 0 || cfg->queues > FM10K_VF_QMAP_STRIDE
+         || (cfg->queues & (cfg->queues - 1))
+         || cfg->nvfs * cfg->queues >= FM10K_VF_QUEUES ) {
+        fprintf(stderr, "Invalid number of queues per VF: %d\n",
+                cfg->queues);
+        return -1;
+    }
+    if ( cfg->vectors <= 0 || cfg->nvfs * cfg->vectors
+         > FM10K_VF_VECTORS - FM10K_VF_VECTORS_PF ) {
+        fprintf(stderr, "Invalid number of vectors per VF: %d\n",
+                cfg->vectors);
+        return -1;
+    }
+    /* The DGLORT decoder takes the VF index from the low GLORT bits */
+    vsi = _log2(cfg->nvfs);
+    if ( cfg->glort_base & ((1U << vsi) - 1) ) {
+        fprintf(stderr, "VF GLORT base %04x is not aligned to %d VFs\n",
+                cfg->glort_base, 1 << vsi);
+        return -1;
+    }
+
+    memset(vfm, 0, sizeof(fm10k_vf_t));
+    vfm->fm10k = fm10k;
+    vfm->glort = glort;
+    vfm->cfg = *cfg;
+
+    if ( fm10k_glort_alloc_range(glort, cfg->glort_base, cfg->nvfs) < 0 ) {
+        return -1;
+    }
+
+    qbase = FM10K_VF_QUEUES - cfg->nvfs * cfg->queues;
+    for ( i = 0; i < cfg->nvfs; i++ ) {
+        vfm->vf[i].qbase = qbase + i * cfg->queues;
+        vfm->vf[i].glort = cfg->glort_base + i;
+        vfm->vf[i].vbase = FM10K_VF_VECTORS_PF + i * cfg->vectors;
+        vfm->dirty |= 1ULL << i;
+    }
+    vfm->dglort_dirty = 1;
+
+    return 0;
+}
+
+/*
+ * Hand the VFs in the mask to their guests (deferred until commit)
+ */
+int
+fm10k_vf_enable(fm10k_vf_t *vfm, uint64_t mask)
+{
+    int i;
+
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        if ( !(mask & (1ULL << i)) || vfm->vf[i].active ) {
+            continue;
+        }
+        if ( fm10k_glort_add_port(vfm->glort, vfm->vf[i].glort,
+                                  vfm->cfg.pf_port) < 0 ) {
+            return -1;
+        }
+        vfm->vf[i].active = 1;
+        vfm->dirty |= 1ULL << i;
+    }
+
+    return 0;
+}
+
+/*
+ * Return the queues of the VFs in the mask to the PF (deferred until
+ * commit)
+ */
+int
+fm10k_vf_disable(fm10k_vf_t *vfm, uint64_t mask)
+{
+    int i;
+
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        if ( !(mask & (1ULL << i)) || !vfm->vf[i].active ) {
+            continue;
+        }
+        if ( fm10k_glort_del_port(vfm->glort, vfm->vf[i].glort,
+                                  vfm->cfg.pf_port) < 0 ) {
+            return -1;
+        }
+        vfm->vf[i].active = 0;
+        vfm->dirty |= 1ULL << i;
+    }
+
+    return 0;
+}
+
+/*
+ * Write the queue and vector mapping of a VF
+ */
+static int
+_write_vf(fm10k_vf_t *vfm, int i)
+{
+    fm10k_vf_entry_t *vf;
+    uint32_t txq;
+    uint32_t rxq;
+    int q;
+    int v;
+    int j;
+    int n;
+
+    vf = &vfm->vf[i];
+    txq = 0;
+    rxq = 0;
+    if ( vf->active ) {
+        txq = TXQCTL_OWNED_BY_VF | i;
+        rxq = RXQCTL_OWNED_BY_VF | (i << RXQCTL_VF_SHIFT);
+    }
+
+    n = 0;
+    for ( j = 0; j < vfm->cfg.queues; j++ ) {
+        q = vf->qbase + j;
+        wr32(vfm->fm10k->mmio,
+             FM10K_PCIE_TQMAP(i * FM10K_VF_QMAP_STRIDE + j), q);
+        wr32(vfm->fm10k->mmio,
+             FM10K_PCIE_RQMAP(i * FM10K_VF_QMAP_STRIDE + j), q);
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_TX_SGLORT(q), vf->glort);
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_TXQCTL(q), txq);
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_RXQCTL(q), rxq);
+        n += 5;
+    }
+    /* Chain the vectors of the VF */
+    for ( j = 0; j < vfm->cfg.vectors; j++ ) {
+        v = vf->vbase + j;
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_ITR2(v), j ? v - 1 : v);
+        n++;
+    }
+
+    return n;
+}
+
+/*
+ * Write the mapping of all modified VFs, the VF pool GLORT decoder and the
+ * GLORT destinations.  Returns the number of register writes issued.
+ */
+int
+fm10k_vf_commit(fm10k_vf_t *vfm)
+{
+    uint64_t mask;
+    uint32_t m32;
+    int vsi;
+    int i;
+    int n;
+    int ret;
+
+    n = 0;
+    mask = vfm->dirty;
+    while ( mask ) {
+        i = __builtin_ctzll(mask);
+        mask &= mask - 1;
+        n += _write_vf(vfm, i);
+    }
+    vfm->dirty = 0;
+
+    if ( vfm->dglort_dirty ) {
+        /* One decoder entry serves the whole pool: VSI from the low GLORT
+           bits, RSS over the queues of the VF */
+        vsi = _log2(vfm->cfg.nvfs);
+        m32 = vfm->cfg.glort_base
+            | ((uint32_t)(0xffff << vsi) & 0xffff) << 16;
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_DGLORTMAP(FM10K_VF_DGLORT), m32);
+        m32 = _log2(vfm->cfg.queues) | (vsi << 4) | (1 << 7)
+            | (vfm->vf[0].qbase << 16);
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_DGLORTDEC(FM10K_VF_DGLORT), m32);
+        vfm->dglort_dirty = 0;
+        n += 2;
+    }
+
+    ret = fm10k_glort_commit(vfm->glort);
+    if ( ret < 0 ) {
+        return -1;
+    }
+
+    return n + ret;
+}
+
+/*
+ * Reset the VFs in the mask: stop all of their queues at once, wait for
+ * them to drain together and acknowledge the function level resets.  The
+ * mapping is left in place, so the guest driver can restart immediately.
+ */
+int
+fm10k_vf_reset(fm10k_vf_t *vfm, uint64_t mask)
+{
+    uint32_t m32;
+    uint64_t deadline;
+    int pending;
+    int ret;
+    int q;
+    int i;
+    int j;
+
+    mask &= vfm->cfg.nvfs < 64 ? (1ULL << vfm->cfg.nvfs) - 1 : ~0ULL;
+
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        if ( !(mask & (1ULL << i)) ) {
+            continue;
+        }
+        for ( j = 0; j < vfm->cfg.queues; j++ ) {
+            q = vfm->vf[i].qbase + j;
+            wr32(vfm->fm10k->mmio, FM10K_PCIE_TXDCTL(q), 0);
+            m32 = rd32(vfm->fm10k->mmio, FM10K_PCIE_RXQCTL(q));
+            wr32(vfm->fm10k->mmio, FM10K_PCIE_RXQCTL(q),
+                 m32 & ~RXQCTL_ENABLE);
+        }
+        /* Drop the interrupt moderation of the previous guest */
+        for ( j = 0; j < vfm->cfg.vectors; j++ ) {
+            wr32(vfm->fm10k->mmio, FM10K_PCIE_ITR(vfm->vf[i].vbase + j), 0);
+        }
+    }
+
+    /* Wait for all the queues of all the VFs in one loop */
+    ret = 0;
+    deadline = _now() + (uint64_t)vfm->cfg.timeout_us * 1000;
+    for ( ;; ) {
+        pending = 0;
+        for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+            if ( !(mask & (1ULL << i)) ) {
+                continue;
+            }
+            for ( j = 0; j < vfm->cfg.queues; j++ ) {
+                q = vfm->vf[i].qbase + j;
+                if ( (rd32(vfm->fm10k->mmio, FM10K_PCIE_TXDCTL(q))
+                      & TXDCTL_ENABLE)
+                     || (rd32(vfm->fm10k->mmio, FM10K_PCIE_RXQCTL(q))
+                         & RXQCTL_ENABLE) ) {
+                    pending++;
+                }
+            }
+        }
+        if ( 0 == pending ) {
+            break;
+        }
+        if ( _now() > deadline ) {
+            fprintf(stderr, "VF reset: %d queues did not stop\n", pending);
+            ret = -1;
+            break;
+        }
+    }
+
+    if ( mask & 0xffffffffULL ) {
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_PFVFLREC(0), (uint32_t)mask);
+    }
+    if ( mask >> 32 ) {
+        wr32(vfm->fm10k->mmio, FM10K_PCIE_PFVFLREC(1),
+             (uint32_t)(mask >> 32));
+    }
+
+    return ret;
+}
+
+/*
+ * Recycle the VFs in the mask for new guests.  The switch stops delivering
+ * to the VFs before their queues are reset and resumes afterwards; the
+ * queue, GLORT and vector layout itself is not reprogrammed.
+ */
+int
+fm10k_vf_reassign(fm10k_vf_t *vfm, uint64_t mask)
+{
+    uint64_t active;
+    int ret;
+    int i;
+
+    ret = 0;
+    active = 0;
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        if ( !(mask & (1ULL << i)) || !vfm->vf[i].active ) {
+            continue;
+        }
+        if ( fm10k_glort_del_port(vfm->glort, vfm->vf[i].glort,
+                                  vfm->cfg.pf_port) < 0 ) {
+            ret = -1;
+            break;
+        }
+        active |= 1ULL << i;
+    }
+    if ( 0 == ret && fm10k_glort_commit(vfm->glort) < 0 ) {
+        ret = -1;
+    }
+
+    if ( 0 == ret ) {
+        ret = fm10k_vf_reset(vfm, mask);
+    }
+
+    /* Resume delivery to the VFs removed above, also after a failure */
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        if ( (active & (1ULL << i))
+             && fm10k_glort_add_port(vfm->glort, vfm->vf[i].glort,
+                                     vfm->cfg.pf_port) < 0 ) {
+            ret = -1;
+        }
+    }
+    if ( fm10k_glort_commit(vfm->glort) < 0 ) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/*
+ * Reset all the VFs with a pending function level reset.  Returns the
+ * number of VFs reset.
+ */
+int
+fm10k_vf_poll(fm10k_vf_t *vfm)
+{
+    uint64_t mask;
+
+    mask = rd32(vfm->fm10k->mmio, FM10K_PCIE_PFVFLRE(0))
+        | (uint64_t)rd32(vfm->fm10k->mmio, FM10K_PCIE_PFVFLRE(1)) << 32;
+    mask &= vfm->cfg.nvfs < 64 ? (1ULL << vfm->cfg.nvfs) - 1 : ~0ULL;
+    if ( 0 == mask ) {
+        return 0;
+    }
+    if ( fm10k_vf_reset(vfm, mask) < 0 ) {
+        return -1;
+    }
+
+    return __builtin_popcountll(mask);
+}
+
+/*
+ * Print the VF resource map
+ */
+void
+fm10k_vf_print(FILE *fp, const fm10k_vf_t *vfm)
+{
+    const fm10k_vf_entry_t *vf;
+    int i;
+
+    fprintf(fp, "VF  State     GLORT  Queues    Vectors\n");
+    for ( i = 0; i < vfm->cfg.nvfs; i++ ) {
+        vf = &vfm->vf[i];
+        fprintf(fp, "%-3d %-9s %04x   %3d-%-3d   %3d-%-3d\n", i,
+                vf->active ? "active" : "idle", vf->glort, vf->qbase,
+                vf->qbase + vfm->cfg.queues - 1, vf->vbase,
+                vf->vbase + vfm->cfg.vectors - 1);
+    }
+}
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,111 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _VF_H
+#define _VF_H
+
+#include "fm10k.h"
+#include "glort.h"
+#include <stdio.h>
+#include <stdint.h>
+
+#define FM10K_VF_MAX            64
+#define FM10K_VF_QUEUES         256
+/* TQMAP/RQMAP entries per VF */
+#define FM10K_VF_QMAP_STRIDE    32
+/* Interrupt vectors; the first 256 belong to the PF */
+#define FM10K_VF_VECTORS        768
+#define FM10K_VF_VECTORS_PF     256
+/* DGLORTMAP/DGLORTDEC entry used for the VF pool */
+#define FM10K_VF_DGLORT         1
+
+/*
+ * VF pool configuration
+ */
+typedef struct _fm10k_vf_cfg {
+    int nvfs;
+    /* Queues per VF (power of two); the VF pool takes the top queues */
+    int queues;
+    /* Interrupt vectors per VF */
+    int vectors;
+    /* GLORT of VF 0; VF i uses glort_base + i */
+    uint16_t glort_base;
+    /* Logical port of the PCIe host interface */
+    int pf_port;
+    /* Queue drain timeout on reset */
+    int timeout_us;
+} fm10k_vf_cfg_t;
+
+/*
+ * Per-VF resources
+ */
+typedef struct _fm10k_vf_entry {
+    int active;
+    int qbase;
+    uint16_t glort;
+    int vbase;
+} fm10k_vf_entry_t;
+
+/*
+ * VF manager
+ */
+typedef struct _fm10k_vf {
+    fm10k_t *fm10k;
+    fm10k_glort_t *glort;
+    fm10k_vf_cfg_t cfg;
+    fm10k_vf_entry_t vf[FM10K_VF_MAX];
+    /* VFs whose mapping has to be written on the next commit */
+    uint64_t dirty;
+    int dglort_dirty;
+} fm10k_vf_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void fm10k_vf_default_cfg(fm10k_vf_cfg_t *);
+int fm10k_vf_init(fm10k_vf_t *, fm10k_t *, fm10k_glort_t *,
+                  const fm10k_vf_cfg_t *);
+int fm10k_vf_enable(fm10k_vf_t *, uint64_t);
+int fm10k_vf_disable(fm10k_vf_t *, uint64_t);
+int fm10k_vf_commit(fm10k_vf_t *);
+int fm10k_vf_reset(fm10k_vf_t *, uint64_t);
+int fm10k_vf_reassign(fm10k_vf_t *, uint64_t);
+int fm10k_vf_poll(fm10k_vf_t *);
+void fm10k_vf_print(FILE *, const fm10k_vf_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VF_H */
+
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,469 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "warm.h"
+#include "clock.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Expected contents of a register of the desired program
+ */
+typedef struct _state {
+    uint32_t offset;
+    int wide;
+    int mixed;
+    int loaded;
+    uint64_t known;
+    uint64_t value;
+} state_t;
+
+/*
+ * Register access operation
+ */
+static int
+_is_access(int op)
+{
+    return op <= FM10K_PROG_RMW64;
+}
+
+/*
+ * 64-bit register access
+ */
+static int
+_is_wide(int op)
+{
+    return FM10K_PROG_WR64 == op || FM10K_PROG_RMW64 == op;
+}
+
+/*
+ * Compare register offsets
+ */
+static int
+_cmp(const void *a, const void *b)
+{
+    uint32_t x;
+    uint32_t y;
+
+    x = *(const uint32_t *)a;
+    y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Find the state of a register
+ */
+static state_t *
+_find(state_t *states, int n, uint32_t offset)
+{
+    return bsearch(&offset, states, n, sizeof(state_t), _cmp);
+}
+
+/*
+ * Fold a register access into the expected contents
+ */
+static void
+_fold(state_t *s, const fm10k_prog_rec_t *rec)
+{
+    s->value = (s->value & ~rec->mask) | (rec->value & rec->mask);
+    s->known |= rec->mask;
+}
+
+/*
+ * Registers in the switch memories cleared at the release from reset; a
+ * removed entry is restored by writing zero
+ */
+static int
+_cleared(uint32_t offset)
+{
+    if ( offset >= FM10K_INGRESS_VID_TABLE(0)
+         && offset <= FM10K_INGRESS_VID_TABLE(4095) ) {
+        return 1;
+    }
+    if ( offset >= FM10K_EGRESS_VID_TABLE(0)
+         && offset <= FM10K_EGRESS_VID_TABLE(4095) ) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Check if the switch is out of reset and ready
+ */
+int
+fm10k_warm_ready(fm10k_t *fm10k)
+{
+    uint32_t m32;
+
+    /* SwitchReady=1, SwitchReset=0, EPLReset=0 */
+    m32 = rd32(fm10k->mmio, FM10K_SOFT_RESET);
+
+    return (m32 & 0xe) == (1 << 3);
+}
+
+/*
+ * Check if a change of the register needs a switch reset; the EPL port
+ * layout and the scheduler calendar cannot be changed under traffic
+ */
+int
+fm10k_warm_cold(uint32_t offset)
+{
+    uint32_t i;
+
+    for ( i = 0; i < 9; i++ ) {
+        if ( offset == FM10K_EPL_CFG_A(i) || offset == FM10K_EPL_CFG_B(i) ) {
+            return 1;
+        }
+    }
+    if ( offset >= FM10K_SCHED_RX_SCHEDULE(0)
+         && offset <= FM10K_SCHED_SCHEDULE_CTRL ) {
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Build the delta program that takes the switch from its current state to
+ * the desired program.  The current state is the persisted shadow program
+ * of the last apply when given, otherwise the registers are read back from
+ * the switch.  Accesses whose bits already hold the desired values are
+ * dropped, as are the polls, delays and barriers of the ordering domains
+ * left without a change.  Removed registers are only detected against a
+ * shadow.
+ */
+int
+fm10k_warm_diff(fm10k_t *fm10k, const fm10k_prog_t *shadow,
+                const fm10k_prog_t *desired, fm10k_prog_t *delta,
+                fm10k_warm_t *warm)
+{
+    uint32_t *offsets;
+    uint32_t *stale;
+    state_t *states;
+    state_t *s;
+    const fm10k_prog_rec_t *rec;
+    uint64_t full;
+    int nstates;
+    int nstale;
+    int changed;
+    int i;
+    int j;
+
+    memset(warm, 0, sizeof(fm10k_warm_t));
+
+    /* Registers of the desired program */
+    offsets = malloc(sizeof(uint32_t) * (desired->n + 1));
+    stale = malloc(sizeof(uint32_t) * ((shadow ? shadow->n : 0) + 1));
+    if ( NULL == offsets || NULL == stale ) {
+        free(offsets);
+        free(stale);
+        return -1;
+    }
+    j = 0;
+    for ( i = 0; i < desired->n; i++ ) {
+        if ( _is_access(desired->recs[i].op) ) {
+            offsets[j++] = desired->recs[i].offset;
+            warm->naccess++;
+        }
+    }
+    qsort(offsets, j, sizeof(uint32_t), _cmp);
+    nstates = 0;
+    for ( i = 0; i < j; i++ ) {
+        if ( 0 == nstates || offsets[nstates - 1] != offsets[i] ) {
+            offsets[nstates++] = offsets[i];
+        }
+    }
+    states = calloc(nstates + 1, sizeof(state_t));
+    if ( NULL == states ) {
+        free(offsets);
+        free(stale);
+        return -1;
+    }
+    for ( i = 0; i < nstates; i++ ) {
+        states[i].offset = offsets[i];
+        states[i].wide = -1;
+    }
+    free(offsets);
+    for ( i = 0; i < desired->n; i++ ) {
+        rec = &desired->recs[i];
+        if ( !_is_access(rec->op) ) {
+            continue;
+        }
+        s = _find(states, nstates, rec->offset);
+        if ( s->wide < 0 ) {
+            s->wide = _is_wide(rec->op);
+        } else if ( s->wide != _is_wide(rec->op) ) {
+            s->mixed = 1;
+        }
+    }
+
+    /* Contents left by the last apply */
+    nstale = 0;
+    for ( i = 0; NULL != shadow && i < shadow->n; i++ ) {
+        rec = &shadow->recs[i];
+        if ( !_is_access(rec->op) ) {
+            continue;
+        }
+        s = _find(states, nstates, rec->offset);
+        if ( NULL == s ) {
+            stale[nstale++] = rec->offset;
+            continue;
+        }
+        if ( s->wide != _is_wide(rec->op) ) {
+            s->mixed = 1;
+        }
+        _fold(s, rec);
+        s->loaded = 1;
+    }
+
+    /* Clear the removed registers first */
+    qsort(stale, nstale, sizeof(uint32_t), _cmp);
+    for ( i = 0; i < nstale; i++ ) {
+        if ( i > 0 && stale[i - 1] == stale[i] ) {
+            continue;
+        }
+        warm->nstale++;
+        if ( _cleared(stale[i]) ) {
+            fm10k_prog_wr64(delta, stale[i], 0);
+            warm->ndiff++;
+        } else {
+            if ( 0 == warm->ncold ) {
+                warm->cold_offset = stale[i];
+            }
+            warm->ncold++;
+        }
+    }
+    free(stale);
+
+    changed = 0;
+    for ( i = 0; i < desired->n; i++ ) {
+        rec = &desired->recs[i];
+        switch ( rec->op ) {
+        case FM10K_PROG_WR32:
+        case FM10K_PROG_WR64:
+        case FM10K_PROG_RMW32:
+        case FM10K_PROG_RMW64:
+            s = _find(states, nstates, rec->offset);
+            full = _is_wide(rec->op) ? ~0ULL : 0xffffffffULL;
+            if ( NULL == shadow && !s->loaded ) {
+                if ( s->wide ) {
+                    s->value = rd64(fm10k->mmio, rec->offset);
+                } else {
+                    s->value = rd32(fm10k->mmio, rec->offset);
+                }
+                s->known = full;
+                s->loaded = 1;
+                warm->nread++;
+            }
+            if ( !s->mixed && (s->known & rec->mask) == rec->mask
+                 && ((s->value ^ rec->value) & rec->mask & full) == 0 ) {
+                /* Already in place */
+                break;
+            }
+            if ( fm10k_prog_add(delta, rec->op, rec->offset, rec->value,
+                                rec->mask) < 0 ) {
+                free(states);
+                return -1;
+            }
+            _fold(s, rec);
+            warm->ndiff++;
+            if ( fm10k_warm_cold(rec->offset) ) {
+                if ( 0 == warm->ncold ) {
+                    warm->cold_offset = rec->offset;
+                }
+                warm->ncold++;
+            }
+            changed = 1;
+            break;
+        case FM10K_PROG_POLL32:
+        case FM10K_PROG_DELAY:
+            /* Waits for the changes of the domain */
+            if ( changed ) {
+                if ( fm10k_prog_add(delta, rec->op, rec->offset, rec->value,
+                                    rec->mask) < 0 ) {
+                    free(states);
+                    return -1;
+                }
+                delta->recs[delta->n - 1].timeout = rec->timeout;
+            }
+            break;
+        case FM10K_PROG_BARRIER:
+            if ( changed ) {
+                fm10k_prog_barrier(delta);
+            }
+            changed = 0;
+            break;
+        }
+    }
+    free(states);
+
+    return warm->ndiff;
+}
+
+/*
+ * Print the difference
+ */
+void
+fm10k_warm_print(FILE *fp, const fm10k_warm_t *warm)
+{
+    fprintf(fp, "Warm apply: %d of %d accesses differ", warm->ndiff,
+            warm->naccess);
+    if ( warm->nread ) {
+        fprintf(fp, ", %d registers read back", warm->nread);
+    }
+    if ( warm->nstale ) {
+        fprintf(fp, ", %d removed", warm->nstale);
+    }
+    if ( warm->ncold ) {
+        fprintf(fp, ", %d need a switch reset (first 0x%x)", warm->ncold,
+                warm->cold_offset);
+    }
+    fprintf(fp, "\n");
+}
+
+/*
+ * Check if the running switch can take a configuration without a reset;
+ * returns 1 when it is down or the profile needs another frame handler
+ * clock
+ */
+int
+fm10k_warm_check(fm10k_t *fm10k, int profile)
+{
+    fm10k_clock_t clk;
+    uint64_t hz;
+
+    if ( !fm10k_warm_ready(fm10k) ) {
+        printf("Switch is not ready; a cold boot is required\n");
+        return 1;
+    }
+
+    /* A new frame handler clock needs the switch in reset */
+    if ( fm10k_clock_plan(fm10k, profile, &clk) < 0 ) {
+        return -1;
+    }
+    hz = fm10k_clock_read(fm10k);
+    if ( hz != clk.fh_hz ) {
+        printf("Frame handler clock %.1f MHz, the profile needs %.1f MHz; "
+               "a cold boot is required\n", hz / 1e6, clk.fh_hz / 1e6);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Write the registers of the configuration that differ from the last
+ * applied program (last), or from the switch when last is empty; last is
+ * replaced by the new program.  Returns 1 when a change needs a switch
+ * reset, and then nothing is written.
+ */
+int
+fm10k_warm_write(fm10k_t *fm10k, const fm10k_conf_t *conf,
+                 fm10k_prog_t *last, const char *shadow, int dryrun,
+                 fm10k_warm_t *warm)
+{
+    fm10k_prog_t prog;
+    fm10k_prog_t delta;
+    int ret;
+
+    fm10k_prog_init(&prog);
+    fm10k_prog_init(&delta);
+    ret = fm10k_conf_compile(conf, &prog);
+    if ( ret >= 0 ) {
+        ret = fm10k_warm_diff(fm10k, last->n ? last : NULL, &prog, &delta,
+                              warm);
+    }
+    if ( ret >= 0 ) {
+        fm10k_warm_print(stdout, warm);
+        if ( warm->ncold ) {
+            printf("A cold boot is required\n");
+            ret = 1;
+        } else if ( dryrun ) {
+            ret = fm10k_prog_save(stdout, &delta);
+        } else {
+            ret = fm10k_prog_apply(fm10k, &delta);
+            if ( ret >= 0 && NULL != shadow ) {
+                ret = fm10k_prog_save_file(shadow, &prog);
+            }
+            if ( ret >= 0 ) {
+                fm10k_prog_free(last);
+                *last = prog;
+                fm10k_prog_init(&prog);
+            }
+        }
+    }
+    fm10k_prog_free(&prog);
+    fm10k_prog_free(&delta);
+    if ( ret < 0 ) {
+        fprintf(stderr, "Failed to apply the configuration\n");
+        return -1;
+    }
+
+    return ret > 0 ? 1 : 0;
+}
+
+/*
+ * Apply the configuration to a running switch by writing only the
+ * registers that differ from the shadow of the last apply (read into
+ * last), or from the switch when there is none; returns 1 when the switch
+ * is down or a change needs a switch reset, and then nothing is written
+ */
+int
+fm10k_warm_apply(fm10k_t *fm10k, const fm10k_conf_t *conf,
+                 const char *shadow, int dryrun, fm10k_prog_t *last)
+{
+    fm10k_warm_t warm;
+    FILE *fp;
+    int ret;
+
+    ret = fm10k_warm_check(fm10k, conf->profile);
+    if ( 0 != ret ) {
+        return ret;
+    }
+
+    fp = NULL;
+    if ( NULL != shadow ) {
+        fp = fopen(shadow, "r");
+    }
+    if ( NULL != fp ) {
+        if ( fm10k_prog_load(fp, last) < 0 ) {
+            fprintf(stderr, "Ignoring the broken shadow %s\n", shadow);
+            fm10k_prog_free(last);
+        }
+        fclose(fp);
+    }
+
+    return fm10k_warm_write(fm10k, conf, last, shadow, dryrun, &warm);
+}
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */
@@ -0,0 +1,78 @@
+/*_
+ * Copyright (c) 2018 Hirochika Asai <asai@jar.jp>
+ * All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _WARM_H
+#define _WARM_H
+
+#include "fm10k.h"
+#include "prog.h"
+#include "conf.h"
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Difference between the desired configuration and the live switch
+ */
+typedef struct _fm10k_warm {
+    /* Register accesses in the desired program */
+    int naccess;
+    /* Accesses that change the switch */
+    int ndiff;
+    /* Changed registers that only take effect through a switch reset */
+    int ncold;
+    uint32_t cold_offset;
+    /* Shadow registers no longer in the configuration */
+    int nstale;
+    /* Registers read back from the switch */
+    int nread;
+} fm10k_warm_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int fm10k_warm_ready(fm10k_t *);
+int fm10k_warm_cold(uint32_t);
+int fm10k_warm_diff(fm10k_t *, const fm10k_prog_t *, const fm10k_prog_t *,
+                    fm10k_prog_t *, fm10k_warm_t *);
+void fm10k_warm_print(FILE *, const fm10k_warm_t *);
+int fm10k_warm_check(fm10k_t *, int);
+int fm10k_warm_write(fm10k_t *, const fm10k_conf_t *, fm10k_prog_t *,
+                     const char *, int, fm10k_warm_t *);
+int fm10k_warm_apply(fm10k_t *, const fm10k_conf_t *, const char *, int,
+                     fm10k_prog_t *);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WARM_H */
+/*
+ * Local variables:
+ * tab-width: 4
+ * c-basic-offset: 4
+ * End:
+ * vim600: sw=4 ts=4 fdm=marker
+ * vim<600: sw=4 ts=4
+ */